@@ -0,0 +1,115 @@
+#include "Animation.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+// Index of the last key at or before time (0 if time is before every key)
+template <typename Key>
+static unsigned int FindKey(const std::vector<Key>& keys, float time)
+{
+	auto next = std::upper_bound(keys.begin(), keys.end(), time,
+		[](float t, const Key& key) { return t < key.Time; });
+	return next == keys.begin() ? 0 : (unsigned int)(next - keys.begin() - 1);
+}
+
+static XMVECTOR SampleVectorKeys(const std::vector<AnimationVectorKey>& keys, float time)
+{
+	unsigned int i = FindKey(keys, time);
+	if (i + 1 >= keys.size() || time <= keys[i].Time) { return XMLoadFloat3(&keys[i].Value); }
+	float t = (time - keys[i].Time) / (keys[i + 1].Time - keys[i].Time);
+	return XMVectorLerp(XMLoadFloat3(&keys[i].Value), XMLoadFloat3(&keys[i + 1].Value), t);
+}
+
+static XMVECTOR SampleQuatKeys(const std::vector<AnimationQuatKey>& keys, float time)
+{
+	unsigned int i = FindKey(keys, time);
+	if (i + 1 >= keys.size() || time <= keys[i].Time) { return XMLoadFloat4(&keys[i].Value); }
+	float t = (time - keys[i].Time) / (keys[i + 1].Time - keys[i].Time);
+	return XMQuaternionSlerp(XMLoadFloat4(&keys[i].Value), XMLoadFloat4(&keys[i + 1].Value), t);
+}
+
+void SampleClip(const Skeleton& skeleton, const AnimationClip& clip, float time, bool loop, JointPose* pose)
+{
+	// Wrap or clamp into the clip
+	if (clip.Duration <= 0.0f)
+		time = 0.0f;
+	else if (loop)
+	{
+		time = std::fmod(time, clip.Duration);
+		if (time < 0.0f) { time += clip.Duration; }
+	}
+	else
+		time = std::min(std::max(time, 0.0f), clip.Duration);
+
+	for (size_t j = 0; j < skeleton.Joints.size(); j++) { pose[j] = skeleton.Joints[j].BindPose; }
+	for (const AnimationChannel& channel : clip.Channels)
+	{
+		JointPose& joint = pose[channel.Joint];
+		if (!channel.Positions.empty()) { XMStoreFloat3(&joint.Translation, SampleVectorKeys(channel.Positions, time)); }
+		if (!channel.Rotations.empty()) { XMStoreFloat4(&joint.Rotation, SampleQuatKeys(channel.Rotations, time)); }
+		if (!channel.Scales.empty()) { XMStoreFloat3(&joint.Scale, SampleVectorKeys(channel.Scales, time)); }
+	}
+}
+
+void BlendPoses(JointPose* pose, const JointPose* other, float weight, unsigned int jointCount)
+{
+	for (unsigned int j = 0; j < jointCount; j++)
+	{
+		XMStoreFloat3(&pose[j].Translation,
+			XMVectorLerp(XMLoadFloat3(&pose[j].Translation), XMLoadFloat3(&other[j].Translation), weight));
+		XMStoreFloat3(&pose[j].Scale,
+			XMVectorLerp(XMLoadFloat3(&pose[j].Scale), XMLoadFloat3(&other[j].Scale), weight));
+
+		// Take the short way around, then renormalize the lerp
+		XMVECTOR from = XMLoadFloat4(&pose[j].Rotation);
+		XMVECTOR to = XMLoadFloat4(&other[j].Rotation);
+		if (XMVectorGetX(XMVector4Dot(from, to)) < 0.0f) { to = XMVectorNegate(to); }
+		XMStoreFloat4(&pose[j].Rotation, XMQuaternionNormalize(XMVectorLerp(from, to, weight)));
+	}
+}
+
+void BuildSkinPalette(const Skeleton& skeleton, const JointPose* pose,
+	XMFLOAT4X4* jointGlobals, XMFLOAT4X4* palette)
+{
+	// Joints are stored parents first, so one pass gives every model space transform
+	for (size_t j = 0; j < skeleton.Joints.size(); j++)
+	{
+		XMMATRIX local = XMMatrixAffineTransformation(XMLoadFloat3(&pose[j].Scale), XMVectorZero(),
+			XMLoadFloat4(&pose[j].Rotation), XMLoadFloat3(&pose[j].Translation));
+		int parent = skeleton.Joints[j].Parent;
+		if (parent >= 0) { local = local * XMLoadFloat4x4(&jointGlobals[parent]); }
+		XMStoreFloat4x4(&jointGlobals[j], local);
+	}
+
+	// Mesh space -> joint space -> posed model space
+	XMMATRIX rootInverse = XMLoadFloat4x4(&skeleton.RootInverse);
+	for (size_t b = 0; b < skeleton.Bones.size(); b++)
+	{
+		const SkinBone& bone = skeleton.Bones[b];
+		XMStoreFloat4x4(&palette[b],
+			XMLoadFloat4x4(&bone.Offset) * XMLoadFloat4x4(&jointGlobals[bone.Joint]) * rootInverse);
+	}
+}
+
+void SkinVertices(const Vertex* vertices, const SkinWeights* weights, unsigned int vertexCount,
+	const XMFLOAT4X4* palette, CompactVertex* output)
+{
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		// Blend the bone matrices first, so each attribute is transformed once
+		const SkinWeights& w = weights[v];
+		XMMATRIX skin = XMLoadFloat4x4(&palette[w.Bones[0]]) * w.Weights[0];
+		for (unsigned int i = 1; i < SKIN_MAX_INFLUENCES && w.Weights[i] > 0.0f; i++)
+		{
+			skin += XMLoadFloat4x4(&palette[w.Bones[i]]) * w.Weights[i];
+		}
+
+		Vertex skinned;
+		XMStoreFloat3(&skinned.Position, XMVector3Transform(XMLoadFloat3(&vertices[v].Position), skin));
+		XMStoreFloat3(&skinned.Normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&vertices[v].Normal), skin)));
+		XMStoreFloat3(&skinned.Tangent, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&vertices[v].Tangent), skin)));
+		skinned.UV = vertices[v].UV;
+		output[v] = EncodeCompactVertex(skinned);
+	}
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <DirectXMath.h>
+#include "Vertex.h"
+#include "VertexFormats.h"
+
+// --------------------------------------------------------
+// Skeletal animation data and the CPU side math to play it
+//
+// - A Skeleton is the model's node hierarchy (parents come
+//   before their children) plus the bones that vertices are
+//   weighted to, each pointing at one joint
+// - Clips store keyframes per joint; sampling one gives a
+//   pose (translation, rotation, scale per joint), and poses
+//   from several clips can be blended
+// - A pose turns into a palette of skinning matrices, which
+//   SkinVertices() applies to the bind pose vertices
+//
+// None of this touches D3D, so it runs on any thread
+// --------------------------------------------------------
+
+#define SKIN_MAX_INFLUENCES 4
+#define SKIN_MAX_BONES 256		// Bone indices are stored in a byte
+
+// One joint's local transform
+struct JointPose
+{
+	DirectX::XMFLOAT3 Translation;
+	DirectX::XMFLOAT4 Rotation;		// Quaternion
+	DirectX::XMFLOAT3 Scale;
+};
+
+struct SkeletonJoint
+{
+	std::string Name;
+	int Parent;						// -1 for the root; always less than this joint's index
+	JointPose BindPose;				// The node's transform when no clip animates it
+};
+
+// A palette entry: moves vertices from mesh space into the space of one joint
+struct SkinBone
+{
+	unsigned int Joint;
+	DirectX::XMFLOAT4X4 Offset;		// Inverse bind matrix
+};
+
+struct Skeleton
+{
+	std::vector<SkeletonJoint> Joints;
+	std::vector<SkinBone> Bones;
+	DirectX::XMFLOAT4X4 RootInverse;	// Undoes the root node's transform, keeping the model at its origin
+};
+
+// Which bones move a vertex, and how much (weights sum to 1)
+struct SkinWeights
+{
+	unsigned char Bones[SKIN_MAX_INFLUENCES];
+	float Weights[SKIN_MAX_INFLUENCES];
+};
+
+struct AnimationVectorKey
+{
+	float Time;						// Seconds
+	DirectX::XMFLOAT3 Value;
+};
+
+struct AnimationQuatKey
+{
+	float Time;						// Seconds
+	DirectX::XMFLOAT4 Value;
+};
+
+// Keyframes for one joint (any of the lists can be empty, leaving that part at the bind pose)
+struct AnimationChannel
+{
+	unsigned int Joint;
+	std::vector<AnimationVectorKey> Positions;
+	std::vector<AnimationQuatKey> Rotations;
+	std::vector<AnimationVectorKey> Scales;
+};
+
+struct AnimationClip
+{
+	std::string Name;
+	float Duration;					// Seconds
+	std::vector<AnimationChannel> Channels;
+};
+
+/// <summary>
+/// Samples a clip, writing every joint's pose (joints the clip doesn't animate get their bind pose)
+/// </summary>
+/// <param name="skeleton">Skeleton the clip was imported with</param>
+/// <param name="clip">Clip to sample</param>
+/// <param name="time">Time in seconds</param>
+/// <param name="loop">Wrap time around the clip's duration instead of clamping it</param>
+/// <param name="pose">Receives one pose per joint</param>
+void SampleClip(const Skeleton& skeleton, const AnimationClip& clip, float time, bool loop, JointPose* pose);
+
+/// <summary>
+/// Blends another pose into a pose (lerp for translation and scale, nlerp for rotation)
+/// </summary>
+/// <param name="pose">Pose to blend into</param>
+/// <param name="other">Pose to blend towards</param>
+/// <param name="weight">0 keeps pose, 1 replaces it with other</param>
+/// <param name="jointCount">Number of joints in both poses</param>
+void BlendPoses(JointPose* pose, const JointPose* other, float weight, unsigned int jointCount);
+
+/// <summary>
+/// Builds the skinning matrices for a pose
+/// </summary>
+/// <param name="skeleton">The pose's skeleton</param>
+/// <param name="pose">One pose per joint</param>
+/// <param name="jointGlobals">Scratch space for one matrix per joint (receives each joint's model space transform)</param>
+/// <param name="palette">Receives one matrix per bone</param>
+void BuildSkinPalette(const Skeleton& skeleton, const JointPose* pose,
+	DirectX::XMFLOAT4X4* jointGlobals, DirectX::XMFLOAT4X4* palette);
+
+/// <summary>
+/// Skins vertices with a palette, blending up to SKIN_MAX_INFLUENCES bone matrices per vertex,
+/// and encodes the results for a compact vertex buffer
+/// </summary>
+/// <param name="vertices">Bind pose vertices</param>
+/// <param name="weights">One set of weights per vertex</param>
+/// <param name="vertexCount">Number of vertices to skin</param>
+/// <param name="palette">Matrices from BuildSkinPalette()</param>
+/// <param name="output">Receives the skinned vertices (may be a mapped vertex buffer)</param>
+void SkinVertices(const Vertex* vertices, const SkinWeights* weights, unsigned int vertexCount,
+	const DirectX::XMFLOAT4X4* palette, CompactVertex* output);
@@ -0,0 +1,133 @@
+#include "Animator.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace DirectX;
+
+AnimatedMesh::AnimatedMesh(std::shared_ptr<const SkinnedModel> _model,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	std::shared_ptr<Mesh> _placeholder) :
+	model(_model)
+{
+	// The mesh handed to entities stays the same one when the model arrives
+	mesh = std::make_shared<Mesh>(_placeholder, _context, _device);
+	if (model->Loaded) { FinishLoad(); }
+}
+
+void AnimatedMesh::FinishLoad()
+{
+	pose.resize(model->Rig.Joints.size());
+	layerPose.resize(model->Rig.Joints.size());
+	jointGlobals.resize(model->Rig.Joints.size());
+	palette.resize(model->Rig.Bones.size());
+	mesh->FinishDynamicLoad(model->Vertices.data(), (int)model->Vertices.size(),
+		model->Indices.data(), (int)model->Indices.size(), model->Submeshes);
+}
+
+void AnimatedMesh::Play(unsigned int clip, float weight, float speed, bool loop)
+{
+	if (clip >= model->Clips.size()) { return; }
+	layers.push_back({ clip, 0.0f, speed, weight, loop });
+}
+
+void AnimatedMesh::Stop() { layers.clear(); }
+
+void AnimatedMesh::Advance(float deltaTime)
+{
+	for (AnimationLayer& layer : layers) { layer.Time += deltaTime * layer.Speed; }
+}
+
+void AnimatedMesh::Evaluate(CompactVertex* output)
+{
+	const Skeleton& skeleton = model->Rig;
+	unsigned int jointCount = (unsigned int)skeleton.Joints.size();
+
+	// Blend the layers in turn, each weighted against everything before it
+	float totalWeight = 0.0f;
+	for (const AnimationLayer& layer : layers)
+	{
+		if (layer.Weight <= 0.0f) { continue; }
+		const AnimationClip& clip = model->Clips[layer.Clip];
+		if (totalWeight == 0.0f)
+			SampleClip(skeleton, clip, layer.Time, layer.Loop, pose.data());
+		else
+		{
+			SampleClip(skeleton, clip, layer.Time, layer.Loop, layerPose.data());
+			BlendPoses(pose.data(), layerPose.data(), layer.Weight / (totalWeight + layer.Weight), jointCount);
+		}
+		totalWeight += layer.Weight;
+	}
+	if (totalWeight == 0.0f)
+	{
+		for (unsigned int j = 0; j < jointCount; j++) { pose[j] = skeleton.Joints[j].BindPose; }
+	}
+
+	BuildSkinPalette(skeleton, pose.data(), jointGlobals.data(), palette.data());
+	SkinVertices(model->Vertices.data(), model->Weights.data(), (unsigned int)model->Vertices.size(),
+		palette.data(), output);
+}
+
+Animator::Animator(Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	unsigned int threadCount) :
+	context(_context),
+	device(_device),
+	stats(),
+	pool(threadCount)
+{
+}
+
+std::shared_ptr<AnimatedMesh> Animator::CreateAnimatedMesh(std::shared_ptr<const SkinnedModel> model,
+	std::shared_ptr<Mesh> placeholder)
+{
+	animatedMeshes.push_back(std::make_shared<AnimatedMesh>(model, context, device, placeholder));
+	return animatedMeshes.back();
+}
+
+void Animator::Update(float deltaTime)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Drop characters nobody else holds on to
+	animatedMeshes.erase(std::remove_if(animatedMeshes.begin(), animatedMeshes.end(),
+		[](const std::shared_ptr<AnimatedMesh>& animatedMesh) { return animatedMesh.use_count() == 1; }),
+		animatedMeshes.end());
+
+	// Mapping needs the context, so it stays on this thread, as does creating the buffers
+	// of characters whose model finished loading (placeholders don't map)
+	stats = {};
+	mappedVertices.resize(animatedMeshes.size());
+	for (size_t i = 0; i < animatedMeshes.size(); i++)
+	{
+		if (!animatedMeshes[i]->IsReady() && animatedMeshes[i]->GetModel()->Loaded) { animatedMeshes[i]->FinishLoad(); }
+		animatedMeshes[i]->Advance(deltaTime);
+		mappedVertices[i] = animatedMeshes[i]->GetMesh()->MapVertices();
+		if (mappedVertices[i])
+		{
+			stats.Characters++;
+			stats.VerticesSkinned += animatedMeshes[i]->GetMesh()->GetVertexCount();
+		}
+	}
+
+	// A few batches per worker, so uneven characters still spread out
+	size_t batchSize = std::max<size_t>(1, animatedMeshes.size() / (pool.GetThreadCount() * 4));
+	for (size_t first = 0; first < animatedMeshes.size(); first += batchSize)
+	{
+		size_t last = std::min(first + batchSize, animatedMeshes.size());
+		pool.Enqueue([this, first, last]()
+		{
+			for (size_t i = first; i < last; i++)
+			{
+				if (mappedVertices[i]) { animatedMeshes[i]->Evaluate(mappedVertices[i]); }
+			}
+		});
+	}
+	pool.WaitIdle();
+
+	for (size_t i = 0; i < animatedMeshes.size(); i++)
+	{
+		if (mappedVertices[i]) { animatedMeshes[i]->GetMesh()->UnmapVertices(); }
+	}
+	stats.UpdateTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
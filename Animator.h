@@ -0,0 +1,137 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+#include "Mesh.h"
+#include "SkinnedModel.h"
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Skeletal animation playback
+//
+// An AnimatedMesh is one character: a shared SkinnedModel,
+// the clips it's playing and its own dynamic Mesh (hand
+// GetMesh() to an Entity to draw it). A character whose
+// model is still loading draws its placeholder, and starts
+// animating in the first Update() after the model is in.
+//
+// Animator::Update() runs once per frame on the render
+// thread. It maps every character's vertex buffer, then
+// worker threads sample the clips, build the bone palettes
+// and skin straight into the mapped memory.
+// --------------------------------------------------------
+
+// A clip being played
+struct AnimationLayer
+{
+	unsigned int Clip;				// Index into the model's clips
+	float Time;						// Seconds
+	float Speed;
+	float Weight;					// Relative to the other layers
+	bool Loop;
+};
+
+class AnimatedMesh
+{
+public:
+	/// <summary>
+	/// Creates a character in its bind pose, or waiting for its model if that's still loading
+	/// </summary>
+	/// <param name="_model">The rigged model to animate</param>
+	/// <param name="_placeholder">Mesh drawn until the model is loaded (can be null)</param>
+	AnimatedMesh(std::shared_ptr<const SkinnedModel> _model,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+		Microsoft::WRL::ComPtr<ID3D11Device> _device,
+		std::shared_ptr<Mesh> _placeholder = nullptr);
+
+	/// <summary>
+	/// Creates the skinned vertex buffer and scratch space once the model has loaded
+	/// </summary>
+	void FinishLoad();
+	/// <summary>
+	/// Starts playing a clip on top of the ones already playing (does nothing until the model is loaded)
+	/// </summary>
+	/// <param name="clip">Index into the model's clips</param>
+	/// <param name="weight">Blend weight relative to the other playing clips</param>
+	/// <param name="speed">Playback speed (1 = normal)</param>
+	/// <param name="loop">Wrap around at the end instead of holding the last frame</param>
+	void Play(unsigned int clip, float weight = 1.0f, float speed = 1.0f, bool loop = true);
+	/// <summary>
+	/// Stops every clip, returning to the bind pose
+	/// </summary>
+	void Stop();
+	/// <summary>
+	/// Moves every playing clip forward
+	/// </summary>
+	void Advance(float deltaTime);
+	/// <summary>
+	/// Samples and blends the playing clips, builds the palette and skins every
+	/// vertex into output. Different AnimatedMeshes can evaluate on different threads.
+	/// </summary>
+	/// <param name="output">Room for every vertex of the model</param>
+	void Evaluate(CompactVertex* output);
+
+	// Getters
+	std::shared_ptr<Mesh> GetMesh() { return mesh; }
+	std::shared_ptr<const SkinnedModel> GetModel() { return model; }
+	bool IsReady() { return mesh->IsReady(); }
+	std::vector<AnimationLayer>& GetLayers() { return layers; }
+
+private:
+	std::shared_ptr<const SkinnedModel> model;
+	std::shared_ptr<Mesh> mesh;
+	std::vector<AnimationLayer> layers;
+
+	// Per evaluation scratch, kept to avoid allocating every frame
+	std::vector<JointPose> pose;
+	std::vector<JointPose> layerPose;
+	std::vector<DirectX::XMFLOAT4X4> jointGlobals;
+	std::vector<DirectX::XMFLOAT4X4> palette;
+};
+
+// Work done by the last Animator::Update()
+struct AnimatorStats
+{
+	unsigned int Characters;
+	unsigned int VerticesSkinned;
+	float UpdateTime;				// Milliseconds, including the wait for the workers
+};
+
+class Animator
+{
+public:
+	/// <summary>
+	/// Starts the skinning threads
+	/// </summary>
+	/// <param name="threadCount">Number of worker threads (0 = one less than the hardware thread count)</param>
+	Animator(Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+		Microsoft::WRL::ComPtr<ID3D11Device> _device,
+		unsigned int threadCount = 0);
+
+	/// <summary>
+	/// Creates a character that Update() will animate until nothing else references it
+	/// </summary>
+	/// <param name="model">The rigged model to animate (may still be loading)</param>
+	/// <param name="placeholder">Mesh drawn until the model is loaded (can be null)</param>
+	std::shared_ptr<AnimatedMesh> CreateAnimatedMesh(std::shared_ptr<const SkinnedModel> model,
+		std::shared_ptr<Mesh> placeholder = nullptr);
+	/// <summary>
+	/// Advances, poses and skins every character into its vertex buffer
+	/// </summary>
+	void Update(float deltaTime);
+
+	// Getters
+	AnimatorStats GetStats() { return stats; }
+	unsigned int GetThreadCount() { return pool.GetThreadCount(); }
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	std::vector<std::shared_ptr<AnimatedMesh>> animatedMeshes;
+	std::vector<CompactVertex*> mappedVertices;
+	AnimatorStats stats;
+
+	// Declared last so the workers are joined before anything they use is destroyed
+	ThreadPool pool;
+};
@@ -17,10 +17,16 @@ float4 main(VertexToPixel input) : SV_TARGET
     float3 tangent = normalize(input.tangent);
     float3 viewVector = normalize(cameraPosition - input.worldPosition);
 	
-    // (float3 normal, Light light, float3 viewVector, float specularPower, float3 worldPosition, float2 uv, float3 tangent)
-    float4 light = totalLight(normal, input.worldPosition, input.uv, tangent, input.shadowMapPos);
+    // Sample the material once and light it with everything
+    Surface surface = SampleSurface(normal, input.uv, tangent);
+    float4 light = totalLight(surface, input.worldPosition, input.screenPosition.xy);
+    // The flashlight's shadow is the spot shadow map in the atlas
+    float spotShadow = 1.0f;
+    float shadowFootprint = ShadowFootprint(input.worldPosition);
+    if (hasShadowMap)
+        spotShadow = AtlasShadow(4, input.worldPosition, shadowFootprint);
     float3 totalColor = colorTint.rgb * light.rgb
-    + SpotLight(normal, spotLight, viewVector, input.worldPosition, input.uv, tangent).rgb;
+    + SpotLight(surface, spotLight, viewVector, input.worldPosition).rgb * spotShadow;
     //float3 totalColor = colorTint.rgb * float3(totalLight(normal, input.worldPosition, input.uv, tangent)) + (temp * 0);
     return float4(pow(totalColor.rgb, 1.0f / 2.2f), light.a);
 }
\ No newline at end of file
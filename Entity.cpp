@@ -15,11 +15,21 @@ Entity::Entity(std::shared_ptr<Mesh> _mesh, std::shared_ptr<Material> _material)
 std::shared_ptr<Transform> Entity::GetTransform() { return transform; }
 std::shared_ptr<Mesh> Entity::GetMesh() { return mesh; }
 std::shared_ptr<Material> Entity::GetMaterial() { return material; }
+std::shared_ptr<Material> Entity::GetMaterial(unsigned int materialSlot)
+{
+	if (materialSlot < slotMaterials.size() && slotMaterials[materialSlot]) { return slotMaterials[materialSlot]; }
+	return material;
+}
 
 // Setters
 void Entity::setTransform(std::shared_ptr<Transform> _transform) { transform = _transform; }
 void Entity::SetMesh(std::shared_ptr<Mesh> _mesh) { mesh = _mesh; }
 void Entity::SetMaterial(std::shared_ptr<Material> _material) { material = _material; }
+void Entity::SetMaterial(unsigned int materialSlot, std::shared_ptr<Material> _material)
+{
+	if (materialSlot >= slotMaterials.size()) { slotMaterials.resize(materialSlot + 1); }
+	slotMaterials[materialSlot] = _material;
+}
 void Entity::SetDefaultRastState(Microsoft::WRL::ComPtr<ID3D11RasterizerState> _defaultRastState) { defaultRastState = _defaultRastState; }
 void Entity::SetCullBackRastState(Microsoft::WRL::ComPtr<ID3D11RasterizerState> _cullBackRastState) { cullBackRastState = _cullBackRastState; }
 
@@ -30,7 +40,8 @@ void Entity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
 	std::shared_ptr<Camera> camera)
 {
 	// Prepare the shaders
-	material->PrepareMaterial(transform.get(), camera);
+	DirectX::XMFLOAT4X4 positionTransform = mesh->GetPositionTransform();
+	material->PrepareMaterial(transform.get(), camera, &positionTransform);
 
 	// Draw Mesh geometry
 	mesh->Draw();
@@ -39,13 +50,60 @@ void Entity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
 void Entity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
 	std::shared_ptr<Camera> camera)
 {
+	// Meshes still loading have no submeshes yet, so their placeholder is drawn with the main material
+	if (!slotMaterials.empty() && mesh->IsReady())
+	{
+		DrawSubmeshes(context, camera);
+		return;
+	}
+
 	// Prepare the shaders
-	material->PrepareMaterial(transform.get(), camera);
+	DirectX::XMFLOAT4X4 positionTransform = mesh->GetPositionTransform();
+	material->PrepareMaterial(transform.get(), camera, &positionTransform);
 	bool isTransparent = material->GetTransparency() != 1.0f;
 
-	// Draw Mesh geometry
+	// Draw Mesh geometry, skipping meshlets the camera can't see
+	DirectX::XMFLOAT4X4 view = camera->GetViewMatrix();
+	DirectX::XMFLOAT4X4 projection = camera->GetProjMatrix();
+	DirectX::XMFLOAT4X4 viewProj;
+	DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMLoadFloat4x4(&view) * DirectX::XMLoadFloat4x4(&projection));
 	if (isTransparent) { context->RSSetState(cullBackRastState.Get()); }
-	mesh->Draw();
+	mesh->DrawCulled(transform->GetWorldMatrix(), viewProj, camera->GetPosition());
 	if (isTransparent) { context->RSSetState(defaultRastState.Get()); }
 }
 
+/// <summary>
+/// Draws each submesh with its material slot's material, only re-preparing
+/// the shaders when the material changes between submeshes
+/// </summary>
+void Entity::DrawSubmeshes(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	std::shared_ptr<Camera> camera)
+{
+	DirectX::XMFLOAT4X4 positionTransform = mesh->GetPositionTransform();
+	DirectX::XMFLOAT4X4 world = transform->GetWorldMatrix();
+	DirectX::XMFLOAT4X4 view = camera->GetViewMatrix();
+	DirectX::XMFLOAT4X4 projection = camera->GetProjMatrix();
+	DirectX::XMFLOAT4X4 viewProj;
+	DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMLoadFloat4x4(&view) * DirectX::XMLoadFloat4x4(&projection));
+
+	const std::vector<MeshSubmeshRange>& ranges = mesh->GetSubmeshRanges();
+	Material* prepared = nullptr;
+	bool isTransparent = false;
+	for (unsigned int i = 0; i < (unsigned int)ranges.size(); i++)
+	{
+		std::shared_ptr<Material> submeshMaterial = GetMaterial(ranges[i].MaterialIndex);
+		if (submeshMaterial.get() != prepared)
+		{
+			submeshMaterial->PrepareMaterial(transform.get(), camera, &positionTransform);
+			prepared = submeshMaterial.get();
+			bool transparent = submeshMaterial->GetTransparency() != 1.0f;
+			if (transparent != isTransparent)
+			{
+				context->RSSetState(transparent ? cullBackRastState.Get() : defaultRastState.Get());
+				isTransparent = transparent;
+			}
+		}
+		mesh->DrawSubmeshCulled(i, world, viewProj, camera->GetPosition());
+	}
+	if (isTransparent) { context->RSSetState(defaultRastState.Get()); }
+}
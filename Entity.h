@@ -3,6 +3,7 @@
 #include "Mesh.h"
 #include "BuffStructs.h"
 #include <memory>
+#include <vector>
 #include "Camera.h"
 #include "SimpleShader.h"
 #include "Material.h"
@@ -16,11 +17,20 @@ public:
 	std::shared_ptr<Transform> GetTransform();
 	std::shared_ptr<Mesh> GetMesh();
 	std::shared_ptr<Material> GetMaterial();
+	/// <summary>
+	/// Returns the material used for a mesh material slot (MeshSubmeshRange::MaterialIndex),
+	/// which is the entity's main material unless the slot has its own
+	/// </summary>
+	std::shared_ptr<Material> GetMaterial(unsigned int materialSlot);
 
 	// Setters
 	void setTransform(std::shared_ptr<Transform> _transform);
 	void SetMesh(std::shared_ptr<Mesh> _mesh);
 	void SetMaterial(std::shared_ptr<Material> _material);
+	/// <summary>
+	/// Gives every submesh that uses a mesh material slot its own material
+	/// </summary>
+	void SetMaterial(unsigned int materialSlot, std::shared_ptr<Material> _material);
 	static void SetDefaultRastState(Microsoft::WRL::ComPtr<ID3D11RasterizerState> _defaultRastState);
 	static void SetCullBackRastState(Microsoft::WRL::ComPtr<ID3D11RasterizerState> _cullBackRastState);
 
@@ -39,5 +49,8 @@ private:
 	std::shared_ptr<Transform> transform;
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Material> material;
+	std::vector<std::shared_ptr<Material>> slotMaterials;	// Per material slot overrides (null = material)
+
+	void DrawSubmeshes(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera);
 };
 
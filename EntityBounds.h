@@ -0,0 +1,13 @@
+#pragma once
+
+// --------------------------------------------------------
+// An entity's world space bounding sphere, worked out once
+// a frame (see Game::GetEntityBounds()) and shared by
+// everything that culls or sorts entities against lights:
+// light assignment and shadow caster culling
+// --------------------------------------------------------
+struct EntityBounds
+{
+	float Center[3];
+	float Radius;
+};
@@ -10,6 +10,7 @@
 #pragma comment(lib, "d3dcompiler.lib")
 #include <d3dcompiler.h>
 #include <algorithm>
+#include <chrono>
 
 // For the DirectX Math library
 using namespace DirectX;
@@ -17,14 +18,13 @@ using namespace DirectX;
 //Variables
 const float RADTODEG = 57.2958f;
 XMFLOAT4 uiColor(1.0f, 1.0f, 1.0f, 1.0f);
-//XMFLOAT4 skyColor(1.0f, 0.745f, 0.941f,1.0f); // Cloud Pink
-XMFLOAT4 skyColor(0.8f, 0.8f, 0.8f, 1.0f); // Planet
 bool demoWindowVisible = false;
 bool isFullscreen = false;
-float BRIGHTNESS = 0.1f;
-XMFLOAT3 ambientColor = XMFLOAT3(uiColor.x * skyColor.x * BRIGHTNESS,
-	uiColor.y * skyColor.y * BRIGHTNESS,
-	uiColor.z * skyColor.z * BRIGHTNESS);
+float environmentIntensity = 1.0f;	// Scales the sky's image based lighting
+int extraLightCount = 0;			// Random point lights added to stress clustered lighting
+int lightAssignmentMode = 0;		// 0 = clustered, 1 = per entity
+bool filteredShadows = false;		// Shadows from prefiltered moments (EVSM) instead of hardware compared depth
+const unsigned int MESH_LOAD_BENCHMARK_COUNT = 50;
 
 // --------------------------------------------------------
 // Constructor
@@ -51,6 +51,9 @@ Game::Game(HINSTANCE hInstance)
 	cameraIndex = 0;
 	spotLight = {};
 	blurStrength = 0;
+	initTime = 0;
+	sceneLightCount = 0;
+	for (float& time : textureLoadBenchmarkTimes) { time = 0; }
 }
 
 // --------------------------------------------------------
@@ -79,6 +82,8 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	auto initStart = std::chrono::high_resolution_clock::now();
+
 	// Create Cameras
 	cameraIndex = 0;
 	cameras.push_back(std::make_shared<Camera>(
@@ -88,6 +93,14 @@ void Game::Init()
 	cameras[1]->UpdateProjMatrix(false, (float)windowWidth, (float)windowHeight);
 	cameras[1]->SetMouseSens(0.005f);
 
+	// Models load on worker threads, showing a placeholder cube until they're uploaded
+	meshLoader = std::make_unique<MeshLoader>(context, device);
+	textureLoader = std::make_unique<TextureLoader>(context, device);
+	// Cooked textures start with only their low mips, the rest stream in as they're seen up close
+	textureStreamer = std::make_unique<TextureStreamer>(context, device, 64 * 1024 * 1024);
+	textureLoader->SetStreamer(textureStreamer.get());
+	animator = std::make_unique<Animator>(context, device);
+
 	LoadShaders();
 	CreateMaterials();
 	CreateGeometry();
@@ -138,6 +151,8 @@ void Game::Init()
 	device->CreateBlendState(&bd, blendState.GetAddressOf());
 
 	PostProcessSetup();
+
+	initTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - initStart).count();
 }
 
 // --------------------------------------------------------
@@ -156,6 +171,9 @@ void Game::LoadShaders()
 	ppVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"PostProcessVS.cso").c_str());
 	ppPS = std::make_shared<SimplePixelShader>(device, context, FixPath(L"BlurPS.cso").c_str());
 
+	// Every mesh vertex format feeds VertexShaderInput, so any shader using it can validate the layouts
+	Mesh::CreateInputLayouts(device, vs->GetShaderBlob());
+
 }
 
 
@@ -172,201 +190,18 @@ void Game::CreateMaterials()
 	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 	device->CreateSamplerState(&samplerDesc, samplerState.GetAddressOf());
 
-	// Load Textures
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneAlb;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneMtl;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneNrm;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobblestoneRgh;
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/cobblestone_albedo.png").c_str(), nullptr, cobblestoneAlb.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/cobblestone_metal.png").c_str(), nullptr, cobblestoneMtl.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/cobblestone_normals.png").c_str(), nullptr, cobblestoneNrm.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/cobblestone_roughness.png").c_str(), nullptr, cobblestoneRgh.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorAlb;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorMtl;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorNrm;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorRgh;
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/floor_albedo.png").c_str(), nullptr, floorAlb.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/floor_metal.png").c_str(), nullptr, floorMtl.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/floor_normals.png").c_str(), nullptr, floorNrm.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/floor_roughness.png").c_str(), nullptr, floorRgh.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintAlb;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintMtl;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintNrm;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintRgh;
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/paint_albedo.png").c_str(), nullptr, paintAlb.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/paint_metal.png").c_str(), nullptr, paintMtl.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/paint_normals.png").c_str(), nullptr, paintNrm.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/paint_roughness.png").c_str(), nullptr, paintRgh.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedAlb;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedMtl;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedNrm;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedRgh;
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/scratched_albedo.png").c_str(), nullptr, scratchedAlb.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/scratched_metal.png").c_str(), nullptr, scratchedMtl.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/scratched_normals.png").c_str(), nullptr, scratchedNrm.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/scratched_roughness.png").c_str(), nullptr, scratchedRgh.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeAlb;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeMtl;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeNrm;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeRgh;
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/bronze_albedo.png").c_str(), nullptr, bronzeAlb.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/bronze_metal.png").c_str(), nullptr, bronzeMtl.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/bronze_normals.png").c_str(), nullptr, bronzeNrm.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/bronze_roughness.png").c_str(), nullptr, bronzeRgh.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughAlb;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughMtl;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughNrm;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughRgh;
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/rough_albedo.png").c_str(), nullptr, roughAlb.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/rough_metal.png").c_str(), nullptr, roughMtl.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/rough_normals.png").c_str(), nullptr, roughNrm.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/rough_roughness.png").c_str(), nullptr, roughRgh.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodAlb;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodMtl;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodNrm;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodRgh;
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/wood_albedo.png").c_str(), nullptr, woodAlb.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/wood_metal.png").c_str(), nullptr, woodMtl.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/wood_normals.png").c_str(), nullptr, woodNrm.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/wood_roughness.png").c_str(), nullptr, woodRgh.GetAddressOf());
-
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> webAlb;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> webOpc;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> webNrm;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> webRgh;
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/web_albedo.jpg").c_str(), nullptr, webAlb.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/web_opacity.jpg").c_str(), nullptr, webOpc.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/web_normals.png").c_str(), nullptr, webNrm.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/web_roughness.jpg").c_str(), nullptr, webRgh.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> plasticAlb;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> plasticOpc;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> plasticNrm;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> plasticRgh;
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/plastic_albedo.jpg").c_str(), nullptr,    plasticAlb.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/plastic_opacity.jpg").c_str(), nullptr,   plasticOpc.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/plastic_normals.png").c_str(), nullptr,   plasticNrm.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/plastic_roughness.jpg").c_str(), nullptr, plasticRgh.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> waterAlb;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> waterNrm;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> waterRgh;
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/water_albedo.jpg").c_str(), nullptr, waterAlb.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/water_normals.png").c_str(), nullptr, waterNrm.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/water_roughness.jpg").c_str(), nullptr, waterRgh.GetAddressOf());
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rainAlb;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rainNrm;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rainRgh;
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/rain_albedo.jpg").c_str(), nullptr,    rainAlb.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/rain_normals.png").c_str(), nullptr,   rainNrm.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/PBR/rain_roughness.jpg").c_str(), nullptr, rainRgh.GetAddressOf());
-
-	// Create Materials
-	materials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.1f, vs, customPS));
-	materials.back().get()->AddSampler("Sampler", samplerState);
-	materials.back().get()->AddTextureSRV("Albedo", cobblestoneAlb);
-	materials.back().get()->AddTextureSRV("RoughnessMap", cobblestoneRgh);
-	materials.back().get()->AddTextureSRV("MetalnessMap", cobblestoneMtl);
-	materials.back().get()->AddTextureSRV("NormalMap", cobblestoneNrm);
-
-	materials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.1f, vs, customPS));
-	materials.back().get()->AddSampler("Sampler", samplerState);
-	materials.back().get()->AddTextureSRV("Albedo", floorAlb);
-	materials.back().get()->AddTextureSRV("RoughnessMap", floorRgh);
-	materials.back().get()->AddTextureSRV("MetalnessMap", floorMtl);
-	materials.back().get()->AddTextureSRV("NormalMap", floorNrm);
-
-	materials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.1f, vs, customPS));
-	materials.back().get()->AddSampler("Sampler", samplerState);
-	materials.back().get()->AddTextureSRV("Albedo", paintAlb);
-	materials.back().get()->AddTextureSRV("RoughnessMap", paintRgh);
-	materials.back().get()->AddTextureSRV("MetalnessMap", paintMtl);
-	materials.back().get()->AddTextureSRV("NormalMap", paintNrm);
-
-	materials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.1f, vs, customPS));
-	materials.back().get()->AddSampler("Sampler", samplerState);
-	materials.back().get()->AddTextureSRV("Albedo", scratchedAlb);
-	materials.back().get()->AddTextureSRV("RoughnessMap", scratchedRgh);
-	materials.back().get()->AddTextureSRV("MetalnessMap", scratchedMtl);
-	materials.back().get()->AddTextureSRV("NormalMap", scratchedNrm);
-
-	materials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.1f, vs, customPS));
-	materials.back().get()->AddSampler("Sampler", samplerState);
-	materials.back().get()->AddTextureSRV("Albedo", bronzeAlb);
-	materials.back().get()->AddTextureSRV("RoughnessMap", bronzeRgh);
-	materials.back().get()->AddTextureSRV("MetalnessMap", bronzeMtl);
-	materials.back().get()->AddTextureSRV("NormalMap", bronzeNrm);
-
-	materials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.1f, vs, customPS));
-	materials.back().get()->AddSampler("Sampler", samplerState);
-	materials.back().get()->AddTextureSRV("Albedo", roughAlb);
-	materials.back().get()->AddTextureSRV("RoughnessMap", roughRgh);
-	materials.back().get()->AddTextureSRV("MetalnessMap", roughMtl);
-	materials.back().get()->AddTextureSRV("NormalMap", roughNrm);
-
-	materials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.1f, vs, customPS));
-	materials.back().get()->AddSampler("Sampler", samplerState);
-	materials.back().get()->AddTextureSRV("Albedo", woodAlb);
-	materials.back().get()->AddTextureSRV("RoughnessMap", woodRgh);
-	materials.back().get()->AddTextureSRV("MetalnessMap", woodMtl);
-	materials.back().get()->AddTextureSRV("NormalMap", woodNrm);
-
-
-	transparentMaterials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.1f, vs, customPS));
-	transparentMaterials.back().get()->AddSampler("Sampler", samplerState);
-	transparentMaterials.back().get()->AddTextureSRV("Albedo", webAlb);
-	transparentMaterials.back().get()->AddTextureSRV("RoughnessMap", webRgh);
-	transparentMaterials.back().get()->AddTextureSRV("OpacityMap", webOpc);
-	transparentMaterials.back().get()->AddTextureSRV("NormalMap", webNrm);
-
-	transparentMaterials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.1f, vs, customPS));
-	transparentMaterials.back().get()->AddSampler("Sampler", samplerState);
-	transparentMaterials.back().get()->AddTextureSRV("Albedo",       plasticAlb);
-	transparentMaterials.back().get()->AddTextureSRV("RoughnessMap", plasticRgh);
-	transparentMaterials.back().get()->AddTextureSRV("OpacityMap",   plasticOpc);
-	transparentMaterials.back().get()->AddTextureSRV("NormalMap",    plasticNrm);
-	transparentMaterials.back().get()->SetTransparency(0.9f);
-
-	transparentMaterials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.1f, vs, customPS));
-	transparentMaterials.back().get()->AddSampler("Sampler", samplerState);
-	transparentMaterials.back().get()->AddTextureSRV("Albedo", waterAlb);
-	transparentMaterials.back().get()->AddTextureSRV("RoughnessMap", waterRgh);
-	transparentMaterials.back().get()->AddTextureSRV("NormalMap", waterNrm);
-	transparentMaterials.back().get()->SetTransparency(0.5f);
-
-	transparentMaterials.push_back(std::make_shared<Material>(XMFLOAT4(0.3f, 0.7f, 1.0f, 1.0f), 0.1f, vs, customPS));
-	transparentMaterials.back().get()->AddSampler("Sampler", samplerState);
-	transparentMaterials.back().get()->AddTextureSRV("Albedo",       rainAlb);
-	transparentMaterials.back().get()->AddTextureSRV("RoughnessMap", rainRgh);
-	transparentMaterials.back().get()->AddTextureSRV("NormalMap",    rainNrm);
-	transparentMaterials.back().get()->SetTransparency(0.5f);
-	transparentMaterials.back().get()->SetUVScale(XMFLOAT2(2.f,2.f));
-	//materials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.2f, vs, customPS));
-	//materials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.8f, vs, ps));
-	//materials.push_back(std::make_shared<Material>(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f), 0.2f, vs, ps));
-
+	// Meshes, textures and materials come from the scene manifest, loaded as entities need them (see CreateGeometry())
+	resources = std::make_unique<ResourceRegistry>(*meshLoader, *textureLoader, *animator, vs, customPS, samplerState);
+	if (!resources->LoadManifest(FixPath(L"../../Assets/Scenes/demo.scene")))
+	{
+		printf("The scene manifest didn't load cleanly; only the entries without errors will appear\n");
+	}
 
 	// Create SkyBox
-	meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cube.obj").c_str(), context, device));
-	skyBox = std::make_unique<Sky>(meshes.back(),
-		samplerState, device, context,
+	skyBox = std::make_unique<Sky>(resources->LoadMesh(FixPath(L"../../Assets/Models/cube.obj")),
+		samplerState, device, context, *textureLoader,
 		FixPath(L"../../Assets/Skies/Planet/").c_str());
 	skyBox->colorTint = uiColor;
-
-	//auto skyTexture = skyBox->GetSkyTexture();
-	//customPS->SetData("EnvironmentMap", skyBox->GetSkyTexture().GetAddressOf(), sizeof(texture2d));
-	//if (materials[0]->GetPixelShader()->HasShaderResourceView("EnvironmentMap"))
-	//{
-	//	materials[0]->AddTextureSRV("EnvironmentMap", skyBox->GetSkyTexture());
-	//}
 }
 
 void Game::CreateLights()
@@ -378,33 +213,38 @@ void Game::CreateLights()
 	spotLight.Intensity = 1.0f;
 	spotLight.Color = XMFLOAT3(1.0f, 1.0f, 1.0f);
 	spotLight.SpotFalloff = 1.0f;
-	lights.push_back(Light{});
-	lights[lights.size() - 1].Type = LIGHT_TYPE_DIR;
-	lights[lights.size() - 1].Direction = XMFLOAT3(1.0f, -1.0f, 0.0f); // Affects top and right of objects
-	lights[lights.size() - 1].Color = XMFLOAT3(0.2f, 0.2f, 1.0f); // Blue
-	lights[lights.size() - 1].Intensity = 1.0f;
-	lights.push_back(Light{});
-	lights[lights.size() - 1].Type = LIGHT_TYPE_DIR;
-	lights[lights.size() - 1].Direction = XMFLOAT3(0.0f, 1.0f, 0.0f); // Affects bottom of objects
-	lights[lights.size() - 1].Color = XMFLOAT3(0.2f, 1.0f, 0.2f); // Green
-	lights[lights.size() - 1].Intensity = 0.2f;
-	lights.push_back(Light{});
-	lights[lights.size() - 1].Type = LIGHT_TYPE_DIR;
-	lights[lights.size() - 1].Direction = XMFLOAT3(-1.0f, -1.0f, 0.0f); // Affects top and left of objects
-	lights[lights.size() - 1].Color = XMFLOAT3(1.0f, 0.2f, 0.2f); // Red
-	lights[lights.size() - 1].Intensity = 0.1f;
-	lights.push_back(Light{});
-	lights[lights.size() - 1].Type = LIGHT_TYPE_POINT;
-	lights[lights.size() - 1].Range = 5.0f;
-	lights[lights.size() - 1].Position = XMFLOAT3(4.0f, 2.5f, -2.0f); // Located behind the cube / creature
-	lights[lights.size() - 1].Color = XMFLOAT3(1.0f, 1.0f, 0.2f); // Yellow
-	lights[lights.size() - 1].Intensity = 0.5f;
-	lights.push_back(Light{});
-	lights[lights.size() - 1].Type = LIGHT_TYPE_POINT;
-	lights[lights.size() - 1].Range = 3.0f;
-	lights[lights.size() - 1].Position = XMFLOAT3(9.0f, -0.5f, 1.65f); // Located in front of yoshi
-	lights[lights.size() - 1].Color = XMFLOAT3(1.0f, 0.2f, 1.0f); // Magenta
-	lights[lights.size() - 1].Intensity = 0.7f;
+	Light light = {};
+	light.Type = LIGHT_TYPE_DIR;
+	light.Direction = XMFLOAT3(1.0f, -1.0f, 0.0f); // Affects top and right of objects
+	light.Color = XMFLOAT3(0.2f, 0.2f, 1.0f); // Blue
+	light.Intensity = 1.0f;
+	lights.Add(light);
+	light = {};
+	light.Type = LIGHT_TYPE_DIR;
+	light.Direction = XMFLOAT3(0.0f, 1.0f, 0.0f); // Affects bottom of objects
+	light.Color = XMFLOAT3(0.2f, 1.0f, 0.2f); // Green
+	light.Intensity = 0.2f;
+	lights.Add(light);
+	light = {};
+	light.Type = LIGHT_TYPE_DIR;
+	light.Direction = XMFLOAT3(-1.0f, -1.0f, 0.0f); // Affects top and left of objects
+	light.Color = XMFLOAT3(1.0f, 0.2f, 0.2f); // Red
+	light.Intensity = 0.1f;
+	lights.Add(light);
+	light = {};
+	light.Type = LIGHT_TYPE_POINT;
+	light.Range = 5.0f;
+	light.Position = XMFLOAT3(4.0f, 2.5f, -2.0f); // Located behind the cube / creature
+	light.Color = XMFLOAT3(1.0f, 1.0f, 0.2f); // Yellow
+	light.Intensity = 0.5f;
+	unsigned int shadowedPointLightId = lights.Add(light); // Casts shadows, see below
+	light = {};
+	light.Type = LIGHT_TYPE_POINT;
+	light.Range = 3.0f;
+	light.Position = XMFLOAT3(9.0f, -0.5f, 1.65f); // Located in front of yoshi
+	light.Color = XMFLOAT3(1.0f, 0.2f, 1.0f); // Magenta
+	light.Intensity = 0.7f;
+	lights.Add(light);
 
 	// Shadow Lights
 	//ShadowLight::SetContext(context);
@@ -421,22 +261,47 @@ void Game::CreateLights()
 	shLight.Color = XMFLOAT3(0.2f, 0.2f, 1.0f); // Blue
 	shLight.Intensity = 0.1f;
 	shadowLights.push_back(ShadowLight(shLight, device, context));
-
-
-	//ps->SetData("lights",
-	//	&lights[0],
-	//	sizeof(Light)*MAX_NUM_LIGHTS);
-	customPS->SetData("lights",
-		&lights[0],
-		sizeof(Light) * MAX_NUM_LIGHTS);
-
-	int numLights = (int)lights.size();
-	//ps->SetData("numLights",
-	//	&numLights,
-	//	sizeof(int));
-	customPS->SetData("numLights",
-		&numLights,
-		sizeof(int));
+	shadowLights.push_back(ShadowLight(lights.Get(shadowedPointLightId), device, context, (int)shadowedPointLightId));
+
+	// Their shadow maps are tiles of one atlas, handed out every frame by how much of the screen each covers (see RenderShadowAtlas())
+	shadowAtlas = std::make_unique<ShadowAtlas>(ShadowAtlasSettings{ 4096, 128, 1024, 1.0f, 0.25f });
+	D3D11_TEXTURE2D_DESC shadowAtlasDesc = {};
+	shadowAtlasDesc.Width = shadowAtlas->GetSettings().Size;
+	shadowAtlasDesc.Height = shadowAtlas->GetSettings().Size;
+	shadowAtlasDesc.ArraySize = 1;
+	shadowAtlasDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+	shadowAtlasDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	shadowAtlasDesc.MipLevels = 1;
+	shadowAtlasDesc.SampleDesc.Count = 1;
+	shadowAtlasDesc.Usage = D3D11_USAGE_DEFAULT;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowAtlasTexture;
+	device->CreateTexture2D(&shadowAtlasDesc, 0, shadowAtlasTexture.GetAddressOf());
+	D3D11_DEPTH_STENCIL_VIEW_DESC shadowAtlasDSVDesc = {};
+	shadowAtlasDSVDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	shadowAtlasDSVDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+	device->CreateDepthStencilView(shadowAtlasTexture.Get(), &shadowAtlasDSVDesc, shadowAtlasDSV.GetAddressOf());
+	D3D11_SHADER_RESOURCE_VIEW_DESC shadowAtlasSRVDesc = {};
+	shadowAtlasSRVDesc.Format = DXGI_FORMAT_R32_FLOAT;
+	shadowAtlasSRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	shadowAtlasSRVDesc.Texture2D.MipLevels = 1;
+	device->CreateShaderResourceView(shadowAtlasTexture.Get(), &shadowAtlasSRVDesc, shadowAtlasSRV.GetAddressOf());
+	// Filtered shadows read the same tiles as moments, blurred and mipmapped whenever a map is rendered
+	// (the moment atlas itself is only created once they're turned on)
+	shadowMomentFilter = std::make_unique<ShadowMomentFilter>(shadowAtlas->GetSettings(), shadowAtlasSRV, device, context);
+
+
+	// Lights live in a structured buffer, packed and sorted by type (see LightSet), and bound once per frame in Draw()
+	lightBuffer = std::make_unique<StructuredBuffer<PackedLight>>(device, context);
+	lightBuffer->SetData(lights.GetPacked());
+	sceneLightCount = lights.GetCount();
+
+	// Each pixel only loops over the lights binned into its cluster (see BindLightClusters())
+	lightClusters = std::make_unique<LightClusters>();
+	clusterRangeBuffer = std::make_unique<StructuredBuffer<LightClusterRange>>(device, context, lightClusters->GetClusterCount());
+	clusterIndexBuffer = std::make_unique<StructuredBuffer<unsigned int>>(device, context, 1024);
+	lightAssignment = std::make_unique<LightAssignment>();
+	entityLightStats = {};
+	shadowStats = {};
 }
 
 // --------------------------------------------------------
@@ -444,52 +309,30 @@ void Game::CreateLights()
 // --------------------------------------------------------
 void Game::CreateGeometry()
 {
-	//meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cheburashka.obj").c_str(), context, device));
-	meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/sphere.obj").c_str(), context, device));
-	//meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/N square.obj").c_str(), context, device));
-	//meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/yoshi.obj").c_str(), context, device));
-	//meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cheburashka.obj").c_str(), context, device));
-	//meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/Brian_Quest64.obj").c_str(), context, device));
-	//meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/flower.dae").c_str(), context, device));
-	//meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/Pikachu (Gigantamax).dae").c_str(), context, device));
-	//meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/Pikachu (Gigantamax).fbx").c_str(), context, device));
-	//meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cylinder.obj").c_str(), context, device));
-	//meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/helix.obj").c_str(), context, device));
-	//meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/torus.obj").c_str(), context, device));
-	meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/quad.obj").c_str(), context, device));
-
-
-
-	// Create Entities
-	for (size_t i = 0; i < materials.size(); i++)
+	// Only what the manifest's entities use gets loaded
+	const SceneManifest& manifest = resources->GetManifest();
+	for (unsigned int i = 0; i < manifest.Entities.size(); i++)
 	{
-		//entities.push_back(Entity(meshes[i], materials[i % 2]));
-		//entities[i * 2].GetTransform()->SetPosition(XMFLOAT3(-3.0f*(1+i), 0.0f, 0.0f));
-		//entities.push_back(Entity(meshes[i], materials[i%2 + 2]));
-		//entities[i * 2 + 1].GetTransform()->SetPosition(XMFLOAT3(3.0f * (1 + i), 0.0f, 0.0f));
-		entities.push_back(Entity(meshes[1], materials[i]));
-		entities.back().GetTransform()->SetPosition(XMFLOAT3(2.0f * (i), 0.0f, 0.0f));
+		resources->Instantiate(i, manifest.Entities[i].Transparent ? transparentEntities : entities);
 	}
-	entities.push_back(Entity(meshes[0], materials[6]));
-	entities.back().GetTransform()->SetScale(15.0f, 1.0f, 15.0f);
-	entities.back().GetTransform()->SetPosition(0.0f, -3.0f, 0.0f);
 
-	for (size_t i = 0; i < transparentMaterials.size(); i++)
+	// Textures decode on the loader's threads; materials need the views filled in
+	resources->Finish();
+	skyBox->CreateEnvironmentLighting(device);
+
+	// Every material is lit by the sky
+	if (skyBox->GetSpecularMap())
 	{
-		transparentEntities.push_back(Entity(meshes[1], transparentMaterials[i]));
-		transparentEntities.back().GetTransform()->SetPosition(-(i * 2.0f), 1.0f, -2.5f);
+		for (auto& material : resources->GetMaterials())
+		{
+			material->AddTextureSRV("SpecularMap", skyBox->GetSpecularMap());
+			material->AddTextureSRV("BRDFLookup", skyBox->GetBRDFLookup());
+		}
 	}
 
-	transparentEntities.push_back(Entity(meshes[2], transparentMaterials[2]));
-	transparentEntities.back().GetTransform()->SetScale(15.0f, 1.0f, 15.0f);
-	transparentEntities.back().GetTransform()->SetPosition(0, -1.99f, 0);
-	transparentEntities.push_back(Entity(meshes[2], transparentMaterials[3]));
-	transparentEntities.back().GetTransform()->SetScale(15.0f, 1.0f, 15.0f);
-	transparentEntities.back().GetTransform()->SetPosition(0, -1.98f, 0);
-	//entities[0].SetMaterial(materials[0]);
-	//entities.back().SetMaterial(materials.back());
-
-
+	// Let the streamer swap new views into the materials using its textures
+	textureStreamer->TrackMaterials(resources->GetMaterials());
+	rainMaterial = resources->FindMaterial("rain");
 }
 
 
@@ -519,6 +362,14 @@ void Game::Update(float deltaTime, float totalTime)
 
 	UpdateUI(deltaTime);
 
+	// Upload meshes that finished loading, without stalling the frame for too long
+	meshLoader->Update(2.0f);
+	resources->Update();
+	if (meshLoadBenchmark) { meshLoadBenchmark->Update(2.0f); }
+
+	// Pose and skin animated characters
+	animator->Update(deltaTime);
+
 	// Update Camera
 	cameras[cameraIndex]->Update(deltaTime);
 
@@ -535,6 +386,11 @@ void Game::Update(float deltaTime, float totalTime)
 		//transparentEntities[i].GetTransform()->SetPosition(pos.x, (float)sin(totalTime) + 1.0f, pos.z);
 	}
 
+	// Stream texture mips for what's on screen now
+	RequestTextureMips(entities);
+	RequestTextureMips(transparentEntities);
+	textureStreamer->Update();
+
 
 	//Move SpotLight
 	spotLight.Position = cameras[cameraIndex]->GetPosition();
@@ -545,7 +401,8 @@ void Game::Update(float deltaTime, float totalTime)
 		&spotLight,
 		sizeof(Light));
 
-	shadowLights[0].SetDirection(cameras[cameraIndex]->GetTransform().GetForward());
+	// The spot shadow light follows the flashlight, whose shadow it casts
+	shadowLights[0].SetDirection(mouseDir);
 	shadowLights[0].SetPosition(cameras[cameraIndex]->GetPosition());
 
 	// Example input checking: Quit if the escape key is pressed
@@ -575,29 +432,52 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	}
 
-	// DRAW Shadow Map
-	for (ShadowLight shadowLight : shadowLights)
-	{
-		shadowLight.Update(entities, transparentEntities, ppRTV, depthBufferDSV, rastState);
-	}
-	if (customPS->HasShaderResourceView("ShadowMap")) { customPS->SetShaderResourceView("ShadowMap", shadowLights[1].GetShadowSRV()); }
+	// DRAW Shadow Maps
+	RenderShadowAtlas();
+	if (customPS->HasShaderResourceView("ShadowAtlas")) { customPS->SetShaderResourceView("ShadowAtlas", shadowAtlasSRV); }
 	if (customPS->HasSamplerState("ShadowSampler")) { customPS->SetSamplerState("ShadowSampler", shadowLights[1].GetShadowSampler()); }
+	if (customPS->HasShaderResourceView("ShadowMoments")) { customPS->SetShaderResourceView("ShadowMoments", shadowMomentFilter->GetMomentSRV()); }
+	if (customPS->HasSamplerState("ShadowMomentSampler")) { customPS->SetSamplerState("ShadowMomentSampler", shadowMomentFilter->GetSampler()); }
 	bool t = true;
 	if (customPS->HasVariable("hasShadowMap")) { customPS->SetData("hasShadowMap", &t, sizeof(bool)); }
+	// Upload (only if changed) and bind the scene lights once for the whole frame
+	lightBuffer->Bind(customPS, "Lights");
+	BindLightClusters();
 	// DRAW entities
-	XMFLOAT3 ambientColor = XMFLOAT3(uiColor.x * skyColor.x * BRIGHTNESS,
-		uiColor.y * skyColor.y * BRIGHTNESS,
-		uiColor.z * skyColor.z * BRIGHTNESS);
+	// Image based lighting, tinted like the sky itself
+	XMFLOAT3 environmentTint = XMFLOAT3(uiColor.x * environmentIntensity,
+		uiColor.y * environmentIntensity,
+		uiColor.z * environmentIntensity);
+	const SHCoefficients& irradiance = skyBox->GetIrradiance();
+	XMFLOAT4 irradianceSH[9];
+	for (int i = 0; i < 9; i++) { irradianceSH[i] = XMFLOAT4(irradiance.Values[i][0], irradiance.Values[i][1], irradiance.Values[i][2], 0.0f); }
 	// Loop through shaders and set universal data
 	//if (ps->HasVariable("totalTime")) { ps->SetFloat("totalTime", totalTime); }
 	if (customPS->HasVariable("totalTime")) { customPS->SetFloat("totalTime", totalTime); }
-	//if (ps->HasVariable("ambient")) { ps->SetFloat3("ambient", ambientColor); }
-	if (customPS->HasVariable("ambient")) { customPS->SetFloat3("ambient", ambientColor); }
+	if (customPS->HasVariable("environmentTint")) { customPS->SetFloat3("environmentTint", environmentTint); }
+	if (customPS->HasVariable("irradianceSH")) { customPS->SetData("irradianceSH", irradianceSH, sizeof(irradianceSH)); }
+	if (customPS->HasVariable("specularMipCount")) { customPS->SetFloat("specularMipCount", (float)skyBox->GetSpecularMipCount()); }
+
+	// Per entity lighting swaps each pixel's cluster list for the lights picked for its entity
+	bool perEntityLights = lightAssignmentMode == 1;
+	entityLightStats = {};
+	if (perEntityLights)
+	{
+		lightAssignment->SetLights(lights);
+		AssignEntityLights(entities);
+	}
+	else
+	{
+		customPS->SetInt("entityLightCount", -1);
+	}
 
 	for (size_t i = 0; i < entities.size(); i++)
 	{
-		entities[i].GetMaterial()->GetVertShader()->SetMatrix4x4("shadowView", shadowLights[1].GetShadowViewMatrix());
-		entities[i].GetMaterial()->GetVertShader()->SetMatrix4x4("shadowProjection", shadowLights[1].GetShadowProjectionMatrix());
+		if (perEntityLights)
+		{
+			customPS->SetData("entityLights", entityLights[i].Indices, sizeof(entityLights[i].Indices));
+			customPS->SetInt("entityLightCount", (int)entityLights[i].Count);
+		}
 		entities[i].Draw(context, cameras[cameraIndex]);
 	}
 
@@ -607,7 +487,7 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	// DRAW Transparent entities
 	{
-		if((int)(totalTime*100) % 10 == 0) { transparentMaterials[3]->AddUVOffset(XMFLOAT2(deltaTime*(rand()%10+2), deltaTime * (rand() % 10 + 2))); }
+		if(rainMaterial && (int)(totalTime*100) % 10 == 0) { rainMaterial->AddUVOffset(XMFLOAT2(deltaTime*(rand()%10+2), deltaTime * (rand() % 10 + 2))); }
 		// Sort the transparent objects by distance to the camera
 			// Sort using a lambda function
 		std::sort(
@@ -625,12 +505,16 @@ void Game::Draw(float deltaTime, float totalTime)
 				float bDist = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bPos) - XMLoadFloat3(&camPos)));
 				return aDist > bDist;
 			});
+		if (perEntityLights) { AssignEntityLights(transparentEntities); }
 		// Set blend state
 		context->OMSetBlendState(blendState.Get(), 0, 0xFFFFFFFF);
 		for (size_t i = 0; i < transparentEntities.size(); i++)
 		{
-			transparentEntities[i].GetMaterial()->GetVertShader()->SetMatrix4x4("shadowView", shadowLights[1].GetShadowViewMatrix());
-			transparentEntities[i].GetMaterial()->GetVertShader()->SetMatrix4x4("shadowProjection", shadowLights[1].GetShadowProjectionMatrix());
+			if (perEntityLights)
+			{
+				customPS->SetData("entityLights", entityLights[i].Indices, sizeof(entityLights[i].Indices));
+				customPS->SetInt("entityLightCount", (int)entityLights[i].Count);
+			}
 			transparentEntities[i].Draw(context, cameras[cameraIndex]);
 		}
 		// Reset blend state
@@ -678,6 +562,14 @@ void Game::Draw(float deltaTime, float totalTime)
 		// Unbind SRVs
 		ID3D11ShaderResourceView* nullSRVs[128] = {};
 		context->PSSetShaderResources(0, 128, nullSRVs);
+
+		// Save this frame's constant buffer uploads for the UI
+		uploadStats = ISimpleShader::UploadStats;
+		ISimpleShader::ResetUploadStats();
+		cullStats = Mesh::CullStats;
+		Mesh::ResetCullStats();
+		depthStats = Mesh::DepthStats;
+		Mesh::ResetDepthStats();
 	}
 }
 
@@ -725,6 +617,21 @@ void Game::BuildUI()
 		else { ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Framerate: %f fps", fps); }
 		ImGui::Text("Frame Count: %d", ImGui::GetFrameCount());
 		ImGui::Text("Window Resolution: %dx%d", windowWidth, windowHeight);
+		ImGui::Text("CB Uploads: %u buffers, %u bytes (%u dirty)",
+			uploadStats.BuffersUploaded, uploadStats.BytesUploaded, uploadStats.DirtyBytes);
+		ImGui::Text("CB Uploads Skipped: %u", uploadStats.BuffersSkipped);
+		ImGui::Checkbox("Meshlet Culling", &Mesh::MeshletCulling);
+		ImGui::Text("Meshlets: %u tested, %u outside frustum, %u backfacing",
+			cullStats.MeshletsTested, cullStats.FrustumCulled, cullStats.BackfaceCulled);
+		ImGui::Text("Triangles: %u submitted, %u culled", cullStats.TrianglesSubmitted, cullStats.TrianglesCulled);
+		ImGui::Text("Shadow Vertex Fetch: %.1f KB in %u draws (%.1f KB with full vertices)",
+			depthStats.VertexBytes / 1024.0f, depthStats.Draws, depthStats.InterleavedBytes / 1024.0f);
+		ImGui::Text("Shadow Maps: %u draws, %u casters culled, %u of %u maps cached (%.0f%%)", shadowStats.Draws,
+			shadowStats.CulledCasters, shadowStats.CachedMaps, shadowStats.Maps,
+			shadowStats.Maps > 0 ? shadowStats.CachedMaps * 100.0f / shadowStats.Maps : 0.0f);
+		AnimatorStats animatorStats = animator->GetStats();
+		ImGui::Text("Skinning: %u character(s), %u vertices in %.2fms (%u thread(s))", animatorStats.Characters,
+			animatorStats.VerticesSkinned, animatorStats.UpdateTime, animator->GetThreadCount());
 		ImGui::Checkbox("ImGui Demo Window Visibility", &demoWindowVisible);
 		if (ImGui::Button(isFullscreen ? "Windowed" : "Fullscreen")) {
 			isFullscreen = !isFullscreen;
@@ -749,22 +656,82 @@ void Game::BuildUI()
 	}
 	if (ImGui::TreeNode("Lighting"))
 	{
-		ImGui::DragFloat("Brightness", &BRIGHTNESS, 0.0002f, 0.001f, 0.5f, "%.3f");
+		ImGui::DragFloat("Environment Intensity", &environmentIntensity, 0.01f, 0.0f, 4.0f, "%.2f");
+		ImGui::Text("Sky lighting %s in %.0fms", skyBox->IsEnvironmentLightingCached() ? "read from cache" : "prefiltered",
+			skyBox->GetEnvironmentLightingTime());
 		ImGui::ColorEdit4("Background Color", &uiColor.x);
 		ImGui::ColorEdit3("Spotlight Color", &spotLight.Color.x);
+		if (ImGui::SliderInt("Extra Point Lights", &extraLightCount, 0, 4096)) { SetExtraLightCount(extraLightCount); }
+		LightClusterStats clusterStats = lightClusters->GetStats();
+		ImGui::Text("%u light(s) binned into %u clusters in %.2fms: %u in view, up to %u per cluster", clusterStats.Lights,
+			lightClusters->GetClusterCount(), clusterStats.BinTime, clusterStats.VisibleLights + clusterStats.DirectionalLights,
+			clusterStats.MaxClusterLights);
+		ImGui::RadioButton("Clustered", &lightAssignmentMode, 0); ImGui::SameLine();
+		ImGui::RadioButton("Per Entity", &lightAssignmentMode, 1);
+		if (lightAssignmentMode == 1)
+		{
+			ImGui::Text("%.2f light(s) per entity (up to %d), %u dropped, assigned in %.2fms",
+				entityLightStats.Entities > 0 ? entityLightStats.AssignedLights / (float)entityLightStats.Entities : 0.0f,
+				MAX_ENTITY_LIGHTS, entityLightStats.DroppedLights, entityLightStats.GridTime + entityLightStats.AssignTime);
+		}
 		if (ImGui::TreeNode("Scene Lights"))
 		{
 			if (ImGui::TreeNode("Shadow Lights"))
 			{
+				ImGui::Text("Atlas: %u tiles, %.0f%% used, %u dropped", shadowAtlas->GetTileCount(),
+					shadowAtlas->GetUsage() * 100.0f, shadowAtlas->GetDroppedCount());
+				ShadowAtlasSettings atlasSettings = shadowAtlas->GetSettings();
+				int maxTileOctave = (int)log2f((float)atlasSettings.MaxTileSize);
+				bool atlasChanged = ImGui::SliderInt("Max Tile Size (2^n)", &maxTileOctave, 7, 12);
+				atlasChanged |= ImGui::SliderFloat("Atlas Budget", &atlasSettings.Budget, 0.05f, 1.0f);
+				atlasChanged |= ImGui::SliderFloat("Tile Hysteresis", &atlasSettings.Hysteresis, 0.0f, 1.0f);
+				if (atlasChanged)
+				{
+					atlasSettings.MaxTileSize = 1u << maxTileOctave;
+					shadowAtlas->SetSettings(atlasSettings);
+				}
+				ImGui::Checkbox("Filtered (EVSM)", &filteredShadows);
+				if (filteredShadows)
+				{
+					ShadowMomentSettings momentSettings = shadowMomentFilter->GetSettings();
+					int blurRadius = (int)momentSettings.BlurRadius;
+					bool momentsChanged = ImGui::SliderFloat("Positive Exponent", &momentSettings.PositiveExponent, 1.0f, 42.0f);
+					momentsChanged |= ImGui::SliderFloat("Negative Exponent", &momentSettings.NegativeExponent, 1.0f, 42.0f);
+					momentsChanged |= ImGui::SliderFloat("Light Bleed Reduction", &momentSettings.LightBleedReduction, 0.0f, 0.9f);
+					momentsChanged |= ImGui::SliderInt("Blur Radius", &blurRadius, 0, MAX_SHADOW_BLUR_RADIUS);
+					momentsChanged |= ImGui::DragFloat("Min Deviation", &momentSettings.MinDeviation, 0.00001f, 0.0f, 0.01f, "%.5f");
+					if (momentsChanged)
+					{
+						momentSettings.BlurRadius = (unsigned int)blurRadius;
+						shadowMomentFilter->SetSettings(momentSettings);
+					}
+				}
+				ImGui::Image(shadowAtlasSRV.Get(), ImVec2(512, 512));
 				for (int i = 0; i < shadowLights.size(); i++)
 				{
 					char buf[128];
 					sprintf_s(buf, "ShadowLight %i", i);
 					if (ImGui::TreeNode(buf))
 					{
-						ImGui::Image(shadowLights[i].GetShadowSRV().Get(), ImVec2(512, 512));
 						if (shadowLights[i].GetType() == LIGHT_TYPE_DIR)
 						{
+							ShadowCascadeSettings cascadeSettings = shadowLights[i].GetCascadeSettings();
+							int cascadeCount = (int)cascadeSettings.Count;
+							bool cascadesChanged = ImGui::SliderInt("Cascades", &cascadeCount, 1, MAX_SHADOW_CASCADES);
+							cascadesChanged |= ImGui::SliderFloat("Split Lambda", &cascadeSettings.SplitLambda, 0.0f, 1.0f);
+							cascadesChanged |= ImGui::DragFloat("Shadow Distance", &cascadeSettings.MaxDistance, 0.5f, 1.0f, 500.0f);
+							if (cascadesChanged)
+							{
+								cascadeSettings.Count = (unsigned int)cascadeCount;
+								shadowLights[i].SetCascadeSettings(cascadeSettings);
+							}
+							for (unsigned int c = 0; c < shadowLights[i].GetCascadeCount(); c++)
+							{
+								const ShadowCascade& cascade = shadowLights[i].GetCascade(c);
+								const ShadowAtlasTile* tile = shadowAtlas->GetTile(i * MAX_LIGHT_SHADOW_MAPS + c);
+								ImGui::Text("Cascade %u: %.2f - %.2f, radius %.2f, %u texels", c, cascade.SplitNear, cascade.SplitFar,
+									cascade.Radius, tile ? tile->Size : 0);
+							}
 							XMFLOAT3 dir = shadowLights[i].GetDirection();
 							float dirArray[3] = { dir.x, dir.y, dir.z };
 							if (ImGui::DragFloat3("Direction", dirArray, 0.001f, -1.0f, 1.0f, "% .3f"))
@@ -773,8 +740,43 @@ void Game::BuildUI()
 							}
 
 						}
+						else if (shadowLights[i].GetType() == LIGHT_TYPE_POINT)
+						{
+							unsigned int texels[POINT_SHADOW_FACES];
+							for (unsigned int f = 0; f < POINT_SHADOW_FACES; f++)
+							{
+								const ShadowAtlasTile* tile = shadowAtlas->GetTile(i * MAX_LIGHT_SHADOW_MAPS + f);
+								texels[f] = tile ? tile->Size : 0;
+							}
+							ImGui::Text("Faces: %u %u %u %u %u %u texels", texels[0], texels[1], texels[2], texels[3], texels[4], texels[5]);
+							int facesPerFrame = (int)shadowLights[i].GetSlicedFacesPerFrame();
+							float sliceDistance = shadowLights[i].GetSliceDistance();
+							bool slicingChanged = ImGui::SliderInt("Faces Per Frame When Far", &facesPerFrame, 1, POINT_SHADOW_FACES);
+							slicingChanged |= ImGui::DragFloat("Far From Camera", &sliceDistance, 0.5f, 0.0f, 200.0f);
+							if (slicingChanged)
+							{
+								shadowLights[i].SetFaceSlicing((unsigned int)facesPerFrame, sliceDistance);
+							}
+							// Moves the scene light too, if this shadows one
+							XMFLOAT3 pos = shadowLights[i].GetPosition();
+							float posArray[3] = { pos.x, pos.y, pos.z };
+							if (ImGui::DragFloat3("Position", posArray, 0.01f, -20.0f, 20.0f, "% .3f"))
+							{
+								shadowLights[i].SetPosition(XMFLOAT3(posArray[0], posArray[1], posArray[2]));
+								int sceneLightId = shadowLights[i].GetSceneLightId();
+								if (sceneLightId >= 0)
+								{
+									Light light = lights.Get(sceneLightId);
+									light.Position = shadowLights[i].GetPosition();
+									lights.Set(sceneLightId, light);
+									lightBuffer->SetElement(lights.GetIndex(sceneLightId), lights.GetPacked()[lights.GetIndex(sceneLightId)]);
+								}
+							}
+						}
 						else
 						{
+							const ShadowAtlasTile* tile = shadowAtlas->GetTile(i * MAX_LIGHT_SHADOW_MAPS);
+							ImGui::Text("Tile: %u texels", tile ? tile->Size : 0);
 							XMFLOAT3 dir = shadowLights[i].GetDirection();
 							float dirArray[3] = { dir.x, dir.y, dir.z };
 							if (ImGui::DragFloat3("Direction", dirArray, 0.001f, -1.0f, 1.0f, "% .3f"))
@@ -794,19 +796,16 @@ void Game::BuildUI()
 				}
 				ImGui::TreePop();
 			}
-			for (int i = 0; i < lights.size(); i++)
+			for (unsigned int i = 0; i < sceneLightCount; i++)
 			{
 				char buf[128];
 				sprintf_s(buf, "Light %i Color", i);
 				// Edit color of each light
-				if (ImGui::ColorEdit3(buf, &lights[i].Color.x))
+				Light light = lights.Get(i);
+				if (ImGui::ColorEdit3(buf, &light.Color.x))
 				{
-					//ps->SetData("lights",
-					//	&lights[0],
-					//	sizeof(Light) * MAX_NUM_LIGHTS);
-					customPS->SetData("lights",
-						&lights[0],
-						sizeof(Light) * MAX_NUM_LIGHTS);
+					lights.Set(i, light);
+					lightBuffer->SetElement(lights.GetIndex(i), lights.GetPacked()[lights.GetIndex(i)]);
 				}
 			}
 			ImGui::TreePop();
@@ -857,13 +856,95 @@ void Game::BuildUI()
 	}
 	if (ImGui::TreeNode("Meshes"))
 	{
+		ImGui::Text("Startup: %.2fms until the first frame", initTime);
+		if (meshLoader->GetPendingCount() > 0)
+			ImGui::Text("Loading %u mesh(es) on %u thread(s)", meshLoader->GetPendingCount(), meshLoader->GetThreadCount());
+		else
+			ImGui::Text("All meshes ready %.2fms after loading started (%u thread(s))", meshLoader->GetLastBatchTime(), meshLoader->GetThreadCount());
+		ResourceRegistryStats resourceStats = resources->GetStats();
+		ImGui::Text("Scene manifest %s in %.2fms", resourceStats.Compiled ? "compiled" : "read", resourceStats.ManifestTime);
+		ImGui::Text("Loaded %u of %u mesh(es), %u of %u texture(s), %u of %u material(s)",
+			resourceStats.LoadedMeshes, resourceStats.DeclaredMeshes, resourceStats.LoadedTextures, resourceStats.DeclaredTextures,
+			resourceStats.LoadedMaterials, resourceStats.DeclaredMaterials);
+		ImGui::Text("Shared: %u mesh(es), %u texture(s)", resourceStats.SharedMeshes, resourceStats.SharedTextures);
+		if (ImGui::Button("Load 50 models (cold)")) { StartMeshLoadBenchmark(true); }
+		ImGui::SameLine();
+		if (ImGui::Button("Load 50 models (cached)")) { StartMeshLoadBenchmark(false); }
+		if (meshLoadBenchmark && meshLoadBenchmark->GetPendingCount() > 0)
+			ImGui::Text("Benchmark: %u of %u model(s) still loading", meshLoadBenchmark->GetPendingCount(), MESH_LOAD_BENCHMARK_COUNT);
+		else if (meshLoadBenchmark)
+		{
+			unsigned int cached = 0;
+			for (auto& mesh : meshLoadBenchmarkMeshes) { cached += mesh->WasLoadedFromCache() ? 1 : 0; }
+			ImGui::Text("Benchmark: %u model(s) ready %.2fms after queuing (%u thread(s), %u from cache)", MESH_LOAD_BENCHMARK_COUNT,
+				meshLoadBenchmark->GetLastBatchTime(), meshLoadBenchmark->GetThreadCount(), cached);
+		}
+		const std::vector<std::shared_ptr<Mesh>>& meshes = resources->GetMeshes();
 		for (size_t i = 0; i < meshes.size(); i++)
 		{
-			ImGui::Text("Mesh %i: %i triangle(s), %i indices", i, meshes[i]->GetIndexCount() / 3, meshes[i]->GetVertexCount());
+			ImGui::Text("Mesh %i: %i triangle(s), %i vertices, loaded in %.2fms%s", i, meshes[i]->GetIndexCount() / 3,
+				meshes[i]->GetVertexCount(), meshes[i]->GetLoadTime(),
+				!meshes[i]->IsReady() ? " (loading)" : meshes[i]->WasLoadedFromCache() ? " (cached)" : "");
+			ImGui::Text("    %s vertices: %.1f KB (%.1f KB uncompressed)",
+				meshes[i]->GetVertexFormat() == MESH_VERTEX_QUANTIZED ? "Quantized" : "Compact",
+				meshes[i]->GetGPUMemory() / 1024.0f, meshes[i]->GetUncompressedMemory() / 1024.0f);
+			ImGui::Text("    %u submesh(es), %u meshlets", meshes[i]->GetSubmeshCount(), (unsigned int)meshes[i]->GetMeshlets().size());
+			MeshVertexCacheRatios cacheRatios = meshes[i]->GetVertexCacheRatios();
+			if (cacheRatios.ACMRAfter > 0.0f)
+			{
+				ImGui::Text("    Vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", cacheRatios.ACMRBefore, cacheRatios.ACMRAfter,
+					cacheRatios.ATVRBefore, cacheRatios.ATVRAfter);
+			}
 		}
 
 		ImGui::TreePop();
 	}
+	if (ImGui::TreeNode("Textures"))
+	{
+		TextureLoadStats textureStats = textureLoader->GetStats();
+		ImGui::Text("%u texture(s) loaded in %.2fms on %u thread(s), %u from cooked .dds files", textureStats.Textures,
+			textureStats.LoadTime, textureLoader->GetThreadCount(), textureStats.Cooked);
+		ImGui::Text("GPU memory: %.1f MB", textureStats.GPUBytes / 1048576.0f);
+		if (textureStats.Cooked < textureStats.Textures)
+			ImGui::Text("Run with -cook to compress the material textures");
+
+		// What packing each material's occlusion/roughness/metalness/opacity maps saves, against a BC4 texture per map
+		const std::vector<TexturePackStats>& packStats = textureLoader->GetPackStats();
+		if (!packStats.empty() && ImGui::TreeNode("Packed maps"))
+		{
+			size_t separateBytes = 0;
+			size_t packedBytes = 0;
+			for (const TexturePackStats& pack : packStats)
+			{
+				separateBytes += pack.SeparateBytes;
+				packedBytes += pack.Bytes;
+			}
+			ImGui::Text("Every material: %.0fKB as separate maps -> %.0fKB", separateBytes / 1024.0f, packedBytes / 1024.0f);
+			for (const TexturePackStats& pack : packStats)
+			{
+				ImGui::Text("%s: %u of %u map(s) packed, %.0fKB -> %.0fKB, %u -> %u sample(s) and %.1f -> %.1f bytes per pixel",
+					pack.Name.c_str(), pack.PackedMaps, pack.Maps, pack.SeparateBytes / 1024.0f, pack.Bytes / 1024.0f,
+					pack.Maps, pack.Samples, pack.SeparateTexelBytes, pack.TexelBytes);
+			}
+			ImGui::TreePop();
+		}
+
+		if (ImGui::Button("Time loading on 1, 4 and 8 threads")) { RunTextureLoadBenchmark(); }
+		if (textureLoadBenchmarkTimes[0] > 0)
+		{
+			ImGui::Text("Every mip of the manifest's textures: %.2fms on 1 thread, %.2fms on 4, %.2fms on 8",
+				textureLoadBenchmarkTimes[0], textureLoadBenchmarkTimes[1], textureLoadBenchmarkTimes[2]);
+		}
+
+		ImGui::Text("Streaming %u texture(s): %.1f MB resident of %.1f MB budget (%.1f MB loading)", textureStreamer->GetTextureCount(),
+			textureStreamer->GetResidentBytes() / 1048576.0f, textureStreamer->GetBudget() / 1048576.0f,
+			textureStreamer->GetPendingBytes() / 1048576.0f);
+		ImGui::Text("%u mip(s) streamed in, %u evicted", textureStreamer->GetLoadCount(), textureStreamer->GetEvictionCount());
+		int budgetMB = (int)(textureStreamer->GetBudget() / (1024 * 1024));
+		if (ImGui::SliderInt("Budget (MB)", &budgetMB, 4, 256)) { textureStreamer->SetBudget((size_t)budgetMB * 1024 * 1024); }
+
+		ImGui::TreePop();
+	}
 	if (ImGui::TreeNode("Scene Entities"))
 	{
 		for (int i = 0; i < entities.size(); i++)
@@ -1030,3 +1111,270 @@ DirectX::XMFLOAT3 Game::MouseRayCast()
 	XMStoreFloat3(&ray_wor, ray_wor_vec);
 	return ray_wor;
 }
+
+// --------------------------------------------------------
+// Requests the texture mips each entity needs at its size
+// on screen this frame
+// --------------------------------------------------------
+void Game::RequestTextureMips(std::vector<Entity>& drawnEntities)
+{
+	std::shared_ptr<Camera> camera = cameras[cameraIndex];
+	XMFLOAT3 cameraPos = camera->GetPosition();
+	XMFLOAT3 cameraForward = camera->GetTransform().GetForward();
+	bool perspective = camera->GetIsPerspective();
+
+	// Pixels per world unit, at a distance of 1 for perspective
+	float pixelsPerUnit = perspective ? windowHeight * 0.5f / tanf(camera->GetFov() * 0.5f) : 1.0f / camera->GetOrthoScale();
+
+	for (Entity& entity : drawnEntities)
+	{
+		std::shared_ptr<Mesh> mesh = entity.GetMesh();
+		XMFLOAT3 boundsMin = mesh->GetBoundsMin();
+		XMFLOAT3 boundsMax = mesh->GetBoundsMax();
+		XMVECTOR center = (XMLoadFloat3(&boundsMin) + XMLoadFloat3(&boundsMax)) * 0.5f;
+		float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&boundsMax) - XMLoadFloat3(&boundsMin))) * 0.5f;
+
+		XMFLOAT4X4 world = entity.GetTransform()->GetWorldMatrix();
+		XMFLOAT3 scale = entity.GetTransform()->GetScale();
+		float worldRadius = radius * std::max(fabsf(scale.x), std::max(fabsf(scale.y), fabsf(scale.z)));
+		XMVECTOR toEntity = XMVector3Transform(center, XMLoadFloat4x4(&world)) - XMLoadFloat3(&cameraPos);
+
+		// Nothing behind the camera needs detail
+		if (XMVectorGetX(XMVector3Dot(toEntity, XMLoadFloat3(&cameraForward))) < -worldRadius)
+			continue;
+
+		float projectedRadius = worldRadius * pixelsPerUnit;
+		if (perspective)
+			projectedRadius /= std::max(XMVectorGetX(XMVector3Length(toEntity)), camera->GetNearDist());
+
+		for (const MeshSubmeshRange& range : mesh->GetSubmeshRanges())
+		{
+			textureStreamer->RequestMaterial(entity.GetMaterial(range.MaterialIndex).get(),
+				mesh->GetUVDensity(), radius, projectedRadius);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Replaces the lights after the scene's own with random
+// point lights over the floor
+// --------------------------------------------------------
+void Game::SetExtraLightCount(int count)
+{
+	lights.Truncate(sceneLightCount);
+	srand(1234);
+	for (int i = 0; i < count; i++)
+	{
+		Light light = {};
+		light.Type = LIGHT_TYPE_POINT;
+		light.Position = XMFLOAT3(rand() / (float)RAND_MAX * 30.0f - 15.0f, rand() / (float)RAND_MAX * 4.0f - 2.5f,
+			rand() / (float)RAND_MAX * 30.0f - 15.0f);
+		light.Range = 1.0f + rand() / (float)RAND_MAX * 2.0f;
+		light.Color = XMFLOAT3(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+		light.Intensity = 0.5f;
+		lights.Add(light);
+	}
+	lightBuffer->SetData(lights.GetPacked());
+}
+
+// --------------------------------------------------------
+// Bins the lights into the current camera's clusters and
+// binds the lists and the constants to find a pixel's
+// cluster to the pixel shader
+// --------------------------------------------------------
+void Game::BindLightClusters()
+{
+	std::shared_ptr<Camera> camera = cameras[cameraIndex];
+	XMFLOAT4X4 view = camera->GetViewMatrix();
+	XMFLOAT4X4 projection = camera->GetProjMatrix();
+	lightClusters->SetProjection(&projection._11, camera->GetNearDist(), camera->GetFarDist());
+	lightClusters->Bin(lights, &view._11);
+
+	clusterRangeBuffer->SetData(lightClusters->GetRanges());
+	clusterIndexBuffer->SetData(lightClusters->GetIndices());
+	clusterRangeBuffer->Bind(customPS, "ClusterRanges");
+	clusterIndexBuffer->Bind(customPS, "ClusterLightIndices");
+
+	unsigned int clusterCount[3] = { lightClusters->GetTilesX(), lightClusters->GetTilesY(), lightClusters->GetSlices() };
+	customPS->SetInt("directionalLightCount", (int)lights.GetTypeCount(LIGHT_TYPE_DIR));
+	customPS->SetInt("spotLightOffset", (int)lights.GetTypeOffset(LIGHT_TYPE_SPOT));
+	customPS->SetFloat4("clusterViewZ", XMFLOAT4(view._13, view._23, view._33, view._43));
+	customPS->SetFloat2("clusterScale", XMFLOAT2(clusterCount[0] / (float)windowWidth, clusterCount[1] / (float)windowHeight));
+	customPS->SetFloat("clusterDepthScale", lightClusters->GetDepthScale());
+	customPS->SetFloat("clusterDepthBias", lightClusters->GetDepthBias());
+	customPS->SetData("clusterCount", clusterCount, sizeof(clusterCount));
+}
+
+// --------------------------------------------------------
+// World bounding sphere of each entity's mesh, in the same
+// order as drawnEntities
+// --------------------------------------------------------
+void Game::GetEntityBounds(std::vector<Entity>& drawnEntities, std::vector<EntityBounds>& bounds)
+{
+	bounds.resize(drawnEntities.size());
+	for (size_t i = 0; i < drawnEntities.size(); i++)
+	{
+		std::shared_ptr<Mesh> mesh = drawnEntities[i].GetMesh();
+		XMFLOAT3 boundsMin = mesh->GetBoundsMin();
+		XMFLOAT3 boundsMax = mesh->GetBoundsMax();
+		XMVECTOR center = (XMLoadFloat3(&boundsMin) + XMLoadFloat3(&boundsMax)) * 0.5f;
+		float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&boundsMax) - XMLoadFloat3(&boundsMin))) * 0.5f;
+
+		XMFLOAT4X4 world = drawnEntities[i].GetTransform()->GetWorldMatrix();
+		XMFLOAT3 scale = drawnEntities[i].GetTransform()->GetScale();
+		XMFLOAT3 worldCenter;
+		XMStoreFloat3(&worldCenter, XMVector3Transform(center, XMLoadFloat4x4(&world)));
+		bounds[i] = { { worldCenter.x, worldCenter.y, worldCenter.z },
+			radius * std::max(fabsf(scale.x), std::max(fabsf(scale.y), fabsf(scale.z))) };
+	}
+}
+
+// --------------------------------------------------------
+// Picks the brightest lights reaching each entity's world
+// bounding sphere, in the same order as drawnEntities
+// --------------------------------------------------------
+void Game::AssignEntityLights(std::vector<Entity>& drawnEntities)
+{
+	GetEntityBounds(drawnEntities, entityBounds);
+	lightAssignment->Assign(entityBounds.data(), (unsigned int)entityBounds.size(), entityLights);
+	LightAssignmentStats stats = lightAssignment->GetStats();
+	entityLightStats.Entities += stats.Entities;
+	entityLightStats.AssignedLights += stats.AssignedLights;
+	entityLightStats.DroppedLights += stats.DroppedLights;
+	entityLightStats.GridTime = stats.GridTime;
+	entityLightStats.AssignTime += stats.AssignTime;
+}
+
+// --------------------------------------------------------
+// Fits every shadow light to the camera, hands out atlas
+// tiles by how much of the screen each shadow map covers,
+// renders the ones that changed and uploads what the pixel
+// shader needs to find them: the first directional
+// light's cascades in slots 0-3, the first spot light's
+// map in slot 4 and the first point light's faces in 5-10
+// --------------------------------------------------------
+void Game::RenderShadowAtlas()
+{
+	std::shared_ptr<Camera> camera = cameras[cameraIndex];
+	XMFLOAT4X4 view = camera->GetViewMatrix();
+	XMFLOAT4X4 projection = camera->GetProjMatrix();
+	for (unsigned int i = 0; i < shadowLights.size(); i++)
+	{
+		shadowLights[i].Update(camera);
+		for (unsigned int c = 0; c < shadowLights[i].GetCascadeCount(); c++)
+		{
+			const ShadowCascade& cascade = shadowLights[i].GetCascade(c);
+			shadowAtlas->Request(i * MAX_LIGHT_SHADOW_MAPS + c,
+				GetSphereScreenCoverage(&view._11, &projection._11, cascade.Center, cascade.Radius));
+		}
+	}
+	shadowAtlas->Allocate();
+
+	// Opaque entities cast shadows, each light culling them to its own maps
+	GetEntityBounds(entities, shadowCasterBounds);
+	shadowStats = {};
+	for (unsigned int i = 0; i < shadowLights.size(); i++)
+	{
+		shadowLights[i].Render(*shadowAtlas, i * MAX_LIGHT_SHADOW_MAPS, shadowAtlasDSV,
+			entities, shadowCasterBounds, filteredShadows ? shadowMomentFilter.get() : nullptr, ppRTV, depthBufferDSV, rastState);
+		ShadowRenderStats stats = shadowLights[i].GetRenderStats();
+		shadowStats.Maps += stats.Maps;
+		shadowStats.CachedMaps += stats.CachedMaps;
+		shadowStats.Draws += stats.Draws;
+		shadowStats.CulledCasters += stats.CulledCasters;
+	}
+
+	// Maps without a tile keep a zero rect, which the shader reads as unshadowed
+	XMFLOAT4X4 shadowViewProjection[MAX_SHADOW_CASCADES + 1 + POINT_SHADOW_FACES] = {};
+	XMFLOAT4 shadowAtlasRects[MAX_SHADOW_CASCADES + 1 + POINT_SHADOW_FACES] = {};
+	XMFLOAT4 shadowDepthParams[MAX_SHADOW_CASCADES + 1 + POINT_SHADOW_FACES] = {};
+	XMFLOAT4 cascadeSplits = {};
+	unsigned int cascadeCount = 0;
+	int shadowedPointLight = -1;
+	// The shader has slots for one light of each type; any others still render, but aren't sampled
+	bool typeHasSlots[3] = {};
+	for (unsigned int light = 0; light < shadowLights.size(); light++)
+	{
+		int type = shadowLights[light].GetType();
+		if (typeHasSlots[type])
+			continue;
+		typeHasSlots[type] = true;
+		unsigned int firstSlot = type == LIGHT_TYPE_DIR ? 0 : type == LIGHT_TYPE_SPOT ? MAX_SHADOW_CASCADES : MAX_SHADOW_CASCADES + 1;
+		if (type == LIGHT_TYPE_DIR) { cascadeCount = shadowLights[light].GetCascadeCount(); }
+		// Its faces are only sampled for the scene light it shadows
+		if (type == LIGHT_TYPE_POINT && shadowLights[light].GetSceneLightId() >= 0)
+		{
+			shadowedPointLight = (int)lights.GetIndex(shadowLights[light].GetSceneLightId());
+		}
+		for (unsigned int cascade = 0; cascade < shadowLights[light].GetCascadeCount(); cascade++)
+		{
+			if (type == LIGHT_TYPE_DIR) { (&cascadeSplits.x)[cascade] = shadowLights[light].GetCascade(cascade).SplitFar; }
+			const ShadowAtlasTile* tile = shadowAtlas->GetTile(light * MAX_LIGHT_SHADOW_MAPS + cascade);
+			if (!tile)
+				continue;
+			unsigned int slot = firstSlot + cascade;
+			memcpy(&shadowViewProjection[slot], shadowLights[light].GetCascade(cascade).ViewProjection, sizeof(XMFLOAT4X4));
+			shadowAtlas->GetTileRect(*tile, &shadowAtlasRects[slot].x);
+			GetShadowDepthParams(shadowLights[light].GetCascade(cascade).Projection, &shadowDepthParams[slot].x);
+		}
+	}
+	customPS->SetData("shadowViewProjection", shadowViewProjection, sizeof(shadowViewProjection));
+	customPS->SetData("shadowAtlasRects", shadowAtlasRects, sizeof(shadowAtlasRects));
+	customPS->SetFloat4("cascadeSplits", cascadeSplits);
+	customPS->SetInt("cascadeCount", (int)cascadeCount);
+	customPS->SetFloat("shadowAtlasTexelSize", 1.0f / shadowAtlas->GetSettings().Size);
+	customPS->SetInt("shadowedPointLight", shadowedPointLight);
+	customPS->SetInt("shadowFilter", filteredShadows ? 1 : 0);
+	customPS->SetData("shadowDepthParams", shadowDepthParams, sizeof(shadowDepthParams));
+	customPS->SetFloat4("shadowMomentParams", shadowMomentFilter->GetShaderParams());
+	customPS->SetFloat("shadowMomentTexelSize", 1.0f / shadowMomentFilter->GetSize());
+	customPS->SetFloat("shadowMomentMipCount", (float)shadowMomentFilter->GetMipCount());
+}
+
+// --------------------------------------------------------
+// Queues 50 models on a loader of their own, as startup
+// queues the scene's, and times how long they take to all
+// become ready while frames keep running. Loads of one file
+// are shared, so each is a copy of one of the repo's models
+// in the temp directory; cold runs delete their .mesh
+// caches first, so every model is imported again.
+// --------------------------------------------------------
+void Game::StartMeshLoadBenchmark(bool cold)
+{
+	const wchar_t* models[] = { L"Brian_Quest64.obj", L"cheburashka.obj", L"cylinder.obj", L"flower.dae", L"helix.obj",
+		L"N square.obj", L"Pikachu (Gigantamax).fbx", L"sphere.obj", L"torus.obj", L"yoshi.obj" };
+	wchar_t tempPath[MAX_PATH];
+	GetTempPathW(MAX_PATH, tempPath);
+	std::wstring directory = std::wstring(tempPath) + L"MeshLoadBenchmark\\";
+	CreateDirectoryW(directory.c_str(), nullptr);
+
+	meshLoadBenchmark = std::make_unique<MeshLoader>(context, device);
+	meshLoadBenchmarkMeshes.clear();
+	for (unsigned int i = 0; i < MESH_LOAD_BENCHMARK_COUNT; i++)
+	{
+		const wchar_t* model = models[i % ARRAYSIZE(models)];
+		std::wstring copyPath = directory + std::to_wstring(i) + L" " + model;
+		CopyFileW(FixPath(std::wstring(L"../../Assets/Models/") + model).c_str(), copyPath.c_str(), TRUE);
+		if (cold) { DeleteFileW(NarrowToWide(GetMeshCachePath(WideToNarrow(copyPath))).c_str()); }
+		meshLoadBenchmarkMeshes.push_back(meshLoadBenchmark->LoadAsync(copyPath));
+	}
+}
+
+// --------------------------------------------------------
+// Loads every texture the manifest declares again, on new
+// TextureLoaders of 1, 4 and 8 threads, and times each.
+// Blocks the frame it's run in. Nothing streams, so every
+// mip loads, and the files are already in the OS's cache.
+// --------------------------------------------------------
+void Game::RunTextureLoadBenchmark()
+{
+	const unsigned int threadCounts[3] = { 1, 4, 8 };
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		TextureLoader loader(context, device, threadCounts[i]);
+		std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> views;
+		resources->QueueAllTextures(loader, views);
+		loader.Finish();
+		textureLoadBenchmarkTimes[i] = loader.GetStats().LoadTime;
+	}
+}
@@ -5,6 +5,8 @@
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include <memory>
 #include "Mesh.h"
+#include "MeshLoader.h"
+#include "Animator.h"
 #include <vector>
 #include "BuffStructs.h"
 #include "Entity.h"
@@ -12,9 +14,16 @@
 #include "SimpleShader.h"
 #include "Material.h"
 #include "Light.h"
+#include "LightSet.h"
 #include "WICTextureLoader.h"
+#include "TextureLoader.h"
+#include "TextureStreamer.h"
 #include "Sky.h"
 #include "ShadowLight.h"
+#include "StructuredBuffer.h"
+#include "LightClusters.h"
+#include "LightAssignment.h"
+#include "ResourceRegistry.h"
 
 
 class Game 
@@ -48,13 +57,42 @@ private:
 
 	// Lights
 	Light spotLight;
-	std::vector<Light> lights;
-	std::vector<ShadowLight> shadowLights;
+	LightSet lights;
+	std::unique_ptr<StructuredBuffer<PackedLight>> lightBuffer;
+	unsigned int sceneLightCount;		// Ids of the lights before any added by the UI's light count
+	// Clustered lighting: lights binned into froxels of the camera's frustum every frame
+	std::unique_ptr<LightClusters> lightClusters;
+	std::unique_ptr<StructuredBuffer<LightClusterRange>> clusterRangeBuffer;
+	std::unique_ptr<StructuredBuffer<unsigned int>> clusterIndexBuffer;
+	// Or each entity's brightest few lights, picked on the CPU and set per draw
+	std::unique_ptr<LightAssignment> lightAssignment;
+	std::vector<EntityBounds> entityBounds;
+	std::vector<EntityLights> entityLights;
+	LightAssignmentStats entityLightStats;	// Summed over this frame's entity lists
+	std::vector<ShadowLight> shadowLights;	// The flashlight's spot, the directional light and a point light
+	// Every shadow light's maps, packed into tiles of one depth texture each frame
+	std::unique_ptr<ShadowAtlas> shadowAtlas;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowAtlasDSV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowAtlasSRV;
+	std::unique_ptr<ShadowMomentFilter> shadowMomentFilter;
+	std::vector<EntityBounds> shadowCasterBounds;
+	ShadowRenderStats shadowStats;		// Summed over the shadow lights this frame
 
 	// Store data for entities
-	std::vector<std::shared_ptr<Mesh>> meshes;
-	std::vector<std::shared_ptr<Material>> materials;
-	std::vector<std::shared_ptr<Material>> transparentMaterials;
+	std::unique_ptr<MeshLoader> meshLoader;
+	std::unique_ptr<TextureLoader> textureLoader;
+	std::unique_ptr<TextureStreamer> textureStreamer;
+	// Skeletal animation
+	std::unique_ptr<Animator> animator;
+	// Everything the scene manifest declares, loaded on first use
+	std::unique_ptr<ResourceRegistry> resources;
+	float initTime;			// Milliseconds spent in Init(), before the first frame
+	// The Meshes UI's load benchmark: copies of the models, on a loader of their own so they stay out of the scene
+	std::unique_ptr<MeshLoader> meshLoadBenchmark;
+	std::vector<std::shared_ptr<Mesh>> meshLoadBenchmarkMeshes;
+	// The Textures UI's: milliseconds to load the manifest's textures on 1, 4 and 8 threads (0 until it's run)
+	float textureLoadBenchmarkTimes[3];
+	std::shared_ptr<Material> rainMaterial;		// Scrolled every frame
 	std::vector<Entity> entities;
 	std::vector<Entity> transparentEntities;
 	std::unique_ptr<Sky> skyBox;
@@ -78,10 +116,23 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ppSRV; // For sampling
 	int blurStrength;
 
+	// Constant buffer uploads from the last completed frame
+	SimpleShaderUploadStats uploadStats;
+	MeshletCullStats cullStats;
+	MeshDepthStats depthStats;
+
 	// Helper Functions
 	void PostProcessSetup();
 	void ResetPostProcess();
 	DirectX::XMFLOAT3 MouseRayCast();
+	void RequestTextureMips(std::vector<Entity>& drawnEntities);
+	void SetExtraLightCount(int count);
+	void BindLightClusters();
+	void GetEntityBounds(std::vector<Entity>& drawnEntities, std::vector<EntityBounds>& bounds);
+	void AssignEntityLights(std::vector<Entity>& drawnEntities);
+	void RenderShadowAtlas();
+	void StartMeshLoadBenchmark(bool cold);
+	void RunTextureLoadBenchmark();
 
 };
 
@@ -0,0 +1,487 @@
+#include "ImageBasedLighting.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// DXGI_FORMAT values for the DDS header (spelled out so this file doesn't need D3D)
+static const unsigned int DDS_FORMAT_R16G16B16A16_FLOAT = 10;
+static const unsigned int DDS_FORMAT_R16G16_FLOAT = 34;
+
+static const float PI = 3.14159265359f;
+
+// Gamma the sky images are encoded with (the sky shader shows them as they are)
+static const float SKY_GAMMA = 2.2f;
+
+// --------------------------------------------------------
+// Cube map helpers
+// --------------------------------------------------------
+
+static void Normalize(float v[3])
+{
+	float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	v[0] /= length;
+	v[1] /= length;
+	v[2] /= length;
+}
+
+void GetCubemapDirection(unsigned int face, float u, float v, float direction[3])
+{
+	float s = u * 2.0f - 1.0f;
+	float t = v * 2.0f - 1.0f;
+	switch (face)
+	{
+	case 0: direction[0] = 1.0f; direction[1] = -t; direction[2] = -s; break;
+	case 1: direction[0] = -1.0f; direction[1] = -t; direction[2] = s; break;
+	case 2: direction[0] = s; direction[1] = 1.0f; direction[2] = t; break;
+	case 3: direction[0] = s; direction[1] = -1.0f; direction[2] = -t; break;
+	case 4: direction[0] = s; direction[1] = -t; direction[2] = 1.0f; break;
+	default: direction[0] = -s; direction[1] = -t; direction[2] = -1.0f; break;
+	}
+	Normalize(direction);
+}
+
+// The face a direction points at, and where on it (0 to 1)
+static unsigned int GetCubemapFace(const float direction[3], float& u, float& v)
+{
+	float x = direction[0], y = direction[1], z = direction[2];
+	float ax = fabsf(x), ay = fabsf(y), az = fabsf(z);
+	unsigned int face;
+	float s, t;
+	if (ax >= ay && ax >= az)
+	{
+		face = x > 0.0f ? 0 : 1;
+		s = (x > 0.0f ? -z : z) / ax;
+		t = -y / ax;
+	}
+	else if (ay >= az)
+	{
+		face = y > 0.0f ? 2 : 3;
+		s = x / ay;
+		t = (y > 0.0f ? z : -z) / ay;
+	}
+	else
+	{
+		face = z > 0.0f ? 4 : 5;
+		s = (z > 0.0f ? x : -x) / az;
+		t = -y / az;
+	}
+	u = s * 0.5f + 0.5f;
+	v = t * 0.5f + 0.5f;
+	return face;
+}
+
+// Bilinear sample within one face (clamped at its edges)
+static void SampleCubemap(const EnvironmentCubemap& cubemap, const float direction[3], float color[3])
+{
+	float u, v;
+	const std::vector<float>& face = cubemap.Faces[GetCubemapFace(direction, u, v)];
+	int size = (int)cubemap.Size;
+	float x = std::min(std::max(u * size - 0.5f, 0.0f), (float)(size - 1));
+	float y = std::min(std::max(v * size - 0.5f, 0.0f), (float)(size - 1));
+	int x0 = (int)x, y0 = (int)y;
+	int x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+	float fx = x - x0, fy = y - y0;
+	for (int c = 0; c < 3; c++)
+	{
+		float top = face[(y0 * size + x0) * 3 + c] * (1.0f - fx) + face[(y0 * size + x1) * 3 + c] * fx;
+		float bottom = face[(y1 * size + x0) * 3 + c] * (1.0f - fx) + face[(y1 * size + x1) * 3 + c] * fx;
+		color[c] = top * (1.0f - fy) + bottom * fy;
+	}
+}
+
+// Trilinear sample from a chain of box filtered cube maps
+static void SampleCubemapLevel(const std::vector<EnvironmentCubemap>& chain, const float direction[3], float level, float color[3])
+{
+	level = std::min(std::max(level, 0.0f), (float)(chain.size() - 1));
+	unsigned int level0 = (unsigned int)level;
+	unsigned int level1 = std::min(level0 + 1, (unsigned int)chain.size() - 1);
+	float blend = level - level0;
+	float color0[3], color1[3];
+	SampleCubemap(chain[level0], direction, color0);
+	SampleCubemap(chain[level1], direction, color1);
+	for (int c = 0; c < 3; c++) { color[c] = color0[c] * (1.0f - blend) + color1[c] * blend; }
+}
+
+// Solid angle of the part of a face from its center to (x, y), both -1 to 1
+static float GetAreaElement(float x, float y)
+{
+	return atan2f(x * y, sqrtf(x * x + y * y + 1.0f));
+}
+
+static float GetTexelSolidAngle(unsigned int x, unsigned int y, unsigned int size)
+{
+	float x0 = (float)x / size * 2.0f - 1.0f, x1 = (float)(x + 1) / size * 2.0f - 1.0f;
+	float y0 = (float)y / size * 2.0f - 1.0f, y1 = (float)(y + 1) / size * 2.0f - 1.0f;
+	return GetAreaElement(x0, y0) - GetAreaElement(x0, y1) - GetAreaElement(x1, y0) + GetAreaElement(x1, y1);
+}
+
+bool CreateEnvironmentCubemap(const TextureImage faces[6], unsigned int size, ThreadPool& pool, EnvironmentCubemap& cubemap)
+{
+	unsigned int sourceSize = faces[0].Width;
+	for (int f = 0; f < 6; f++)
+	{
+		if (faces[f].Width != sourceSize || faces[f].Height != sourceSize || sourceSize == 0)
+			return false;
+	}
+
+	float toLinear[256];
+	for (int i = 0; i < 256; i++) { toLinear[i] = powf(i / 255.0f, SKY_GAMMA); }
+
+	cubemap.Size = size;
+	for (int f = 0; f < 6; f++)
+	{
+		cubemap.Faces[f].assign((size_t)size * size * 3, 0.0f);
+		pool.Enqueue([&faces, &cubemap, &toLinear, f, size, sourceSize]()
+		{
+			// Average every source texel landing in each texel (nearest if the source is smaller)
+			const TextureImage& source = faces[f];
+			std::vector<float>& face = cubemap.Faces[f];
+			unsigned int step = std::max(1u, sourceSize / size);
+			for (unsigned int y = 0; y < size; y++)
+			{
+				for (unsigned int x = 0; x < size; x++)
+				{
+					unsigned int sourceX = (unsigned int)((unsigned long long)x * sourceSize / size);
+					unsigned int sourceY = (unsigned int)((unsigned long long)y * sourceSize / size);
+					float sum[3] = {};
+					for (unsigned int sy = sourceY; sy < sourceY + step; sy++)
+					{
+						const unsigned char* row = source.Pixels.data() + ((size_t)sy * sourceSize + sourceX) * 4;
+						for (unsigned int sx = 0; sx < step; sx++)
+						{
+							for (int c = 0; c < 3; c++) { sum[c] += toLinear[row[sx * 4 + c]]; }
+						}
+					}
+					for (int c = 0; c < 3; c++) { face[((size_t)y * size + x) * 3 + c] = sum[c] / (step * step); }
+				}
+			}
+		});
+	}
+	pool.WaitIdle();
+	return true;
+}
+
+// --------------------------------------------------------
+// Diffuse: spherical harmonics
+// --------------------------------------------------------
+
+// Real SH basis functions of the first three bands
+static void GetSHBasis(const float d[3], float basis[9])
+{
+	float x = d[0], y = d[1], z = d[2];
+	basis[0] = 0.282095f;
+	basis[1] = 0.488603f * y;
+	basis[2] = 0.488603f * z;
+	basis[3] = 0.488603f * x;
+	basis[4] = 1.092548f * x * y;
+	basis[5] = 1.092548f * y * z;
+	basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+	basis[7] = 1.092548f * x * z;
+	basis[8] = 0.546274f * (x * x - y * y);
+}
+
+void ProjectSH(const EnvironmentCubemap& cubemap, SHCoefficients& radiance)
+{
+	memset(radiance.Values, 0, sizeof(radiance.Values));
+	unsigned int size = cubemap.Size;
+	for (unsigned int f = 0; f < 6; f++)
+	{
+		for (unsigned int y = 0; y < size; y++)
+		{
+			for (unsigned int x = 0; x < size; x++)
+			{
+				float direction[3];
+				float basis[9];
+				GetCubemapDirection(f, (x + 0.5f) / size, (y + 0.5f) / size, direction);
+				GetSHBasis(direction, basis);
+				float solidAngle = GetTexelSolidAngle(x, y, size);
+				const float* texel = &cubemap.Faces[f][((size_t)y * size + x) * 3];
+				for (int i = 0; i < 9; i++)
+				{
+					for (int c = 0; c < 3; c++) { radiance.Values[i][c] += texel[c] * basis[i] * solidAngle; }
+				}
+			}
+		}
+	}
+}
+
+void GetIrradianceSH(const SHCoefficients& radiance, SHCoefficients& irradiance)
+{
+	// Clamped cosine convolution per band (pi, 2pi/3, pi/4), divided by pi, times the basis constants
+	static const float scales[9] =
+	{
+		1.0f * 0.282095f,
+		2.0f / 3.0f * 0.488603f, 2.0f / 3.0f * 0.488603f, 2.0f / 3.0f * 0.488603f,
+		0.25f * 1.092548f, 0.25f * 1.092548f, 0.25f * 0.315392f, 0.25f * 1.092548f, 0.25f * 0.546274f
+	};
+	for (int i = 0; i < 9; i++)
+	{
+		for (int c = 0; c < 3; c++) { irradiance.Values[i][c] = radiance.Values[i][c] * scales[i]; }
+	}
+}
+
+void EvaluateIrradianceSH(const SHCoefficients& irradiance, const float normal[3], float color[3])
+{
+	float x = normal[0], y = normal[1], z = normal[2];
+	float terms[9] = { 1.0f, y, z, x, x * y, y * z, 3.0f * z * z - 1.0f, x * z, x * x - y * y };
+	for (int c = 0; c < 3; c++)
+	{
+		float sum = 0.0f;
+		for (int i = 0; i < 9; i++) { sum += irradiance.Values[i][c] * terms[i]; }
+		color[c] = std::max(sum, 0.0f);
+	}
+}
+
+// --------------------------------------------------------
+// Specular: GGX prefiltering and the BRDF lookup
+// --------------------------------------------------------
+
+// Low discrepancy 2D point i of count
+static void Hammersley(unsigned int i, unsigned int count, float& x, float& y)
+{
+	unsigned int bits = i;
+	bits = (bits << 16) | (bits >> 16);
+	bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+	bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+	bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+	bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+	x = (float)i / count;
+	y = bits * 2.3283064365386963e-10f;
+}
+
+// GGX distributed half vector around +Z. The shaders square roughness first, so alpha = roughness^2.
+static void ImportanceSampleGGX(float x, float y, float alpha, float h[3])
+{
+	float phi = 2.0f * PI * x;
+	float cosTheta = sqrtf((1.0f - y) / (1.0f + (alpha * alpha - 1.0f) * y));
+	float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+	h[0] = sinTheta * cosf(phi);
+	h[1] = sinTheta * sinf(phi);
+	h[2] = cosTheta;
+}
+
+// One importance sample, the same for every texel of a mip once rotated to its normal
+struct SpecularSample
+{
+	float Direction[3];		// Light direction around +Z
+	float Weight;			// n dot l
+	float Level;			// Source mip matching the sample's solid angle
+};
+
+void PrefilterSpecular(const EnvironmentCubemap& source, unsigned int mipCount, unsigned int sampleCount,
+	ThreadPool& pool, std::vector<EnvironmentCubemap>& mips)
+{
+	// Box filtered source chain, so wide lobes read a few blurred texels instead of
+	// many sharp ones (filtered importance sampling)
+	std::vector<EnvironmentCubemap> chain(1, source);
+	while (chain.back().Size > 1)
+	{
+		const EnvironmentCubemap& previous = chain.back();
+		EnvironmentCubemap next;
+		next.Size = previous.Size / 2;
+		for (int f = 0; f < 6; f++)
+		{
+			next.Faces[f].resize((size_t)next.Size * next.Size * 3);
+			for (unsigned int y = 0; y < next.Size; y++)
+			{
+				for (unsigned int x = 0; x < next.Size; x++)
+				{
+					for (int c = 0; c < 3; c++)
+					{
+						const std::vector<float>& face = previous.Faces[f];
+						size_t row0 = (size_t)(y * 2) * previous.Size, row1 = row0 + previous.Size;
+						next.Faces[f][((size_t)y * next.Size + x) * 3 + c] = 0.25f *
+							(face[(row0 + x * 2) * 3 + c] + face[(row0 + x * 2 + 1) * 3 + c] +
+							face[(row1 + x * 2) * 3 + c] + face[(row1 + x * 2 + 1) * 3 + c]);
+					}
+				}
+			}
+		}
+		chain.push_back(next);
+	}
+
+	mipCount = std::max(1u, std::min(mipCount, (unsigned int)chain.size()));
+	mips.assign(mipCount, EnvironmentCubemap());
+	mips[0] = source;
+	float texelSolidAngle = 4.0f * PI / (6.0f * source.Size * source.Size);
+	for (unsigned int mip = 1; mip < mipCount; mip++)
+	{
+		// Every texel of a mip uses the same samples, rotated to its direction
+		float roughness = (float)mip / (mipCount - 1);
+		float alpha = roughness * roughness;
+		std::vector<SpecularSample> samples;
+		for (unsigned int i = 0; i < sampleCount; i++)
+		{
+			float x, y, h[3];
+			Hammersley(i, sampleCount, x, y);
+			ImportanceSampleGGX(x, y, alpha, h);
+
+			// With n = v, l is h reflected about n and n dot h = v dot h
+			SpecularSample sample;
+			float nDotH = h[2];
+			sample.Direction[0] = 2.0f * nDotH * h[0];
+			sample.Direction[1] = 2.0f * nDotH * h[1];
+			sample.Direction[2] = 2.0f * nDotH * h[2] - 1.0f;
+			sample.Weight = sample.Direction[2];
+			if (sample.Weight <= 0.0f)
+				continue;
+
+			float a2 = alpha * alpha;
+			float denominator = nDotH * nDotH * (a2 - 1.0f) + 1.0f;
+			float d = a2 / (PI * denominator * denominator);
+			float sampleSolidAngle = 1.0f / (sampleCount * d * 0.25f + 0.0001f);	// pdf = d * (n dot h) / (4 v dot h)
+			sample.Level = 0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f;
+			samples.push_back(sample);
+		}
+
+		EnvironmentCubemap& target = mips[mip];
+		target.Size = std::max(1u, source.Size >> mip);
+		for (int f = 0; f < 6; f++)
+		{
+			target.Faces[f].assign((size_t)target.Size * target.Size * 3, 0.0f);
+			pool.Enqueue([&chain, &target, samples, f]()
+			{
+				unsigned int size = target.Size;
+				for (unsigned int y = 0; y < size; y++)
+				{
+					for (unsigned int x = 0; x < size; x++)
+					{
+						// Tangent frame around the texel's direction
+						float n[3], t[3], b[3];
+						GetCubemapDirection(f, (x + 0.5f) / size, (y + 0.5f) / size, n);
+						float up[3] = { 0.0f, 0.0f, 1.0f };
+						if (fabsf(n[2]) > 0.999f) { up[0] = 1.0f; up[2] = 0.0f; }
+						t[0] = up[1] * n[2] - up[2] * n[1];
+						t[1] = up[2] * n[0] - up[0] * n[2];
+						t[2] = up[0] * n[1] - up[1] * n[0];
+						Normalize(t);
+						b[0] = n[1] * t[2] - n[2] * t[1];
+						b[1] = n[2] * t[0] - n[0] * t[2];
+						b[2] = n[0] * t[1] - n[1] * t[0];
+
+						float sum[3] = {};
+						float weight = 0.0f;
+						for (const SpecularSample& sample : samples)
+						{
+							const float* l = sample.Direction;
+							float direction[3], color[3];
+							for (int c = 0; c < 3; c++) { direction[c] = t[c] * l[0] + b[c] * l[1] + n[c] * l[2]; }
+							SampleCubemapLevel(chain, direction, sample.Level, color);
+							for (int c = 0; c < 3; c++) { sum[c] += color[c] * sample.Weight; }
+							weight += sample.Weight;
+						}
+						float* texel = &target.Faces[f][((size_t)y * size + x) * 3];
+						for (int c = 0; c < 3; c++) { texel[c] = weight > 0.0f ? sum[c] / weight : 0.0f; }
+					}
+				}
+			});
+		}
+	}
+	pool.WaitIdle();
+}
+
+void ComputeBRDFLookup(unsigned int size, unsigned int sampleCount, ThreadPool& pool, std::vector<float>& lookup)
+{
+	lookup.assign((size_t)size * size * 2, 0.0f);
+	for (unsigned int row = 0; row < size; row++)
+	{
+		pool.Enqueue([&lookup, row, size, sampleCount]()
+		{
+			float roughness = (row + 0.5f) / size;
+			float alpha = roughness * roughness;
+			float k = alpha / 2.0f;		// Schlick-GGX k for image based lighting
+			for (unsigned int column = 0; column < size; column++)
+			{
+				// n is +Z, v is in the xz plane
+				float nDotV = (column + 0.5f) / size;
+				float v[3] = { sqrtf(1.0f - nDotV * nDotV), 0.0f, nDotV };
+				float scale = 0.0f, bias = 0.0f;
+				for (unsigned int i = 0; i < sampleCount; i++)
+				{
+					float x, y, h[3];
+					Hammersley(i, sampleCount, x, y);
+					ImportanceSampleGGX(x, y, alpha, h);
+					float vDotH = v[0] * h[0] + v[1] * h[1] + v[2] * h[2];
+					float nDotL = 2.0f * vDotH * h[2] - v[2];
+					if (nDotL <= 0.0f)
+						continue;
+
+					float nDotH = h[2];
+					vDotH = std::max(vDotH, 0.0f);
+					float g = (nDotV / (nDotV * (1.0f - k) + k)) * (nDotL / (nDotL * (1.0f - k) + k));
+					float visibility = g * vDotH / (nDotH * nDotV);
+					float fresnel = powf(1.0f - vDotH, 5.0f);
+					scale += (1.0f - fresnel) * visibility;
+					bias += fresnel * visibility;
+				}
+				lookup[((size_t)row * size + column) * 2 + 0] = scale / sampleCount;
+				lookup[((size_t)row * size + column) * 2 + 1] = bias / sampleCount;
+			}
+		});
+	}
+	pool.WaitIdle();
+}
+
+// --------------------------------------------------------
+// DDS output
+// --------------------------------------------------------
+
+// IEEE half precision, rounded to nearest (the values here are never NaN)
+static unsigned short FloatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(bits));
+	unsigned int sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+	unsigned int mantissa = bits & 0x7FFFFF;
+	if (exponent >= 31)
+		return (unsigned short)(sign | 0x7BFF);		// Clamp to the largest finite half
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return (unsigned short)sign;
+		mantissa |= 0x800000;
+		unsigned int shift = 14 - exponent;
+		return (unsigned short)(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+	}
+	unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000) { half++; }				// Carries into the exponent when it has to
+	return (unsigned short)half;
+}
+
+static void AppendHalves(const float* values, size_t count, std::vector<unsigned char>& dds)
+{
+	size_t start = dds.size();
+	dds.resize(start + count * 2);
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned short half = FloatToHalf(values[i]);
+		memcpy(&dds[start + i * 2], &half, 2);
+	}
+}
+
+void WriteSpecularDDS(const std::vector<EnvironmentCubemap>& mips, std::vector<unsigned char>& dds)
+{
+	unsigned int size = mips[0].Size;
+	WriteDDSHeader(size, size, (unsigned int)mips.size(), DDS_FORMAT_R16G16B16A16_FLOAT, true, (size_t)size * size * 8, dds);
+
+	// Each face with all its mips, then the next face
+	for (int f = 0; f < 6; f++)
+	{
+		for (const EnvironmentCubemap& mip : mips)
+		{
+			std::vector<float> rgba((size_t)mip.Size * mip.Size * 4, 1.0f);
+			for (size_t i = 0; i < (size_t)mip.Size * mip.Size; i++)
+			{
+				for (int c = 0; c < 3; c++) { rgba[i * 4 + c] = mip.Faces[f][i * 3 + c]; }
+			}
+			AppendHalves(rgba.data(), rgba.size(), dds);
+		}
+	}
+}
+
+void WriteBRDFLookupDDS(unsigned int size, const std::vector<float>& lookup, std::vector<unsigned char>& dds)
+{
+	WriteDDSHeader(size, size, 1, DDS_FORMAT_R16G16_FLOAT, false, (size_t)size * size * 4, dds);
+	AppendHalves(lookup.data(), lookup.size(), dds);
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <vector>
+#include "TextureCompression.h"
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// CPU precomputation for image based lighting
+//
+// A sky cube map is turned into three things the pixel
+// shader can light with in one lookup each:
+// - A GGX prefiltered specular cube map, one roughness per
+//   mip (split sum approximation, with N = V = R)
+// - 9 spherical harmonic coefficients of the diffuse
+//   irradiance
+// - A BRDF lookup table (scale and bias applied to F0) over
+//   n dot v and roughness, shared by every environment
+//
+// Sky caches the results next to the sky's images. Nothing
+// here needs D3D, and the heavy parts are split across a
+// ThreadPool.
+// --------------------------------------------------------
+
+// Linear RGB radiance on the six faces of a cube, in D3D order (+X, -X, +Y, -Y, +Z, -Z)
+struct EnvironmentCubemap
+{
+	unsigned int Size;
+	std::vector<float> Faces[6];	// Size * Size texels, 3 floats each, rows tightly packed
+};
+
+// Coefficients of the first three spherical harmonic bands, RGB each
+struct SHCoefficients
+{
+	float Values[9][3];
+};
+
+/// <summary>
+/// Converts gamma encoded sky images to a linear cube map, box filtering them down
+/// </summary>
+/// <param name="faces">+X, -X, +Y, -Y, +Z, -Z, all the same square size</param>
+/// <param name="size">Face size of the result</param>
+/// <param name="pool">Converts the faces in parallel</param>
+/// <param name="cubemap">Receives the result</param>
+/// <returns>False if the faces aren't square and the same size</returns>
+bool CreateEnvironmentCubemap(const TextureImage faces[6], unsigned int size, ThreadPool& pool, EnvironmentCubemap& cubemap);
+
+/// <summary>
+/// Direction through the center of a texel
+/// </summary>
+/// <param name="face">Cube face, in D3D order</param>
+/// <param name="u">0 to 1 across the face</param>
+/// <param name="v">0 to 1 down the face</param>
+/// <param name="direction">Receives the normalized direction</param>
+void GetCubemapDirection(unsigned int face, float u, float v, float direction[3]);
+
+/// <summary>
+/// Projects the radiance of a cube map onto the first three spherical harmonic bands
+/// </summary>
+/// <param name="cubemap">Linear radiance</param>
+/// <param name="radiance">Receives the coefficients (real SH, ordered l = 0, 1, 2 and m = -l..l)</param>
+void ProjectSH(const EnvironmentCubemap& cubemap, SHCoefficients& radiance);
+
+/// <summary>
+/// Convolves radiance SH with a clamped cosine, giving irradiance divided by pi (what a
+/// white Lambertian surface reflects). The SH basis constants are folded in, so evaluating
+/// it is a polynomial in the normal: 1, y, z, x, xy, yz, 3z^2 - 1, xz, x^2 - y^2.
+/// </summary>
+/// <param name="radiance">From ProjectSH()</param>
+/// <param name="irradiance">Receives the shader ready coefficients</param>
+void GetIrradianceSH(const SHCoefficients& radiance, SHCoefficients& irradiance);
+
+/// <summary>
+/// Evaluates irradiance SH from GetIrradianceSH() for a normal, as the pixel shader does
+/// </summary>
+/// <param name="irradiance">From GetIrradianceSH()</param>
+/// <param name="normal">Normalized direction</param>
+/// <param name="color">Receives irradiance / pi, clamped to 0</param>
+void EvaluateIrradianceSH(const SHCoefficients& irradiance, const float normal[3], float color[3]);
+
+/// <summary>
+/// Prefilters a cube map with GGX for increasing roughness, one mip per roughness step
+/// </summary>
+/// <param name="source">Linear radiance; its size becomes the top mip's</param>
+/// <param name="mipCount">Mips to make; mip m has roughness m / (mipCount - 1)</param>
+/// <param name="sampleCount">Importance samples per texel</param>
+/// <param name="pool">Filters every face of every mip in parallel</param>
+/// <param name="mips">Receives the mips, most detailed (a copy of source) first</param>
+void PrefilterSpecular(const EnvironmentCubemap& source, unsigned int mipCount, unsigned int sampleCount,
+	ThreadPool& pool, std::vector<EnvironmentCubemap>& mips);
+
+/// <summary>
+/// Integrates the split sum BRDF term: specular = prefiltered * (F0 * scale + bias)
+/// </summary>
+/// <param name="size">Width (n dot v) and height (roughness) of the table</param>
+/// <param name="sampleCount">Importance samples per texel</param>
+/// <param name="pool">Fills rows in parallel</param>
+/// <param name="lookup">Receives size * size (scale, bias) pairs, row r holding roughness (r + 0.5) / size</param>
+void ComputeBRDFLookup(unsigned int size, unsigned int sampleCount, ThreadPool& pool, std::vector<float>& lookup);
+
+/// <summary>
+/// Builds a .dds cube map (R16G16B16A16_FLOAT) from prefiltered mips
+/// </summary>
+void WriteSpecularDDS(const std::vector<EnvironmentCubemap>& mips, std::vector<unsigned char>& dds);
+
+/// <summary>
+/// Builds a .dds texture (R16G16_FLOAT) from a BRDF lookup table
+/// </summary>
+void WriteBRDFLookupDDS(unsigned int size, const std::vector<float>& lookup, std::vector<unsigned char>& dds);
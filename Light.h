@@ -5,7 +5,6 @@
 #define LIGHT_TYPE_DIR   0
 #define LIGHT_TYPE_POINT 1
 #define LIGHT_TYPE_SPOT  2
-#define MAX_NUM_LIGHTS 10
 
 struct Light
 {
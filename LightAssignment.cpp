@@ -0,0 +1,216 @@
+#include "LightAssignment.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <climits>
+#include <cfloat>
+
+LightAssignment::LightAssignment(unsigned int threadCount) :
+	lights(nullptr),
+	cellSize(1.0f),
+	stats(),
+	pool(threadCount)
+{
+	gridMin[0] = gridMin[1] = gridMin[2] = 0.0f;
+	gridSize[0] = gridSize[1] = gridSize[2] = 0;
+}
+
+void LightAssignment::SetLights(LightSet& _lights)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	lights = &_lights;
+	unsigned int count = lights->GetCount();
+	const float* position[3] = { lights->GetField(LIGHT_FIELD_POSITION_X), lights->GetField(LIGHT_FIELD_POSITION_Y), lights->GetField(LIGHT_FIELD_POSITION_Z) };
+	const float* range = lights->GetField(LIGHT_FIELD_RANGE);
+
+	// Fit the grid around every point and spot light that reaches anything (directional lights come first)
+	float gridMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	gridMin[0] = gridMin[1] = gridMin[2] = FLT_MAX;
+	float rangeSum = 0.0f;
+	unsigned int gridded = 0;
+	for (unsigned int i = lights->GetTypeOffset(LIGHT_TYPE_POINT); i < count; i++)
+	{
+		if (range[i] <= 0.0f)
+			continue;
+		for (int a = 0; a < 3; a++)
+		{
+			gridMin[a] = std::min(gridMin[a], position[a][i] - range[i]);
+			gridMax[a] = std::max(gridMax[a], position[a][i] + range[i]);
+		}
+		rangeSum += range[i];
+		gridded++;
+	}
+
+	// How bright each light is, before falloff
+	brightness.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		brightness[i] = lights->GetField(LIGHT_FIELD_INTENSITY)[i] * std::max(lights->GetField(LIGHT_FIELD_COLOR_R)[i],
+			std::max(lights->GetField(LIGHT_FIELD_COLOR_G)[i], lights->GetField(LIGHT_FIELD_COLOR_B)[i]));
+	}
+
+	gridSize[0] = gridSize[1] = gridSize[2] = 0;
+	cellOffsets.assign(1, 0);
+	cellLights.clear();
+	if (gridded == 0)
+	{
+		stats.GridTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return;
+	}
+
+	// Cells about a light across, but no more than 32 along any axis
+	float extent = std::max(gridMax[0] - gridMin[0], std::max(gridMax[1] - gridMin[1], gridMax[2] - gridMin[2]));
+	cellSize = std::max(2.0f * rangeSum / gridded, extent / 32.0f);
+	for (int a = 0; a < 3; a++) { gridSize[a] = std::max(1u, (unsigned int)ceilf((gridMax[a] - gridMin[a]) / cellSize)); }
+
+	// Count, then fill each cell's list
+	cellOffsets.assign(gridSize[0] * gridSize[1] * gridSize[2] + 1, 0);
+	unsigned int first[3], last[3];
+	for (int pass = 0; pass < 2; pass++)
+	{
+		std::vector<unsigned int> cursors;
+		if (pass == 1)
+		{
+			for (size_t c = 1; c < cellOffsets.size(); c++) { cellOffsets[c] += cellOffsets[c - 1]; }
+			cellLights.resize(cellOffsets.back());
+			cursors.assign(cellOffsets.begin(), cellOffsets.end() - 1);
+		}
+
+		for (unsigned int i = lights->GetTypeOffset(LIGHT_TYPE_POINT); i < count; i++)
+		{
+			if (range[i] <= 0.0f)
+				continue;
+			const float center[3] = { position[0][i], position[1][i], position[2][i] };
+			GetCellRange(center, range[i], first, last);
+			for (unsigned int z = first[2]; z <= last[2]; z++)
+				for (unsigned int y = first[1]; y <= last[1]; y++)
+					for (unsigned int x = first[0]; x <= last[0]; x++)
+					{
+						unsigned int cell = (z * gridSize[1] + y) * gridSize[0] + x;
+						if (pass == 0) { cellOffsets[cell + 1]++; }
+						else { cellLights[cursors[cell]++] = i; }
+					}
+		}
+	}
+	stats.GridTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void LightAssignment::Assign(const EntityBounds* entities, unsigned int count, std::vector<EntityLights>& results)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	results.resize(count);
+	stats.Entities = count;
+	stats.AssignedLights = 0;
+	stats.DroppedLights = 0;
+
+	// A few batches per thread, so uneven entities still balance out
+	unsigned int batchSize = std::max(64u, count / (pool.GetThreadCount() * 4));
+	unsigned int batchCount = (count + batchSize - 1) / batchSize;
+	std::vector<unsigned int> assigned(batchCount, 0);
+	std::vector<unsigned int> dropped(batchCount, 0);
+	for (unsigned int b = 0; b < batchCount; b++)
+	{
+		pool.Enqueue([this, entities, count, batchSize, b, &results, &assigned, &dropped]()
+		{
+			AssignRange(entities, b * batchSize, std::min(count, (b + 1) * batchSize), results, assigned[b], dropped[b]);
+		});
+	}
+	pool.WaitIdle();
+
+	for (unsigned int b = 0; b < batchCount; b++)
+	{
+		stats.AssignedLights += assigned[b];
+		stats.DroppedLights += dropped[b];
+	}
+	stats.AssignTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Scores every light in the cells an entity's sphere
+// touches, keeping the best few in order
+// --------------------------------------------------------
+void LightAssignment::AssignRange(const EntityBounds* entities, unsigned int first, unsigned int last,
+	std::vector<EntityLights>& results, unsigned int& assigned, unsigned int& dropped)
+{
+	// Lights span several cells; remember which entity last saw each one
+	std::vector<unsigned int> lastSeen(lights->GetCount(), UINT_MAX);
+	const float* position[3] = { lights->GetField(LIGHT_FIELD_POSITION_X), lights->GetField(LIGHT_FIELD_POSITION_Y), lights->GetField(LIGHT_FIELD_POSITION_Z) };
+	const float* direction[3] = { lights->GetField(LIGHT_FIELD_DIRECTION_X), lights->GetField(LIGHT_FIELD_DIRECTION_Y), lights->GetField(LIGHT_FIELD_DIRECTION_Z) };
+	const float* range = lights->GetField(LIGHT_FIELD_RANGE);
+	unsigned int firstSpot = lights->GetTypeOffset(LIGHT_TYPE_SPOT);
+	unsigned int cellFirst[3], cellLast[3];
+	for (unsigned int e = first; e < last; e++)
+	{
+		const EntityBounds& entity = entities[e];
+		EntityLights& result = results[e];
+		float scores[MAX_ENTITY_LIGHTS];
+		result.Count = 0;
+		if (cellLights.empty())
+			continue;
+
+		GetCellRange(entity.Center, entity.Radius, cellFirst, cellLast);
+		for (unsigned int z = cellFirst[2]; z <= cellLast[2]; z++)
+			for (unsigned int y = cellFirst[1]; y <= cellLast[1]; y++)
+				for (unsigned int x = cellFirst[0]; x <= cellLast[0]; x++)
+				{
+					unsigned int cell = (z * gridSize[1] + y) * gridSize[0] + x;
+					for (unsigned int l = cellOffsets[cell]; l < cellOffsets[cell + 1]; l++)
+					{
+						unsigned int index = cellLights[l];
+						if (lastSeen[index] == e)
+							continue;
+						lastSeen[index] = e;
+
+						float offset[3] = { entity.Center[0] - position[0][index], entity.Center[1] - position[1][index], entity.Center[2] - position[2][index] };
+						float distance = sqrtf(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+						if (distance >= range[index] + entity.Radius)
+							continue;
+
+						// Spot lights don't reach behind themselves (see ConeAttenuate() in PBR.hlsli)
+						if (index >= firstSpot)
+						{
+							const float axis[3] = { direction[0][index], direction[1][index], direction[2][index] };
+							float along = offset[0] * axis[0] + offset[1] * axis[1] + offset[2] * axis[2];
+							float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+							if (along <= -entity.Radius * length)
+								continue;
+						}
+
+						// Brightness at the entity's nearest point, with the shader's falloff
+						float nearest = std::max(0.0f, distance - entity.Radius);
+						float score = brightness[index] * (1.0f - nearest * nearest / (range[index] * range[index]));
+
+						if (result.Count == MAX_ENTITY_LIGHTS)
+						{
+							dropped++;
+							if (score <= scores[MAX_ENTITY_LIGHTS - 1])
+								continue;
+							result.Count--;
+						}
+						unsigned int slot = result.Count++;
+						for (; slot > 0 && scores[slot - 1] < score; slot--)
+						{
+							scores[slot] = scores[slot - 1];
+							result.Indices[slot] = result.Indices[slot - 1];
+						}
+						scores[slot] = score;
+						result.Indices[slot] = index;
+					}
+				}
+
+		// Buffer order, so the shader meets the point lights before the spot lights
+		std::sort(result.Indices, result.Indices + result.Count);
+		assigned += result.Count;
+	}
+}
+
+void LightAssignment::GetCellRange(const float center[3], float radius, unsigned int first[3], unsigned int last[3])
+{
+	for (int a = 0; a < 3; a++)
+	{
+		float low = (center[a] - radius - gridMin[a]) / cellSize;
+		float high = (center[a] + radius - gridMin[a]) / cellSize;
+		first[a] = (unsigned int)std::min(std::max(low, 0.0f), (float)(gridSize[a] - 1));
+		last[a] = (unsigned int)std::min(std::max(high, 0.0f), (float)(gridSize[a] - 1));
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <vector>
+#include "LightSet.h"
+#include "ThreadPool.h"
+#include "EntityBounds.h"
+
+// Most lights one entity is lit by when lights are assigned per entity (two uint4s in PBR.hlsli)
+#define MAX_ENTITY_LIGHTS 8
+
+// --------------------------------------------------------
+// Picks the most relevant point and spot lights for each
+// entity, for forward rendering without clusters
+//
+// SetLights() sorts the lights' range spheres into a grid,
+// then Assign() finds the lights reaching each entity's
+// bounding sphere and keeps the MAX_ENTITY_LIGHTS brightest
+// at the entity's nearest point (intensity times the light's
+// own falloff). Entities are split across worker threads.
+// Directional lights reach everything and aren't assigned;
+// see LightClusters for those.
+// --------------------------------------------------------
+
+// The lights picked for one entity, laid out as PBR.hlsli's entityLights
+struct EntityLights
+{
+	unsigned int Indices[MAX_ENTITY_LIGHTS];	// Light indices in the LightSet given to SetLights(), ascending
+	unsigned int Count;
+};
+
+// What the last Assign() did
+struct LightAssignmentStats
+{
+	unsigned int Entities;
+	unsigned int AssignedLights;	// Over every entity
+	unsigned int DroppedLights;		// Reached an entity that already had MAX_ENTITY_LIGHTS brighter ones
+	float GridTime;					// Milliseconds in the last SetLights()
+	float AssignTime;				// Milliseconds
+};
+
+class LightAssignment
+{
+public:
+	/// <summary>
+	/// Starts the worker threads
+	/// </summary>
+	/// <param name="threadCount">Number of worker threads (0 = one less than the hardware thread count)</param>
+	LightAssignment(unsigned int threadCount = 0);
+
+	/// <summary>
+	/// Sorts the point and spot lights into a grid; call again whenever they move
+	/// </summary>
+	/// <param name="lights">Scene lights, which must stay alive and unchanged until the last Assign()</param>
+	void SetLights(LightSet& lights);
+	/// <summary>
+	/// Picks each entity's lights
+	/// </summary>
+	/// <param name="entities">Bounding spheres</param>
+	/// <param name="count">Number of entities</param>
+	/// <param name="results">Receives one entry per entity (resized to count)</param>
+	void Assign(const EntityBounds* entities, unsigned int count, std::vector<EntityLights>& results);
+
+	// Getters
+	LightAssignmentStats GetStats() { return stats; }
+
+private:
+	LightSet* lights;
+	std::vector<float> brightness;	// Per light, intensity times its brightest channel
+
+	// Light indices per cell, as offsets into cellLights (one more offset than cells)
+	float gridMin[3];
+	float cellSize;
+	unsigned int gridSize[3];
+	std::vector<unsigned int> cellOffsets;
+	std::vector<unsigned int> cellLights;
+
+	LightAssignmentStats stats;
+	ThreadPool pool;
+
+	void AssignRange(const EntityBounds* entities, unsigned int first, unsigned int last,
+		std::vector<EntityLights>& results, unsigned int& assigned, unsigned int& dropped);
+	void GetCellRange(const float center[3], float radius, unsigned int first[3], unsigned int last[3]);
+};
@@ -0,0 +1,263 @@
+#include "LightClusters.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+
+LightClusters::LightClusters(unsigned int _tilesX, unsigned int _tilesY, unsigned int _slices, unsigned int threadCount) :
+	tilesX(std::max(_tilesX, 1u)),
+	tilesY(std::max(_tilesY, 1u)),
+	slices(std::max(_slices, 1u)),
+	nearDist(0.0f),
+	farDist(0.0f),
+	depthScale(0.0f),
+	depthBias(0.0f),
+	rowStride((tilesX + 3) & ~3u),
+	stats(),
+	pool(threadCount)
+{
+	memset(projection, 0, sizeof(projection));
+	clusterLights.resize(GetClusterCount());
+	sliceLights.resize(slices);
+	ranges.resize(GetClusterCount());
+}
+
+void LightClusters::SetProjection(const float _projection[16], float _nearDist, float _farDist)
+{
+	if (memcmp(projection, _projection, sizeof(projection)) == 0 && nearDist == _nearDist && farDist == _farDist)
+		return;
+
+	memcpy(projection, _projection, sizeof(projection));
+	nearDist = std::max(_nearDist, 0.0001f);
+	farDist = std::max(_farDist, nearDist * 1.001f);
+	BuildClusters();
+}
+
+void LightClusters::Bin(LightSet& lights, const float view[16])
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	stats = LightClusterStats();
+	stats.Lights = lights.GetCount();
+	stats.DirectionalLights = lights.GetTypeCount(LIGHT_TYPE_DIR);
+
+	// Directional lights reach every pixel and are all at the front of the buffer,
+	// so only the point and spot lights after them are binned
+	indices.clear();
+	binnedLights.clear();
+	const float* positionX = lights.GetField(LIGHT_FIELD_POSITION_X);
+	const float* positionY = lights.GetField(LIGHT_FIELD_POSITION_Y);
+	const float* positionZ = lights.GetField(LIGHT_FIELD_POSITION_Z);
+	const float* range = lights.GetField(LIGHT_FIELD_RANGE);
+	unsigned int firstLight = lights.GetTypeOffset(LIGHT_TYPE_POINT);
+	unsigned int firstSpot = lights.GetTypeOffset(LIGHT_TYPE_SPOT);
+	unsigned int count = lights.GetCount();
+	for (unsigned int i = firstLight; i < count; i += 4)
+	{
+		// Four lights to view space at once (row vectors: view space = (x, y, z, 1) * view)
+		__m128 x = _mm_loadu_ps(positionX + i);
+		__m128 y = _mm_loadu_ps(positionY + i);
+		__m128 z = _mm_loadu_ps(positionZ + i);
+		__m128 radius = _mm_loadu_ps(range + i);
+		__m128 center[3];
+		for (int a = 0; a < 3; a++)
+		{
+			center[a] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(view[a])), _mm_mul_ps(y, _mm_set1_ps(view[4 + a]))),
+				_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(view[8 + a])), _mm_set1_ps(view[12 + a])));
+		}
+		__m128 inDepth = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(center[2], radius), _mm_set1_ps(nearDist)),
+			_mm_cmple_ps(_mm_sub_ps(center[2], radius), _mm_set1_ps(farDist)));
+		int mask = _mm_movemask_ps(_mm_and_ps(inDepth, _mm_cmpgt_ps(radius, _mm_setzero_ps())));
+		if (mask == 0)
+			continue;
+
+		float centers[3][4];
+		for (int a = 0; a < 3; a++) { _mm_storeu_ps(centers[a], center[a]); }
+		for (unsigned int lane = 0; lane < 4 && i + lane < count; lane++)
+		{
+			if ((mask & (1 << lane)) == 0)
+				continue;
+
+			unsigned int index = i + lane;
+			BinnedLight binned = {};
+			binned.Index = index;
+			binned.Radius = range[index];
+			for (int a = 0; a < 3; a++) { binned.Center[a] = centers[a][lane]; }
+
+			// Spot lights have no hard cone (see ConeAttenuate() in PBR.hlsli), only nothing behind them
+			if (index >= firstSpot)
+			{
+				const float direction[3] = { lights.GetField(LIGHT_FIELD_DIRECTION_X)[index],
+					lights.GetField(LIGHT_FIELD_DIRECTION_Y)[index], lights.GetField(LIGHT_FIELD_DIRECTION_Z)[index] };
+				float length = 0.0f;
+				for (int a = 0; a < 3; a++)
+				{
+					binned.Axis[a] = direction[0] * view[a] + direction[1] * view[4 + a] + direction[2] * view[8 + a];
+					length += binned.Axis[a] * binned.Axis[a];
+				}
+				if (length > 0.0f)
+				{
+					length = sqrtf(length);
+					binned.Spot = true;
+					for (int a = 0; a < 3; a++) { binned.Axis[a] /= length; }
+					binned.PlaneDistance = binned.Axis[0] * binned.Center[0] + binned.Axis[1] * binned.Center[1] + binned.Axis[2] * binned.Center[2];
+				}
+			}
+
+			binned.FirstSlice = GetSlice(binned.Center[2] - binned.Radius);
+			binned.LastSlice = GetSlice(binned.Center[2] + binned.Radius);
+			binnedLights.push_back(binned);
+		}
+	}
+	stats.VisibleLights = (unsigned int)binnedLights.size();
+
+	// Bucket the lights by the slices they overlap, so each slice only looks at its own
+	for (std::vector<unsigned int>& bucket : sliceLights) { bucket.clear(); }
+	for (unsigned int i = 0; i < binnedLights.size(); i++)
+	{
+		for (unsigned int slice = binnedLights[i].FirstSlice; slice <= binnedLights[i].LastSlice; slice++) { sliceLights[slice].push_back(i); }
+	}
+
+	// Each slice's clusters are only written by that slice's task
+	for (unsigned int slice = 0; slice < slices; slice++)
+	{
+		pool.Enqueue([this, slice]() { BinSlice(slice); });
+	}
+	pool.WaitIdle();
+
+	// Pack the lists one after another
+	for (unsigned int c = 0; c < GetClusterCount(); c++)
+	{
+		ranges[c].Offset = (unsigned int)indices.size();
+		ranges[c].Count = (unsigned int)clusterLights[c].size();
+		indices.insert(indices.end(), clusterLights[c].begin(), clusterLights[c].end());
+		stats.MaxClusterLights = std::max(stats.MaxClusterLights, ranges[c].Count);
+	}
+	stats.Indices = (unsigned int)indices.size();
+	stats.BinTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+unsigned int LightClusters::FindCluster(float screenX, float screenY, float viewZ)
+{
+	unsigned int x = (unsigned int)std::min(std::max(screenX * tilesX, 0.0f), (float)(tilesX - 1));
+	unsigned int y = (unsigned int)std::min(std::max(screenY * tilesY, 0.0f), (float)(tilesY - 1));
+	return (GetSlice(viewZ) * tilesY + y) * tilesX + x;
+}
+
+// --------------------------------------------------------
+// Finds the view space bounds of every cluster, from where
+// the tile's corner rays cross the slice's near and far
+// depths. Works for off center and orthographic projections
+// too, since only the terms those use are involved.
+// --------------------------------------------------------
+void LightClusters::BuildClusters()
+{
+	float logRange = logf(farDist / nearDist);
+	depthScale = slices / logRange;
+	depthBias = -(float)slices * logf(nearDist) / logRange;
+
+	// View x at a depth for an NDC x: ndc * w = x * P11 + z * P31 + P41, with w = z * P34 + P44
+	auto viewX = [this](float ndc, float z) { return (ndc * (z * projection[11] + projection[15]) - z * projection[8] - projection[12]) / projection[0]; };
+	auto viewY = [this](float ndc, float z) { return (ndc * (z * projection[11] + projection[15]) - z * projection[9] - projection[13]) / projection[5]; };
+
+	minX.assign(slices * tilesY * rowStride, FLT_MAX);
+	maxX.assign(slices * tilesY * rowStride, -FLT_MAX);
+	rowMinY.resize(slices * tilesY);
+	rowMaxY.resize(slices * tilesY);
+	sliceMinZ.resize(slices);
+	sliceMaxZ.resize(slices);
+	for (unsigned int s = 0; s < slices; s++)
+	{
+		float z0 = nearDist * powf(farDist / nearDist, (float)s / slices);
+		float z1 = nearDist * powf(farDist / nearDist, (float)(s + 1) / slices);
+		sliceMinZ[s] = z0;
+		sliceMaxZ[s] = z1;
+		for (unsigned int y = 0; y < tilesY; y++)
+		{
+			// Rows go down the screen, NDC y goes up
+			float top = 1.0f - 2.0f * y / tilesY;
+			float bottom = 1.0f - 2.0f * (y + 1) / tilesY;
+			float ys[4] = { viewY(top, z0), viewY(top, z1), viewY(bottom, z0), viewY(bottom, z1) };
+			rowMinY[s * tilesY + y] = *std::min_element(ys, ys + 4);
+			rowMaxY[s * tilesY + y] = *std::max_element(ys, ys + 4);
+
+			for (unsigned int x = 0; x < tilesX; x++)
+			{
+				float left = -1.0f + 2.0f * x / tilesX;
+				float right = -1.0f + 2.0f * (x + 1) / tilesX;
+				float xs[4] = { viewX(left, z0), viewX(left, z1), viewX(right, z0), viewX(right, z1) };
+				minX[(s * tilesY + y) * rowStride + x] = *std::min_element(xs, xs + 4);
+				maxX[(s * tilesY + y) * rowStride + x] = *std::max_element(xs, xs + 4);
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Tests every light overlapping a slice against its
+// clusters: the distance from the light to each cluster's
+// box, then which side of a spot light the box is on. Rows
+// share their y and z bounds, so those are checked once and
+// four clusters along the row are tested at a time.
+// --------------------------------------------------------
+void LightClusters::BinSlice(unsigned int slice)
+{
+	for (unsigned int i = 0; i < tilesX * tilesY; i++) { clusterLights[slice * tilesX * tilesY + i].clear(); }
+
+	float minZ = sliceMinZ[slice];
+	float maxZ = sliceMaxZ[slice];
+	for (unsigned int lightIndex : sliceLights[slice])
+	{
+		const BinnedLight& light = binnedLights[lightIndex];
+		float dz = std::max(0.0f, std::max(minZ - light.Center[2], light.Center[2] - maxZ));
+		float radiusSq = light.Radius * light.Radius;
+		__m128 centerX = _mm_set1_ps(light.Center[0]);
+		__m128 zero = _mm_setzero_ps();
+		for (unsigned int y = 0; y < tilesY; y++)
+		{
+			unsigned int row = slice * tilesY + y;
+			float dy = std::max(0.0f, std::max(rowMinY[row] - light.Center[1], light.Center[1] - rowMaxY[row]));
+			float remaining = radiusSq - dy * dy - dz * dz;
+			if (remaining < 0.0f)
+				continue;
+
+			// Farthest point of each box along the spot's axis must be in front of it
+			float spotYZ = 0.0f;
+			if (light.Spot)
+			{
+				spotYZ = (light.Axis[1] > 0.0f ? rowMaxY[row] : rowMinY[row]) * light.Axis[1] +
+					(light.Axis[2] > 0.0f ? maxZ : minZ) * light.Axis[2] - light.PlaneDistance;
+			}
+			const float* spotX = light.Axis[0] > 0.0f ? &maxX[row * rowStride] : &minX[row * rowStride];
+			__m128 remainingSq = _mm_set1_ps(remaining);
+			for (unsigned int x = 0; x < tilesX; x += 4)
+			{
+				__m128 boxMin = _mm_loadu_ps(&minX[row * rowStride + x]);
+				__m128 boxMax = _mm_loadu_ps(&maxX[row * rowStride + x]);
+				__m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(boxMin, centerX), _mm_sub_ps(centerX, boxMax)));
+				__m128 hit = _mm_cmple_ps(_mm_mul_ps(dx, dx), remainingSq);
+				if (light.Spot)
+				{
+					__m128 front = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(spotX + x), _mm_set1_ps(light.Axis[0])), _mm_set1_ps(spotYZ));
+					hit = _mm_and_ps(hit, _mm_cmpgt_ps(front, zero));
+				}
+
+				int mask = _mm_movemask_ps(hit);
+				for (unsigned int lane = 0; mask != 0 && lane < 4; lane++, mask >>= 1)
+				{
+					if ((mask & 1) && x + lane < tilesX)
+						clusterLights[row * tilesX + x + lane].push_back(light.Index);
+				}
+			}
+		}
+	}
+}
+
+unsigned int LightClusters::GetSlice(float viewZ)
+{
+	if (viewZ <= nearDist)
+		return 0;
+	float slice = logf(viewZ) * depthScale + depthBias;
+	return (unsigned int)std::min(std::max(slice, 0.0f), (float)(slices - 1));
+}
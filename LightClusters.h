@@ -0,0 +1,142 @@
+#pragma once
+#include <vector>
+#include "LightSet.h"
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Bins lights into a 3D grid over the view frustum
+// (clustered forward shading)
+//
+// The screen is split into tiles and the view depth into
+// exponential slices, giving one cluster (froxel) per tile
+// and slice. Every frame Bin() finds which point and spot
+// lights reach each cluster, so a pixel only loops over the
+// lights listed for its cluster. Directional lights reach
+// everything and aren't listed; they're the first lights in
+// the buffer.
+//
+// Lights are read from a LightSet's arrays and moved to view
+// space four at a time, then slices are binned in parallel,
+// four clusters of a row at a time, with SSE. Nothing here
+// needs D3D; Game uploads the results as structured buffers
+// (see PBR.hlsli).
+// --------------------------------------------------------
+
+// Where one cluster's lights are in the index list
+struct LightClusterRange
+{
+	unsigned int Offset;
+	unsigned int Count;
+};
+
+// What the last Bin() did
+struct LightClusterStats
+{
+	unsigned int Lights;
+	unsigned int DirectionalLights;
+	unsigned int VisibleLights;		// Point and spot lights within the camera's depth range
+	unsigned int Indices;			// Length of the index list
+	unsigned int MaxClusterLights;	// Most point and spot lights in one cluster
+	float BinTime;					// Milliseconds
+};
+
+class LightClusters
+{
+public:
+	/// <summary>
+	/// Creates the grid and its worker threads
+	/// </summary>
+	/// <param name="_tilesX">Clusters across the screen</param>
+	/// <param name="_tilesY">Clusters down the screen</param>
+	/// <param name="_slices">Clusters from the near plane to the far plane</param>
+	/// <param name="threadCount">Number of worker threads (0 = one less than the hardware thread count)</param>
+	LightClusters(unsigned int _tilesX = 16, unsigned int _tilesY = 9, unsigned int _slices = 24, unsigned int threadCount = 0);
+
+	/// <summary>
+	/// Fits the clusters to a camera's projection. Cheap to call every frame; the
+	/// cluster bounds are only rebuilt when something changed.
+	/// </summary>
+	/// <param name="projection">Row major projection matrix (perspective or orthographic)</param>
+	/// <param name="nearDist">Near plane distance</param>
+	/// <param name="farDist">Far plane distance</param>
+	void SetProjection(const float projection[16], float nearDist, float farDist);
+	/// <summary>
+	/// Lists the point and spot lights reaching each cluster, by index in ascending
+	/// order (so each list's point lights come before its spot lights)
+	/// </summary>
+	/// <param name="lights">Scene lights</param>
+	/// <param name="view">Row major view matrix of the camera given to SetProjection()</param>
+	void Bin(LightSet& lights, const float view[16]);
+	/// <summary>
+	/// Finds the cluster a view space position falls in, as the pixel shader does
+	/// </summary>
+	/// <param name="screenX">0 to 1 across the screen</param>
+	/// <param name="screenY">0 to 1 down the screen</param>
+	/// <param name="viewZ">View space depth</param>
+	/// <returns>Index into GetRanges()</returns>
+	unsigned int FindCluster(float screenX, float screenY, float viewZ);
+
+	// Getters
+	unsigned int GetTilesX() { return tilesX; }
+	unsigned int GetTilesY() { return tilesY; }
+	unsigned int GetSlices() { return slices; }
+	unsigned int GetClusterCount() { return tilesX * tilesY * slices; }
+	/// <summary>
+	/// Slice = log(view z) * scale + bias
+	/// </summary>
+	float GetDepthScale() { return depthScale; }
+	float GetDepthBias() { return depthBias; }
+	/// <summary>
+	/// Per cluster ranges, x fastest, then y (top row first), then depth
+	/// </summary>
+	const std::vector<LightClusterRange>& GetRanges() { return ranges; }
+	/// <summary>
+	/// Every cluster's light indices, one list after another
+	/// </summary>
+	const std::vector<unsigned int>& GetIndices() { return indices; }
+	LightClusterStats GetStats() { return stats; }
+
+private:
+	// A point or spot light's bounds in view space
+	struct BinnedLight
+	{
+		unsigned int Index;
+		float Center[3];
+		float Radius;
+		bool Spot;
+		float Axis[3];				// Spot direction; the light only reaches the side it points to
+		float PlaneDistance;		// dot(Axis, apex)
+		unsigned int FirstSlice;
+		unsigned int LastSlice;
+	};
+
+	unsigned int tilesX;
+	unsigned int tilesY;
+	unsigned int slices;
+	float projection[16];
+	float nearDist;
+	float farDist;
+	float depthScale;
+	float depthBias;
+
+	// Cluster bounds in view space. X varies along a row; y and z don't.
+	std::vector<float> minX;		// Per cluster, rows padded to a multiple of 4
+	std::vector<float> maxX;
+	std::vector<float> rowMinY;		// Per slice and row
+	std::vector<float> rowMaxY;
+	std::vector<float> sliceMinZ;	// Per slice
+	std::vector<float> sliceMaxZ;
+	unsigned int rowStride;
+
+	std::vector<BinnedLight> binnedLights;
+	std::vector<std::vector<unsigned int>> sliceLights;		// Per slice, into binnedLights
+	std::vector<std::vector<unsigned int>> clusterLights;	// Each cluster's list while binning
+	std::vector<LightClusterRange> ranges;
+	std::vector<unsigned int> indices;
+	LightClusterStats stats;
+	ThreadPool pool;
+
+	void BuildClusters();
+	void BinSlice(unsigned int slice);
+	unsigned int GetSlice(float viewZ);
+};
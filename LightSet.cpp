@@ -0,0 +1,180 @@
+#include "LightSet.h"
+
+using namespace DirectX::PackedVector;
+
+// Lights of other types would break the type ranges, so anything unknown is a point light
+static int GetLightType(const Light& light)
+{
+	return light.Type == LIGHT_TYPE_DIR || light.Type == LIGHT_TYPE_SPOT ? light.Type : LIGHT_TYPE_POINT;
+}
+
+// In LightField order
+static void GetFieldValues(const Light& light, float values[LIGHT_FIELD_COUNT])
+{
+	const float fieldValues[LIGHT_FIELD_COUNT] = { light.Position.x, light.Position.y, light.Position.z, light.Range,
+		light.Direction.x, light.Direction.y, light.Direction.z, light.Color.x, light.Color.y, light.Color.z,
+		light.Intensity, light.SpotFalloff, light.Fov };
+	for (int f = 0; f < LIGHT_FIELD_COUNT; f++) { values[f] = fieldValues[f]; }
+}
+
+PackedLight PackLight(const Light& light)
+{
+	PackedLight packed = {};
+	packed.Position = light.Position;
+	packed.Range = light.Range;
+	packed.ColorIntensity.x = XMConvertFloatToHalf(light.Color.x);
+	packed.ColorIntensity.y = XMConvertFloatToHalf(light.Color.y);
+	packed.ColorIntensity.z = XMConvertFloatToHalf(light.Color.z);
+	packed.ColorIntensity.w = XMConvertFloatToHalf(light.Intensity);
+	packed.DirectionFalloff.x = XMConvertFloatToHalf(light.Direction.x);
+	packed.DirectionFalloff.y = XMConvertFloatToHalf(light.Direction.y);
+	packed.DirectionFalloff.z = XMConvertFloatToHalf(light.Direction.z);
+	packed.DirectionFalloff.w = XMConvertFloatToHalf(light.SpotFalloff);
+	return packed;
+}
+
+Light UnpackLight(const PackedLight& packed, int type)
+{
+	Light light = {};
+	light.Type = type;
+	light.Position = packed.Position;
+	light.Range = packed.Range;
+	light.Color = DirectX::XMFLOAT3(XMConvertHalfToFloat(packed.ColorIntensity.x),
+		XMConvertHalfToFloat(packed.ColorIntensity.y), XMConvertHalfToFloat(packed.ColorIntensity.z));
+	light.Intensity = XMConvertHalfToFloat(packed.ColorIntensity.w);
+	light.Direction = DirectX::XMFLOAT3(XMConvertHalfToFloat(packed.DirectionFalloff.x),
+		XMConvertHalfToFloat(packed.DirectionFalloff.y), XMConvertHalfToFloat(packed.DirectionFalloff.z));
+	light.SpotFalloff = XMConvertHalfToFloat(packed.DirectionFalloff.w);
+	return light;
+}
+
+LightSet::LightSet()
+{
+	Clear();
+}
+
+unsigned int LightSet::Add(const Light& light)
+{
+	unsigned int id = (unsigned int)indices.size();
+	indices.push_back(0);
+	int type = GetLightType(light);
+	Insert(GetTypeOffset(type) + typeCounts[type], id, light);
+	return id;
+}
+
+void LightSet::Set(unsigned int id, const Light& light)
+{
+	unsigned int index = indices[id];
+	int type = GetLightType(light);
+	if (index < GetTypeOffset(type) || index >= GetTypeOffset(type) + typeCounts[type])
+	{
+		Erase(index);
+		Insert(GetTypeOffset(type) + typeCounts[type], id, light);
+		return;
+	}
+
+	float values[LIGHT_FIELD_COUNT];
+	GetFieldValues(light, values);
+	for (int f = 0; f < LIGHT_FIELD_COUNT; f++) { fields[f][index] = values[f]; }
+	packed[index] = PackLight(light);
+}
+
+Light LightSet::Get(unsigned int id)
+{
+	unsigned int index = indices[id];
+	Light light = {};
+	light.Type = GetType(index);
+	light.Position = DirectX::XMFLOAT3(fields[LIGHT_FIELD_POSITION_X][index], fields[LIGHT_FIELD_POSITION_Y][index], fields[LIGHT_FIELD_POSITION_Z][index]);
+	light.Range = fields[LIGHT_FIELD_RANGE][index];
+	light.Direction = DirectX::XMFLOAT3(fields[LIGHT_FIELD_DIRECTION_X][index], fields[LIGHT_FIELD_DIRECTION_Y][index], fields[LIGHT_FIELD_DIRECTION_Z][index]);
+	light.Color = DirectX::XMFLOAT3(fields[LIGHT_FIELD_COLOR_R][index], fields[LIGHT_FIELD_COLOR_G][index], fields[LIGHT_FIELD_COLOR_B][index]);
+	light.Intensity = fields[LIGHT_FIELD_INTENSITY][index];
+	light.SpotFalloff = fields[LIGHT_FIELD_SPOT_FALLOFF][index];
+	light.Fov = fields[LIGHT_FIELD_FOV][index];
+	return light;
+}
+
+void LightSet::Truncate(unsigned int idCount)
+{
+	if (idCount >= indices.size())
+		return;
+
+	// Slide the kept lights down over the removed ones in one pass
+	unsigned int kept = 0;
+	unsigned int keptTypes[3] = { 0, 0, 0 };
+	for (unsigned int index = 0; index < ids.size(); index++)
+	{
+		if (ids[index] >= idCount)
+			continue;
+		for (int f = 0; f < LIGHT_FIELD_COUNT; f++) { fields[f][kept] = fields[f][index]; }
+		packed[kept] = packed[index];
+		ids[kept] = ids[index];
+		indices[ids[kept]] = kept;
+		keptTypes[GetType(index)]++;
+		kept++;
+	}
+
+	for (int t = 0; t < 3; t++) { typeCounts[t] = keptTypes[t]; }
+	ids.resize(kept);
+	packed.resize(kept);
+	indices.resize(idCount);
+	Pad();
+}
+
+void LightSet::Clear()
+{
+	ids.clear();
+	indices.clear();
+	packed.clear();
+	typeCounts[0] = typeCounts[1] = typeCounts[2] = 0;
+	Pad();
+}
+
+int LightSet::GetType(unsigned int index)
+{
+	if (index < typeCounts[LIGHT_TYPE_DIR])
+		return LIGHT_TYPE_DIR;
+	return index < GetTypeOffset(LIGHT_TYPE_SPOT) ? LIGHT_TYPE_POINT : LIGHT_TYPE_SPOT;
+}
+
+unsigned int LightSet::GetTypeOffset(int type)
+{
+	unsigned int offset = 0;
+	for (int t = 0; t < type; t++) { offset += typeCounts[t]; }
+	return offset;
+}
+
+void LightSet::Insert(unsigned int index, unsigned int id, const Light& light)
+{
+	float values[LIGHT_FIELD_COUNT];
+	GetFieldValues(light, values);
+	for (int f = 0; f < LIGHT_FIELD_COUNT; f++) { fields[f].insert(fields[f].begin() + index, values[f]); }
+	packed.insert(packed.begin() + index, PackLight(light));
+	ids.insert(ids.begin() + index, id);
+	typeCounts[GetLightType(light)]++;
+
+	// Everything after it moved up one
+	for (unsigned int i = index; i < ids.size(); i++) { indices[ids[i]] = i; }
+}
+
+void LightSet::Erase(unsigned int index)
+{
+	typeCounts[GetType(index)]--;
+	for (int f = 0; f < LIGHT_FIELD_COUNT; f++) { fields[f].erase(fields[f].begin() + index); }
+	packed.erase(packed.begin() + index);
+	ids.erase(ids.begin() + index);
+	for (unsigned int i = index; i < ids.size(); i++) { indices[ids[i]] = i; }
+}
+
+// --------------------------------------------------------
+// Keeps three zeroed floats past the last light in every
+// field, so a four wide load starting at any light is safe
+// --------------------------------------------------------
+void LightSet::Pad()
+{
+	for (int f = 0; f < LIGHT_FIELD_COUNT; f++)
+	{
+		fields[f].resize(ids.size());
+		fields[f].resize(ids.size() + 3, 0.0f);
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <vector>
+#include <DirectXPackedVector.h>
+#include "Light.h"
+
+// --------------------------------------------------------
+// The scene's lights, kept twice: one array per field for
+// the CPU (structure of arrays, so culling can read four
+// lights at a time) and 32 byte PackedLights for the GPU
+//
+// Both are sorted by type, directional lights first, then
+// point lights, then spot lights, so shaders loop over each
+// type's range instead of checking Type per light. Lights
+// are added and edited by the id Add() returns; the light's
+// index (its place in the arrays and the GPU buffer) moves
+// as lights of earlier types come and go.
+// --------------------------------------------------------
+
+// Per light arrays of a LightSet
+enum LightField
+{
+	LIGHT_FIELD_POSITION_X,
+	LIGHT_FIELD_POSITION_Y,
+	LIGHT_FIELD_POSITION_Z,
+	LIGHT_FIELD_RANGE,
+	LIGHT_FIELD_DIRECTION_X,
+	LIGHT_FIELD_DIRECTION_Y,
+	LIGHT_FIELD_DIRECTION_Z,
+	LIGHT_FIELD_COLOR_R,
+	LIGHT_FIELD_COLOR_G,
+	LIGHT_FIELD_COLOR_B,
+	LIGHT_FIELD_INTENSITY,
+	LIGHT_FIELD_SPOT_FALLOFF,
+	LIGHT_FIELD_FOV,
+	LIGHT_FIELD_COUNT
+};
+
+// A light as the shaders read it (PackedLight in PBR.hlsli). Type comes from
+// where it is in the buffer. Position and range stay full precision for world
+// space distances; the rest are halves.
+struct PackedLight
+{
+	DirectX::XMFLOAT3 Position;
+	float Range;
+	DirectX::PackedVector::XMHALF4 ColorIntensity;		// Color, intensity
+	DirectX::PackedVector::XMHALF4 DirectionFalloff;	// Direction, spot falloff
+};
+
+/// <summary>
+/// Converts a light to the GPU format
+/// </summary>
+PackedLight PackLight(const Light& light);
+/// <summary>
+/// Inverse of PackLight() (matches UnpackLight() in PBR.hlsli). Fov isn't packed and comes back 0.
+/// </summary>
+/// <param name="packed">Light to decode</param>
+/// <param name="type">Its type, from where it was in the buffer</param>
+Light UnpackLight(const PackedLight& packed, int type);
+
+class LightSet
+{
+public:
+	LightSet();
+
+	/// <summary>
+	/// Adds a light after the others of its type
+	/// </summary>
+	/// <returns>The light's id</returns>
+	unsigned int Add(const Light& light);
+	/// <summary>
+	/// Replaces a light, moving it if its type changed
+	/// </summary>
+	void Set(unsigned int id, const Light& light);
+	Light Get(unsigned int id);
+	/// <summary>
+	/// Removes every light added after the first idCount, whose ids are then reused
+	/// </summary>
+	void Truncate(unsigned int idCount);
+	void Clear();
+
+	// Getters
+	unsigned int GetCount() { return (unsigned int)ids.size(); }
+	unsigned int GetIndex(unsigned int id) { return indices[id]; }
+	/// <summary>
+	/// The type of the light at an index
+	/// </summary>
+	int GetType(unsigned int index);
+	/// <summary>
+	/// The first index of a type's range
+	/// </summary>
+	unsigned int GetTypeOffset(int type);
+	unsigned int GetTypeCount(int type) { return typeCounts[type]; }
+	/// <summary>
+	/// One field of every light by index, padded so four wide loads from any light stay in bounds
+	/// </summary>
+	const float* GetField(LightField field) { return fields[field].data(); }
+	/// <summary>
+	/// The GPU copy, in index order
+	/// </summary>
+	const std::vector<PackedLight>& GetPacked() { return packed; }
+
+private:
+	std::vector<float> fields[LIGHT_FIELD_COUNT];
+	std::vector<PackedLight> packed;
+	std::vector<unsigned int> ids;		// Per index
+	std::vector<unsigned int> indices;	// Per id
+	unsigned int typeCounts[3];
+
+	void Insert(unsigned int index, unsigned int id, const Light& light);
+	void Erase(unsigned int index);
+	void Pad();
+};
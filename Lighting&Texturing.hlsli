@@ -138,7 +138,10 @@ float3 SpotLight(float3 normal, Light light, float3 viewVector, float specularPo
 // Assuming normal and tangent are already normalized
 float3 normalMapCalc(float2 uv, float3 normal, float3 tangent)
 {
-    float3 unpackedNormal = normalize(NormalMap.Sample(Sampler, uv).rgb * 2 - 1);
+    // Only x and y are stored (BC5 when cooked), z is rebuilt
+    float3 unpackedNormal;
+    unpackedNormal.xy = NormalMap.Sample(Sampler, uv).rg * 2 - 1;
+    unpackedNormal.z = sqrt(saturate(1 - dot(unpackedNormal.xy, unpackedNormal.xy)));
     float3 N = normal;
     float3 T = tangent;
     T = normalize(T - N * dot(T, N));
@@ -1,6 +1,10 @@
 
 #include <Windows.h>
 #include "Game.h"
+#include "TextureCooker.h"
+#include "PathHelpers.h"
+#include <cstdio>
+#include <cstring>
 
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
@@ -18,6 +22,29 @@ int WINAPI WinMain(
 	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
+	// "-cook" compresses the material textures to .dds files and exits,
+	// "-cook -force" recooks the ones that are already up to date
+	if (strstr(lpCmdLine, "-cook"))
+	{
+		// Report to the console we were started from, or a new one
+		bool ownConsole = !AttachConsole(ATTACH_PARENT_PROCESS);
+		if (ownConsole) AllocConsole();
+		FILE* stream;
+		freopen_s(&stream, "CONIN$", "r", stdin);
+		freopen_s(&stream, "CONOUT$", "w", stdout);
+		freopen_s(&stream, "CONOUT$", "w", stderr);
+
+		TextureCookStats stats = CookTextures(FixPath(L"../../Assets/Textures/PBR"), strstr(lpCmdLine, "-force") != nullptr);
+		printf("Cooked %u texture(s) in %.0fms (%u packed): %.1fMB of sources -> %.1fMB of .dds (%u up to date, %u failed)\n",
+			stats.Cooked, stats.CookTime, stats.Packed, stats.SourceBytes / 1048576.0f, stats.CookedBytes / 1048576.0f, stats.UpToDate, stats.Failed);
+		if (ownConsole)
+		{
+			printf("Press enter to close\n");
+			getchar();
+		}
+		return stats.Failed > 0 ? 1 : 0;
+	}
+
 	// Create the Game object using
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
@@ -0,0 +1,57 @@
+#include "MappedFile.h"
+#include "PathHelpers.h"
+
+MappedFile::MappedFile() :
+	file(INVALID_HANDLE_VALUE),
+	mapping(NULL),
+	data(nullptr),
+	size(0)
+{
+}
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string& filePath)
+{
+	Close();
+
+	// Open the file itself (wide version so non-ASCII paths survive)
+	file = CreateFileW(NarrowToWide(filePath).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) { return false; }
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		// Empty files can't be mapped
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+
+	// Map the whole file as read-only
+	mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+	{
+		Close();
+		return false;
+	}
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data) { UnmapViewOfFile(data); }
+	if (mapping) { CloseHandle(mapping); }
+	if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+	data = nullptr;
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+	size = 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <Windows.h>
+#include <string>
+
+// --------------------------------------------------------
+// Read-only memory mapped view of an entire file.
+// The OS pages the file in on demand, so loaders can parse
+// it in place without copying it into a buffer first.
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/// <summary>
+	/// Maps the given file, closing any previously mapped file
+	/// </summary>
+	/// <param name="filePath">Path to the file to map</param>
+	/// <returns>True if the file exists and could be mapped</returns>
+	bool Open(const std::string& filePath);
+	/// <summary>
+	/// Unmaps the file and releases its handles
+	/// </summary>
+	void Close();
+
+	// Getters
+	bool IsOpen() { return data != nullptr; }
+	const char* GetData() { return data; }
+	size_t GetSize() { return size; }
+
+private:
+	HANDLE file;
+	HANDLE mapping;
+	const char* data;
+	size_t size;
+};
@@ -22,6 +22,8 @@ std::shared_ptr<SimpleVertexShader> Material::GetVertShader() { return vertShade
 std::shared_ptr<SimplePixelShader> Material::GetPixelShader() { return pixelShader; }
 bool Material::HasTextureSRV(std::string name) { return textureSRVs.find(name) != textureSRVs.end(); }
 float Material::GetTransparency() { return transparency; }
+const std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>& Material::GetTextureSRVs() { return textureSRVs; }
+DirectX::XMFLOAT2 Material::GetUVScale() { return uvScale; }
 
 // Setters
 void Material::SetColorTint(DirectX::XMFLOAT4 _colorTint) { colorTint = _colorTint; }
@@ -39,6 +41,10 @@ void Material::AddTextureSRV(std::string shaderVariableName, Microsoft::WRL::Com
 {
 	textureSRVs.insert({ shaderVariableName, srv });
 }
+void Material::SetTextureSRV(std::string shaderVariableName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	textureSRVs[shaderVariableName] = srv;
+}
 void Material::AddSampler(std::string samplerVariableName, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
 {
 	samplers.insert({ samplerVariableName, sampler });
@@ -47,7 +53,8 @@ void Material::SetTransparency(float _transparency) { transparency = _transparen
 
 
 // Functions
-void Material::PrepareMaterial(Transform* transform, std::shared_ptr<Camera> camera)
+void Material::PrepareMaterial(Transform* transform, std::shared_ptr<Camera> camera,
+	const DirectX::XMFLOAT4X4* positionTransform)
 {
 	// Set active shaders
 	vertShader->SetShader();
@@ -55,7 +62,10 @@ void Material::PrepareMaterial(Transform* transform, std::shared_ptr<Camera> cam
 
 	// Provide data for vertex shader's cbuffer
 	// Strings must match names in VertexShader.hlsl
-	vertShader->SetMatrix4x4("world", transform->GetWorldMatrix());
+	DirectX::XMFLOAT4X4 world = transform->GetWorldMatrix();
+	if (positionTransform)
+		DirectX::XMStoreFloat4x4(&world, DirectX::XMLoadFloat4x4(positionTransform) * DirectX::XMLoadFloat4x4(&world));
+	vertShader->SetMatrix4x4("world", world);
 	vertShader->SetMatrix4x4("worldInvTranspose", transform->GetWorldInverseTransposeMatrix());
 	vertShader->SetMatrix4x4("view", camera->GetViewMatrix());
 	vertShader->SetMatrix4x4("proj", camera->GetProjMatrix());
@@ -89,6 +99,16 @@ void Material::PrepareMaterial(Transform* transform, std::shared_ptr<Camera> cam
 		bool hasOpacityMap = textureSRVs.count("OpacityMap") != 0;
 		pixelShader->SetData("hasOpacityMap", &hasOpacityMap, sizeof(bool));
 	}
+	if (pixelShader->HasVariable("hasOcclusionMap"))
+	{
+		bool hasOcclusionMap = textureSRVs.count("OcclusionMap") != 0;
+		pixelShader->SetData("hasOcclusionMap", &hasOcclusionMap, sizeof(bool));
+	}
+	if (pixelShader->HasVariable("hasPackedMap"))
+	{
+		bool hasPackedMap = textureSRVs.count("PackedMap") != 0;
+		pixelShader->SetData("hasPackedMap", &hasPackedMap, sizeof(bool));
+	}
 	//if (pixelShader->HasVariable("hasShadowMap"))
 	//{
 	//	bool hasShadowMap = textureSRVs.count("ShadowMap") != 0;
@@ -98,7 +118,7 @@ void Material::PrepareMaterial(Transform* transform, std::shared_ptr<Camera> cam
 	pixelShader->SetData("hasMask", &hasMask, sizeof(bool));
 	bool hasNormalMap = textureSRVs.count("NormalMap") != 0;
 	pixelShader->SetData("hasNormalMap", &hasNormalMap, sizeof(bool));
-	bool hasEnvironmentMap = textureSRVs.count("EnvironmentMap") != 0;
+	bool hasEnvironmentMap = textureSRVs.count("SpecularMap") != 0;
 	pixelShader->SetData("hasEnvironmentMap", &hasEnvironmentMap, sizeof(bool));
 	pixelShader->SetFloat("roughness", roughness);
 	pixelShader->SetFloat("transparency", transparency);
@@ -19,6 +19,8 @@ public:
 	std::shared_ptr<SimpleVertexShader> GetVertShader();
 	std::shared_ptr<SimplePixelShader> GetPixelShader();
 	bool HasTextureSRV(std::string name);
+	const std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>& GetTextureSRVs();
+	DirectX::XMFLOAT2 GetUVScale();
 	float GetTransparency();
 
 	// Setters
@@ -30,11 +32,22 @@ public:
 	void AddUVOffset(DirectX::XMFLOAT2 _uvOffset);
 	void SetUVScale(DirectX::XMFLOAT2  _uvScale);
 	void AddTextureSRV(std::string shaderVariableName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	/// <summary>
+	/// Replaces a texture added with AddTextureSRV() (used when streaming swaps in a new view)
+	/// </summary>
+	void SetTextureSRV(std::string shaderVariableName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	void AddSampler(std::string samplerVariableName, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
 	void SetTransparency(float _transparency);
 
 	// Function
-	void PrepareMaterial(Transform* transform, std::shared_ptr<Camera> camera);
+	/// <summary>
+	/// Sets this material's shaders and uploads their data
+	/// </summary>
+	/// <param name="transform">Transform of the entity being drawn</param>
+	/// <param name="camera">Camera being drawn with</param>
+	/// <param name="positionTransform">Optional mesh dequantization matrix, applied before the world matrix</param>
+	void PrepareMaterial(Transform* transform, std::shared_ptr<Camera> camera,
+		const DirectX::XMFLOAT4X4* positionTransform = nullptr);
 
 private:
 
@@ -2,6 +2,13 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include "ObjLoader.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
 
 // Manual assimp install
 // https://github.com/assimp/assimp/blob/master/Build.md
@@ -19,50 +26,155 @@
 
 using namespace DirectX;
 
+// Static
+Microsoft::WRL::ComPtr<ID3D11InputLayout> Mesh::inputLayouts[MESH_VERTEX_FORMAT_COUNT];
+Microsoft::WRL::ComPtr<ID3D11InputLayout> Mesh::positionInputLayouts[MESH_VERTEX_FORMAT_COUNT];
+MeshletCullStats Mesh::CullStats = {};
+bool Mesh::MeshletCulling = true;
+MeshDepthStats Mesh::DepthStats = {};
+bool Mesh::PositionStreams = true;
+
+void Mesh::ResetCullStats() { CullStats = {}; }
+void Mesh::ResetDepthStats() { DepthStats = {}; }
+
 // Constructors
 Mesh::Mesh(Vertex* vertices, int _vertexCount, unsigned int* indices, int _indexCount,
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
-	Microsoft::WRL::ComPtr<ID3D11Device> _device) :
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	MeshVertexFormat _vertexFormat) :
 	vertexCount(_vertexCount),
 	indexCount(_indexCount),
+	loadTime(0),
+	loadedFromCache(false),
+	cacheRatios(),
+	ready(true),
+	dynamicVertices(false),
+	boundsMin(0, 0, 0),
+	boundsMax(0, 0, 0),
+	uvDensity(0),
+	vertexFormat(_vertexFormat),
+	indexFormat(DXGI_FORMAT_R32_UINT),
 	context(_context),
 	device(_device)
 	
 {
-	CreateBuffers(vertices, indices, _device);
+	CalculateBounds(vertices, (unsigned int)vertexCount, boundsMin, boundsMax);
+	submeshes.push_back({ 0, (unsigned int)indexCount, 0, 0 });
+
+	// Meshlets reorder triangles, so work on a copy of the caller's indices
+	std::vector<unsigned int> meshletIndices(indices, indices + indexCount);
+	BuildMeshlets(vertices, (unsigned int)vertexCount, meshletIndices.data(), (unsigned int)indexCount,
+		submeshes.data(), (unsigned int)submeshes.size(), meshlets);
+	CreateBuffers(vertices, meshletIndices.data(), _device);
+}
+
+Mesh::Mesh(const Vertex* vertices, int _vertexCount, const unsigned int* indices, int _indexCount,
+	const std::vector<MeshSubmeshRange>& _submeshes,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	Microsoft::WRL::ComPtr<ID3D11Device> _device) :
+	vertexCount(0),
+	indexCount(0),
+	loadTime(0),
+	loadedFromCache(false),
+	cacheRatios(),
+	ready(false),
+	dynamicVertices(false),
+	boundsMin(0, 0, 0),
+	boundsMax(0, 0, 0),
+	uvDensity(0),
+	vertexFormat(MESH_VERTEX_COMPACT),
+	indexFormat(DXGI_FORMAT_R32_UINT),
+	context(_context),
+	device(_device)
+{
+	FinishDynamicLoad(vertices, _vertexCount, indices, _indexCount, _submeshes);
 }
 
 Mesh::Mesh(std::wstring relativeFilePath, 
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, Microsoft::WRL::ComPtr<ID3D11Device> _device) :
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	MeshVertexFormat _vertexFormat) :
 	vertexCount(0),
 	indexCount(0),
+	loadTime(0),
+	loadedFromCache(false),
+	cacheRatios(),
+	ready(true),
+	dynamicVertices(false),
+	boundsMin(0, 0, 0),
+	boundsMax(0, 0, 0),
+	uvDensity(0),
+	vertexFormat(_vertexFormat),
+	indexFormat(DXGI_FORMAT_R32_UINT),
 	context(_context),
 	device(_device)
 {
 	//LoadModelGiven(WideToNarrow(relativeFilePath));
-	LoadModelAssimp(WideToNarrow(relativeFilePath));
+	LoadModel(WideToNarrow(relativeFilePath));
 }
 
 Mesh::Mesh(std::string relativeFilePath, 
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, Microsoft::WRL::ComPtr<ID3D11Device> _device) :
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	MeshVertexFormat _vertexFormat) :
 	vertexCount(0),
 	indexCount(0),
+	loadTime(0),
+	loadedFromCache(false),
+	cacheRatios(),
+	ready(true),
+	dynamicVertices(false),
+	boundsMin(0, 0, 0),
+	boundsMax(0, 0, 0),
+	uvDensity(0),
+	vertexFormat(_vertexFormat),
+	indexFormat(DXGI_FORMAT_R32_UINT),
 	context(_context),
 	device(_device)
 {
 	//LoadModelGiven(relativeFilePath);
-	LoadModelAssimp(relativeFilePath);
+	LoadModel(relativeFilePath);
 }
 
 Mesh::Mesh(const char* relativeFilePath, 
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, Microsoft::WRL::ComPtr<ID3D11Device> _device) :
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	MeshVertexFormat _vertexFormat) :
 	vertexCount(0),
 	indexCount(0),
+	loadTime(0),
+	loadedFromCache(false),
+	cacheRatios(),
+	ready(true),
+	dynamicVertices(false),
+	boundsMin(0, 0, 0),
+	boundsMax(0, 0, 0),
+	uvDensity(0),
+	vertexFormat(_vertexFormat),
+	indexFormat(DXGI_FORMAT_R32_UINT),
 	context(_context),
 	device(_device)
 {
 	//LoadModelGiven(std::string(relativeFilePath));
-	LoadModelAssimp(std::string(relativeFilePath));
+	LoadModel(std::string(relativeFilePath));
+}
+
+Mesh::Mesh(std::shared_ptr<Mesh> _placeholder,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	MeshVertexFormat _vertexFormat) :
+	vertexCount(0),
+	indexCount(0),
+	loadTime(0),
+	loadedFromCache(false),
+	cacheRatios(),
+	ready(false),
+	dynamicVertices(false),
+	boundsMin(0, 0, 0),
+	boundsMax(0, 0, 0),
+	uvDensity(0),
+	vertexFormat(_vertexFormat),
+	indexFormat(DXGI_FORMAT_R32_UINT),
+	placeholder(_placeholder),
+	context(_context),
+	device(_device)
+{
 }
 
 Mesh::~Mesh() {}
@@ -72,24 +184,262 @@ Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer() { return vertexBuff
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer() { return indexBuffer; }
 int Mesh::GetIndexCount() { return indexCount; }
 int Mesh::GetVertexCount() { return vertexCount; }
+float Mesh::GetLoadTime() { return loadTime; }
+bool Mesh::WasLoadedFromCache() { return loadedFromCache; }
+MeshVertexCacheRatios Mesh::GetVertexCacheRatios() { return cacheRatios; }
+bool Mesh::IsReady() { return ready; }
+bool Mesh::IsDynamic() { return dynamicVertices; }
+DirectX::XMFLOAT3 Mesh::GetBoundsMin() { return boundsMin; }
+DirectX::XMFLOAT3 Mesh::GetBoundsMax() { return boundsMax; }
+float Mesh::GetUVDensity() { return uvDensity; }
+const std::vector<MeshSubmeshRange>& Mesh::GetSubmeshRanges() { return submeshes; }
+unsigned int Mesh::GetSubmeshCount() { return (unsigned int)submeshes.size(); }
+MeshVertexFormat Mesh::GetVertexFormat() { return vertexFormat; }
+const std::vector<Meshlet>& Mesh::GetMeshlets() { return meshlets; }
+unsigned int Mesh::GetUncompressedMemory() { return sizeof(Vertex) * vertexCount + sizeof(unsigned int) * indexCount; }
+
+DirectX::XMFLOAT4X4 Mesh::GetPositionTransform()
+{
+	if (!ready && placeholder) { return placeholder->GetPositionTransform(); }
+
+	XMFLOAT4X4 transform;
+	if (vertexFormat == MESH_VERTEX_QUANTIZED)
+	{
+		// Positions are stored as 0-1 fractions of the bounds
+		XMVECTOR extent = XMLoadFloat3(&boundsMax) - XMLoadFloat3(&boundsMin);
+		XMStoreFloat4x4(&transform, XMMatrixScalingFromVector(extent) * XMMatrixTranslation(boundsMin.x, boundsMin.y, boundsMin.z));
+	}
+	else
+		XMStoreFloat4x4(&transform, XMMatrixIdentity());
+	return transform;
+}
+
+unsigned int Mesh::GetGPUMemory()
+{
+	unsigned int stride = vertexFormat == MESH_VERTEX_QUANTIZED ? sizeof(QuantizedVertex) : sizeof(CompactVertex);
+	unsigned int indexSize = indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(unsigned int);
+	unsigned int positionStride = !positionBuffer ? 0 :
+		vertexFormat == MESH_VERTEX_QUANTIZED ? QuantizedPositionLayout::Stride : CompactPositionLayout::Stride;
+	return (stride + positionStride) * vertexCount + indexSize * indexCount;
+}
+
+bool Mesh::CreateInputLayouts(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3DBlob> vertexShaderBlob)
+{
+	D3D11_INPUT_ELEMENT_DESC compactElements[CompactVertexLayout::ElementCount];
+	CompactVertexLayout::GetInputElements(compactElements);
+	HRESULT compactResult = _device->CreateInputLayout(compactElements, CompactVertexLayout::ElementCount,
+		vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(),
+		inputLayouts[MESH_VERTEX_COMPACT].ReleaseAndGetAddressOf());
+
+	D3D11_INPUT_ELEMENT_DESC quantizedElements[QuantizedVertexLayout::ElementCount];
+	QuantizedVertexLayout::GetInputElements(quantizedElements);
+	HRESULT quantizedResult = _device->CreateInputLayout(quantizedElements, QuantizedVertexLayout::ElementCount,
+		vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(),
+		inputLayouts[MESH_VERTEX_QUANTIZED].ReleaseAndGetAddressOf());
+
+	if (FAILED(compactResult) || FAILED(quantizedResult))
+	{
+		std::cerr << "Could not create mesh input layouts" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Mesh::CreatePositionInputLayouts(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3DBlob> vertexShaderBlob)
+{
+	if (positionInputLayouts[MESH_VERTEX_COMPACT] && positionInputLayouts[MESH_VERTEX_QUANTIZED]) { return true; }
+
+	D3D11_INPUT_ELEMENT_DESC compactElements[CompactPositionLayout::ElementCount];
+	CompactPositionLayout::GetInputElements(compactElements);
+	HRESULT compactResult = _device->CreateInputLayout(compactElements, CompactPositionLayout::ElementCount,
+		vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(),
+		positionInputLayouts[MESH_VERTEX_COMPACT].ReleaseAndGetAddressOf());
+
+	D3D11_INPUT_ELEMENT_DESC quantizedElements[QuantizedPositionLayout::ElementCount];
+	QuantizedPositionLayout::GetInputElements(quantizedElements);
+	HRESULT quantizedResult = _device->CreateInputLayout(quantizedElements, QuantizedPositionLayout::ElementCount,
+		vertexShaderBlob->GetBufferPointer(), vertexShaderBlob->GetBufferSize(),
+		positionInputLayouts[MESH_VERTEX_QUANTIZED].ReleaseAndGetAddressOf());
+
+	if (FAILED(compactResult) || FAILED(quantizedResult))
+	{
+		std::cerr << "Could not create position-only input layouts" << std::endl;
+		return false;
+	}
+	return true;
+}
 
 // Helper Functions
-void Mesh::LoadModelAssimp(std::string fileName) 
+
+// Post processing used for every assimp import (part of the .mesh cache key)
+static const unsigned int ASSIMP_IMPORT_FLAGS = aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_ConvertToLeftHanded;
+
+void Mesh::LoadModel(std::string fileName)
 {
-	const aiScene* scene = aiImportFile(fileName.c_str(), aiProcessPreset_TargetRealtime_MaxQuality |
-		aiProcess_ConvertToLeftHanded );
+	MeshImportData data;
+	if (ImportModel(fileName, data))
+		FinishLoad(data);
+}
+
+bool Mesh::ImportModel(const std::string& fileName, MeshImportData& data, unsigned int maxParseThreads)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	data.FromCache = false;
+
+	// Case-insensitive extension check
+	std::string extension = fileName.substr(fileName.find_last_of('.') + 1);
+	for (char& c : extension) { c = (char)tolower(c); }
+	bool isObj = extension == "obj";
+
+	// Use the cached import if it was built from this exact file with the current importer settings
+	unsigned long long sourceHash = 0;
+	unsigned long long sourceSize = 0;
+	bool hashed = HashFile(fileName, sourceHash, sourceSize);
+	std::string cachePath = GetMeshCachePath(fileName);
+	if (hashed)
+	{
+		MeshCacheFile cache;
+		if (cache.Open(cachePath, sourceHash, sourceSize))
+		{
+			const MeshCacheHeader* header = cache.GetHeader();
+			bool current =
+				(header->Importer == MESH_IMPORTER_OBJ && isObj && header->ImportFlags == OBJ_LOADER_VERSION) ||
+				(header->Importer == MESH_IMPORTER_ASSIMP && header->ImportFlags == ASSIMP_IMPORT_FLAGS);
+			if (current)
+			{
+				// Straight copies of the mapped arrays, no parsing
+				data.Vertices.assign(cache.GetVertices(), cache.GetVertices() + header->VertexCount);
+				data.Indices.assign(cache.GetIndices(), cache.GetIndices() + header->IndexCount);
+				data.Submeshes.assign(cache.GetSubmeshes(), cache.GetSubmeshes() + header->SubmeshCount);
+				data.Meshlets.assign(cache.GetMeshlets(), cache.GetMeshlets() + header->MeshletCount);
+				data.BoundsMin = header->BoundsMin;
+				data.BoundsMax = header->BoundsMax;
+				data.CacheRatios = header->CacheRatios;
+				data.FromCache = true;
+				data.ImportTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+				return true;
+			}
+		}
+	}
+
+	// No usable cache, so import from scratch
+	std::vector<Vertex>& vertices = data.Vertices;
+	std::vector<unsigned int>& indices = data.Indices;
+	MeshCacheHeader header = {};
+	if (isObj && LoadModelObj(fileName, vertices, indices, data.Submeshes, maxParseThreads))
+	{
+		header.Importer = MESH_IMPORTER_OBJ;
+		header.ImportFlags = OBJ_LOADER_VERSION;
+	}
+	else if (LoadModelAssimp(fileName, vertices, indices, data.Submeshes))
+	{
+		header.Importer = MESH_IMPORTER_ASSIMP;
+		header.ImportFlags = ASSIMP_IMPORT_FLAGS;
+	}
+	else
+		return false;
+
+	// Reorder for the post-transform cache, overdraw and vertex fetch (saved in the cache, so only done once)
+	VertexCacheStats before, after;
+	OptimizeMesh(vertices, indices, data.Submeshes, before, after);
+	data.CacheRatios.ACMRBefore = before.ACMR;
+	data.CacheRatios.ACMRAfter = after.ACMR;
+	data.CacheRatios.ATVRBefore = before.ATVR;
+	data.CacheRatios.ATVRAfter = after.ATVR;
+
+	// Split into meshlets for culling (also saved in the cache)
+	BuildMeshlets(vertices.data(), (unsigned int)vertices.size(), indices.data(), (unsigned int)indices.size(),
+		data.Submeshes.data(), (unsigned int)data.Submeshes.size(), data.Meshlets);
+
+	CalculateBounds(vertices.data(), (unsigned int)vertices.size(), data.BoundsMin, data.BoundsMax);
+
+	// Save the import for next time
+	if (hashed)
+	{
+		header.SourceHash = sourceHash;
+		header.SourceSize = sourceSize;
+		header.BoundsMin = data.BoundsMin;
+		header.BoundsMax = data.BoundsMax;
+		header.CacheRatios = data.CacheRatios;
+		if (!WriteMeshCache(cachePath, header, data.Submeshes, vertices, indices, data.Meshlets))
+			std::cerr << "Could not write mesh cache " << cachePath << std::endl;
+	}
+	data.ImportTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return true;
+}
+
+void Mesh::FinishLoad(MeshImportData& data)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	vertexCount = (int)data.Vertices.size();
+	indexCount = (int)data.Indices.size();
+	boundsMin = data.BoundsMin;
+	boundsMax = data.BoundsMax;
+	submeshes.swap(data.Submeshes);
+	meshlets.swap(data.Meshlets);
+	loadedFromCache = data.FromCache;
+	cacheRatios = data.CacheRatios;
+	CreateBuffers(data.Vertices.data(), data.Indices.data(), device);
+
+	loadTime = data.ImportTime + std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	ready = true;
+	placeholder.reset();
+}
+
+void Mesh::FinishDynamicLoad(const Vertex* vertices, int _vertexCount, const unsigned int* indices, int _indexCount,
+	const std::vector<MeshSubmeshRange>& _submeshes)
+{
+	// Skinning rewrites compact vertices, and meshlets wouldn't stay valid once they move
+	vertexCount = _vertexCount;
+	indexCount = _indexCount;
+	submeshes = _submeshes;
+	meshlets.clear();
+	vertexFormat = MESH_VERTEX_COMPACT;
+	dynamicVertices = true;
+	CalculateBounds(vertices, (unsigned int)vertexCount, boundsMin, boundsMax);
+	CreateBuffers(vertices, indices, device);
+
+	ready = true;
+	placeholder.reset();
+}
+
+bool Mesh::LoadModelObj(std::string fileName, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+	std::vector<MeshSubmeshRange>& ranges, unsigned int maxParseThreads)
+{
+	if (!LoadObjFile(fileName, vertices, indices, maxParseThreads))
+	{
+		std::cerr << "Fast OBJ load failed for " << fileName << ", falling back to assimp" << std::endl;
+		return false;
+	}
+
+	// .obj materials aren't supported, so the whole file is one range
+	ranges.clear();
+	ranges.push_back({ 0, (unsigned int)indices.size(), 0, 0 });
+	return true;
+}
+
+bool Mesh::LoadModelAssimp(std::string fileName, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+	std::vector<MeshSubmeshRange>& ranges)
+{
+	const aiScene* scene = aiImportFile(fileName.c_str(), ASSIMP_IMPORT_FLAGS);
 
 	if (!scene) {
 		std::cerr << "Could not load file " << fileName << ": " << aiGetErrorString() << std::endl;
-		return;
+		return false;
 	}
 
 	// Load all meshes (assimp separates a model into a mesh for each material)
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
+	vertices.clear();
+	indices.clear();
+	ranges.clear();
 	for (size_t i = 0; i < scene->mNumMeshes; i++)
 	{
 		aiMesh* readMesh = scene->mMeshes[i];
+		MeshSubmeshRange range = {};
+		range.StartIndex = (unsigned int)indices.size();
+		range.BaseVertex = (unsigned int)vertices.size();
+		range.MaterialIndex = readMesh->mMaterialIndex;
 
 		// Material Data
 		//aiMaterial* material = scene->mMaterials[readMesh->mMaterialIndex];
@@ -103,8 +453,11 @@ void Mesh::LoadModelAssimp(std::string fileName)
 		//aiGetMaterialColor(material, AI_MATKEY_COLOR_AMBIENT, &ambientColor);
 		//aiGetMaterialFloat(material, AI_MATKEY_SHININESS, &shininess);
 
+		// Parts without positions/normals (or with only points/lines) can't be drawn, so leave them out
+		if (!readMesh->HasPositions() || !readMesh->HasNormals() || !readMesh->HasFaces())
+			continue;
+
 		// Vertex Data
-		if (readMesh->HasPositions() && readMesh->HasNormals())
 		{
 			for (size_t i = 0; i < readMesh->mNumVertices; i++)
 			{
@@ -142,20 +495,20 @@ void Mesh::LoadModelAssimp(std::string fileName)
 		//indices.reserve(readMesh->mNumFaces * 3);
 		for (size_t i = 0; i < readMesh->mNumFaces; i++)
 		{
-			//assert(readMesh->mFaces[i].mNumIndices == 3);
+			if (readMesh->mFaces[i].mNumIndices != 3)
+				continue;
 
+			// Indices stay relative to this part's vertices; range.BaseVertex is added when drawing
 			indices.push_back(readMesh->mFaces[i].mIndices[0]);
 			indices.push_back(readMesh->mFaces[i].mIndices[1]);
 			indices.push_back(readMesh->mFaces[i].mIndices[2]);
 		}
+		range.IndexCount = (unsigned int)indices.size() - range.StartIndex;
+		ranges.push_back(range);
 	}
 
 	aiReleaseImport(scene);
-	
-	// Create Buffers
-	vertexCount = (int)vertices.size();
-	indexCount = (int)indices.size();
-	CreateBuffers(&vertices[0], &indices[0], device);
+	return !vertices.empty() && !indices.empty();
 }
 void Mesh::LoadModelGiven(std::string relativeFilePath) {
 	// Author: Chris Cascioli
@@ -374,38 +727,139 @@ void Mesh::LoadModelGiven(std::string relativeFilePath) {
 	//    sophisticated model loading library like TinyOBJLoader or The Open Asset Importer Library
 	vertexCount = vertCounter;
 	indexCount = indexCounter;
+	submeshes.assign(1, { 0, (unsigned int)indexCount, 0, 0 });
+	CalculateBounds(&verts[0], vertCounter, boundsMin, boundsMax);
 	CreateBuffers(&verts[0], &indices[0], device);
 
 }
 
-void Mesh::CreateBuffers(Vertex* vertices, unsigned int* indices, Microsoft::WRL::ComPtr<ID3D11Device> _device)
+float CalculateUVDensity(const Vertex* vertices, const unsigned int* indices, const std::vector<MeshSubmeshRange>& submeshes)
+{
+	double surfaceArea = 0.0;
+	double uvArea = 0.0;
+	for (const MeshSubmeshRange& range : submeshes)
+	{
+		const Vertex* base = vertices + range.BaseVertex;
+		for (unsigned int i = range.StartIndex; i + 2 < range.StartIndex + range.IndexCount; i += 3)
+		{
+			const Vertex& a = base[indices[i]];
+			const Vertex& b = base[indices[i + 1]];
+			const Vertex& c = base[indices[i + 2]];
+			XMVECTOR edge1 = XMVectorSubtract(XMLoadFloat3(&b.Position), XMLoadFloat3(&a.Position));
+			XMVECTOR edge2 = XMVectorSubtract(XMLoadFloat3(&c.Position), XMLoadFloat3(&a.Position));
+			surfaceArea += 0.5f * XMVectorGetX(XMVector3Length(XMVector3Cross(edge1, edge2)));
+			float uvCross = (b.UV.x - a.UV.x) * (c.UV.y - a.UV.y) - (c.UV.x - a.UV.x) * (b.UV.y - a.UV.y);
+			uvArea += 0.5f * fabsf(uvCross);
+		}
+	}
+	return surfaceArea > 0.0 ? (float)sqrt(uvArea / surfaceArea) : 0.0f;
+}
+
+void Mesh::CreateBuffers(const Vertex* vertices, const unsigned int* indices, Microsoft::WRL::ComPtr<ID3D11Device> _device)
 {
+	// The full vertices aren't kept after this, so measure the UVs while they're here
+	uvDensity = CalculateUVDensity(vertices, indices, submeshes);
+
+	// Encode the vertices into the mesh's GPU format
+	std::vector<CompactVertex> compactVertices;
+	std::vector<QuantizedVertex> quantizedVertices;
+	const void* vertexData = nullptr;
+	unsigned int vertexStride = 0;
+	if (vertexFormat == MESH_VERTEX_QUANTIZED)
+	{
+		quantizedVertices.resize(vertexCount);
+		for (int i = 0; i < vertexCount; i++) { quantizedVertices[i] = EncodeQuantizedVertex(vertices[i], boundsMin, boundsMax); }
+		vertexData = quantizedVertices.data();
+		vertexStride = sizeof(QuantizedVertex);
+	}
+	else
+	{
+		compactVertices.resize(vertexCount);
+		for (int i = 0; i < vertexCount; i++) { compactVertices[i] = EncodeCompactVertex(vertices[i]); }
+		vertexData = compactVertices.data();
+		vertexStride = sizeof(CompactVertex);
+	}
+
+	// 16-bit indices whenever they can address every vertex (indices are relative to their
+	// submesh's BaseVertex, so large multi-part models can still use them)
+	unsigned int maxIndex = 0;
+	for (int i = 0; i < indexCount; i++) { maxIndex = std::max(maxIndex, indices[i]); }
+	std::vector<unsigned short> shortIndices;
+	const void* indexData = indices;
+	unsigned int indexSize = sizeof(unsigned int);
+	indexFormat = DXGI_FORMAT_R32_UINT;
+	if (maxIndex < 65536)
+	{
+		shortIndices.assign(indices, indices + indexCount);
+		indexData = shortIndices.data();
+		indexSize = sizeof(unsigned short);
+		indexFormat = DXGI_FORMAT_R16_UINT;
+	}
 
 	// Create a VERTEX BUFFER
 	{
 		// First, we need to describe the buffer we want Direct3D to make on the GPU
 		D3D11_BUFFER_DESC vbd = {};
 		vbd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		vbd.ByteWidth = sizeof(Vertex) * vertexCount;
+		vbd.ByteWidth = vertexStride * vertexCount;
 		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
 		vbd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
+		if (dynamicVertices)
+		{
+			// Except for dynamic meshes, which are rewritten with MapVertices()
+			vbd.Usage = D3D11_USAGE_DYNAMIC;
+			vbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		}
 		vbd.MiscFlags = 0;
 		vbd.StructureByteStride = 0;
 
 		// Create the proper struct to hold the initial vertex data
 		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = vertices; // pSysMem = Pointer to System Memory
+		initialVertexData.pSysMem = vertexData; // pSysMem = Pointer to System Memory
 
 		// Actually create the buffer on the GPU with the initial data
 		_device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
 	}
 
+	// Create a POSITION BUFFER: the same positions again, tightly packed, so depth
+	// passes don't fetch normals, UVs and tangents they never read
+	positionBuffer.Reset();
+	if (PositionStreams && !dynamicVertices)
+	{
+		std::vector<XMFLOAT3> compactPositions;
+		std::vector<PackedVector::XMUSHORTN4> quantizedPositions;
+		const void* positionData = nullptr;
+		unsigned int positionStride = 0;
+		if (vertexFormat == MESH_VERTEX_QUANTIZED)
+		{
+			quantizedPositions.resize(vertexCount);
+			for (int i = 0; i < vertexCount; i++) { quantizedPositions[i] = quantizedVertices[i].Position; }
+			positionData = quantizedPositions.data();
+			positionStride = QuantizedPositionLayout::Stride;
+		}
+		else
+		{
+			compactPositions.resize(vertexCount);
+			for (int i = 0; i < vertexCount; i++) { compactPositions[i] = compactVertices[i].Position; }
+			positionData = compactPositions.data();
+			positionStride = CompactPositionLayout::Stride;
+		}
+
+		D3D11_BUFFER_DESC pbd = {};
+		pbd.Usage = D3D11_USAGE_IMMUTABLE;
+		pbd.ByteWidth = positionStride * vertexCount;
+		pbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		D3D11_SUBRESOURCE_DATA initialPositionData = {};
+		initialPositionData.pSysMem = positionData;
+		_device->CreateBuffer(&pbd, &initialPositionData, positionBuffer.GetAddressOf());
+	}
+
 	// Create an INDEX BUFFER
 	{
 		// Describe the buffer, as we did above, with two major differences
 		D3D11_BUFFER_DESC ibd = {};
 		ibd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		ibd.ByteWidth = sizeof(unsigned int) * indexCount;
+		ibd.ByteWidth = indexSize * indexCount;
 		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
 		ibd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
 		ibd.MiscFlags = 0;
@@ -413,33 +867,196 @@ void Mesh::CreateBuffers(Vertex* vertices, unsigned int* indices, Microsoft::WRL
 
 		// Specify the initial data for this buffer, similar to above
 		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = indices; // pSysMem = Pointer to System Memory
+		initialIndexData.pSysMem = indexData; // pSysMem = Pointer to System Memory
 
 		// Actually create the buffer with the initial data
 		_device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
 	}
+
+	// Where each submesh's meshlets start (they're built in submesh order)
+	submeshMeshletStart.assign(submeshes.size() + 1, (unsigned int)meshlets.size());
+	for (unsigned int m = (unsigned int)meshlets.size(); m-- > 0;)
+	{
+		if (meshlets[m].Submesh < submeshes.size()) { submeshMeshletStart[meshlets[m].Submesh] = m; }
+	}
+	for (size_t i = submeshes.size(); i-- > 0;)
+	{
+		submeshMeshletStart[i] = std::min(submeshMeshletStart[i], submeshMeshletStart[i + 1]);
+	}
+
+	// Meshes that can be partly culled also get a dynamic index buffer to compact the visible
+	// meshlets into, plus a CPU copy of the indices to compact them from
+	cpuIndices.clear();
+	culledIndexBuffer.Reset();
+	if (meshlets.size() > 1)
+	{
+		const unsigned char* indexBytes = (const unsigned char*)indexData;
+		cpuIndices.assign(indexBytes, indexBytes + indexSize * indexCount);
+
+		D3D11_BUFFER_DESC cbd = {};
+		cbd.Usage = D3D11_USAGE_DYNAMIC;	// Rewritten every draw
+		cbd.ByteWidth = indexSize * indexCount;
+		cbd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		cbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		_device->CreateBuffer(&cbd, 0, culledIndexBuffer.GetAddressOf());
+	}
 }
 
 // Public Functions
+void Mesh::BindBuffers(ID3D11Buffer* meshIndexBuffer)
+{
+	// Set buffers in the input assembler (IA) stage, along with the layout
+	// that matches this mesh's vertex format (replacing the shader's own)
+	UINT stride = vertexFormat == MESH_VERTEX_QUANTIZED ? sizeof(QuantizedVertex) : sizeof(CompactVertex);
+	UINT offset = 0;
+	context->IASetInputLayout(inputLayouts[vertexFormat].Get());
+	context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+	context->IASetIndexBuffer(meshIndexBuffer, indexFormat, 0);
+}
+
 void Mesh::Draw()
 {
 	// DRAW geometry
 	// - These steps are generally repeated for EACH object you draw
 	// - Other Direct3D calls will also be necessary to do more complex things
-	UINT stride = sizeof(Vertex);
+	if (!ready)
+	{
+		if (placeholder) { placeholder->Draw(); }
+		return;
+	}
+	BindBuffers(indexBuffer.Get());
+
+	// Tell Direct3D to draw
+	//  - This will use all currently set Direct3D resources (shaders, buffers, etc)
+	//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
+	//     vertices in the currently set VERTEX BUFFER
+	//  - Each submesh's indices start at its own vertex, so BaseVertex is added to them
+	for (const MeshSubmeshRange& range : submeshes)
+	{
+		context->DrawIndexed(range.IndexCount, range.StartIndex, range.BaseVertex);
+	}
+}
+
+void Mesh::DrawSubmesh(unsigned int submesh)
+{
+	if (!ready && submesh == 0)
+	{
+		if (placeholder) { placeholder->Draw(); }
+		return;
+	}
+	if (submesh >= submeshes.size()) { return; }
+	const MeshSubmeshRange& range = submeshes[submesh];
+	BindBuffers(indexBuffer.Get());
+	context->DrawIndexed(range.IndexCount, range.StartIndex, range.BaseVertex);
+}
+
+void Mesh::DrawPositionOnly()
+{
+	if (!ready)
+	{
+		if (placeholder) { placeholder->DrawPositionOnly(); }
+		return;
+	}
+	UINT interleavedStride = vertexFormat == MESH_VERTEX_QUANTIZED ? sizeof(QuantizedVertex) : sizeof(CompactVertex);
+	DepthStats.Draws++;
+	DepthStats.InterleavedBytes += (unsigned long long)interleavedStride * vertexCount;
+	if (!positionBuffer || !positionInputLayouts[vertexFormat])
+	{
+		DepthStats.VertexBytes += (unsigned long long)interleavedStride * vertexCount;
+		Draw();
+		return;
+	}
+
+	UINT stride = vertexFormat == MESH_VERTEX_QUANTIZED ? QuantizedPositionLayout::Stride : CompactPositionLayout::Stride;
 	UINT offset = 0;
+	DepthStats.VertexBytes += (unsigned long long)stride * vertexCount;
+	context->IASetInputLayout(positionInputLayouts[vertexFormat].Get());
+	context->IASetVertexBuffers(0, 1, positionBuffer.GetAddressOf(), &stride, &offset);
+	context->IASetIndexBuffer(indexBuffer.Get(), indexFormat, 0);
+	for (const MeshSubmeshRange& range : submeshes)
+	{
+		context->DrawIndexed(range.IndexCount, range.StartIndex, range.BaseVertex);
+	}
+}
+
+CompactVertex* Mesh::MapVertices()
+{
+	if (!dynamicVertices || !vertexBuffer) { return nullptr; }
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(vertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) { return nullptr; }
+	return (CompactVertex*)mapped.pData;
+}
+
+void Mesh::UnmapVertices()
+{
+	if (dynamicVertices && vertexBuffer) { context->Unmap(vertexBuffer.Get(), 0); }
+}
+
+void Mesh::DrawCulled(const XMFLOAT4X4& world, const XMFLOAT4X4& viewProj, XMFLOAT3 cameraPosition)
+{
+	if (!ready || !MeshletCulling || !culledIndexBuffer)
+	{
+		Draw();
+		return;
+	}
+	for (unsigned int i = 0; i < (unsigned int)submeshes.size(); i++)
 	{
-		// Set buffers in the input assembler (IA) stage
-		context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-		context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+		DrawSubmeshCulled(i, world, viewProj, cameraPosition);
+	}
+}
 
-		// Tell Direct3D to draw
-		//  - This will use all currently set Direct3D resources (shaders, buffers, etc)
-		//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
-		//     vertices in the currently set VERTEX BUFFER
-		context->DrawIndexed(
-			indexCount,     // The number of indices to use (we could draw a subset if we wanted)
-			0,     // Offset to the first index we want to use
-			0);    // Offset to add to each index when looking up vertices
+void Mesh::DrawSubmeshCulled(unsigned int submesh, const XMFLOAT4X4& world, const XMFLOAT4X4& viewProj, XMFLOAT3 cameraPosition)
+{
+	if (!ready || submesh >= submeshes.size())
+	{
+		DrawSubmesh(submesh);
+		return;
+	}
+	const MeshSubmeshRange& range = submeshes[submesh];
+	unsigned int firstMeshlet = submeshMeshletStart[submesh];
+	unsigned int meshletCount = submeshMeshletStart[submesh + 1] - firstMeshlet;
+	if (!MeshletCulling || !culledIndexBuffer || meshletCount <= 1)
+	{
+		DrawSubmesh(submesh);
+		return;
 	}
-}
\ No newline at end of file
+
+	// Meshlet bounds come from the full precision positions, so they're already in object space
+	XMFLOAT4 planes[6];
+	ExtractFrustumPlanes(viewProj, planes);
+	CullMeshlets(meshlets.data() + firstMeshlet, meshletCount, world, planes, cameraPosition, visibleMeshlets, CullStats);
+
+	if (visibleMeshlets.empty()) { return; }
+	if (visibleMeshlets.size() == meshletCount)
+	{
+		DrawSubmesh(submesh);
+		return;
+	}
+
+	// Copy the visible meshlets' indices into the dynamic buffer, merging neighbouring ranges
+	unsigned int indexSize = indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(unsigned int);
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(culledIndexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		DrawSubmesh(submesh);
+		return;
+	}
+	unsigned char* dest = (unsigned char*)mapped.pData;
+	unsigned int culledIndexCount = 0;
+	for (size_t i = 0; i < visibleMeshlets.size();)
+	{
+		const Meshlet& first = meshlets[firstMeshlet + visibleMeshlets[i]];
+		unsigned int start = first.StartIndex;
+		unsigned int end = first.StartIndex + first.TriangleCount * 3;
+		for (i++; i < visibleMeshlets.size() && meshlets[firstMeshlet + visibleMeshlets[i]].StartIndex == end; i++)
+		{
+			end += meshlets[firstMeshlet + visibleMeshlets[i]].TriangleCount * 3;
+		}
+		memcpy(dest + culledIndexCount * indexSize, cpuIndices.data() + start * indexSize, (end - start) * indexSize);
+		culledIndexCount += end - start;
+	}
+	context->Unmap(culledIndexBuffer.Get(), 0);
+
+	BindBuffers(culledIndexBuffer.Get());
+	context->DrawIndexed(culledIndexCount, 0, range.BaseVertex);
+}
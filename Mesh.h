@@ -3,7 +3,44 @@
 #include <d3d11.h>
 #include "Vertex.h"
 #include "PathHelpers.h"
+#include "MeshCache.h"
+#include "VertexFormats.h"
+#include "Meshlets.h"
 #include <string>
+#include <vector>
+#include <memory>
+
+// Vertex data read by DrawPositionOnly() since the last Mesh::ResetDepthStats()
+// (each vertex counted once per draw, ignoring post-transform cache misses)
+struct MeshDepthStats
+{
+	unsigned int Draws;
+	unsigned long long VertexBytes;			// Read from position streams (or full vertices for meshes without one)
+	unsigned long long InterleavedBytes;	// What the same draws would read from the full vertex buffers
+};
+
+/// <summary>
+/// Calculates how many UV units cover one object space unit of the surface, on
+/// average: the square root of the total UV area over the total triangle area.
+/// Texture streaming uses it to pick mips from a mesh's size on screen.
+/// </summary>
+/// <returns>UV units per object space unit (0 for meshes without UV area)</returns>
+float CalculateUVDensity(const Vertex* vertices, const unsigned int* indices,
+	const std::vector<MeshSubmeshRange>& submeshes);
+
+// CPU side results of loading a model file (see Mesh::ImportModel()), ready to upload
+struct MeshImportData
+{
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+	std::vector<MeshSubmeshRange> Submeshes;
+	std::vector<Meshlet> Meshlets;
+	DirectX::XMFLOAT3 BoundsMin;
+	DirectX::XMFLOAT3 BoundsMax;
+	MeshVertexCacheRatios CacheRatios;
+	bool FromCache;
+	float ImportTime;		// Milliseconds
+};
 
 class Mesh
 {
@@ -11,27 +48,109 @@ public:
 	Mesh(Vertex* vertices, int _vertexCount,
 		unsigned int* indices, int _indexCount,
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
-		Microsoft::WRL::ComPtr<ID3D11Device> _device);
+		Microsoft::WRL::ComPtr<ID3D11Device> _device,
+		MeshVertexFormat _vertexFormat = MESH_VERTEX_COMPACT);
 	Mesh(std::wstring relativeFilePath,
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
-		Microsoft::WRL::ComPtr<ID3D11Device> _device);
+		Microsoft::WRL::ComPtr<ID3D11Device> _device,
+		MeshVertexFormat _vertexFormat = MESH_VERTEX_COMPACT);
 	Mesh(std::string relativeFilePath,
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
-		Microsoft::WRL::ComPtr<ID3D11Device> _device);
+		Microsoft::WRL::ComPtr<ID3D11Device> _device,
+		MeshVertexFormat _vertexFormat = MESH_VERTEX_COMPACT);
 	Mesh(const char* relativeFilePath,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+		Microsoft::WRL::ComPtr<ID3D11Device> _device,
+		MeshVertexFormat _vertexFormat = MESH_VERTEX_COMPACT);
+	/// <summary>
+	/// Creates a mesh with no geometry yet, which draws the placeholder until
+	/// FinishLoad() is called (see MeshLoader)
+	/// </summary>
+	/// <param name="_placeholder">Mesh drawn in this one's place until it's ready (can be null)</param>
+	Mesh(std::shared_ptr<Mesh> _placeholder,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+		Microsoft::WRL::ComPtr<ID3D11Device> _device,
+		MeshVertexFormat _vertexFormat = MESH_VERTEX_COMPACT);
+	/// <summary>
+	/// Creates a mesh whose vertices are rewritten every frame through MapVertices(),
+	/// e.g. by CPU skinning. Always compact, with no meshlets or position stream, as
+	/// neither would stay valid once the vertices move.
+	/// </summary>
+	/// <param name="vertices">Initial vertices</param>
+	/// <param name="_submeshes">Index ranges (indices are relative to each range's BaseVertex)</param>
+	Mesh(const Vertex* vertices, int _vertexCount, const unsigned int* indices, int _indexCount,
+		const std::vector<MeshSubmeshRange>& _submeshes,
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
 		Microsoft::WRL::ComPtr<ID3D11Device> _device);
 	~Mesh();
 	/// <summary>
-	/// Create the Vertex and Index buffers for the mesh
+	/// Creates the input layout for each MeshVertexFormat. Must be called once before any mesh is drawn.
+	/// </summary>
+	/// <param name="_device">Device to create the layouts with</param>
+	/// <param name="vertexShaderBlob">Compiled shader whose input is VertexShaderInput</param>
+	/// <returns>True if every layout was created</returns>
+	static bool CreateInputLayouts(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3DBlob> vertexShaderBlob);
+	/// <summary>
+	/// Creates the input layout for each position-only stream. Must be called before
+	/// DrawPositionOnly(); does nothing if the layouts already exist.
+	/// </summary>
+	/// <param name="_device">Device to create the layouts with</param>
+	/// <param name="vertexShaderBlob">Compiled depth shader that only reads POSITION</param>
+	/// <returns>True if every layout exists</returns>
+	static bool CreatePositionInputLayouts(Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3DBlob> vertexShaderBlob);
+	/// <summary>
+	/// Create the Vertex and Index buffers for the mesh, encoding the
+	/// vertices into the mesh's vertex format and using 16-bit
+	/// indices when every submesh's vertices can be addressed with them
 	/// </summary>
 	/// <param name="vertices">The mesh's vertices</param>
 	/// <param name="indices">The mesh's indices</param>
 	/// <param name="_device">The ID3D11Device we are creating buffers with</param>
-	void CreateBuffers(Vertex* vertices, unsigned int* indices, Microsoft::WRL::ComPtr<ID3D11Device> _device);
-	void LoadModelAssimp(std::string relativeFilePath);
+	void CreateBuffers(const Vertex* vertices, const unsigned int* indices, Microsoft::WRL::ComPtr<ID3D11Device> _device);
+	/// <summary>
+	/// Loads a model file, using its .mesh cache when it's up to date. Otherwise the
+	/// model is imported (the fast .obj loader for .obj files, falling back to assimp,
+	/// and assimp for everything else) and the cache is rewritten.
+	/// </summary>
+	/// <param name="relativeFilePath">Path to the model file</param>
+	void LoadModel(std::string relativeFilePath);
+	/// <summary>
+	/// The CPU half of LoadModel(): reads the .mesh cache or imports, optimizes and caches
+	/// the model. Doesn't touch D3D, so it's safe to call from worker threads.
+	/// </summary>
+	/// <param name="relativeFilePath">Path to the model file</param>
+	/// <param name="data">Receives the model's geometry</param>
+	/// <param name="maxParseThreads">Max threads for the .obj parser (0 = all hardware threads)</param>
+	/// <returns>True if the model was loaded</returns>
+	static bool ImportModel(const std::string& relativeFilePath, MeshImportData& data, unsigned int maxParseThreads = 0);
+	/// <summary>
+	/// The GPU half of LoadModel(): takes the imported geometry and creates the buffers.
+	/// Must be called on the render thread. The mesh is ready to draw afterwards.
+	/// </summary>
+	/// <param name="data">Geometry from ImportModel() (its submeshes and meshlets are moved out)</param>
+	void FinishLoad(MeshImportData& data);
+	/// <summary>
+	/// FinishLoad() for a mesh that's skinned every frame: turns a placeholder mesh into
+	/// a dynamic one, as the dynamic constructor creates. Must be called on the render thread.
+	/// </summary>
+	/// <param name="vertices">Initial vertices</param>
+	/// <param name="_submeshes">Index ranges (indices are relative to each range's BaseVertex)</param>
+	void FinishDynamicLoad(const Vertex* vertices, int _vertexCount, const unsigned int* indices, int _indexCount,
+		const std::vector<MeshSubmeshRange>& _submeshes);
+	/// <summary>
+	/// Imports a model with assimp
+	/// </summary>
+	/// <returns>True if the model was loaded</returns>
+	static bool LoadModelAssimp(std::string relativeFilePath, std::vector<Vertex>& vertices,
+		std::vector<unsigned int>& indices, std::vector<MeshSubmeshRange>& ranges);
 	void LoadModelGiven(std::string relativeFilePath);
 	/// <summary>
+	/// Imports an .obj file with the memory mapped, multithreaded ObjLoader
+	/// </summary>
+	/// <returns>True if the model was loaded</returns>
+	static bool LoadModelObj(std::string relativeFilePath, std::vector<Vertex>& vertices,
+		std::vector<unsigned int>& indices, std::vector<MeshSubmeshRange>& ranges, unsigned int maxParseThreads = 0);
+	/// <summary>
 	/// Returns the Vertex Buffer ComPtr
 	/// </summary>
 	/// <returns>The Vertex Buffer ComPtr</returns>
@@ -52,15 +171,135 @@ public:
 	/// <returns>The number of vertices this mesh contains</returns>
 	int GetVertexCount();
 	/// <summary>
-	/// Activates the buffers and draws the correct number of indices
+	/// Returns how long loading the model file took (0 for meshes made from raw data)
+	/// </summary>
+	/// <returns>Load time in milliseconds</returns>
+	float GetLoadTime();
+	/// <summary>
+	/// Returns whether the mesh came from an up to date .mesh cache instead of an import
+	/// </summary>
+	bool WasLoadedFromCache();
+	/// <summary>
+	/// Returns the mesh's vertex cache ratios before and after it was optimized on import (all 0 for meshes made from raw data)
+	/// </summary>
+	MeshVertexCacheRatios GetVertexCacheRatios();
+	/// <summary>
+	/// Returns false while an asynchronous load is still in progress (the placeholder is drawn instead)
+	/// </summary>
+	bool IsReady();
+	/// <summary>
+	/// Returns whether the vertices are rewritten through MapVertices(), so anything drawn from them goes stale every frame
+	/// </summary>
+	bool IsDynamic();
+	// Object space bounds of the mesh's vertices
+	DirectX::XMFLOAT3 GetBoundsMin();
+	DirectX::XMFLOAT3 GetBoundsMax();
+	/// <summary>
+	/// Returns the average UV units per object space unit across the surface, for picking texture mips (0 until loaded)
+	/// </summary>
+	float GetUVDensity();
+	/// <summary>
+	/// Returns the index ranges of each part of the model (one per assimp mesh). Indices
+	/// are relative to each range's BaseVertex, which is applied when drawing.
+	/// </summary>
+	const std::vector<MeshSubmeshRange>& GetSubmeshRanges();
+	MeshVertexFormat GetVertexFormat();
+	/// <summary>
+	/// Returns the matrix that turns vertex buffer positions into object space positions
+	/// (identity unless positions are quantized). Apply it before the world matrix.
+	/// </summary>
+	DirectX::XMFLOAT4X4 GetPositionTransform();
+	/// <summary>
+	/// Returns the size of the mesh's vertex and index buffers in bytes
+	/// </summary>
+	unsigned int GetGPUMemory();
+	/// <summary>
+	/// Returns the size the buffers would be with full Vertex structs and 32-bit indices
+	/// </summary>
+	unsigned int GetUncompressedMemory();
+	/// <summary>
+	/// Returns the mesh's meshlets (built at import and saved in the .mesh cache)
+	/// </summary>
+	const std::vector<Meshlet>& GetMeshlets();
+	/// <summary>
+	/// Returns the number of submeshes (draw ranges sharing the mesh's buffers)
+	/// </summary>
+	unsigned int GetSubmeshCount();
+	/// <summary>
+	/// Activates the buffers and draws every submesh
 	/// </summary>
 	void Draw();
+	/// <summary>
+	/// Activates the buffers and draws one submesh
+	/// </summary>
+	/// <param name="submesh">Index into GetSubmeshRanges()</param>
+	void DrawSubmesh(unsigned int submesh);
+	/// <summary>
+	/// Draws every submesh from the position-only stream, for depth passes whose
+	/// vertex shader only reads positions. Falls back to Draw() without one.
+	/// </summary>
+	void DrawPositionOnly();
+	/// <summary>
+	/// Maps a dynamic mesh's vertex buffer for rewriting (every vertex must be written).
+	/// Map and unmap on the render thread; the memory itself can be filled from any thread.
+	/// </summary>
+	/// <returns>GetVertexCount() vertices to fill, or null if the mesh isn't dynamic</returns>
+	CompactVertex* MapVertices();
+	void UnmapVertices();
+	/// <summary>
+	/// Culls the mesh's meshlets against a view and draws only the survivors,
+	/// compacted into a per frame index buffer. Falls back to Draw() when
+	/// nothing is culled or MeshletCulling is off.
+	/// </summary>
+	/// <param name="world">The mesh's world matrix (without GetPositionTransform())</param>
+	/// <param name="viewProj">The camera's view * projection matrix</param>
+	/// <param name="cameraPosition">World space camera position</param>
+	void DrawCulled(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT4X4& viewProj, DirectX::XMFLOAT3 cameraPosition);
+	/// <summary>
+	/// DrawCulled() for a single submesh
+	/// </summary>
+	/// <param name="submesh">Index into GetSubmeshRanges()</param>
+	void DrawSubmeshCulled(unsigned int submesh, const DirectX::XMFLOAT4X4& world,
+		const DirectX::XMFLOAT4X4& viewProj, DirectX::XMFLOAT3 cameraPosition);
+
+	// Meshlet culling results for every DrawCulled() since the last ResetCullStats()
+	static MeshletCullStats CullStats;
+	static void ResetCullStats();
+	static bool MeshletCulling;
+
+	// Vertex data read by every DrawPositionOnly() since the last ResetDepthStats()
+	static MeshDepthStats DepthStats;
+	static void ResetDepthStats();
+	// Whether meshes uploaded from now on also get a position-only stream
+	static bool PositionStreams;
 
 private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
 	int vertexCount;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 	int indexCount;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> positionBuffer;	// Optional position-only copy of the vertices
+	float loadTime;
+	bool loadedFromCache;
+	MeshVertexCacheRatios cacheRatios;
+	bool ready;
+	bool dynamicVertices;
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+	float uvDensity;
+	std::vector<MeshSubmeshRange> submeshes;
+	MeshVertexFormat vertexFormat;
+	DXGI_FORMAT indexFormat;
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned char> cpuIndices;		// Index buffer contents, for compacting visible meshlets
+	std::vector<unsigned int> visibleMeshlets;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> culledIndexBuffer;
+	std::vector<unsigned int> submeshMeshletStart;	// First meshlet of each submesh (plus one past the end)
+
+	void BindBuffers(ID3D11Buffer* meshIndexBuffer);
+	static Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayouts[MESH_VERTEX_FORMAT_COUNT];
+	static Microsoft::WRL::ComPtr<ID3D11InputLayout> positionInputLayouts[MESH_VERTEX_FORMAT_COUNT];
+	std::shared_ptr<Mesh> placeholder;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
 
@@ -0,0 +1,125 @@
+#include "MeshCache.h"
+#include <fstream>
+#include <cstring>
+#include <cfloat>
+
+using namespace DirectX;
+
+static const char MESH_CACHE_MAGIC[4] = { 'M', 'E', 'S', 'H' };
+
+bool HashFile(const std::string& filePath, unsigned long long& hash, unsigned long long& size)
+{
+	MappedFile source;
+	if (!source.Open(filePath)) { return false; }
+
+	// 64-bit FNV-1a
+	const unsigned char* bytes = (const unsigned char*)source.GetData();
+	size = source.GetSize();
+	hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return true;
+}
+
+void CalculateBounds(const Vertex* vertices, unsigned int vertexCount, XMFLOAT3& boundsMin, XMFLOAT3& boundsMax)
+{
+	XMVECTOR minV = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxV = XMVectorReplicate(-FLT_MAX);
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		XMVECTOR pos = XMLoadFloat3(&vertices[i].Position);
+		minV = XMVectorMin(minV, pos);
+		maxV = XMVectorMax(maxV, pos);
+	}
+	XMStoreFloat3(&boundsMin, minV);
+	XMStoreFloat3(&boundsMax, maxV);
+}
+
+std::string GetMeshCachePath(const std::string& sourceFilePath)
+{
+	return sourceFilePath + ".mesh";
+}
+
+bool WriteMeshCache(const std::string& cacheFilePath, MeshCacheHeader header,
+	const std::vector<MeshSubmeshRange>& submeshes,
+	const std::vector<Vertex>& vertices,
+	const std::vector<unsigned int>& indices,
+	const std::vector<Meshlet>& meshlets)
+{
+	memcpy(header.Magic, MESH_CACHE_MAGIC, sizeof(header.Magic));
+	header.Version = MESH_CACHE_VERSION;
+	header.VertexStride = sizeof(Vertex);
+	header.VertexCount = (unsigned int)vertices.size();
+	header.IndexCount = (unsigned int)indices.size();
+	header.SubmeshCount = (unsigned int)submeshes.size();
+	header.MeshletCount = (unsigned int)meshlets.size();
+
+	std::ofstream out(cacheFilePath, std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) { return false; }
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)submeshes.data(), sizeof(MeshSubmeshRange) * submeshes.size());
+	out.write((const char*)vertices.data(), sizeof(Vertex) * vertices.size());
+	out.write((const char*)indices.data(), sizeof(unsigned int) * indices.size());
+	out.write((const char*)meshlets.data(), sizeof(Meshlet) * meshlets.size());
+	return out.good();
+}
+
+bool MeshCacheFile::Open(const std::string& cacheFilePath, unsigned long long sourceHash, unsigned long long sourceSize)
+{
+	if (!file.Open(cacheFilePath)) { return false; }
+
+	// Make sure this is a cache of the right version that matches the source
+	const MeshCacheHeader* header = GetHeader();
+	if (file.GetSize() < sizeof(MeshCacheHeader) ||
+		memcmp(header->Magic, MESH_CACHE_MAGIC, sizeof(header->Magic)) != 0 ||
+		header->Version != MESH_CACHE_VERSION ||
+		header->VertexStride != sizeof(Vertex) ||
+		header->SourceHash != sourceHash ||
+		header->SourceSize != sourceSize ||
+		header->VertexCount == 0 ||
+		header->IndexCount == 0)
+	{
+		Close();
+		return false;
+	}
+
+	// Make sure the file isn't truncated
+	unsigned long long expectedSize = sizeof(MeshCacheHeader) +
+		sizeof(MeshSubmeshRange) * (unsigned long long)header->SubmeshCount +
+		sizeof(Vertex) * (unsigned long long)header->VertexCount +
+		sizeof(unsigned int) * (unsigned long long)header->IndexCount +
+		sizeof(Meshlet) * (unsigned long long)header->MeshletCount;
+	if (file.GetSize() != expectedSize)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MeshCacheFile::Close() { file.Close(); }
+
+// Getters
+const MeshCacheHeader* MeshCacheFile::GetHeader()
+{
+	return (const MeshCacheHeader*)file.GetData();
+}
+const MeshSubmeshRange* MeshCacheFile::GetSubmeshes()
+{
+	return (const MeshSubmeshRange*)(file.GetData() + sizeof(MeshCacheHeader));
+}
+const Vertex* MeshCacheFile::GetVertices()
+{
+	return (const Vertex*)(GetSubmeshes() + GetHeader()->SubmeshCount);
+}
+const unsigned int* MeshCacheFile::GetIndices()
+{
+	return (const unsigned int*)(GetVertices() + GetHeader()->VertexCount);
+}
+const Meshlet* MeshCacheFile::GetMeshlets()
+{
+	return (const Meshlet*)(GetIndices() + GetHeader()->IndexCount);
+}
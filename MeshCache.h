@@ -0,0 +1,127 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Vertex.h"
+#include "MappedFile.h"
+#include "Meshlets.h"
+
+// --------------------------------------------------------
+// Binary .mesh cache of a fully imported model
+//
+// Layout (all little endian, tightly packed):
+//   MeshCacheHeader
+//   MeshSubmeshRange[SubmeshCount]
+//   Vertex[VertexCount]
+//   unsigned int[IndexCount]
+//   Meshlet[MeshletCount]
+//
+// The vertex and index arrays are stored exactly as the GPU
+// wants them, so a mapped cache can be handed straight to
+// Mesh::CreateBuffers() without any parsing or copying.
+// --------------------------------------------------------
+
+// Bump whenever the file layout or Vertex changes
+#define MESH_CACHE_VERSION 4
+
+// Which importer produced the cached data
+enum MeshImporter
+{
+	MESH_IMPORTER_OBJ = 1,
+	MESH_IMPORTER_ASSIMP = 2
+};
+
+// A range of the index buffer that shares one material
+struct MeshSubmeshRange
+{
+	unsigned int StartIndex;
+	unsigned int IndexCount;
+	unsigned int BaseVertex;
+	unsigned int MaterialIndex;
+};
+
+// Post-transform cache efficiency of an import before and after OptimizeMesh() (see VertexCacheStats)
+struct MeshVertexCacheRatios
+{
+	float ACMRBefore;
+	float ACMRAfter;
+	float ATVRBefore;
+	float ATVRAfter;
+};
+
+struct MeshCacheHeader
+{
+	char Magic[4];						// "MESH"
+	unsigned int Version;				// MESH_CACHE_VERSION
+	unsigned int Importer;				// MeshImporter
+	unsigned int ImportFlags;			// Importer specific (assimp post process flags, etc.)
+	unsigned long long SourceHash;		// FNV-1a hash of the source file's bytes
+	unsigned long long SourceSize;		// Size of the source file in bytes
+	unsigned int VertexStride;			// sizeof(Vertex) when written
+	unsigned int VertexCount;
+	unsigned int IndexCount;
+	unsigned int SubmeshCount;
+	unsigned int MeshletCount;
+	DirectX::XMFLOAT3 BoundsMin;
+	DirectX::XMFLOAT3 BoundsMax;
+	MeshVertexCacheRatios CacheRatios;
+};
+
+/// <summary>
+/// Hashes a file's contents with 64-bit FNV-1a
+/// </summary>
+/// <param name="filePath">File to hash</param>
+/// <param name="hash">Resulting hash</param>
+/// <param name="size">Resulting file size in bytes</param>
+/// <returns>True if the file could be read</returns>
+bool HashFile(const std::string& filePath, unsigned long long& hash, unsigned long long& size);
+
+/// <summary>
+/// Calculates the axis-aligned bounds of the given vertices' positions
+/// </summary>
+void CalculateBounds(const Vertex* vertices, unsigned int vertexCount,
+	DirectX::XMFLOAT3& boundsMin, DirectX::XMFLOAT3& boundsMax);
+
+/// <summary>
+/// Returns the path of the cache file for a given model file
+/// </summary>
+std::string GetMeshCachePath(const std::string& sourceFilePath);
+
+/// <summary>
+/// Writes imported mesh data to a cache file. The header's importer, flags,
+/// source and bounds fields must already be filled in; the rest are set here.
+/// </summary>
+/// <returns>True if the whole file was written</returns>
+bool WriteMeshCache(const std::string& cacheFilePath, MeshCacheHeader header,
+	const std::vector<MeshSubmeshRange>& submeshes,
+	const std::vector<Vertex>& vertices,
+	const std::vector<unsigned int>& indices,
+	const std::vector<Meshlet>& meshlets);
+
+// --------------------------------------------------------
+// A memory mapped, validated .mesh file. The pointers stay
+// valid until the MeshCacheFile is closed or destroyed.
+// --------------------------------------------------------
+class MeshCacheFile
+{
+public:
+	/// <summary>
+	/// Maps a cache file and checks that it's complete and was built from
+	/// the given source file. The caller still checks the importer/flags.
+	/// </summary>
+	/// <param name="cacheFilePath">Path to the .mesh file</param>
+	/// <param name="sourceHash">Hash of the current source file</param>
+	/// <param name="sourceSize">Size of the current source file</param>
+	/// <returns>True if the cache is usable</returns>
+	bool Open(const std::string& cacheFilePath, unsigned long long sourceHash, unsigned long long sourceSize);
+	void Close();
+
+	// Getters
+	const MeshCacheHeader* GetHeader();
+	const MeshSubmeshRange* GetSubmeshes();
+	const Vertex* GetVertices();
+	const unsigned int* GetIndices();
+	const Meshlet* GetMeshlets();
+
+private:
+	MappedFile file;
+};
@@ -0,0 +1,199 @@
+#include "MeshLoader.h"
+#include "PathHelpers.h"
+#include <iostream>
+#include <cfloat>
+#include <algorithm>
+
+using namespace DirectX;
+
+MeshLoader::MeshLoader(Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	unsigned int threadCount) :
+	context(_context),
+	device(_device),
+	pendingCount(0),
+	lastBatchTime(0),
+	pool(threadCount)
+{
+	CreatePlaceholder();
+}
+
+MeshLoader::~MeshLoader() {}
+
+void MeshLoader::CreatePlaceholder()
+{
+	// Unit cube with flat faces. Corners go clockwise around each face's normal.
+	const XMFLOAT3 normals[6] = { {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1} };
+	const XMFLOAT3 tangents[6] = { {0, 0, 1}, {0, 0, -1}, {1, 0, 0}, {1, 0, 0}, {-1, 0, 0}, {1, 0, 0} };
+	const XMFLOAT2 uvs[4] = { {0, 1}, {0, 0}, {1, 0}, {1, 1} };
+	Vertex vertices[24] = {};
+	unsigned int indices[36];
+	for (unsigned int f = 0; f < 6; f++)
+	{
+		XMVECTOR n = XMLoadFloat3(&normals[f]);
+		XMVECTOR u = XMLoadFloat3(&tangents[f]);
+		XMVECTOR v = XMVector3Cross(n, u);
+		XMVECTOR corners[4] = { n - u - v, n - u + v, n + u + v, n + u - v };
+		for (unsigned int c = 0; c < 4; c++)
+		{
+			Vertex& vertex = vertices[f * 4 + c];
+			XMStoreFloat3(&vertex.Position, corners[c] * 0.5f);
+			vertex.Normal = normals[f];
+			vertex.Tangent = tangents[f];
+			vertex.UV = uvs[c];
+		}
+		const unsigned int faceIndices[6] = { 0, 1, 2, 0, 2, 3 };
+		for (unsigned int i = 0; i < 6; i++) { indices[f * 6 + i] = f * 4 + faceIndices[i]; }
+	}
+	placeholder = std::make_shared<Mesh>(vertices, 24, indices, 36, context, device);
+}
+
+std::shared_ptr<Mesh> MeshLoader::LoadAsync(const std::wstring& filePath, MeshVertexFormat vertexFormat)
+{
+	return LoadAsync(WideToNarrow(filePath), vertexFormat);
+}
+
+std::shared_ptr<Mesh> MeshLoader::LoadAsync(const std::string& filePath, MeshVertexFormat vertexFormat)
+{
+	// Share a load that's already in flight
+	auto existing = inFlight.find(filePath);
+	if (existing != inFlight.end())
+	{
+		for (auto& queued : existing->second)
+		{
+			if (queued->VertexFormat == vertexFormat) { return queued->Target; }
+		}
+	}
+
+	if (pendingCount == 0) { batchStart = std::chrono::high_resolution_clock::now(); }
+	pendingCount++;
+
+	std::shared_ptr<PendingLoad> load = std::make_shared<PendingLoad>();
+	load->Target = std::make_shared<Mesh>(placeholder, context, device, vertexFormat);
+	load->FilePath = filePath;
+	load->VertexFormat = vertexFormat;
+	load->Succeeded = false;
+
+	// The .mesh cache doesn't depend on the format, so one import per file at a time
+	// (two workers writing the same cache would clash); other formats wait for it
+	std::vector<std::shared_ptr<PendingLoad>>& loads = inFlight[filePath];
+	loads.push_back(load);
+	if (loads.size() == 1) { StartImport(load); }
+	return load->Target;
+}
+
+std::shared_ptr<SkinnedModel> MeshLoader::LoadSkinnedAsync(const std::wstring& filePath)
+{
+	if (pendingCount == 0) { batchStart = std::chrono::high_resolution_clock::now(); }
+	pendingCount++;
+
+	std::shared_ptr<PendingSkinnedLoad> load = std::make_shared<PendingSkinnedLoad>();
+	load->Target = std::make_shared<SkinnedModel>();
+	load->FilePath = WideToNarrow(filePath);
+	load->Succeeded = false;
+
+	// Characters may already be evaluating other models on the animator's threads, so
+	// the shared model is only written on the render thread, in Update()
+	pool.Enqueue([this, load]()
+	{
+		load->Succeeded = LoadSkinnedModel(load->FilePath, load->Data);
+		std::lock_guard<std::mutex> lock(completedMutex);
+		completedSkinned.push_back(load);
+	});
+	return load->Target;
+}
+
+void MeshLoader::StartImport(std::shared_ptr<PendingLoad> load)
+{
+	// The worker only touches the import data; the Mesh itself is left to the render thread
+	pool.Enqueue([this, load]()
+	{
+		// Models already load in parallel with each other, so each one parses on a single thread
+		load->Succeeded = Mesh::ImportModel(load->FilePath, load->Data, 1);
+		std::lock_guard<std::mutex> lock(completedMutex);
+		completed.push_back(load);
+	});
+}
+
+unsigned int MeshLoader::Update(float budgetMs)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	unsigned int finished = 0;
+	while (true)
+	{
+		std::shared_ptr<PendingLoad> load;
+		std::shared_ptr<PendingSkinnedLoad> skinnedLoad;
+		{
+			std::lock_guard<std::mutex> lock(completedMutex);
+			if (!completed.empty())
+			{
+				load = completed.front();
+				completed.pop_front();
+			}
+			else if (!completedSkinned.empty())
+			{
+				skinnedLoad = completedSkinned.front();
+				completedSkinned.pop_front();
+			}
+			else
+				break;
+		}
+
+		if (load)
+			FinishImport(load, finished);
+		else if (skinnedLoad->Succeeded)
+		{
+			// Marked Loaded by LoadSkinnedModel(), so characters pick it up in their next update
+			*skinnedLoad->Target = std::move(skinnedLoad->Data);
+			finished++;
+		}
+		else
+			std::cerr << "Could not load " << skinnedLoad->FilePath << ", keeping its placeholder" << std::endl;
+		pendingCount--;
+		if (pendingCount == 0)
+		{
+			lastBatchTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - batchStart).count();
+		}
+
+		if (std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() >= budgetMs) { break; }
+	}
+	return finished;
+}
+
+// --------------------------------------------------------
+// Uploads one finished import and moves on to the next
+// format queued for the same file
+// --------------------------------------------------------
+void MeshLoader::FinishImport(std::shared_ptr<PendingLoad> load, unsigned int& finished)
+{
+	if (load->Succeeded)
+	{
+		load->Target->FinishLoad(load->Data);
+		finished++;
+	}
+	else
+		std::cerr << "Could not load " << load->FilePath << ", keeping its placeholder" << std::endl;
+
+	// Forget finished loads so later LoadAsync() calls start fresh, and start
+	// the next format of the same file now its cache is written
+	auto entry = inFlight.find(load->FilePath);
+	if (entry != inFlight.end())
+	{
+		std::vector<std::shared_ptr<PendingLoad>>& loads = entry->second;
+		loads.erase(std::remove(loads.begin(), loads.end(), load), loads.end());
+		if (loads.empty())
+			inFlight.erase(entry);
+		else
+			StartImport(loads.front());
+	}
+}
+
+void MeshLoader::FinishAll()
+{
+	// Loads waiting on another format's import only start in Update()
+	while (pendingCount > 0)
+	{
+		pool.WaitIdle();
+		Update(FLT_MAX);
+	}
+}
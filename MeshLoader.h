@@ -0,0 +1,119 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <chrono>
+#include "Mesh.h"
+#include "SkinnedModel.h"
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Loads meshes in the background.
+//
+// LoadAsync() hands back a Mesh right away, which draws a
+// unit cube until its model is ready. Reading, importing,
+// optimizing and caching the model happen on worker
+// threads (Mesh::ImportModel()). Update(), called once per
+// frame on the render thread, creates the GPU buffers for
+// finished imports until its time budget runs out.
+//
+// Rigged models (LoadSkinnedAsync()) import on the same
+// workers; Update() fills in the SkinnedModel it handed
+// out, and each AnimatedMesh creates its own buffers.
+// --------------------------------------------------------
+class MeshLoader
+{
+public:
+	/// <summary>
+	/// Creates the placeholder cube and starts the worker threads
+	/// </summary>
+	/// <param name="threadCount">Number of worker threads (0 = one less than the hardware thread count)</param>
+	MeshLoader(Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+		Microsoft::WRL::ComPtr<ID3D11Device> _device,
+		unsigned int threadCount = 0);
+	~MeshLoader();
+
+	/// <summary>
+	/// Queues a model to load on a worker thread. Loading the same file and format
+	/// again while the first load is in flight returns the same Mesh. Other formats
+	/// of a file being imported wait for that import, then read its .mesh cache.
+	/// </summary>
+	/// <param name="filePath">Path to the model file</param>
+	/// <param name="vertexFormat">Vertex format to upload the mesh with</param>
+	/// <returns>A mesh that draws the placeholder until it's ready</returns>
+	std::shared_ptr<Mesh> LoadAsync(const std::string& filePath, MeshVertexFormat vertexFormat = MESH_VERTEX_COMPACT);
+	std::shared_ptr<Mesh> LoadAsync(const std::wstring& filePath, MeshVertexFormat vertexFormat = MESH_VERTEX_COMPACT);
+	/// <summary>
+	/// Queues a rigged model to load on a worker thread (LoadSkinnedModel()). Isn't shared
+	/// with other loads of the same file; ResourceRegistry already loads each file once.
+	/// </summary>
+	/// <param name="filePath">Path to the model file</param>
+	/// <returns>A model that stays empty (Loaded is false) until Update() fills it in</returns>
+	std::shared_ptr<SkinnedModel> LoadSkinnedAsync(const std::wstring& filePath);
+
+	/// <summary>
+	/// Creates GPU buffers for finished imports. Always finishes at least one
+	/// when any are waiting, then stops once the budget is used up.
+	/// </summary>
+	/// <param name="budgetMs">Time to spend this frame, in milliseconds</param>
+	/// <returns>Number of meshes and rigged models that became ready</returns>
+	unsigned int Update(float budgetMs);
+	/// <summary>
+	/// Blocks until every queued model is imported and ready (for loading screens and tools)
+	/// </summary>
+	void FinishAll();
+
+	// Getters
+	std::shared_ptr<Mesh> GetPlaceholder() { return placeholder; }
+	unsigned int GetPendingCount() { return pendingCount; }
+	unsigned int GetThreadCount() { return pool.GetThreadCount(); }
+	// Time from the first LoadAsync() until the last queued mesh became ready
+	float GetLastBatchTime() { return lastBatchTime; }
+
+private:
+	struct PendingLoad
+	{
+		std::shared_ptr<Mesh> Target;
+		std::string FilePath;		// Also its entry in inFlight
+		MeshVertexFormat VertexFormat;
+		MeshImportData Data;
+		bool Succeeded;
+	};
+
+	struct PendingSkinnedLoad
+	{
+		std::shared_ptr<SkinnedModel> Target;
+		std::string FilePath;
+		SkinnedModel Data;
+		bool Succeeded;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	std::shared_ptr<Mesh> placeholder;
+
+	// Imports finished by the workers, waiting for Update()
+	std::mutex completedMutex;
+	std::deque<std::shared_ptr<PendingLoad>> completed;
+	std::deque<std::shared_ptr<PendingSkinnedLoad>> completedSkinned;
+
+	// Render thread only
+	// Loads of each file not yet finished, one format each. Only the first is importing;
+	// the rest start once it has written the file's .mesh cache.
+	std::unordered_map<std::string, std::vector<std::shared_ptr<PendingLoad>>> inFlight;
+	unsigned int pendingCount;
+	float lastBatchTime;
+	std::chrono::high_resolution_clock::time_point batchStart;
+
+	// Declared last so the workers are joined before anything they use is destroyed
+	ThreadPool pool;
+
+	void CreatePlaceholder();
+	void StartImport(std::shared_ptr<PendingLoad> load);
+	void FinishImport(std::shared_ptr<PendingLoad> load, unsigned int& finished);
+};
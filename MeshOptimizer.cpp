@@ -0,0 +1,329 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	// FIFO cache simulation using timestamps: a vertex is cached if fewer than
+	// cacheSize misses have happened since it was last loaded
+	struct FifoCache
+	{
+		std::vector<unsigned int> loadTime;
+		unsigned int time;
+		unsigned int cacheSize;
+
+		FifoCache(unsigned int vertexCount, unsigned int _cacheSize) :
+			loadTime(vertexCount, 0), time(_cacheSize + 1), cacheSize(_cacheSize) {}
+
+		void Reset() { time += cacheSize + 1; }
+
+		// Returns 1 on a miss
+		unsigned int Access(unsigned int v)
+		{
+			if (time - loadTime[v] <= cacheSize) { return 0; }
+			loadTime[v] = time++;
+			return 1;
+		}
+	};
+
+	unsigned int MaxIndex(const unsigned int* indices, unsigned int indexCount)
+	{
+		unsigned int maxIndex = 0;
+		for (unsigned int i = 0; i < indexCount; i++) { maxIndex = std::max(maxIndex, indices[i]); }
+		return maxIndex;
+	}
+
+	void FinishStats(VertexCacheStats& stats)
+	{
+		stats.ACMR = stats.TrianglesDrawn > 0 ? (float)stats.VerticesTransformed / stats.TrianglesDrawn : 0.0f;
+		stats.ATVR = stats.VertexCount > 0 ? (float)stats.VerticesTransformed / stats.VertexCount : 0.0f;
+	}
+}
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, unsigned int indexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = {};
+	indexCount -= indexCount % 3;
+	if (indexCount == 0) { return stats; }
+
+	unsigned int vertexCount = MaxIndex(indices, indexCount) + 1;
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> used(vertexCount, false);
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		stats.VerticesTransformed += cache.Access(indices[i]);
+		if (!used[indices[i]])
+		{
+			used[indices[i]] = true;
+			stats.VertexCount++;
+		}
+	}
+	stats.TrianglesDrawn = indexCount / 3;
+	FinishStats(stats);
+	return stats;
+}
+
+void OptimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+	std::vector<unsigned int>& clusters, unsigned int cacheSize)
+{
+	clusters.clear();
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0) { return; }
+
+	// Vertex -> triangle adjacency (offsets into one shared array)
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (unsigned int i = 0; i < triangleCount * 3; i++) { liveTriangles[indices[i]]++; }
+	std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; v++) { adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v]; }
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	{
+		std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			for (int k = 0; k < 3; k++) { adjacency[fill[indices[t * 3 + k]]++] = t; }
+		}
+	}
+
+	std::vector<unsigned int> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnds;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	unsigned int time = cacheSize + 1;
+	unsigned int cursor = 0;
+
+	// Start fanning around the first vertex
+	int fanVertex = (int)indices[0];
+	clusters.push_back(0);
+	while (fanVertex >= 0)
+	{
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (unsigned int a = adjacencyOffset[fanVertex]; a < adjacencyOffset[fanVertex + 1]; a++)
+		{
+			unsigned int t = adjacency[a];
+			if (emitted[t]) { continue; }
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (time - cacheTime[v] > cacheSize) { cacheTime[v] = time++; }
+			}
+			emitted[t] = true;
+		}
+
+		// Next fanning vertex: the one still in the cache with the most remaining
+		// triangles that won't be evicted while fanning around it
+		int best = -1;
+		int bestPriority = -1;
+		for (unsigned int v : candidates)
+		{
+			if (liveTriangles[v] == 0) { continue; }
+			int priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) { priority = (int)(time - cacheTime[v]); }
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				best = (int)v;
+			}
+		}
+
+		// Dead end: back up through recently used vertices, then scan linearly
+		if (best == -1)
+		{
+			while (!deadEnds.empty())
+			{
+				unsigned int v = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[v] > 0) { best = (int)v; break; }
+			}
+			while (best == -1 && cursor < vertexCount)
+			{
+				if (liveTriangles[cursor] > 0) { best = (int)cursor; }
+				cursor++;
+			}
+
+			// A jump breaks cache continuity, so start a new cluster
+			unsigned int trianglesSoFar = (unsigned int)output.size() / 3;
+			if (best != -1 && trianglesSoFar > clusters.back()) { clusters.push_back(trianglesSoFar); }
+		}
+		fanVertex = best;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeOverdraw(const Vertex* vertices, unsigned int* indices, unsigned int indexCount,
+	const std::vector<unsigned int>& clusters, float threshold, unsigned int cacheSize)
+{
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0 || clusters.empty()) { return; }
+	FifoCache cache(MaxIndex(indices, triangleCount * 3) + 1, cacheSize);
+
+	// Split each cluster wherever the ACMR so far is already close to the whole cluster's
+	std::vector<unsigned int> cuts;
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		unsigned int start = clusters[c];
+		unsigned int end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+		cache.Reset();
+		unsigned int clusterMisses = 0;
+		for (unsigned int i = start * 3; i < end * 3; i++) { clusterMisses += cache.Access(indices[i]); }
+		float limit = (float)clusterMisses / (end - start) * threshold;
+
+		cache.Reset();
+		cuts.push_back(start);
+		unsigned int misses = 0;
+		unsigned int subStart = start;
+		for (unsigned int t = start; t < end; t++)
+		{
+			for (int k = 0; k < 3; k++) { misses += cache.Access(indices[t * 3 + k]); }
+			if (t + 1 < end && (float)misses / (t + 1 - subStart) <= limit)
+			{
+				cuts.push_back(t + 1);
+				subStart = t + 1;
+				misses = 0;
+				cache.Reset();
+			}
+		}
+	}
+
+	// Area weighted centroid and normal of each cluster and of the whole mesh
+	struct Cluster { unsigned int Start; unsigned int End; float SortKey; };
+	std::vector<Cluster> sorted(cuts.size());
+	std::vector<XMFLOAT3> centroids(cuts.size());
+	std::vector<XMFLOAT3> normals(cuts.size());
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < cuts.size(); c++)
+	{
+		sorted[c].Start = cuts[c];
+		sorted[c].End = c + 1 < cuts.size() ? cuts[c + 1] : triangleCount;
+
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+		for (unsigned int t = sorted[c].Start; t < sorted[c].End; t++)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+			// Front faces are clockwise, so this points out of the front face
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+			float triArea = XMVectorGetX(XMVector3Length(n)) * 0.5f;
+			centroid += (p0 + p1 + p2) * (triArea / 3.0f);
+			normal += n;
+			area += triArea;
+		}
+		meshCentroid += centroid;
+		meshArea += area;
+		XMStoreFloat3(&centroids[c], area > 0.0f ? centroid / area : centroid);
+		XMStoreFloat3(&normals[c], XMVector3Normalize(normal));
+	}
+	if (meshArea > 0.0f) { meshCentroid /= meshArea; }
+
+	// Clusters that face away from the middle of the mesh are likely to occlude the rest
+	for (size_t c = 0; c < sorted.size(); c++)
+	{
+		XMVECTOR offset = XMLoadFloat3(&centroids[c]) - meshCentroid;
+		sorted[c].SortKey = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&normals[c])));
+	}
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const Cluster& a, const Cluster& b) { return a.SortKey > b.SortKey; });
+
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+	for (const Cluster& c : sorted)
+	{
+		output.insert(output.end(), indices + c.Start * 3, indices + c.End * 3);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeVertexFetch(Vertex* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount)
+{
+	const unsigned int UNUSED = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(vertexCount, UNUSED);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertexCount);
+
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		unsigned int& newIndex = remap[indices[i]];
+		if (newIndex == UNUSED)
+		{
+			newIndex = (unsigned int)reordered.size();
+			reordered.push_back(vertices[indices[i]]);
+		}
+		indices[i] = newIndex;
+	}
+
+	// Keep unused vertices (at the end) so the vertex count doesn't change
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == UNUSED) { reordered.push_back(vertices[v]); }
+	}
+	std::copy(reordered.begin(), reordered.end(), vertices);
+}
+
+void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+	const std::vector<MeshSubmeshRange>& ranges, VertexCacheStats& before, VertexCacheStats& after)
+{
+	before = {};
+	after = {};
+	for (size_t r = 0; r < ranges.size(); r++)
+	{
+		const MeshSubmeshRange& range = ranges[r];
+		unsigned int* rangeIndices = indices.data() + range.StartIndex;
+		unsigned int indexCount = range.IndexCount - range.IndexCount % 3;
+		if (indexCount == 0) { continue; }
+
+		// A range's vertices run until the next range's vertices start
+		unsigned int vertexEnd = (unsigned int)vertices.size();
+		bool sharesVertices = false;
+		for (size_t other = 0; other < ranges.size(); other++)
+		{
+			if (other == r) { continue; }
+			if (ranges[other].BaseVertex > range.BaseVertex) { vertexEnd = std::min(vertexEnd, ranges[other].BaseVertex); }
+			if (ranges[other].BaseVertex == range.BaseVertex) { sharesVertices = true; }
+		}
+		unsigned int vertexCount = vertexEnd - range.BaseVertex;
+
+		VertexCacheStats stats = AnalyzeVertexCache(rangeIndices, indexCount);
+		before.TrianglesDrawn += stats.TrianglesDrawn;
+		before.VerticesTransformed += stats.VerticesTransformed;
+		before.VertexCount += stats.VertexCount;
+
+		// Leave malformed ranges (indices outside their own vertices) alone
+		if (range.BaseVertex >= vertices.size() || MaxIndex(rangeIndices, indexCount) >= vertexCount)
+		{
+			after.TrianglesDrawn += stats.TrianglesDrawn;
+			after.VerticesTransformed += stats.VerticesTransformed;
+			after.VertexCount += stats.VertexCount;
+			continue;
+		}
+
+		// Keep the original order if it was already better (meshes with almost no shared vertices)
+		std::vector<unsigned int> optimized(rangeIndices, rangeIndices + indexCount);
+		std::vector<unsigned int> clusters;
+		OptimizeVertexCache(optimized.data(), indexCount, vertexCount, clusters);
+		OptimizeOverdraw(vertices.data() + range.BaseVertex, optimized.data(), indexCount, clusters);
+		if (AnalyzeVertexCache(optimized.data(), indexCount).VerticesTransformed <= stats.VerticesTransformed)
+			std::copy(optimized.begin(), optimized.end(), rangeIndices);
+		if (!sharesVertices)
+			OptimizeVertexFetch(vertices.data() + range.BaseVertex, vertexCount, rangeIndices, indexCount);
+
+		stats = AnalyzeVertexCache(rangeIndices, indexCount);
+		after.TrianglesDrawn += stats.TrianglesDrawn;
+		after.VerticesTransformed += stats.VerticesTransformed;
+		after.VertexCount += stats.VertexCount;
+	}
+	FinishStats(before);
+	FinishStats(after);
+}
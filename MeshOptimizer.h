@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include "Vertex.h"
+#include "MeshCache.h"
+
+// --------------------------------------------------------
+// Import-time index/vertex reordering
+//
+// - Vertex cache: Tipsify (Sander, Nehab & Barczak 2007)
+//   reorders triangles so recently transformed vertices are
+//   reused by the GPU's post-transform cache
+// - Overdraw: the Tipsify output is cut into clusters, which
+//   are sorted so outward facing clusters draw first
+// - Vertex fetch: vertices are renumbered in order of first
+//   use so the input assembler reads memory linearly
+//
+// Everything here is plain CPU code on index/vertex arrays.
+// --------------------------------------------------------
+
+// Post-transform cache size the optimizer targets
+#define MESH_OPTIMIZER_CACHE_SIZE 16
+
+// Results of simulating a FIFO post-transform cache
+struct VertexCacheStats
+{
+	unsigned int TrianglesDrawn;
+	unsigned int VerticesTransformed;	// Cache misses
+	unsigned int VertexCount;			// Unique vertices referenced
+	float ACMR;							// Average Cache Miss Ratio (misses per triangle, 0.5 is ideal)
+	float ATVR;							// Average Transformed Vertex Ratio (misses per vertex, 1.0 is ideal)
+};
+
+/// <summary>
+/// Simulates a FIFO post-transform vertex cache over a triangle list
+/// </summary>
+/// <param name="indices">Triangle list indices</param>
+/// <param name="indexCount">Number of indices</param>
+/// <param name="cacheSize">Number of entries in the simulated cache</param>
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, unsigned int indexCount,
+	unsigned int cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+/// <summary>
+/// Reorders triangles for post-transform cache locality with Tipsify
+/// </summary>
+/// <param name="indices">Triangle list indices, reordered in place</param>
+/// <param name="indexCount">Number of indices</param>
+/// <param name="vertexCount">Number of vertices the indices can reference</param>
+/// <param name="clusters">Receives the first triangle of each cluster (Tipsify's dead-end jumps)</param>
+/// <param name="cacheSize">Cache size to optimize for</param>
+void OptimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+	std::vector<unsigned int>& clusters, unsigned int cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+/// <summary>
+/// Splits cache optimized clusters further wherever that barely costs cache efficiency,
+/// then sorts the clusters so that outward facing ones are drawn first
+/// </summary>
+/// <param name="vertices">Vertices the indices reference</param>
+/// <param name="indices">Triangle list indices, reordered in place</param>
+/// <param name="indexCount">Number of indices</param>
+/// <param name="clusters">Cluster starts from OptimizeVertexCache()</param>
+/// <param name="threshold">How much worse than the original ACMR a cluster may get (1.05 = 5%)</param>
+/// <param name="cacheSize">Cache size that was optimized for</param>
+void OptimizeOverdraw(const Vertex* vertices, unsigned int* indices, unsigned int indexCount,
+	const std::vector<unsigned int>& clusters, float threshold = 1.05f,
+	unsigned int cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
+
+/// <summary>
+/// Renumbers vertices in the order the indices first use them (unused vertices go last)
+/// </summary>
+/// <param name="vertices">Vertices, reordered in place</param>
+/// <param name="vertexCount">Number of vertices</param>
+/// <param name="indices">Triangle list indices, remapped in place</param>
+/// <param name="indexCount">Number of indices</param>
+void OptimizeVertexFetch(Vertex* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount);
+
+/// <summary>
+/// Runs every optimization above on each submesh range
+/// </summary>
+/// <param name="vertices">The mesh's vertices</param>
+/// <param name="indices">The mesh's indices (relative to each range's BaseVertex)</param>
+/// <param name="ranges">The mesh's submesh ranges</param>
+/// <param name="before">Receives the cache stats before optimizing</param>
+/// <param name="after">Receives the cache stats after optimizing</param>
+void OptimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+	const std::vector<MeshSubmeshRange>& ranges, VertexCacheStats& before, VertexCacheStats& after);
@@ -0,0 +1,325 @@
+#include "Meshlets.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+	// Calculates the bounding sphere and normal cone of a meshlet's triangles
+	void CalculateMeshletBounds(const Vertex* vertices, const unsigned int* indices, bool closed, Meshlet& meshlet)
+	{
+		// Bounding sphere around the center of the AABB
+		XMVECTOR minV = XMVectorReplicate(FLT_MAX);
+		XMVECTOR maxV = XMVectorReplicate(-FLT_MAX);
+		for (unsigned int i = 0; i < meshlet.TriangleCount * 3; i++)
+		{
+			XMVECTOR p = XMLoadFloat3(&vertices[indices[meshlet.StartIndex + i]].Position);
+			minV = XMVectorMin(minV, p);
+			maxV = XMVectorMax(maxV, p);
+		}
+		XMVECTOR center = (minV + maxV) * 0.5f;
+		float radiusSq = 0.0f;
+		for (unsigned int i = 0; i < meshlet.TriangleCount * 3; i++)
+		{
+			XMVECTOR p = XMLoadFloat3(&vertices[indices[meshlet.StartIndex + i]].Position);
+			radiusSq = std::max(radiusSq, XMVectorGetX(XMVector3LengthSq(p - center)));
+		}
+		XMStoreFloat3(&meshlet.Center, center);
+		meshlet.Radius = sqrtf(radiusSq);
+
+		// Normal cone: average face normal, and how far the faces stray from it.
+		// Front faces are clockwise, so these normals point out of the front face.
+		std::vector<XMFLOAT3> normals(meshlet.TriangleCount);
+		XMVECTOR axis = XMVectorZero();
+		for (unsigned int t = 0; t < meshlet.TriangleCount; t++)
+		{
+			const unsigned int* tri = indices + meshlet.StartIndex + t * 3;
+			XMVECTOR p0 = XMLoadFloat3(&vertices[tri[0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[tri[1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[tri[2]].Position);
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+			if (XMVectorGetX(XMVector3LengthSq(n)) > 0.0f) { n = XMVector3Normalize(n); }
+			XMStoreFloat3(&normals[t], n);
+			axis += n;
+		}
+		axis = XMVector3Normalize(axis);
+		XMStoreFloat3(&meshlet.ConeAxis, axis);
+		meshlet.ConeApex = meshlet.Center;
+		meshlet.ConeCutoff = 1.0f;
+
+		if (!closed) { return; }
+		float minDot = 1.0f;
+		for (const XMFLOAT3& n : normals) { minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(XMLoadFloat3(&n), axis))); }
+		if (minDot <= 0.1f) { return; } // Too wide (or degenerate) to ever be entirely backfacing
+
+		// Move the apex back along the axis until it's behind every triangle's plane
+		float maxT = 0.0f;
+		for (unsigned int t = 0; t < meshlet.TriangleCount; t++)
+		{
+			XMVECTOR n = XMLoadFloat3(&normals[t]);
+			XMVECTOR p0 = XMLoadFloat3(&vertices[indices[meshlet.StartIndex + t * 3]].Position);
+			float distance = XMVectorGetX(XMVector3Dot(center - p0, n));
+			float alignment = XMVectorGetX(XMVector3Dot(axis, n));
+			maxT = std::max(maxT, distance / alignment);
+		}
+		XMStoreFloat3(&meshlet.ConeApex, center - axis * maxT);
+		meshlet.ConeCutoff = sqrtf(1.0f - minDot * minDot);
+	}
+
+	// Whether every edge of a range is shared by a triangle facing the other way, so its back faces
+	// can never be seen from outside. The opaque pass doesn't cull back faces, so cones are only
+	// used on closed ranges. Positions are welded first, since UV seams split vertices.
+	bool IsClosed(const Vertex* vertices, const unsigned int* indices, unsigned int start, unsigned int end)
+	{
+		std::unordered_map<unsigned long long, unsigned int> welded;
+		std::unordered_map<unsigned long long, int> edges;
+		std::vector<unsigned int> corners(end - start);
+		for (unsigned int i = start; i < end; i++)
+		{
+			const XMFLOAT3& p = vertices[indices[i]].Position;
+			unsigned int bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			unsigned long long key = ((unsigned long long)bits[0] * 73856093ull) ^ ((unsigned long long)bits[1] << 21) ^
+				((unsigned long long)bits[2] << 42) ^ bits[2];
+			// Hash collisions only make a mesh look less closed, never more
+			corners[i - start] = welded.emplace(key, (unsigned int)welded.size()).first->second;
+		}
+		for (unsigned int t = 0; t + 2 < (unsigned int)corners.size(); t += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = corners[t + k];
+				unsigned int b = corners[t + (k + 1) % 3];
+				if (a == b) { continue; }
+				unsigned long long key = a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+				edges[key] += a < b ? 1 : -1;
+			}
+		}
+		for (const auto& edge : edges)
+		{
+			if (edge.second != 0) { return false; }
+		}
+		return true;
+	}
+
+	// Counts the distinct vertices of a triangle that aren't in the given meshlet yet
+	unsigned int CountNewVertices(const std::vector<unsigned int>& vertexMeshlet, const unsigned int* tri, unsigned int id)
+	{
+		unsigned int a = tri[0], b = tri[1], c = tri[2];
+		return (vertexMeshlet[a] != id ? 1 : 0) +
+			(vertexMeshlet[b] != id && b != a ? 1 : 0) +
+			(vertexMeshlet[c] != id && c != a && c != b ? 1 : 0);
+	}
+
+	// Unit face normal of a triangle
+	XMVECTOR FaceNormal(const Vertex* vertices, const unsigned int* tri)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[tri[0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[tri[1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[tri[2]].Position);
+		XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+		return XMVectorGetX(XMVector3LengthSq(n)) > 0.0f ? XMVector3Normalize(n) : n;
+	}
+}
+
+void BuildMeshlets(const Vertex* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount,
+	const MeshSubmeshRange* ranges, unsigned int rangeCount, std::vector<Meshlet>& meshlets)
+{
+	meshlets.clear();
+
+	for (unsigned int r = 0; r < rangeCount; r++)
+	{
+		const MeshSubmeshRange& range = ranges[r];
+		const Vertex* rangeVertices = vertices + range.BaseVertex;
+		unsigned int rangeEnd = std::min(range.StartIndex + range.IndexCount - range.IndexCount % 3, indexCount);
+		rangeEnd = std::max(rangeEnd, range.StartIndex);
+
+		// Leave out malformed triangles (and everything after them)
+		unsigned int rangeVertexCount = 0;
+		for (unsigned int i = range.StartIndex; i < rangeEnd; i += 3)
+		{
+			unsigned int maxIndex = std::max(indices[i], std::max(indices[i + 1], indices[i + 2]));
+			if (range.BaseVertex + maxIndex >= vertexCount) { rangeEnd = i; }
+			else { rangeVertexCount = std::max(rangeVertexCount, maxIndex + 1); }
+		}
+		bool closed = IsClosed(rangeVertices, indices, range.StartIndex, rangeEnd);
+		unsigned int* rangeIndices = indices + range.StartIndex;
+		unsigned int triangleCount = (rangeEnd - range.StartIndex) / 3;
+
+		// Triangles using each vertex
+		std::vector<unsigned int> adjacencyStart(rangeVertexCount + 1, 0);
+		for (unsigned int i = 0; i < triangleCount * 3; i++) { adjacencyStart[rangeIndices[i] + 1]++; }
+		for (unsigned int v = 0; v < rangeVertexCount; v++) { adjacencyStart[v + 1] += adjacencyStart[v]; }
+		std::vector<unsigned int> adjacency(triangleCount * 3);
+		std::vector<unsigned int> adjacencyFill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (unsigned int i = 0; i < triangleCount * 3; i++) { adjacency[adjacencyFill[rangeIndices[i]]++] = i / 3; }
+
+		std::vector<XMFLOAT3> normals(triangleCount);
+		for (unsigned int t = 0; t < triangleCount; t++) { XMStoreFloat3(&normals[t], FaceNormal(rangeVertices, rangeIndices + t * 3)); }
+
+		// Grow each meshlet from the first unused triangle (in cache order), always adding the neighbour
+		// that brings the fewest new vertices, with ties going to the one facing most like the meshlet.
+		// Compact, flat-ish patches give tight spheres and narrow cones.
+		std::vector<unsigned int> vertexMeshlet(rangeVertexCount, 0xFFFFFFFF);
+		std::vector<bool> used(triangleCount, false);
+		std::vector<unsigned int> order;
+		order.reserve(triangleCount);
+		std::vector<unsigned int> candidates;
+		std::vector<unsigned int> candidateMeshlet(triangleCount, 0xFFFFFFFF);
+		unsigned int firstMeshlet = (unsigned int)meshlets.size();
+		unsigned int seed = 0;
+		while (order.size() < triangleCount)
+		{
+			while (used[seed]) { seed++; }
+
+			Meshlet current = {};
+			current.StartIndex = range.StartIndex + (unsigned int)order.size() * 3;
+			current.Submesh = r;
+			unsigned int id = (unsigned int)meshlets.size();
+			XMVECTOR normalSum = XMVectorZero();
+			candidates.clear();
+			candidates.push_back(seed);
+			candidateMeshlet[seed] = id;
+			while (current.TriangleCount < MESHLET_MAX_TRIANGLES)
+			{
+				// Pick the best candidate that still fits
+				unsigned int best = 0xFFFFFFFF;
+				float bestScore = FLT_MAX;
+				XMVECTOR axis = XMVector3Normalize(normalSum);
+				for (unsigned int c = 0; c < (unsigned int)candidates.size();)
+				{
+					unsigned int t = candidates[c];
+					if (used[t]) { candidates[c] = candidates.back(); candidates.pop_back(); continue; }
+					unsigned int newVertices = CountNewVertices(vertexMeshlet, rangeIndices + t * 3, id);
+					if (current.VertexCount + newVertices <= MESHLET_MAX_VERTICES)
+					{
+						float facing = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normals[t]), axis));
+						float score = newVertices + (1.0f - facing) * 0.5f;
+						if (score < bestScore) { bestScore = score; best = t; }
+					}
+					c++;
+				}
+				if (best == 0xFFFFFFFF) { break; }
+
+				// Add it, and make its neighbours candidates
+				const unsigned int* tri = rangeIndices + best * 3;
+				current.VertexCount += CountNewVertices(vertexMeshlet, tri, id);
+				current.TriangleCount++;
+				used[best] = true;
+				order.push_back(best);
+				normalSum += XMLoadFloat3(&normals[best]);
+				for (int k = 0; k < 3; k++)
+				{
+					vertexMeshlet[tri[k]] = id;
+					for (unsigned int a = adjacencyStart[tri[k]]; a < adjacencyStart[tri[k] + 1]; a++)
+					{
+						unsigned int neighbour = adjacency[a];
+						if (!used[neighbour] && candidateMeshlet[neighbour] != id)
+						{
+							candidateMeshlet[neighbour] = id;
+							candidates.push_back(neighbour);
+						}
+					}
+				}
+			}
+			meshlets.push_back(current);
+		}
+
+		// Rewrite the range in meshlet order
+		std::vector<unsigned int> reordered(triangleCount * 3);
+		for (unsigned int t = 0; t < triangleCount; t++)
+		{
+			for (int k = 0; k < 3; k++) { reordered[t * 3 + k] = rangeIndices[order[t] * 3 + k]; }
+		}
+		std::copy(reordered.begin(), reordered.end(), rangeIndices);
+
+		// Restore vertex cache order inside each meshlet (each one is small enough to stay cache friendly)
+		std::vector<unsigned int> clusters;
+		for (unsigned int m = firstMeshlet; m < (unsigned int)meshlets.size(); m++)
+		{
+			OptimizeVertexCache(indices + meshlets[m].StartIndex, meshlets[m].TriangleCount * 3, rangeVertexCount, clusters);
+			CalculateMeshletBounds(rangeVertices, indices, closed, meshlets[m]);
+		}
+	}
+}
+
+void ExtractFrustumPlanes(const XMFLOAT4X4& viewProj, XMFLOAT4 planes[6])
+{
+	// Row vectors: clip = v * M, so each plane is a combination of M's columns
+	const XMFLOAT4X4& m = viewProj;
+	XMVECTOR col0 = XMVectorSet(m._11, m._21, m._31, m._41);
+	XMVECTOR col1 = XMVectorSet(m._12, m._22, m._32, m._42);
+	XMVECTOR col2 = XMVectorSet(m._13, m._23, m._33, m._43);
+	XMVECTOR col3 = XMVectorSet(m._14, m._24, m._34, m._44);
+
+	XMVECTOR result[6] = {
+		col3 + col0,	// Left
+		col3 - col0,	// Right
+		col3 + col1,	// Bottom
+		col3 - col1,	// Top
+		col2,			// Near (D3D clip z starts at 0)
+		col3 - col2		// Far
+	};
+	for (int i = 0; i < 6; i++) { XMStoreFloat4(&planes[i], XMPlaneNormalize(result[i])); }
+}
+
+void CullMeshlets(const Meshlet* meshlets, unsigned int meshletCount, const XMFLOAT4X4& world,
+	const XMFLOAT4 planes[6], XMFLOAT3 cameraPosition,
+	std::vector<unsigned int>& visible, MeshletCullStats& stats)
+{
+	visible.clear();
+	XMMATRIX worldMat = XMLoadFloat4x4(&world);
+
+	// Spheres grow by the largest scale axis
+	float scaleX = XMVectorGetX(XMVector3Length(worldMat.r[0]));
+	float scaleY = XMVectorGetX(XMVector3Length(worldMat.r[1]));
+	float scaleZ = XMVectorGetX(XMVector3Length(worldMat.r[2]));
+	float maxScale = std::max(scaleX, std::max(scaleY, scaleZ));
+	float minScale = std::min(scaleX, std::min(scaleY, scaleZ));
+
+	// Cones are tested in object space, which only preserves their angles under uniform scale
+	bool coneCulling = maxScale > 0.0f && (maxScale - minScale) / maxScale < 0.01f;
+	XMVECTOR det;
+	XMVECTOR objectCamera = XMVector3TransformCoord(XMLoadFloat3(&cameraPosition), XMMatrixInverse(&det, worldMat));
+
+	for (unsigned int i = 0; i < meshletCount; i++)
+	{
+		const Meshlet& m = meshlets[i];
+		stats.MeshletsTested++;
+
+		// Frustum
+		XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&m.Center), worldMat);
+		float radius = m.Radius * maxScale;
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+		{
+			outside = XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&planes[p]), center)) < -radius;
+		}
+		if (outside)
+		{
+			stats.FrustumCulled++;
+			stats.TrianglesCulled += m.TriangleCount;
+			continue;
+		}
+
+		// Backfacing: the camera is behind every triangle when it's inside the negative cone
+		if (coneCulling && m.ConeCutoff < 1.0f)
+		{
+			XMVECTOR toApex = XMVector3Normalize(XMLoadFloat3(&m.ConeApex) - objectCamera);
+			if (XMVectorGetX(XMVector3Dot(toApex, XMLoadFloat3(&m.ConeAxis))) >= m.ConeCutoff)
+			{
+				stats.BackfaceCulled++;
+				stats.TrianglesCulled += m.TriangleCount;
+				continue;
+			}
+		}
+
+		stats.TrianglesSubmitted += m.TriangleCount;
+		visible.push_back(i);
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+struct MeshSubmeshRange;
+
+// --------------------------------------------------------
+// Meshlets: small clusters of consecutive triangles with
+// their own bounds, so parts of a mesh can be culled
+//
+// - Each meshlet is a contiguous range of the index buffer,
+//   grown from neighbouring triangles so it stays compact
+// - Bounding spheres are used for frustum culling
+// - Normal cones (Shirman & Abi-Ezzi) reject clusters whose
+//   triangles all face away from the camera. Only closed
+//   submeshes get cones, as open ones may show their back faces
+// --------------------------------------------------------
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+struct Meshlet
+{
+	unsigned int StartIndex;		// First index in the mesh's index buffer
+	unsigned int TriangleCount;
+	unsigned int VertexCount;		// Unique vertices referenced
+	unsigned int Submesh;			// Which MeshSubmeshRange this came from
+	DirectX::XMFLOAT3 Center;		// Object space bounding sphere
+	float Radius;
+	DirectX::XMFLOAT3 ConeApex;		// Object space normal cone
+	float ConeCutoff;				// 1 = cone is too wide to ever cull
+	DirectX::XMFLOAT3 ConeAxis;
+	float Padding;
+};
+
+// Per frame culling results
+struct MeshletCullStats
+{
+	unsigned int MeshletsTested;
+	unsigned int FrustumCulled;
+	unsigned int BackfaceCulled;
+	unsigned int TrianglesSubmitted;
+	unsigned int TrianglesCulled;
+};
+
+/// <summary>
+/// Splits each submesh range into meshlets of at most MESHLET_MAX_VERTICES
+/// vertices and MESHLET_MAX_TRIANGLES triangles, reordering the range's
+/// triangles so each meshlet is a contiguous, spatially compact patch
+/// </summary>
+/// <param name="vertices">The mesh's vertices</param>
+/// <param name="vertexCount">Number of vertices</param>
+/// <param name="indices">The mesh's indices (relative to each range's BaseVertex), reordered in place</param>
+/// <param name="indexCount">Number of indices</param>
+/// <param name="ranges">The mesh's submesh ranges</param>
+/// <param name="rangeCount">Number of submesh ranges</param>
+/// <param name="meshlets">Receives the meshlets</param>
+void BuildMeshlets(const Vertex* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount,
+	const MeshSubmeshRange* ranges, unsigned int rangeCount, std::vector<Meshlet>& meshlets);
+
+/// <summary>
+/// Extracts the six (normalized) clip planes of a view-projection matrix
+/// </summary>
+/// <param name="viewProj">Row-vector view * projection matrix</param>
+/// <param name="planes">Receives left, right, bottom, top, near, far planes (xyz = normal, w = distance)</param>
+void ExtractFrustumPlanes(const DirectX::XMFLOAT4X4& viewProj, DirectX::XMFLOAT4 planes[6]);
+
+/// <summary>
+/// Finds the meshlets that could be visible from a camera
+/// </summary>
+/// <param name="meshlets">The meshlets to test</param>
+/// <param name="meshletCount">Number of meshlets</param>
+/// <param name="world">The mesh's world matrix</param>
+/// <param name="planes">World space frustum planes from ExtractFrustumPlanes()</param>
+/// <param name="cameraPosition">World space camera position</param>
+/// <param name="visible">Receives the indices (into meshlets) of meshlets that survived</param>
+/// <param name="stats">Culling counts are added to this</param>
+void CullMeshlets(const Meshlet* meshlets, unsigned int meshletCount, const DirectX::XMFLOAT4X4& world,
+	const DirectX::XMFLOAT4 planes[6], DirectX::XMFLOAT3 cameraPosition,
+	std::vector<unsigned int>& visible, MeshletCullStats& stats);
@@ -0,0 +1,368 @@
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include <thread>
+#include <unordered_map>
+#include <assimp/fast_atof.h>
+
+using namespace DirectX;
+
+namespace
+{
+	// Files smaller than this are parsed on a single thread
+	const size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+	// Index of a missing uv/normal
+	const int OBJ_NONE = -1;
+
+	// One corner of a face. Values >= 0 are final 0-based indices.
+	// Negative (relative) OBJ indices can only be resolved once the
+	// earlier chunks have been counted, so they are stored as a
+	// biased chunk-local index (which may point into earlier chunks)
+	struct ObjCorner
+	{
+		int p;
+		int t;
+		int n;
+		bool operator==(const ObjCorner& other) const { return p == other.p && t == other.t && n == other.n; }
+	};
+	const int LOCAL_BIAS = 1 << 30;
+	inline int EncodeLocal(int localIndex) { return localIndex - LOCAL_BIAS; }
+	inline bool IsLocal(int index) { return index < -(LOCAL_BIAS / 2); }
+	inline int DecodeLocal(int index) { return index + LOCAL_BIAS; }
+
+	struct ObjCornerHash
+	{
+		size_t operator()(const ObjCorner& c) const
+		{
+			size_t h = (size_t)(unsigned int)c.p * 73856093u;
+			h ^= (size_t)(unsigned int)c.t * 19349663u;
+			h ^= (size_t)(unsigned int)c.n * 83492791u;
+			return h;
+		}
+	};
+
+	// Everything parsed out of one chunk of the file
+	struct ObjChunk
+	{
+		std::vector<XMFLOAT3> positions;
+		std::vector<XMFLOAT3> normals;
+		std::vector<XMFLOAT2> uvs;
+		std::vector<ObjCorner> corners; // Three per triangle, winding already flipped
+	};
+
+	inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+	inline const char* SkipSpaces(const char* c, const char* end)
+	{
+		while (c < end && IsSpace(*c)) { c++; }
+		return c;
+	}
+
+	inline const char* SkipLine(const char* c, const char* end)
+	{
+		while (c < end && *c != '\n') { c++; }
+		return c < end ? c + 1 : end;
+	}
+
+	inline bool IsNumberStart(char c) { return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.'; }
+
+	// Reads up to "count" floats from the rest of the line
+	inline const char* ReadFloats(const char* c, const char* end, float* out, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			c = SkipSpaces(c, end);
+			if (c >= end || !IsNumberStart(*c)) { out[i] = 0.0f; continue; }
+			c = Assimp::fast_atoreal_move<float>(c, out[i], false);
+		}
+		return c;
+	}
+
+	// Reads a (possibly negative) integer, returning false if there isn't one
+	inline bool ReadInt(const char*& c, const char* end, int& out)
+	{
+		bool negative = false;
+		if (c < end && *c == '-') { negative = true; c++; }
+		if (c >= end || *c < '0' || *c > '9') { return false; }
+		int value = 0;
+		while (c < end && *c >= '0' && *c <= '9') { value = value * 10 + (*c - '0'); c++; }
+		out = negative ? -value : value;
+		return true;
+	}
+
+	// Converts a 1-based (or negative, relative) OBJ index to our corner encoding
+	inline int ResolveIndex(int objIndex, size_t localCount)
+	{
+		if (objIndex > 0) { return objIndex - 1; }
+		if (objIndex < 0) { return EncodeLocal((int)localCount + objIndex); }
+		return OBJ_NONE;
+	}
+
+	// Parses the lines in [begin, end). The range must end right after a newline
+	// (or be null terminated) so the number parsers never run off the end.
+	void ParseChunk(const char* begin, const char* end, ObjChunk& chunk)
+	{
+		std::vector<ObjCorner> face;
+		const char* c = begin;
+		while (c < end)
+		{
+			c = SkipSpaces(c, end);
+			if (c >= end) { break; }
+
+			if (c[0] == 'v' && c + 1 < end && IsSpace(c[1]))
+			{
+				XMFLOAT3 pos;
+				c = ReadFloats(c + 2, end, &pos.x, 3);
+				chunk.positions.push_back(pos);
+			}
+			else if (c[0] == 'v' && c + 2 < end && c[1] == 't' && IsSpace(c[2]))
+			{
+				XMFLOAT2 uv;
+				c = ReadFloats(c + 3, end, &uv.x, 2);
+				chunk.uvs.push_back(uv);
+			}
+			else if (c[0] == 'v' && c + 2 < end && c[1] == 'n' && IsSpace(c[2]))
+			{
+				XMFLOAT3 norm;
+				c = ReadFloats(c + 3, end, &norm.x, 3);
+				chunk.normals.push_back(norm);
+			}
+			else if (c[0] == 'f' && c + 1 < end && IsSpace(c[1]))
+			{
+				// Read every corner on the line: p, p/t, p//n or p/t/n
+				face.clear();
+				c += 2;
+				while (true)
+				{
+					c = SkipSpaces(c, end);
+					int p = 0, t = 0, n = 0;
+					if (!ReadInt(c, end, p)) { break; }
+					if (c < end && *c == '/')
+					{
+						c++;
+						ReadInt(c, end, t);
+						if (c < end && *c == '/')
+						{
+							c++;
+							ReadInt(c, end, n);
+						}
+					}
+					ObjCorner corner = {};
+					corner.p = ResolveIndex(p, chunk.positions.size());
+					corner.t = ResolveIndex(t, chunk.uvs.size());
+					corner.n = ResolveIndex(n, chunk.normals.size());
+					face.push_back(corner);
+				}
+
+				// Triangulate as a fan, flipping the winding order (RH -> LH)
+				for (size_t i = 1; i + 1 < face.size(); i++)
+				{
+					chunk.corners.push_back(face[0]);
+					chunk.corners.push_back(face[i + 1]);
+					chunk.corners.push_back(face[i]);
+				}
+			}
+			c = SkipLine(c, end);
+		}
+	}
+
+	// Converts a chunk-local index to a global one, given the chunk's starting offset
+	inline int Globalize(int index, size_t offset)
+	{
+		return IsLocal(index) ? (int)offset + DecodeLocal(index) : index;
+	}
+}
+
+bool LoadObjFile(const std::string& filePath, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+	unsigned int maxThreads)
+{
+	MappedFile file;
+	if (!file.Open(filePath)) { return false; }
+	return ParseObj(file.GetData(), file.GetSize(), vertices, indices, maxThreads);
+}
+
+bool ParseObj(const char* data, size_t size, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+	unsigned int maxThreads)
+{
+	vertices.clear();
+	indices.clear();
+
+	// Split off a final line without a trailing newline, and parse it from
+	// a null terminated copy, so no parser ever reads past the mapped data
+	size_t bodySize = size;
+	while (bodySize > 0 && data[bodySize - 1] != '\n') { bodySize--; }
+	std::string lastLine(data + bodySize, size - bodySize);
+
+	// Decide how many chunks to split the body into
+	unsigned int threadCount = maxThreads > 0 ? maxThreads : std::thread::hardware_concurrency();
+	if (threadCount == 0) { threadCount = 1; }
+	size_t chunkCount = bodySize / MIN_CHUNK_SIZE;
+	if (chunkCount < 1) { chunkCount = 1; }
+	if (chunkCount > threadCount) { chunkCount = threadCount; }
+
+	// Chunk boundaries, each moved forward to just after a newline
+	std::vector<const char*> bounds(chunkCount + 1);
+	bounds[0] = data;
+	bounds[chunkCount] = data + bodySize;
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		const char* c = data + bodySize * i / chunkCount;
+		if (c < bounds[i - 1]) { c = bounds[i - 1]; }
+		bounds[i] = SkipLine(c, data + bodySize);
+	}
+
+	// Parse all chunks in parallel (the calling thread takes the first one).
+	// fast_atof throws on malformed numbers, which fails the whole load.
+	std::vector<ObjChunk> chunks(chunkCount + (lastLine.empty() ? 0 : 1));
+	std::vector<char> chunkFailed(chunks.size(), 0);
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < chunkCount; i++)
+	{
+		threads.push_back(std::thread([&bounds, &chunks, &chunkFailed, i]() {
+			try { ParseChunk(bounds[i], bounds[i + 1], chunks[i]); }
+			catch (...) { chunkFailed[i] = 1; }
+			}));
+	}
+	try
+	{
+		ParseChunk(bounds[0], bounds[1], chunks[0]);
+		if (!lastLine.empty())
+		{
+			lastLine += '\n';
+			ParseChunk(lastLine.c_str(), lastLine.c_str() + lastLine.size(), chunks.back());
+		}
+	}
+	catch (...) { chunkFailed[0] = 1; }
+	for (auto& t : threads) { t.join(); }
+	for (char failed : chunkFailed) { if (failed) { return false; } }
+
+	// Gather the attribute arrays, remembering where each chunk starts
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT2> uvs;
+	size_t cornerCount = 0;
+	std::vector<size_t> posOffset(chunks.size()), uvOffset(chunks.size()), normOffset(chunks.size());
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		posOffset[i] = positions.size();
+		uvOffset[i] = uvs.size();
+		normOffset[i] = normals.size();
+		positions.insert(positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+		uvs.insert(uvs.end(), chunks[i].uvs.begin(), chunks[i].uvs.end());
+		normals.insert(normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+		cornerCount += chunks[i].corners.size();
+	}
+	if (cornerCount == 0 || positions.empty()) { return false; }
+
+	// Merge identical corners into shared vertices
+	std::unordered_map<ObjCorner, unsigned int, ObjCornerHash> vertexLookup;
+	vertexLookup.reserve(cornerCount / 2);
+	std::vector<ObjCorner> uniqueCorners;
+	indices.reserve(cornerCount);
+	bool missingNormals = false;
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		const std::vector<ObjCorner>& corners = chunks[i].corners;
+		for (size_t c = 0; c < corners.size(); c += 3)
+		{
+			ObjCorner tri[3];
+			bool valid = true;
+			for (int k = 0; k < 3; k++)
+			{
+				tri[k].p = Globalize(corners[c + k].p, posOffset[i]);
+				tri[k].t = Globalize(corners[c + k].t, uvOffset[i]);
+				tri[k].n = Globalize(corners[c + k].n, normOffset[i]);
+
+				// Drop references to data that doesn't exist
+				if (tri[k].p < 0 || tri[k].p >= (int)positions.size()) { valid = false; }
+				if (tri[k].t >= (int)uvs.size() || tri[k].t < 0) { tri[k].t = OBJ_NONE; }
+				if (tri[k].n >= (int)normals.size() || tri[k].n < 0) { tri[k].n = OBJ_NONE; }
+			}
+			if (!valid) { continue; }
+
+			for (int k = 0; k < 3; k++)
+			{
+				auto result = vertexLookup.insert({ tri[k], (unsigned int)uniqueCorners.size() });
+				if (result.second)
+				{
+					uniqueCorners.push_back(tri[k]);
+					missingNormals |= tri[k].n == OBJ_NONE;
+				}
+				indices.push_back(result.first->second);
+			}
+		}
+	}
+	if (indices.empty()) { return false; }
+
+	// Build the final vertices, converting to left-handed space
+	vertices.resize(uniqueCorners.size());
+	for (size_t i = 0; i < uniqueCorners.size(); i++)
+	{
+		const ObjCorner& c = uniqueCorners[i];
+		Vertex& v = vertices[i];
+		v.Position = positions[c.p];
+		v.Position.z *= -1.0f;
+		v.UV = c.t == OBJ_NONE ? XMFLOAT2(0, 0) : uvs[c.t];
+		v.UV.y = 1.0f - v.UV.y;
+		v.Normal = c.n == OBJ_NONE ? XMFLOAT3(0, 0, 0) : normals[c.n];
+		v.Normal.z *= -1.0f;
+		v.Tangent = XMFLOAT3(0, 0, 0);
+	}
+
+	// Generate smooth normals for vertices that didn't have any, by
+	// accumulating area-weighted face normals per position
+	if (missingNormals)
+	{
+		std::vector<XMFLOAT3> positionNormals(positions.size(), XMFLOAT3(0, 0, 0));
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[indices[i + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[indices[i + 2]].Position);
+			XMVECTOR faceNormal = XMVector3Cross(p1 - p0, p2 - p0);
+			for (int k = 0; k < 3; k++)
+			{
+				XMFLOAT3& n = positionNormals[uniqueCorners[indices[i + k]].p];
+				XMStoreFloat3(&n, XMLoadFloat3(&n) + faceNormal);
+			}
+		}
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			if (uniqueCorners[i].n != OBJ_NONE) { continue; }
+			XMStoreFloat3(&vertices[i].Normal, XMVector3Normalize(XMLoadFloat3(&positionNormals[uniqueCorners[i].p])));
+		}
+	}
+
+	// Tangents: accumulate each triangle's U direction, then orthogonalize against the normal
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		Vertex& v0 = vertices[indices[i]];
+		Vertex& v1 = vertices[indices[i + 1]];
+		Vertex& v2 = vertices[indices[i + 2]];
+		XMVECTOR e1 = XMLoadFloat3(&v1.Position) - XMLoadFloat3(&v0.Position);
+		XMVECTOR e2 = XMLoadFloat3(&v2.Position) - XMLoadFloat3(&v0.Position);
+		float du1 = v1.UV.x - v0.UV.x, dv1 = v1.UV.y - v0.UV.y;
+		float du2 = v2.UV.x - v0.UV.x, dv2 = v2.UV.y - v0.UV.y;
+		float det = du1 * dv2 - du2 * dv1;
+		if (fabsf(det) < 1e-12f) { continue; }
+		XMVECTOR tangent = (e1 * dv2 - e2 * dv1) * (1.0f / det);
+		for (Vertex* v : { &v0, &v1, &v2 })
+		{
+			XMStoreFloat3(&v->Tangent, XMLoadFloat3(&v->Tangent) + tangent);
+		}
+	}
+	for (auto& v : vertices)
+	{
+		XMVECTOR n = XMLoadFloat3(&v.Normal);
+		XMVECTOR t = XMLoadFloat3(&v.Tangent);
+		t = t - n * XMVector3Dot(n, t);
+		if (XMVectorGetX(XMVector3LengthSq(t)) < 1e-12f)
+		{
+			// No usable UVs, so pick any vector perpendicular to the normal
+			t = XMVector3Cross(n, fabsf(v.Normal.y) < 0.99f ? XMVectorSet(0, 1, 0, 0) : XMVectorSet(1, 0, 0, 0));
+		}
+		XMStoreFloat3(&v.Tangent, XMVector3Normalize(t));
+	}
+
+	return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Fast .OBJ loading
+//
+// - The file is memory mapped and parsed in place
+// - Large files are split into line-aligned chunks that are
+//   parsed in parallel
+// - Identical position/uv/normal triples are merged into a
+//   single vertex, producing a real indexed mesh
+// - Polygons are triangulated as fans, missing normals are
+//   generated (smooth), and tangents are calculated
+// - Output is converted to DirectX's left-handed space
+//   (Z and winding flipped, V flipped), matching the assimp path
+// --------------------------------------------------------
+
+// Bump whenever the loader's output changes, so cached imports are rebuilt
+#define OBJ_LOADER_VERSION 1
+
+/// <summary>
+/// Loads an .obj file into indexed vertex data
+/// </summary>
+/// <param name="filePath">Path to the .obj file</param>
+/// <param name="vertices">Resulting unique vertices</param>
+/// <param name="indices">Resulting triangle list indices</param>
+/// <param name="maxThreads">Max threads to parse with, or 0 to use all hardware threads</param>
+/// <returns>True if the file was loaded and contains at least one triangle</returns>
+bool LoadObjFile(const std::string& filePath, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+	unsigned int maxThreads = 0);
+
+/// <summary>
+/// Parses .obj text that is already in memory (doesn't need to be null terminated)
+/// </summary>
+/// <param name="data">Start of the .obj text</param>
+/// <param name="size">Size of the text in bytes</param>
+/// <param name="vertices">Resulting unique vertices</param>
+/// <param name="indices">Resulting triangle list indices</param>
+/// <param name="maxThreads">Max threads to parse with, or 0 to use all hardware threads</param>
+/// <returns>True if the text contains at least one valid triangle</returns>
+bool ParseObj(const char* data, size_t size, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices,
+	unsigned int maxThreads = 0);
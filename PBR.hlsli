@@ -1,10 +1,11 @@
 #ifndef __GGP_LIGHTING__
 #define __GGP_LIGHTING__
 
+#include "ShadowMoments.hlsli"
+
 #define LIGHT_TYPE_DIR   0
 #define LIGHT_TYPE_POINT 1
 #define LIGHT_TYPE_SPOT  2
-#define MAX_NUM_LIGHTS 10
 
 struct Light
 {
@@ -15,9 +16,40 @@ struct Light
     float Intensity;
     float3 Color;
     float SpotFalloff;
-    float3 Padding;
+    float Fov;
+    float2 Padding;
+};
+
+// How lights are stored in the Lights buffer (see PackedLight in LightSet.h): half precision color,
+// intensity, direction and falloff. Type isn't stored; the buffer holds directional lights, then
+// point lights, then spot lights.
+struct PackedLight
+{
+    float3 Position;
+    float Range;
+    uint2 ColorIntensity;
+    uint2 DirectionFalloff;
 };
 
+Light UnpackLight(PackedLight packed, int type)
+{
+    float4 colorIntensity = f16tofloat(uint4(packed.ColorIntensity.x, packed.ColorIntensity.x >> 16,
+        packed.ColorIntensity.y, packed.ColorIntensity.y >> 16));
+    float4 directionFalloff = f16tofloat(uint4(packed.DirectionFalloff.x, packed.DirectionFalloff.x >> 16,
+        packed.DirectionFalloff.y, packed.DirectionFalloff.y >> 16));
+    Light light;
+    light.Type = type;
+    light.Direction = directionFalloff.xyz;
+    light.Range = packed.Range;
+    light.Position = packed.Position;
+    light.Intensity = colorIntensity.w;
+    light.Color = colorIntensity.rgb;
+    light.SpotFalloff = directionFalloff.w;
+    light.Fov = 0.0f;
+    light.Padding = float2(0.0f, 0.0f);
+    return light;
+}
+
 // Bools are different sizes in HLSL and C++, so it could be good to use ints instead
 // They are okay in this situation where the size of data doesn't matter
 // But in a struct it could cause problems 
@@ -25,32 +57,63 @@ cbuffer lightTexData : register(b0)
 {
     float4 colorTint;
     float roughness;
-    Light lights[MAX_NUM_LIGHTS];
-    int numLights;
+    int directionalLightCount;  // The first lights in Lights
     float3 cameraPosition;
     float2 uvOffset;
     float2 uvScale;
     bool hasMask;
-    bool hasMetalMap;
+    bool hasPackedMap;
+    bool hasOcclusionMap;       // Maps left out of PackedMap, a different size to the rest (see TextureLoader::LoadPacked())
     bool hasRoughMap;
+    bool hasMetalMap;
+    bool hasOpacityMap;
     bool hasNormalMap;
     bool hasEnvironmentMap;
     bool hasShadowMap;
-    bool hasOpacityMap;
     float transparency;
+    float4 irradianceSH[9];     // Irradiance / PI from the sky, basis constants folded in (see GetIrradianceSH())
+    float3 environmentTint;
+    float specularMipCount;
+    float4 clusterViewZ;        // View space depth = dot(float4(worldPosition, 1), clusterViewZ)
+    float2 clusterScale;        // Clusters per pixel
+    float clusterDepthScale;    // Slice = log(view depth) * scale + bias (see LightClusters)
+    float clusterDepthBias;
+    uint3 clusterCount;
+    int entityLightCount;       // Lights picked for this entity on the CPU (see LightAssignment), or -1 to use the clusters
+    uint spotLightOffset;       // Index of the first spot light in Lights
+    uint4 entityLights[2];      // Into Lights, packed four to a register
+    matrix shadowViewProjection[11]; // World to each shadow map: the directional light's cascades (0-3), a spot light's (4), then a point light's faces (5-10)
+    float4 shadowAtlasRects[11]; // Each shadow map's tile in ShadowAtlas: uv offset (xy) and scale (zw), 0 scale if it has none
+    float4 cascadeSplits;       // View depth each cascade ends at (see ShadowCascades)
+    int cascadeCount;
+    float shadowAtlasTexelSize; // 1 / atlas resolution
+    int shadowedPointLight;     // Index in Lights of the point light with the face shadow maps, or -1
+    int shadowFilter;           // 1 to read filtered moments from ShadowMoments, 0 to compare depth in ShadowAtlas
+    float4 shadowDepthParams[11]; // Each shadow map's depth linearization (see LinearizeShadowDepth())
+    float4 shadowMomentParams;  // Exponents, smallest deviation and light bleed reduction (see MomentShadow())
+    float shadowMomentTexelSize; // 1 / moment atlas resolution
+    float shadowMomentMipCount;
 }
 
 // Textures
 Texture2D Albedo : register(t0);
-Texture2D RoughnessMap : register(t1);
-Texture2D MetalnessMap : register(t2);
+Texture2D PackedMap : register(t1); // Occlusion, roughness, metalness, opacity
+Texture2D OcclusionMap : register(t2); // Single channel maps that didn't fit in PackedMap
+Texture2D RoughnessMap : register(t12);
+Texture2D MetalnessMap : register(t13);
+Texture2D OpacityMap : register(t14);
 Texture2D NormalMap : register(t3);
 Texture2D TextureMask : register(t4);
-TextureCube EnvironmentMap : register(t5);
-Texture2D ShadowMap : register(t6);
-Texture2D OpacityMap : register(t7);
+TextureCube SpecularMap : register(t5); // The sky, GGX prefiltered: mip = roughness * (specularMipCount - 1)
+Texture2D ShadowAtlas : register(t6); // Every shadow map, a tile each (see ShadowAtlas)
+Texture2D ShadowMoments : register(t11); // The same tiles at half resolution, filtered and mipmapped (see ShadowMomentFilter)
+Texture2D BRDFLookup : register(t7); // Split sum scale and bias over (n dot v, roughness)
+StructuredBuffer<PackedLight> Lights : register(t8); // Scene lights by type, uploaded when they change
+StructuredBuffer<uint2> ClusterRanges : register(t9); // Offset and count of each cluster's lights in ClusterLightIndices
+StructuredBuffer<uint> ClusterLightIndices : register(t10); // Into Lights in ascending order, binned on the CPU every frame
 SamplerState Sampler : register(s0);
 SamplerComparisonState ShadowSampler : register(s1);
+SamplerState ShadowMomentSampler : register(s2);
 
 // Constants
 static const float F0_NON_METAL = 0.04f;
@@ -231,7 +294,10 @@ float3 SpotLight(float3 worldPosition, float3 normal, Light light, float3 surfac
 // Assuming normal and tangent are already normalized
 float3 normalMapCalc(float2 uv, float3 normal, float3 tangent)
 {
-    float3 unpackedNormal = NormalMap.Sample(Sampler, uv).rgb * 2.0f - 1.0f;
+    // Only x and y are stored (BC5 when cooked), z is rebuilt
+    float3 unpackedNormal;
+    unpackedNormal.xy = NormalMap.Sample(Sampler, uv).rg * 2.0f - 1.0f;
+    unpackedNormal.z = sqrt(saturate(1.0f - dot(unpackedNormal.xy, unpackedNormal.xy)));
     float3 N = normal;
     float3 T = normalize(tangent - N * dot(tangent, N));
     float3 B = cross(T, N);
@@ -239,108 +305,235 @@ float3 normalMapCalc(float2 uv, float3 normal, float3 tangent)
     return normalize(mul(unpackedNormal, TBN));
 }
 
-// When getting spotlight calculations outside of totalLight
-float4 SpotLight(float3 normal, Light light, float3 viewVector, float3 worldPosition, float2 uv, float3 tangent)
+// Everything the lighting needs from a material's textures at one pixel
+struct Surface
 {
-    // Alpha-Clipping
-    float alpha = hasOpacityMap ? OpacityMap.Sample(Sampler, uv).r : 1.0f;
-    alpha *= transparency; // Material's transparency value
-    clip(alpha - 0.1f);
-    // Texturing
-    uv = uv * uvScale + uvOffset;
-    float3 surfaceColor = pow(Albedo.Sample(Sampler, uv).rgb, 2.2f);
-    surfaceColor = hasMask ? (surfaceColor * TextureMask.Sample(Sampler, uv).rgb) : surfaceColor;
-    normal = hasNormalMap ? normalMapCalc(uv, normal, tangent) : normal;
-    float roughness = hasRoughMap ? RoughnessMap.Sample(Sampler, uv).r : 0.2f;
-    float metalness = hasMetalMap ? MetalnessMap.Sample(Sampler, uv).r : 0.0f;
-    // Specular color determination
-    float3 specularColor = lerp(F0_NON_METAL, surfaceColor.rgb, metalness);
-    // Lighting
-    float3 toLight = normalize(light.Position - worldPosition);
-    float diffuse = Lambert(normal, toLight);
-    float3 fresnelResult;
-    float3 specular = MicrofacetBRDF(normal, toLight, viewVector, roughness, specularColor, fresnelResult);
-    // Calculate diffuse with energy conservation, including diffuse for metals
-    float3 balancedDiff = DiffuseEnergyConserve(diffuse, specular, metalness);
-    // Combine the final diffuse and specular values for this light
-    float3 finalColor = (balancedDiff * surfaceColor + specular) * light.Color * (light.Intensity * Attenuate(light, worldPosition) * ConeAttenuate(toLight, light));
-    return float4(finalColor, alpha);
-}
-
+    float3 color;       // Linear albedo
+    float3 normal;      // World space, normal map applied
+    float3 specularColor;
+    float roughness;
+    float metalness;
+    float occlusion;    // For ambient lighting
+    float alpha;
+};
 
-// assuming input values are normalized
-float4 totalLight(float3 normal, float3 worldPosition, float2 uv, float3 tangent, float4 shadowMapPos)
+// Samples the material once per pixel: albedo, the packed occlusion/roughness/metalness/opacity
+// map (plus any maps left out of it) and the normal map (plus the mask, if any). Clips pixels
+// below the alpha cutoff.
+Surface SampleSurface(float3 normal, float2 uv, float3 tangent)
 {
+    Surface surface;
+    uv = uv * uvScale + uvOffset;
+    float4 orm = hasPackedMap ? PackedMap.Sample(Sampler, uv) : float4(1.0f, 0.2f, 0.0f, 1.0f);
+    orm.r = hasOcclusionMap ? OcclusionMap.Sample(Sampler, uv).r : orm.r;
+    orm.g = hasRoughMap ? RoughnessMap.Sample(Sampler, uv).r : orm.g;
+    orm.b = hasMetalMap ? MetalnessMap.Sample(Sampler, uv).r : orm.b;
+    orm.a = hasOpacityMap ? OpacityMap.Sample(Sampler, uv).r : orm.a;
     // Alpha-Clipping
-    float alpha = hasOpacityMap ? OpacityMap.Sample(Sampler, uv).r : 1.0f;
-    alpha *= transparency; // Material's transparency value
-    clip(alpha - 0.1f);
+    surface.alpha = orm.a * transparency; // Material's transparency value
+    clip(surface.alpha - 0.1f);
     // Texturing
-    uv = uv * uvScale + uvOffset;
-    float3 surfaceColor = pow(Albedo.Sample(Sampler, uv).rgb, 2.2f);
-    surfaceColor = hasMask ? (surfaceColor * TextureMask.Sample(Sampler, uv).rgb) : surfaceColor;
-    normal = hasNormalMap ? normalMapCalc(uv, normal, tangent) : normal;
-    float roughness = hasRoughMap ? RoughnessMap.Sample(Sampler, uv).r : 0.2f;
-    float metalness = hasMetalMap ? MetalnessMap.Sample(Sampler, uv).r : 0.0f;
+    surface.color = pow(Albedo.Sample(Sampler, uv).rgb, 2.2f);
+    surface.color = hasMask ? (surface.color * TextureMask.Sample(Sampler, uv).rgb) : surface.color;
+    surface.normal = hasNormalMap ? normalMapCalc(uv, normal, tangent) : normal;
+    surface.occlusion = orm.r;
+    surface.roughness = orm.g;
+    surface.metalness = orm.b;
     // Specular color determination -----------------
     // Assume albedo texture is actually holding specular color where metalness == 1
     // Note the use of lerp here - metal is generally 0 or 1, but might be in between
     // because of linear texture sampling, so we lerp the specular color to match
-    float3 specularColor = lerp(F0_NON_METAL, surfaceColor.rgb, metalness);
+    surface.specularColor = lerp(F0_NON_METAL, surface.color, surface.metalness);
+    return surface;
+}
+
+// Irradiance / PI for a normal, from the sky's spherical harmonics
+float3 IrradianceSH(float3 n)
+{
+    float3 irradiance = irradianceSH[0].rgb
+        + irradianceSH[1].rgb * n.y
+        + irradianceSH[2].rgb * n.z
+        + irradianceSH[3].rgb * n.x
+        + irradianceSH[4].rgb * (n.x * n.y)
+        + irradianceSH[5].rgb * (n.y * n.z)
+        + irradianceSH[6].rgb * (3.0f * n.z * n.z - 1.0f)
+        + irradianceSH[7].rgb * (n.x * n.z)
+        + irradianceSH[8].rgb * (n.x * n.x - n.y * n.y);
+    return max(irradiance, 0.0f);
+}
+
+// Ambient light from the sky: SH irradiance for diffuse, and the prefiltered
+// specular map with the split sum BRDF lookup for reflections
+float3 EnvironmentLight(Surface surface, float3 viewVector)
+{
+    float NdotV = saturate(dot(surface.normal, viewVector));
+    // Keep the lookup off the edge texels
+    float2 lookupSize;
+    BRDFLookup.GetDimensions(lookupSize.x, lookupSize.y);
+    float2 lookupUV = (float2(NdotV, surface.roughness) * (lookupSize - 1.0f) + 0.5f) / lookupSize;
+    float2 brdf = BRDFLookup.SampleLevel(Sampler, lookupUV, 0).rg;
+    float3 reflectionVector = reflect(-viewVector, surface.normal);
+    float3 prefiltered = SpecularMap.SampleLevel(Sampler, reflectionVector, surface.roughness * (specularMipCount - 1.0f)).rgb;
+    float3 specular = prefiltered * (surface.specularColor * brdf.x + brdf.y);
+    // Whatever the specular doesn't reflect is left for diffuse, and metals have none
+    float3 diffuse = IrradianceSH(surface.normal) * surface.color * (1.0f - (surface.specularColor * brdf.x + brdf.y)) * (1.0f - surface.metalness);
+    return (diffuse + specular) * environmentTint * surface.occlusion;
+}
+
+// When getting spotlight calculations outside of totalLight
+float4 SpotLight(Surface surface, Light light, float3 viewVector, float3 worldPosition)
+{
+    float3 finalColor = SpotLight(worldPosition, surface.normal, light, surface.color, viewVector,
+        surface.roughness, surface.specularColor, surface.metalness);
+    return float4(finalColor, surface.alpha);
+}
+
+
+// The froxel a pixel is in: its screen tile and exponential depth slice, matching LightClusters::FindCluster()
+uint GetCluster(float2 screenPosition, float3 worldPosition)
+{
+    float viewDepth = dot(float4(worldPosition, 1.0f), clusterViewZ);
+    float slice = floor(log(max(viewDepth, 0.0001f)) * clusterDepthScale + clusterDepthBias);
+    uint3 cluster;
+    cluster.xy = min(uint2(screenPosition * clusterScale), clusterCount.xy - 1);
+    cluster.z = (uint)clamp(slice, 0.0f, (float)(clusterCount.z - 1));
+    return (cluster.z * clusterCount.y + cluster.y) * clusterCount.x + cluster.x;
+}
+
+// How far a pixel spans in the world, for picking shadow moment mips; needs uniform flow, so take it before any loop
+float ShadowFootprint(float3 worldPosition)
+{
+    return max(length(ddx(worldPosition)), length(ddy(worldPosition)));
+}
+
+// How lit a position is in one of the atlas' shadow maps: 1 outside it, or if it has no tile this frame
+// footprint is from ShadowFootprint(), and only used by the filtered mode
+float AtlasShadow(int shadow, float3 worldPosition, float footprint)
+{
+    float4 rect = shadowAtlasRects[shadow];
+    if (rect.z <= 0.0f)
+        return 1.0f;
+
+    // Perform the perspective divide (divide by W) ourselves
+    // Convert the normalized device coordinates to UVs for sampling
+    float4 shadowMapPos = mul(shadowViewProjection[shadow], float4(worldPosition, 1.0f));
+    float2 shadowUV = shadowMapPos.xy / shadowMapPos.w * 0.5f + 0.5f;
+    shadowUV.y = 1 - shadowUV.y; // Flip the Y
+    if (any(shadowUV != saturate(shadowUV)))
+        return 1.0f;
+    if (shadowFilter)
+    {
+        // Mip from how many moment texels the pixel spans, taking the map's scale at this depth and not the surface's slope
+        float texelsPerUnit = 0.5f * length(shadowViewProjection[shadow][0].xyz) / shadowMapPos.w * rect.z / shadowMomentTexelSize;
+        float mip = clamp(log2(max(footprint * texelsPerUnit, 1.0f)), 0.0f, shadowMomentMipCount - 1.0f);
+        // Half a texel of the coarser mip blended in keeps filtering inside the tile
+        float margin = 0.5f * shadowMomentTexelSize * exp2(ceil(mip));
+        float4 moments = ShadowMoments.SampleLevel(ShadowMomentSampler, rect.xy + clamp(shadowUV * rect.zw, margin, rect.zw - margin), mip);
+        // Linear depth, as the moments were warped from (w is view depth in a perspective map)
+        float4 depthParams = shadowDepthParams[shadow];
+        float depth = saturate(depthParams.y == 0.0f ? shadowMapPos.z : (shadowMapPos.w - depthParams.w) * depthParams.z);
+        return MomentShadow(moments, depth, shadowMomentParams);
+    }
+    // Into the tile, kept half a texel from its edges so filtering never reads the neighbours
+    shadowUV = rect.xy + clamp(shadowUV * rect.zw, 0.5f * shadowAtlasTexelSize, rect.zw - 0.5f * shadowAtlasTexelSize);
+    // Get a ratio of comparison results using SampleCmpLevelZero()
+    float distToLight = shadowMapPos.z / shadowMapPos.w;
+    return ShadowAtlas.SampleCmpLevelZero(ShadowSampler, shadowUV, distToLight).r;
+}
+
+// How lit a position is by the shadowed directional light: 1 outside every cascade
+float CascadedShadow(float3 worldPosition, float footprint)
+{
+    // Cascades are split by view depth, the same depth the light clusters use
+    float viewDepth = dot(float4(worldPosition, 1.0f), clusterViewZ);
+    int cascade = 0;
+    while (cascade < cascadeCount && viewDepth > cascadeSplits[cascade])
+        cascade++;
+    if (cascade >= cascadeCount)
+        return 1.0f;
+    return AtlasShadow(cascade, worldPosition, footprint);
+}
+
+// How lit a position is by the shadowed point light, from the cube face (+X, -X, +Y, -Y, +Z, -Z) its direction falls in
+float PointShadow(float3 worldPosition, float3 lightPosition, float footprint)
+{
+    float3 toPosition = worldPosition - lightPosition;
+    float3 axis = abs(toPosition);
+    int face;
+    if (axis.x >= axis.y && axis.x >= axis.z)
+        face = toPosition.x >= 0.0f ? 0 : 1;
+    else if (axis.y >= axis.z)
+        face = toPosition.y >= 0.0f ? 2 : 3;
+    else
+        face = toPosition.z >= 0.0f ? 4 : 5;
+    return AtlasShadow(5 + face, worldPosition, footprint);
+}
+
+// The light at a position of this entity's or this pixel's cluster's list
+uint GetListedLight(bool perEntity, uint position)
+{
+    return perEntity ? entityLights[position >> 2][position & 3] : ClusterLightIndices[position];
+}
+
+// assuming input values are normalized
+// screenPosition is SV_POSITION.xy, which picks the pixel's light cluster
+float4 totalLight(Surface surface, float3 worldPosition, float2 screenPosition)
+{
+    float3 normal = surface.normal;
+    float3 surfaceColor = surface.color;
+    float3 specularColor = surface.specularColor;
+    float roughness = surface.roughness;
+    float metalness = surface.metalness;
+    float alpha = surface.alpha;
     // Lighting
     float3 viewVector = normalize(cameraPosition - worldPosition);
     float3 totalLight = float3(0, 0, 0);
     float shadowAmount = 1.0f;
+    float shadowFootprint = ShadowFootprint(worldPosition);
     if (hasShadowMap)
     {
-        // Perform the perspective divide (divide by W) ourselves
-        // Convert the normalized device coordinates to UVs for sampling
-        float2 shadowUV = shadowMapPos.xy / shadowMapPos.w * 0.5f + 0.5f;
-        shadowUV.y = 1 - shadowUV.y; // Flip the Y
-        // Grab the distances we need: light-to-pixel and closest-surface
-        float distToLight = shadowMapPos.z / shadowMapPos.w;
-        // Get a ratio of comparison results using SampleCmpLevelZero()
-        shadowAmount = ShadowMap.SampleCmpLevelZero(ShadowSampler, shadowUV, distToLight).r; 
+        shadowAmount = CascadedShadow(worldPosition, shadowFootprint);
+    }
+    // Directional lights reach everything
+    for (int i = 0; i < directionalLightCount; i++)
+    {
+        float3 dirLight = DirectionalLight(normal, UnpackLight(Lights[i], LIGHT_TYPE_DIR), surfaceColor, viewVector, roughness, specularColor, metalness);
+        if (i == 0)
+        {
+            dirLight *= shadowAmount;
+        }
+        totalLight += dirLight;
     }
-    // Light Calculations
-    for (int i = 0; i < numLights; i++)
+    // Then only the point and spot lights reaching this entity, or this pixel's cluster
+    bool perEntity = entityLightCount >= 0;
+    uint2 lightRange = uint2(0, entityLightCount);
+    if (!perEntity)
+        lightRange = ClusterRanges[GetCluster(screenPosition, worldPosition)];
+    // Lists are in buffer order, so their point lights all come before their spot lights
+    uint j = 0;
+    for (; j < lightRange.y; j++)
     {
-        switch (lights[i].Type)
+        uint lightIndex = GetListedLight(perEntity, lightRange.x + j);
+        if (lightIndex >= spotLightOffset)
+            break;
+        Light light = UnpackLight(Lights[lightIndex], LIGHT_TYPE_POINT);
+        float3 pointLight = PointLight(worldPosition, normal, light, surfaceColor, viewVector, roughness, specularColor, metalness);
+        if (hasShadowMap && (int)lightIndex == shadowedPointLight)
         {
-            case LIGHT_TYPE_DIR:
-                float3 dirLight = DirectionalLight(normal, lights[i], surfaceColor, viewVector, roughness, specularColor, metalness);
-                if (i == 0)
-                {
-                    dirLight *= shadowAmount;
-                }
-                totalLight += dirLight;
-                break;
-            case LIGHT_TYPE_POINT:
-                totalLight += PointLight(worldPosition, normal, lights[i], surfaceColor, viewVector, roughness, specularColor, metalness);
-                break;
-            case LIGHT_TYPE_SPOT:
-                totalLight += SpotLight(worldPosition, normal, lights[i], surfaceColor, viewVector, roughness, specularColor, metalness);
-                break;
+            pointLight *= PointShadow(worldPosition, light.Position, shadowFootprint);
         }
+        totalLight += pointLight;
+    }
+    for (; j < lightRange.y; j++)
+    {
+        Light light = UnpackLight(Lights[GetListedLight(perEntity, lightRange.x + j)], LIGHT_TYPE_SPOT);
+        totalLight += SpotLight(worldPosition, normal, light, surfaceColor, viewVector, roughness, specularColor, metalness);
     }
     float3 finalColor = totalLight;
-    // EnvironmentMap Reflections
-    //if (hasEnvironmentMap)
-    //{
-    //    float3 reflectionVector = reflect(-viewVector, normal); // Need camera to pixel vector, so negate
-    //    float3 reflectionColor = EnvironmentMap.Sample(Sampler, reflectionVector).rgb;
-	//    // Interpolate between the surface color and reflection color using a Fresnel term
-    //    // Fresnel term - Schlick approx.
-    //    // 
-    //    // v - View vector
-    //    // h - Half vector
-    //    // f0 - Value when l = n
-    //    //
-    //    // F(v,h,f0) = f0 + (1-f0)(1 - (v dot h))^5
-    //     
-    //    float3 h = normalize(viewVector + normalize(-light.Direction));
-    //    finalColor = lerp(totalLight, reflectionColor, F_Schlick(viewVector, viewVector, F0_NON_METAL));
-    //}
+    if (hasEnvironmentMap)
+    {
+        finalColor += EnvironmentLight(surface, viewVector);
+    }
     return float4(finalColor, alpha);
 }
 
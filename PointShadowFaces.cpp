@@ -0,0 +1,71 @@
+#include "PointShadowFaces.h"
+#include <cmath>
+
+void FitPointShadowFaces(const float position[3], float range, float nearDist, ShadowCascade faces[POINT_SHADOW_FACES])
+{
+	// The usual cube map face directions and ups
+	const float forwards[POINT_SHADOW_FACES][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	const float ups[POINT_SHADOW_FACES][3] = { { 0, 1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 1, 0 } };
+	for (int f = 0; f < POINT_SHADOW_FACES; f++)
+	{
+		ShadowCascade& face = faces[f];
+		const float* forward = forwards[f];
+		const float* up = ups[f];
+		const float right[3] = { up[1] * forward[2] - up[2] * forward[1], up[2] * forward[0] - up[0] * forward[2], up[0] * forward[1] - up[1] * forward[0] };
+
+		// XMMatrixLookToLH from the light
+		const float* axes[3] = { right, up, forward };
+		for (int a = 0; a < 3; a++)
+		{
+			face.View[a] = axes[a][0];
+			face.View[4 + a] = axes[a][1];
+			face.View[8 + a] = axes[a][2];
+			face.View[12 + a] = -(axes[a][0] * position[0] + axes[a][1] * position[1] + axes[a][2] * position[2]);
+			face.View[a * 4 + 3] = 0.0f;
+		}
+		face.View[15] = 1.0f;
+
+		// XMMatrixPerspectiveFovLH with a 90 degree fov and square aspect
+		for (int m = 0; m < 16; m++) { face.Projection[m] = 0.0f; }
+		face.Projection[0] = 1.0f;
+		face.Projection[5] = 1.0f;
+		face.Projection[10] = range / (range - nearDist);
+		face.Projection[11] = 1.0f;
+		face.Projection[14] = -nearDist * range / (range - nearDist);
+
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++)
+			{
+				face.ViewProjection[r * 4 + c] = face.View[r * 4] * face.Projection[c] + face.View[r * 4 + 1] * face.Projection[4 + c] +
+					face.View[r * 4 + 2] * face.Projection[8 + c] + face.View[r * 4 + 3] * face.Projection[12 + c];
+			}
+		face.SplitNear = nearDist;
+		face.SplitFar = range;
+
+		// Sphere around the part of the face inside the light's range: halfway out, reaching the far corners
+		for (int a = 0; a < 3; a++) { face.Center[a] = position[a] + forward[a] * range * 0.5f; }
+		face.Radius = range * 0.83f;
+	}
+}
+
+unsigned int GetPointShadowFaceMask(const float position[3], float range, const float center[3], float radius)
+{
+	const float offset[3] = { center[0] - position[0], center[1] - position[1], center[2] - position[2] };
+	float reach = range + radius;
+	if (offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2] > reach * reach)
+		return 0;
+
+	// A face's four side planes lean 45 degrees, e.g. x >= |y| for +X, so the sphere
+	// is past one when it's more than radius * sqrt(2) (unnormalized) behind it
+	float slack = radius * 1.41421356f;
+	const float magnitude[3] = { fabsf(offset[0]), fabsf(offset[1]), fabsf(offset[2]) };
+	unsigned int mask = 0;
+	for (int f = 0; f < POINT_SHADOW_FACES; f++)
+	{
+		int axis = f / 2;
+		float along = (f & 1) ? -offset[axis] : offset[axis];
+		if (along - magnitude[(axis + 1) % 3] >= -slack && along - magnitude[(axis + 2) % 3] >= -slack)
+			mask |= 1u << f;
+	}
+	return mask;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "ShadowCascades.h"
+
+// Faces of a point light's shadow cube: +X, -X, +Y, -Y, +Z, -Z
+#define POINT_SHADOW_FACES 6
+
+// --------------------------------------------------------
+// Fits the six 90 degree shadow maps that cover everything
+// around a point light, and works out which of them an
+// object overlaps, so casters are drawn only into those
+//
+// Faces are ShadowCascades, so they share the rest of the
+// shadow path (atlas tiles, caching). Nothing here needs
+// D3D, so the culling can be checked on the CPU.
+// --------------------------------------------------------
+
+/// <summary>
+/// Fits one perspective shadow map per cube face
+/// </summary>
+/// <param name="position">Light's world position</param>
+/// <param name="range">Light's range, which is each face's far plane</param>
+/// <param name="nearDist">Each face's near plane</param>
+/// <param name="faces">Receives the faces in +X, -X, +Y, -Y, +Z, -Z order</param>
+void FitPointShadowFaces(const float position[3], float range, float nearDist, ShadowCascade faces[POINT_SHADOW_FACES]);
+/// <summary>
+/// Which faces a sphere overlaps, conservatively
+/// </summary>
+/// <param name="position">Light's world position</param>
+/// <param name="range">Light's range</param>
+/// <param name="center">Sphere's world center</param>
+/// <param name="radius">Sphere's radius</param>
+/// <returns>Bit i is set if the sphere reaches face i</returns>
+unsigned int GetPointShadowFaceMask(const float position[3], float range, const float center[3], float radius);
@@ -0,0 +1,311 @@
+#include "ResourceRegistry.h"
+#include "PathHelpers.h"
+#include "SkinnedModel.h"
+#include <chrono>
+#include <algorithm>
+
+// Shader variables for the maps a packed texture leaves out, by TexturePackedChannel (see PBR.hlsli)
+static const char* UNPACKED_CHANNEL_VARIABLES[TEXTURE_PACKED_CHANNEL_COUNT] = { "OcclusionMap", "RoughnessMap", "MetalnessMap", "OpacityMap" };
+
+// Collapses "." and ".." and unifies separators, so two spellings of a path share a key
+static std::wstring NormalizePath(const std::wstring& filePath)
+{
+	std::vector<std::wstring> parts;
+	size_t start = 0;
+	while (start <= filePath.size())
+	{
+		size_t end = filePath.find_first_of(L"/\\", start);
+		if (end == std::wstring::npos) { end = filePath.size(); }
+		std::wstring part = filePath.substr(start, end - start);
+		if (part == L".." && !parts.empty() && parts.back() != L".." && !parts.back().empty()) { parts.pop_back(); }
+		else if (part != L"." && (!part.empty() || parts.empty())) { parts.push_back(part); }
+		start = end + 1;
+	}
+
+	std::wstring normalized;
+	for (size_t i = 0; i < parts.size(); i++) { normalized += (i > 0 ? L"\\" : L"") + parts[i]; }
+	return normalized;
+}
+
+// Keeps the formats of one file apart
+static uint64_t GetMeshHashKey(uint64_t contentHash, SceneMeshType type)
+{
+	return (contentHash ^ (uint64_t)type) * 1099511628211ull;
+}
+
+static std::wstring GetMeshPathKey(const std::wstring& filePath, SceneMeshType type)
+{
+	return NormalizePath(filePath) + L"|" + std::to_wstring((int)type);
+}
+
+ResourceRegistry::ResourceRegistry(MeshLoader& _meshLoader, TextureLoader& _textureLoader, Animator& _animator,
+	std::shared_ptr<SimpleVertexShader> _vertShader,
+	std::shared_ptr<SimplePixelShader> _pixelShader,
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> _sampler) :
+	meshLoader(_meshLoader),
+	textureLoader(_textureLoader),
+	animator(_animator),
+	vertShader(_vertShader),
+	pixelShader(_pixelShader),
+	sampler(_sampler),
+	stats()
+{
+}
+
+bool ResourceRegistry::LoadManifest(const std::wstring& filePath)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	manifestPath = filePath;
+	bool loaded = LoadSceneManifest(filePath, manifest, stats.Compiled);
+	stats.ManifestTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	meshSlots.assign(manifest.Meshes.size(), -1);
+	textureSlots.assign(manifest.Textures.size(), -1);
+	materialSlots.assign(manifest.Materials.size(), -1);
+	stats.DeclaredMeshes = (unsigned int)manifest.Meshes.size();
+	stats.DeclaredTextures = (unsigned int)manifest.Textures.size();
+	stats.DeclaredMaterials = (unsigned int)manifest.Materials.size();
+	return loaded;
+}
+
+void ResourceRegistry::Instantiate(unsigned int entityIndex, std::vector<Entity>& entities)
+{
+	const SceneEntity& sceneEntity = manifest.Entities[entityIndex];
+	int slot = GetMesh(sceneEntity.Mesh);
+	std::shared_ptr<Material> material = GetMaterial(sceneEntity.Material);
+	if (manifest.Meshes[sceneEntity.Mesh].Type == SCENE_MESH_SKINNED)
+	{
+		// The model is shared, but every character needs its own pose
+		animatedMeshes.push_back(animator.CreateAnimatedMesh(skinnedModels[slot], meshLoader.GetPlaceholder()));
+		entities.push_back(Entity(animatedMeshes.back()->GetMesh(), material));
+		pendingCharacters.push_back({ animatedMeshes.back(), entities.back().GetTransform(), sceneEntity.FitSize });
+	}
+	else
+	{
+		entities.push_back(Entity(meshes[slot], material));
+	}
+
+	std::shared_ptr<Transform> transform = entities.back().GetTransform();
+	transform->SetPosition(sceneEntity.Position[0], sceneEntity.Position[1], sceneEntity.Position[2]);
+	transform->SetRotation(sceneEntity.Rotation[0], sceneEntity.Rotation[1], sceneEntity.Rotation[2]);
+	transform->SetScale(sceneEntity.Scale[0], sceneEntity.Scale[1], sceneEntity.Scale[2]);
+}
+
+std::shared_ptr<Mesh> ResourceRegistry::LoadMesh(const std::wstring& filePath, MeshVertexFormat vertexFormat)
+{
+	std::wstring key = GetMeshPathKey(filePath,
+		vertexFormat == MESH_VERTEX_QUANTIZED ? SCENE_MESH_QUANTIZED : SCENE_MESH_COMPACT);
+	auto found = meshesByPath.find(key);
+	if (found != meshesByPath.end())
+	{
+		stats.SharedMeshes++;
+		return meshes[found->second];
+	}
+
+	meshes.push_back(meshLoader.LoadAsync(filePath, vertexFormat));
+	meshesByPath[key] = (int)meshes.size() - 1;
+	stats.LoadedMeshes++;
+	return meshes.back();
+}
+
+void ResourceRegistry::Finish()
+{
+	textureLoader.Finish();
+	for (PendingBinding& binding : pendingBindings)
+	{
+		// Maps left out of a pack bind under their own names, and a pack with nothing in it doesn't bind at all
+		TextureViews& views = *textureViews[binding.Texture];
+		bool leftOut = false;
+		for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+		{
+			if (!views.Channels[c])
+				continue;
+			binding.Target->AddTextureSRV(UNPACKED_CHANNEL_VARIABLES[c], views.Channels[c]);
+			leftOut = true;
+		}
+		if (views.View || !leftOut) { binding.Target->AddTextureSRV(binding.ShaderVariable, views.View); }
+	}
+	pendingBindings.clear();
+}
+
+void ResourceRegistry::Update()
+{
+	for (size_t i = 0; i < pendingCharacters.size();)
+	{
+		PendingCharacter& pending = pendingCharacters[i];
+		std::shared_ptr<const SkinnedModel> model = pending.Character->GetModel();
+		if (!model->Loaded)
+		{
+			i++;
+			continue;
+		}
+
+		if (!model->Clips.empty()) { pending.Character->Play(0); }
+		if (pending.FitSize > 0.0f)
+		{
+			DirectX::XMFLOAT3 extent(model->BoundsMax.x - model->BoundsMin.x,
+				model->BoundsMax.y - model->BoundsMin.y, model->BoundsMax.z - model->BoundsMin.z);
+			float fit = pending.FitSize / std::max(std::max(extent.x, extent.y), std::max(extent.z, 0.001f));
+			pending.Target->SetScale(fit, fit, fit);
+		}
+		pendingCharacters.erase(pendingCharacters.begin() + i);
+	}
+}
+
+void ResourceRegistry::QueueAllTextures(TextureLoader& loader, std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>& views)
+{
+	// Sized up front, as the loader holds on to each view until Finish()
+	const size_t stride = 1 + TEXTURE_PACKED_CHANNEL_COUNT;
+	views.assign(manifest.Textures.size() * stride, nullptr);
+	for (size_t i = 0; i < manifest.Textures.size(); i++)
+	{
+		std::wstring filePaths[TEXTURE_PACKED_CHANNEL_COUNT];
+		ResolveTexturePaths(manifest.Textures[i], filePaths);
+		if (manifest.Textures[i].Packed) { loader.LoadPacked(filePaths, views[i * stride], std::addressof(views[i * stride + 1])); }
+		else { loader.Load(filePaths[0], views[i * stride]); }
+	}
+}
+
+std::shared_ptr<Material> ResourceRegistry::FindMaterial(const std::string& name)
+{
+	for (size_t i = 0; i < manifest.Materials.size(); i++)
+	{
+		if (manifest.Materials[i].Name == name && materialSlots[i] >= 0)
+			return materials[materialSlots[i]];
+	}
+	return nullptr;
+}
+
+// --------------------------------------------------------
+// Finds or loads a manifest mesh
+// Returns its index in meshes (skinnedModels if skinned)
+// --------------------------------------------------------
+int ResourceRegistry::GetMesh(unsigned int index)
+{
+	if (meshSlots[index] >= 0)
+		return meshSlots[index];
+
+	const SceneMesh& sceneMesh = manifest.Meshes[index];
+	std::wstring filePath = ResolveScenePath(manifestPath, sceneMesh.FilePath);
+	std::wstring pathKey = GetMeshPathKey(filePath, sceneMesh.Type);
+	uint64_t hashKey = GetMeshHashKey(sceneMesh.ContentHash, sceneMesh.Type);
+
+	int slot = -1;
+	auto byPath = meshesByPath.find(pathKey);
+	auto byHash = sceneMesh.ContentHash != 0 ? meshesByHash.find(hashKey) : meshesByHash.end();
+	if (byHash != meshesByHash.end()) { slot = byHash->second; }
+	else if (byPath != meshesByPath.end()) { slot = byPath->second; }
+
+	if (slot >= 0)
+	{
+		stats.SharedMeshes++;
+	}
+	else if (sceneMesh.Type == SCENE_MESH_SKINNED)
+	{
+		skinnedModels.push_back(meshLoader.LoadSkinnedAsync(filePath));
+		slot = (int)skinnedModels.size() - 1;
+		stats.LoadedMeshes++;
+	}
+	else
+	{
+		meshes.push_back(meshLoader.LoadAsync(filePath,
+			sceneMesh.Type == SCENE_MESH_QUANTIZED ? MESH_VERTEX_QUANTIZED : MESH_VERTEX_COMPACT));
+		slot = (int)meshes.size() - 1;
+		stats.LoadedMeshes++;
+	}
+
+	meshesByPath[pathKey] = slot;
+	if (sceneMesh.ContentHash != 0) { meshesByHash[hashKey] = slot; }
+	meshSlots[index] = slot;
+	return slot;
+}
+
+// --------------------------------------------------------
+// Finds or queues a manifest texture
+// Returns its index in textureViews
+// --------------------------------------------------------
+int ResourceRegistry::GetTexture(unsigned int index)
+{
+	if (textureSlots[index] >= 0)
+		return textureSlots[index];
+
+	const SceneTexture& sceneTexture = manifest.Textures[index];
+	std::wstring filePaths[TEXTURE_PACKED_CHANNEL_COUNT];
+	ResolveTexturePaths(sceneTexture, filePaths);
+	std::wstring pathKey = sceneTexture.Packed ? L"packed" : L"";
+	for (int c = 0; c < (sceneTexture.Packed ? TEXTURE_PACKED_CHANNEL_COUNT : 1); c++) { pathKey += L"|" + NormalizePath(filePaths[c]); }
+
+	// The loader picks a format from the file name, so the same bytes under another kind of name are another texture
+	uint64_t hashKey = sceneTexture.ContentHash;
+	if (!sceneTexture.Packed)
+	{
+		TextureContent content;
+		TextureCompression compression;
+		GetTextureCookSettings(WideToNarrow(filePaths[0]), content, compression);
+		hashKey = (hashKey ^ ((uint64_t)content << 8 | (uint64_t)compression)) * 1099511628211ull;
+	}
+
+	int slot = -1;
+	auto byPath = texturesByPath.find(pathKey);
+	auto byHash = sceneTexture.ContentHash != 0 ? texturesByHash.find(hashKey) : texturesByHash.end();
+	if (byHash != texturesByHash.end()) { slot = byHash->second; }
+	else if (byPath != texturesByPath.end()) { slot = byPath->second; }
+
+	if (slot >= 0)
+	{
+		stats.SharedTextures++;
+	}
+	else
+	{
+		textureViews.push_back(std::make_unique<TextureViews>());
+		if (sceneTexture.Packed) { textureLoader.LoadPacked(filePaths, textureViews.back()->View, textureViews.back()->Channels); }
+		else { textureLoader.Load(filePaths[0], textureViews.back()->View); }
+		slot = (int)textureViews.size() - 1;
+		stats.LoadedTextures++;
+	}
+
+	texturesByPath[pathKey] = slot;
+	if (sceneTexture.ContentHash != 0) { texturesByHash[hashKey] = slot; }
+	textureSlots[index] = slot;
+	return slot;
+}
+
+// --------------------------------------------------------
+// Gets the files a manifest texture loads from (empty for
+// packed channels that use their default)
+// --------------------------------------------------------
+void ResourceRegistry::ResolveTexturePaths(const SceneTexture& sceneTexture, std::wstring filePaths[TEXTURE_PACKED_CHANNEL_COUNT])
+{
+	for (int c = 0; c < (sceneTexture.Packed ? TEXTURE_PACKED_CHANNEL_COUNT : 1); c++)
+	{
+		if (!sceneTexture.FilePaths[c].empty()) { filePaths[c] = ResolveScenePath(manifestPath, sceneTexture.FilePaths[c]); }
+	}
+}
+
+// --------------------------------------------------------
+// Finds or creates a manifest material, queuing its textures
+// --------------------------------------------------------
+std::shared_ptr<Material> ResourceRegistry::GetMaterial(unsigned int index)
+{
+	if (materialSlots[index] >= 0)
+		return materials[materialSlots[index]];
+
+	const SceneMaterial& sceneMaterial = manifest.Materials[index];
+	std::shared_ptr<Material> material = std::make_shared<Material>(
+		DirectX::XMFLOAT4(sceneMaterial.Color[0], sceneMaterial.Color[1], sceneMaterial.Color[2], sceneMaterial.Color[3]),
+		sceneMaterial.Roughness, vertShader, pixelShader);
+	material->AddSampler("Sampler", sampler);
+	material->SetTransparency(sceneMaterial.Transparency);
+	material->SetUVScale(DirectX::XMFLOAT2(sceneMaterial.UVScale[0], sceneMaterial.UVScale[1]));
+
+	// Views are only filled in once the loader finishes
+	for (const SceneMaterialTexture& texture : sceneMaterial.Textures)
+	{
+		pendingBindings.push_back({ material, texture.ShaderVariable, (unsigned int)GetTexture(texture.Texture) });
+	}
+
+	materials.push_back(material);
+	materialSlots[index] = (int)materials.size() - 1;
+	stats.LoadedMaterials++;
+	return material;
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "SceneManifest.h"
+#include "MeshLoader.h"
+#include "TextureLoader.h"
+#include "Animator.h"
+#include "Material.h"
+#include "Entity.h"
+
+// --------------------------------------------------------
+// Turns a SceneManifest into meshes, textures, materials
+// and entities, loading each only when an entity first
+// needs it
+//
+// Files are shared by the content hash the manifest was
+// compiled with, so two paths to the same bytes load once,
+// and by path for anything loaded outside the manifest (or
+// files the hash couldn't be read for). Meshes, rigged
+// models and textures still load on MeshLoader's and
+// TextureLoader's threads; Finish() waits for the textures
+// and binds them to the materials that were created since
+// the last call, and Update() starts characters whose
+// model has come in.
+// --------------------------------------------------------
+
+// What a manifest declared versus what its instantiated entities needed
+struct ResourceRegistryStats
+{
+	unsigned int DeclaredMeshes;
+	unsigned int DeclaredTextures;
+	unsigned int DeclaredMaterials;
+	unsigned int LoadedMeshes;			// Distinct meshes and skinned models
+	unsigned int LoadedTextures;
+	unsigned int LoadedMaterials;
+	unsigned int SharedMeshes;			// Requests served by an already loaded mesh
+	unsigned int SharedTextures;
+	bool Compiled;						// The manifest's .bin was rebuilt this run
+	float ManifestTime;					// Milliseconds to read (or compile) the manifest
+};
+
+class ResourceRegistry
+{
+public:
+	/// <summary>
+	/// Creates an empty registry. Materials it creates use the given shaders and sampler.
+	/// </summary>
+	ResourceRegistry(MeshLoader& _meshLoader, TextureLoader& _textureLoader, Animator& _animator,
+		std::shared_ptr<SimpleVertexShader> _vertShader,
+		std::shared_ptr<SimplePixelShader> _pixelShader,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> _sampler);
+
+	/// <summary>
+	/// Reads a manifest (see LoadSceneManifest()), without loading anything it refers to
+	/// </summary>
+	/// <returns>False if it couldn't be read or had errors; entries with errors are left out</returns>
+	bool LoadManifest(const std::wstring& filePath);
+	/// <summary>
+	/// Creates one of the manifest's entities, loading its mesh, material and textures
+	/// if nothing has used them yet. Skinned meshes get a new AnimatedMesh per entity,
+	/// which plays its first clip (and is fitted to its size) once the model is loaded.
+	/// </summary>
+	/// <param name="entityIndex">Index into the manifest's entities</param>
+	/// <param name="entities">The entity is added to the end of this</param>
+	void Instantiate(unsigned int entityIndex, std::vector<Entity>& entities);
+	/// <summary>
+	/// Loads a mesh by path, sharing it with manifest entries for the same path and format
+	/// </summary>
+	std::shared_ptr<Mesh> LoadMesh(const std::wstring& filePath, MeshVertexFormat vertexFormat = MESH_VERTEX_COMPACT);
+	/// <summary>
+	/// Waits for queued textures (TextureLoader::Finish()) and binds them to new materials
+	/// </summary>
+	void Finish();
+	/// <summary>
+	/// Starts the first clip of characters whose model finished loading, and fits
+	/// them to their size. Call once per frame, after MeshLoader::Update().
+	/// </summary>
+	void Update();
+	/// <summary>
+	/// Queues every texture the manifest declares on another loader, to time loading them
+	/// (nothing is shared with or bound to this registry's materials)
+	/// </summary>
+	/// <param name="loader">Loader to queue them on</param>
+	/// <param name="views">Resized to 1 + TEXTURE_PACKED_CHANNEL_COUNT views per manifest texture (its own, then
+	/// any maps a packed texture leaves out), filled in by the loader's Finish()</param>
+	void QueueAllTextures(TextureLoader& loader, std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>& views);
+
+	// Getters
+	const SceneManifest& GetManifest() { return manifest; }
+	/// <summary>
+	/// Finds a loaded material by its manifest name
+	/// </summary>
+	/// <returns>The material, or null if it isn't loaded</returns>
+	std::shared_ptr<Material> FindMaterial(const std::string& name);
+	const std::vector<std::shared_ptr<Mesh>>& GetMeshes() { return meshes; }
+	const std::vector<std::shared_ptr<Material>>& GetMaterials() { return materials; }
+	const std::vector<std::shared_ptr<AnimatedMesh>>& GetAnimatedMeshes() { return animatedMeshes; }
+	ResourceRegistryStats GetStats() { return stats; }
+
+private:
+	// A material texture waiting for Finish()
+	struct PendingBinding
+	{
+		std::shared_ptr<Material> Target;
+		std::string ShaderVariable;
+		unsigned int Texture;			// Index into textureViews
+	};
+
+	// A texture's view, plus the maps a packed texture leaves out (see TextureLoader::LoadPacked())
+	struct TextureViews
+	{
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> View;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Channels[TEXTURE_PACKED_CHANNEL_COUNT];
+	};
+
+	// A character whose model is still loading
+	struct PendingCharacter
+	{
+		std::shared_ptr<AnimatedMesh> Character;
+		std::shared_ptr<Transform> Target;
+		float FitSize;					// Manifest FitSize (0 keeps the entity's scale)
+	};
+
+	MeshLoader& meshLoader;
+	TextureLoader& textureLoader;
+	Animator& animator;
+	std::shared_ptr<SimpleVertexShader> vertShader;
+	std::shared_ptr<SimplePixelShader> pixelShader;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler;
+
+	SceneManifest manifest;
+	std::wstring manifestPath;
+	ResourceRegistryStats stats;
+
+	// Loaded resources, and where each manifest entry ended up (-1 until first used)
+	std::vector<std::shared_ptr<Mesh>> meshes;
+	std::vector<std::shared_ptr<SkinnedModel>> skinnedModels;
+	std::vector<std::unique_ptr<TextureViews>> textureViews;	// Stable for TextureLoader
+	std::vector<std::shared_ptr<Material>> materials;
+	std::vector<std::shared_ptr<AnimatedMesh>> animatedMeshes;
+	std::vector<int> meshSlots;			// Into meshes, or skinnedModels for skinned entries
+	std::vector<int> textureSlots;
+	std::vector<int> materialSlots;
+
+	// Keys of loaded files: content hash, or path (with the format for meshes)
+	std::unordered_map<uint64_t, int> meshesByHash;
+	std::unordered_map<std::wstring, int> meshesByPath;
+	std::unordered_map<uint64_t, int> texturesByHash;
+	std::unordered_map<std::wstring, int> texturesByPath;
+	std::vector<PendingBinding> pendingBindings;
+	std::vector<PendingCharacter> pendingCharacters;
+
+	int GetMesh(unsigned int index);
+	int GetTexture(unsigned int index);
+	void ResolveTexturePaths(const SceneTexture& sceneTexture, std::wstring filePaths[TEXTURE_PACKED_CHANNEL_COUNT]);
+	std::shared_ptr<Material> GetMaterial(unsigned int index);
+};
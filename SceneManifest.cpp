@@ -0,0 +1,462 @@
+#include "SceneManifest.h"
+#include "TextureCooker.h"
+#include "PathHelpers.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <unordered_map>
+#include <cstring>
+#include <cstdlib>
+
+// Bumped whenever the binary layout changes, so old .bin files get recompiled
+static const unsigned int SCENE_BINARY_MAGIC = 'S' | ('C' << 8) | ('N' << 16) | ('1' << 24);
+
+// --------------------------------------------------------
+// Text format
+// --------------------------------------------------------
+
+// Splits a line on whitespace, keeping quoted text together and dropping comments
+static std::vector<std::string> Tokenize(const std::string& line)
+{
+	std::vector<std::string> tokens;
+	size_t i = 0;
+	while (i < line.size())
+	{
+		while (i < line.size() && isspace((unsigned char)line[i])) { i++; }
+		if (i >= line.size() || line[i] == '#')
+			break;
+
+		std::string token;
+		bool quoted = false;
+		while (i < line.size() && (quoted || !isspace((unsigned char)line[i])))
+		{
+			if (line[i] == '"') { quoted = !quoted; }
+			else { token += line[i]; }
+			i++;
+		}
+		tokens.push_back(token);
+	}
+	return tokens;
+}
+
+// Reads "1,2,3" into count floats
+static bool ParseFloats(const std::string& text, float* values, int count)
+{
+	const char* start = text.c_str();
+	for (int i = 0; i < count; i++)
+	{
+		char* end;
+		values[i] = strtof(start, &end);
+		if (end == start || (i + 1 < count ? *end != ',' : *end != '\0'))
+			return false;
+		start = end + 1;
+	}
+	return true;
+}
+
+bool ParseSceneManifest(const std::string& text, SceneManifest& manifest)
+{
+	manifest = SceneManifest();
+	std::unordered_map<std::string, unsigned int> meshes, textures, materials;
+	std::istringstream lines(text);
+	std::string line;
+	unsigned int lineNumber = 0;
+	bool succeeded = true;
+	while (std::getline(lines, line))
+	{
+		lineNumber++;
+		std::vector<std::string> tokens = Tokenize(line);
+		if (tokens.empty())
+			continue;
+
+		const std::string& type = tokens[0];
+		std::string error;
+		if ((type == "mesh" || type == "skinned") && (tokens.size() == 3 || tokens.size() == 4))
+		{
+			SceneMesh mesh = {};
+			mesh.Name = tokens[1];
+			mesh.FilePath = tokens[2];
+			mesh.Type = type == "skinned" ? SCENE_MESH_SKINNED : SCENE_MESH_COMPACT;
+			if (tokens.size() == 4)
+			{
+				if (type == "mesh" && tokens[3] == "quantized") { mesh.Type = SCENE_MESH_QUANTIZED; }
+				else { error = "unknown mesh option " + tokens[3]; }
+			}
+			if (error.empty())
+			{
+				meshes[mesh.Name] = (unsigned int)manifest.Meshes.size();
+				manifest.Meshes.push_back(mesh);
+			}
+		}
+		else if (type == "texture" && tokens.size() == 3)
+		{
+			SceneTexture texture = {};
+			texture.Name = tokens[1];
+			texture.FilePaths[0] = tokens[2];
+			textures[texture.Name] = (unsigned int)manifest.Textures.size();
+			manifest.Textures.push_back(texture);
+		}
+		else if (type == "packed" && tokens.size() == 2 + TEXTURE_PACKED_CHANNEL_COUNT)
+		{
+			SceneTexture texture = {};
+			texture.Name = tokens[1];
+			texture.Packed = true;
+			for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++) { texture.FilePaths[c] = tokens[2 + c] == "-" ? "" : tokens[2 + c]; }
+			textures[texture.Name] = (unsigned int)manifest.Textures.size();
+			manifest.Textures.push_back(texture);
+		}
+		else if (type == "material" && tokens.size() >= 2)
+		{
+			SceneMaterial material = {};
+			material.Name = tokens[1];
+			material.Color[0] = material.Color[1] = material.Color[2] = material.Color[3] = 1.0f;
+			material.Roughness = 0.1f;
+			material.Transparency = 1.0f;
+			material.UVScale[0] = material.UVScale[1] = 1.0f;
+			for (size_t i = 2; i < tokens.size() && error.empty(); i++)
+			{
+				size_t equals = tokens[i].find('=');
+				std::string key = tokens[i].substr(0, equals);
+				std::string value = equals == std::string::npos ? "" : tokens[i].substr(equals + 1);
+				bool valid = true;
+				if (key == "color") { valid = ParseFloats(value, material.Color, 4); }
+				else if (key == "roughness") { valid = ParseFloats(value, &material.Roughness, 1); }
+				else if (key == "transparency") { valid = ParseFloats(value, &material.Transparency, 1); }
+				else if (key == "uvScale") { valid = ParseFloats(value, material.UVScale, 2); }
+				else if (textures.count(value)) { material.Textures.push_back({ key, textures[value] }); }
+				else { error = "unknown texture " + value + " for " + key; }
+				if (!valid) { error = "bad value for " + key; }
+			}
+			if (error.empty())
+			{
+				materials[material.Name] = (unsigned int)manifest.Materials.size();
+				manifest.Materials.push_back(material);
+			}
+		}
+		else if (type == "entity" && tokens.size() >= 3)
+		{
+			SceneEntity entity = {};
+			entity.Scale[0] = entity.Scale[1] = entity.Scale[2] = 1.0f;
+			if (!meshes.count(tokens[1])) { error = "unknown mesh " + tokens[1]; }
+			else if (!materials.count(tokens[2])) { error = "unknown material " + tokens[2]; }
+			else
+			{
+				entity.Mesh = meshes[tokens[1]];
+				entity.Material = materials[tokens[2]];
+			}
+			for (size_t i = 3; i < tokens.size() && error.empty(); i++)
+			{
+				size_t equals = tokens[i].find('=');
+				std::string key = tokens[i].substr(0, equals);
+				std::string value = equals == std::string::npos ? "" : tokens[i].substr(equals + 1);
+				bool valid = true;
+				if (key == "position") { valid = ParseFloats(value, entity.Position, 3); }
+				else if (key == "rotation") { valid = ParseFloats(value, entity.Rotation, 3); }
+				else if (key == "scale") { valid = ParseFloats(value, entity.Scale, 3); }
+				else if (key == "fit") { valid = ParseFloats(value, &entity.FitSize, 1); }
+				else if (key == "transparent") { entity.Transparent = true; }
+				else { error = "unknown entity option " + key; }
+				if (!valid) { error = "bad value for " + key; }
+			}
+			if (error.empty()) { manifest.Entities.push_back(entity); }
+		}
+		else
+		{
+			error = "can't parse " + type + " entry";
+		}
+
+		// The entry is left out, so nothing refers to it by a bad index
+		if (!error.empty())
+		{
+			std::cerr << "Scene manifest line " << lineNumber << ": " << error << ", skipped" << std::endl;
+			succeeded = false;
+		}
+	}
+	return succeeded;
+}
+
+// --------------------------------------------------------
+// Binary format
+// --------------------------------------------------------
+
+static void Write(std::vector<unsigned char>& binary, const void* data, size_t size)
+{
+	binary.insert(binary.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+}
+
+static void WriteUInt(std::vector<unsigned char>& binary, unsigned int value) { Write(binary, &value, sizeof(value)); }
+
+static void WriteString(std::vector<unsigned char>& binary, const std::string& str)
+{
+	WriteUInt(binary, (unsigned int)str.size());
+	Write(binary, str.data(), str.size());
+}
+
+// Reads fields in order, failing (and staying failed) past the end
+struct BinaryReader
+{
+	const unsigned char* Data;
+	size_t Size;
+	size_t Position;
+	bool Failed;
+
+	void Read(void* out, size_t size)
+	{
+		if (Failed || Size - Position < size)
+		{
+			Failed = true;
+			memset(out, 0, size);
+			return;
+		}
+		memcpy(out, Data + Position, size);
+		Position += size;
+	}
+	unsigned int ReadUInt() { unsigned int value; Read(&value, sizeof(value)); return value; }
+	std::string ReadString()
+	{
+		unsigned int length = ReadUInt();
+		if (Failed || Size - Position < length)
+		{
+			Failed = true;
+			return std::string();
+		}
+		std::string str((const char*)Data + Position, length);
+		Position += length;
+		return str;
+	}
+};
+
+void WriteSceneManifest(const SceneManifest& manifest, std::vector<unsigned char>& binary)
+{
+	binary.clear();
+	WriteUInt(binary, SCENE_BINARY_MAGIC);
+
+	WriteUInt(binary, (unsigned int)manifest.Meshes.size());
+	for (const SceneMesh& mesh : manifest.Meshes)
+	{
+		WriteString(binary, mesh.Name);
+		WriteString(binary, mesh.FilePath);
+		WriteUInt(binary, mesh.Type);
+		Write(binary, &mesh.ContentHash, sizeof(mesh.ContentHash));
+	}
+
+	WriteUInt(binary, (unsigned int)manifest.Textures.size());
+	for (const SceneTexture& texture : manifest.Textures)
+	{
+		WriteString(binary, texture.Name);
+		WriteUInt(binary, texture.Packed ? 1 : 0);
+		for (int c = 0; c < (texture.Packed ? TEXTURE_PACKED_CHANNEL_COUNT : 1); c++) { WriteString(binary, texture.FilePaths[c]); }
+		Write(binary, &texture.ContentHash, sizeof(texture.ContentHash));
+	}
+
+	WriteUInt(binary, (unsigned int)manifest.Materials.size());
+	for (const SceneMaterial& material : manifest.Materials)
+	{
+		WriteString(binary, material.Name);
+		Write(binary, material.Color, sizeof(material.Color));
+		Write(binary, &material.Roughness, sizeof(material.Roughness));
+		Write(binary, &material.Transparency, sizeof(material.Transparency));
+		Write(binary, material.UVScale, sizeof(material.UVScale));
+		WriteUInt(binary, (unsigned int)material.Textures.size());
+		for (const SceneMaterialTexture& texture : material.Textures)
+		{
+			WriteString(binary, texture.ShaderVariable);
+			WriteUInt(binary, texture.Texture);
+		}
+	}
+
+	WriteUInt(binary, (unsigned int)manifest.Entities.size());
+	for (const SceneEntity& entity : manifest.Entities)
+	{
+		WriteUInt(binary, entity.Mesh);
+		WriteUInt(binary, entity.Material);
+		Write(binary, entity.Position, sizeof(entity.Position));
+		Write(binary, entity.Rotation, sizeof(entity.Rotation));
+		Write(binary, entity.Scale, sizeof(entity.Scale));
+		Write(binary, &entity.FitSize, sizeof(entity.FitSize));
+		WriteUInt(binary, entity.Transparent ? 1 : 0);
+	}
+}
+
+bool ReadSceneManifest(const unsigned char* binary, size_t size, SceneManifest& manifest)
+{
+	manifest = SceneManifest();
+	BinaryReader reader = { binary, size, 0, false };
+	if (reader.ReadUInt() != SCENE_BINARY_MAGIC)
+		return false;
+
+	// Counts are checked against what's left, so a corrupt file can't ask for huge allocations
+	unsigned int count = reader.ReadUInt();
+	if (count > size) { return false; }
+	manifest.Meshes.resize(count);
+	for (SceneMesh& mesh : manifest.Meshes)
+	{
+		mesh.Name = reader.ReadString();
+		mesh.FilePath = reader.ReadString();
+		mesh.Type = (SceneMeshType)reader.ReadUInt();
+		reader.Read(&mesh.ContentHash, sizeof(mesh.ContentHash));
+		if (mesh.Type > SCENE_MESH_SKINNED) { return false; }
+	}
+
+	count = reader.ReadUInt();
+	if (count > size) { return false; }
+	manifest.Textures.resize(count);
+	for (SceneTexture& texture : manifest.Textures)
+	{
+		texture.Name = reader.ReadString();
+		texture.Packed = reader.ReadUInt() != 0;
+		for (int c = 0; c < (texture.Packed ? TEXTURE_PACKED_CHANNEL_COUNT : 1); c++) { texture.FilePaths[c] = reader.ReadString(); }
+		reader.Read(&texture.ContentHash, sizeof(texture.ContentHash));
+	}
+
+	count = reader.ReadUInt();
+	if (count > size) { return false; }
+	manifest.Materials.resize(count);
+	for (SceneMaterial& material : manifest.Materials)
+	{
+		material.Name = reader.ReadString();
+		reader.Read(material.Color, sizeof(material.Color));
+		reader.Read(&material.Roughness, sizeof(material.Roughness));
+		reader.Read(&material.Transparency, sizeof(material.Transparency));
+		reader.Read(material.UVScale, sizeof(material.UVScale));
+		unsigned int textureCount = reader.ReadUInt();
+		if (textureCount > size) { return false; }
+		material.Textures.resize(textureCount);
+		for (SceneMaterialTexture& texture : material.Textures)
+		{
+			texture.ShaderVariable = reader.ReadString();
+			texture.Texture = reader.ReadUInt();
+			if (texture.Texture >= manifest.Textures.size()) { return false; }
+		}
+	}
+
+	count = reader.ReadUInt();
+	if (count > size) { return false; }
+	manifest.Entities.resize(count);
+	for (SceneEntity& entity : manifest.Entities)
+	{
+		entity.Mesh = reader.ReadUInt();
+		entity.Material = reader.ReadUInt();
+		reader.Read(entity.Position, sizeof(entity.Position));
+		reader.Read(entity.Rotation, sizeof(entity.Rotation));
+		reader.Read(entity.Scale, sizeof(entity.Scale));
+		reader.Read(&entity.FitSize, sizeof(entity.FitSize));
+		entity.Transparent = reader.ReadUInt() != 0;
+		if (entity.Mesh >= manifest.Meshes.size() || entity.Material >= manifest.Materials.size()) { return false; }
+	}
+	return !reader.Failed && reader.Position == size;
+}
+
+// --------------------------------------------------------
+// Files
+// --------------------------------------------------------
+
+uint64_t HashFileContents(const std::wstring& filePath)
+{
+	std::ifstream file(filePath, std::ios::binary);
+	if (!file)
+		return 0;
+
+	uint64_t hash = 14695981039346656037ull;
+	std::vector<char> buffer(1 << 16);
+	while (file)
+	{
+		file.read(buffer.data(), buffer.size());
+		std::streamsize read = file.gcount();
+		for (std::streamsize i = 0; i < read; i++)
+		{
+			hash ^= (unsigned char)buffer[i];
+			hash *= 1099511628211ull;
+		}
+	}
+	return hash;
+}
+
+std::wstring ResolveScenePath(const std::wstring& manifestFilePath, const std::string& path)
+{
+	size_t slash = manifestFilePath.find_last_of(L"/\\");
+	std::wstring directory = slash == std::wstring::npos ? L"" : manifestFilePath.substr(0, slash + 1);
+	return directory + NarrowToWide(path);
+}
+
+// Every file a manifest refers to, resolved. Ones that were missing when it was
+// compiled are left out, or the manifest would be compiled again on every load.
+static std::vector<std::wstring> GetReferencedFiles(const std::wstring& filePath, const SceneManifest& manifest)
+{
+	std::vector<std::wstring> files;
+	for (const SceneMesh& mesh : manifest.Meshes)
+	{
+		if (mesh.ContentHash != 0) { files.push_back(ResolveScenePath(filePath, mesh.FilePath)); }
+	}
+	for (const SceneTexture& texture : manifest.Textures)
+	{
+		for (const std::string& path : texture.FilePaths)
+		{
+			if (texture.ContentHash != 0 && !path.empty()) { files.push_back(ResolveScenePath(filePath, path)); }
+		}
+	}
+	return files;
+}
+
+bool LoadSceneManifest(const std::wstring& filePath, SceneManifest& manifest, bool& compiled)
+{
+	compiled = false;
+	std::wstring binaryPath = filePath + L".bin";
+	std::ifstream binaryFile(binaryPath, std::ios::binary | std::ios::ate);
+	if (binaryFile && IsDerivedFileCurrent(binaryPath, &filePath, 1))
+	{
+		std::vector<unsigned char> binary((size_t)binaryFile.tellg());
+		binaryFile.seekg(0);
+		binaryFile.read((char*)binary.data(), binary.size());
+		if (binaryFile.good() && ReadSceneManifest(binary.data(), binary.size(), manifest))
+		{
+			// A changed asset changes its hash too
+			std::vector<std::wstring> files = GetReferencedFiles(filePath, manifest);
+			if (files.empty() || IsDerivedFileCurrent(binaryPath, files.data(), (unsigned int)files.size()))
+				return true;
+		}
+	}
+	binaryFile.close();
+
+	std::ifstream textFile(filePath);
+	if (!textFile)
+	{
+		std::wcerr << L"Could not open scene manifest " << filePath << std::endl;
+		// Nothing from a binary that failed to read is kept
+		manifest = SceneManifest();
+		return false;
+	}
+	std::stringstream text;
+	text << textFile.rdbuf();
+	bool parsed = ParseSceneManifest(text.str(), manifest);
+	compiled = true;
+
+	// Packed textures hash their channels' hashes, so the same maps packed the same way match
+	for (SceneMesh& mesh : manifest.Meshes) { mesh.ContentHash = HashFileContents(ResolveScenePath(filePath, mesh.FilePath)); }
+	for (SceneTexture& texture : manifest.Textures)
+	{
+		if (!texture.Packed)
+		{
+			texture.ContentHash = HashFileContents(ResolveScenePath(filePath, texture.FilePaths[0]));
+			continue;
+		}
+		uint64_t hash = 14695981039346656037ull;
+		for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+		{
+			uint64_t channelHash = texture.FilePaths[c].empty() ? 1 : HashFileContents(ResolveScenePath(filePath, texture.FilePaths[c]));
+			if (channelHash == 0) { hash = 0; break; }
+			hash = (hash ^ channelHash) * 1099511628211ull;
+		}
+		texture.ContentHash = hash;
+	}
+
+	// Only compile a manifest without errors, so they're reported every run until fixed
+	if (!parsed)
+		return false;
+	// A failed write only means compiling again next run
+	std::vector<unsigned char> binary;
+	WriteSceneManifest(manifest, binary);
+	std::ofstream output(binaryPath, std::ios::binary | std::ios::trunc);
+	output.write((const char*)binary.data(), binary.size());
+	return true;
+}
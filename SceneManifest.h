@@ -0,0 +1,131 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "TextureCompression.h"
+
+// --------------------------------------------------------
+// A scene's meshes, textures, materials and entities as
+// data instead of code
+//
+// Authored as text and compiled to a binary .bin next to it
+// the first time it's loaded after a change. The binary also
+// holds a content hash of every file the scene references,
+// so ResourceRegistry can share identical files without
+// reading them at startup. Entries refer to earlier ones:
+// by name in the text, by index in the binary.
+//
+// Text format, one entry per line. '#' starts a comment,
+// paths are relative to the manifest (quote them if they
+// have spaces) and '-' leaves a packed channel at its default.
+//
+//   mesh <name> <path> [quantized]
+//   skinned <name> <path>
+//   texture <name> <path>
+//   packed <name> <occlusion> <roughness> <metalness> <opacity>
+//   material <name> [<shader texture>=<texture>]... [color=r,g,b,a]
+//       [roughness=r] [transparency=t] [uvScale=u,v]
+//   entity <mesh> <material> [position=x,y,z] [rotation=p,y,r]
+//       [scale=x,y,z] [fit=size] [transparent]
+//
+// fit scales a skinned mesh's bind pose to that size.
+// --------------------------------------------------------
+
+enum SceneMeshType
+{
+	SCENE_MESH_COMPACT,				// MESH_VERTEX_COMPACT, loaded by MeshLoader
+	SCENE_MESH_QUANTIZED,			// MESH_VERTEX_QUANTIZED, loaded by MeshLoader
+	SCENE_MESH_SKINNED				// Rigged, one AnimatedMesh per entity
+};
+
+struct SceneMesh
+{
+	std::string Name;
+	std::string FilePath;
+	SceneMeshType Type;
+	uint64_t ContentHash;			// 0 if the file couldn't be read when compiled
+};
+
+struct SceneTexture
+{
+	std::string Name;
+	bool Packed;					// See TextureLoader::LoadPacked()
+	std::string FilePaths[TEXTURE_PACKED_CHANNEL_COUNT];	// Just the first unless Packed (empty for defaults)
+	uint64_t ContentHash;
+};
+
+struct SceneMaterialTexture
+{
+	std::string ShaderVariable;
+	unsigned int Texture;
+};
+
+struct SceneMaterial
+{
+	std::string Name;
+	float Color[4];
+	float Roughness;
+	float Transparency;
+	float UVScale[2];
+	std::vector<SceneMaterialTexture> Textures;
+};
+
+struct SceneEntity
+{
+	unsigned int Mesh;
+	unsigned int Material;
+	float Position[3];
+	float Rotation[3];				// Pitch, yaw, roll in radians
+	float Scale[3];
+	float FitSize;					// 0 to keep Scale
+	bool Transparent;				// Drawn sorted and blended, after the sky
+};
+
+struct SceneManifest
+{
+	std::vector<SceneMesh> Meshes;
+	std::vector<SceneTexture> Textures;
+	std::vector<SceneMaterial> Materials;
+	std::vector<SceneEntity> Entities;
+};
+
+/// <summary>
+/// Parses the text format, printing any errors with their line numbers. Entries with errors
+/// are left out (along with everything that refers to them), so the rest is still usable.
+/// </summary>
+/// <param name="text">Contents of the manifest</param>
+/// <param name="manifest">Receives the scene (content hashes are left at 0)</param>
+/// <returns>False if any line couldn't be parsed</returns>
+bool ParseSceneManifest(const std::string& text, SceneManifest& manifest);
+
+/// <summary>
+/// Serializes a manifest to the binary format
+/// </summary>
+void WriteSceneManifest(const SceneManifest& manifest, std::vector<unsigned char>& binary);
+
+/// <summary>
+/// Reads the binary format back
+/// </summary>
+/// <returns>False if the data is truncated, from another version or refers to missing entries</returns>
+bool ReadSceneManifest(const unsigned char* binary, size_t size, SceneManifest& manifest);
+
+/// <summary>
+/// FNV-1a hash of a file's contents
+/// </summary>
+/// <returns>The hash, or 0 if the file couldn't be read</returns>
+uint64_t HashFileContents(const std::wstring& filePath);
+
+/// <summary>
+/// Resolves a path from a manifest against the manifest's directory
+/// </summary>
+std::wstring ResolveScenePath(const std::wstring& manifestFilePath, const std::string& path);
+
+/// <summary>
+/// Loads a manifest from its compiled .bin if that's newer than the text and every file
+/// it references, otherwise parses the text, hashes the files and writes the .bin
+/// </summary>
+/// <param name="filePath">Path to the text manifest</param>
+/// <param name="manifest">Receives the scene</param>
+/// <param name="compiled">Set to true if the text had to be parsed</param>
+/// <returns>False if neither could be read, or the text had errors (the entries without any are still loaded)</returns>
+bool LoadSceneManifest(const std::wstring& filePath, SceneManifest& manifest, bool& compiled);
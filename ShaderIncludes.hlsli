@@ -13,12 +13,21 @@ struct VertexShaderInput
 	//  |   Name          Semantic
 	//  |    |                |
 	//  v    v                v
-    float3 localPosition : POSITION; // XYZ position
-    float3 normal : NORMAL;
+    float3 localPosition : POSITION; // XYZ position (quantized meshes fold dequantization into world)
+    float2 normal : NORMAL;          // Octahedral encoded, see DecodeOctahedral()
     float2 uv : TEXCOORD;
-    float3 tangent : TANGENT;
+    float2 tangent : TANGENT;        // Octahedral encoded
 };
 
+// Unpacks a unit vector stored with OctahedralEncode() (VertexFormats.h)
+float3 DecodeOctahedral(float2 e)
+{
+    float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t; // Per-component select
+    return normalize(n);
+}
+
 // Struct representing the data we're sending down the pipeline
 // - Should match our pixel shader's input (hence the name: Vertex to Pixel)
 // - At a minimum, we need a piece of data defined tagged as SV_POSITION
@@ -36,7 +45,6 @@ struct VertexToPixel
     float3 worldPosition : POSITION;
     float3 normal : NORMAL;
     float3 tangent : TANGENT;
-    float4 shadowMapPos : SHADOW_POSITION;
 };
 
 struct VertexToPixel_Sky
@@ -0,0 +1,173 @@
+#include "ShadowAtlas.h"
+#include <algorithm>
+#include <cmath>
+
+// Every other bit of a Z-order index, packed down
+static unsigned int CompactBits(unsigned int bits)
+{
+	bits &= 0x55555555;
+	bits = (bits | (bits >> 1)) & 0x33333333;
+	bits = (bits | (bits >> 2)) & 0x0F0F0F0F;
+	bits = (bits | (bits >> 4)) & 0x00FF00FF;
+	bits = (bits | (bits >> 8)) & 0x0000FFFF;
+	return bits;
+}
+
+float GetSphereScreenCoverage(const float view[16], const float projection[16], const float center[3], float radius)
+{
+	float viewCenter[3];
+	for (int a = 0; a < 3; a++)
+	{
+		viewCenter[a] = center[0] * view[a] + center[1] * view[4 + a] + center[2] * view[8 + a] + view[12 + a];
+	}
+
+	// Perspective spheres shrink with distance (by the tangent of the angle they subtend); orthographic ones don't
+	bool perspective = projection[11] != 0.0f;
+	float scale = 1.0f;
+	float w = 1.0f;
+	if (perspective)
+	{
+		if (viewCenter[2] + radius <= 0.0f)
+			return 0.0f;
+		if (viewCenter[2] <= radius)
+			return 1.0f;
+		scale = 1.0f / sqrtf(viewCenter[2] * viewCenter[2] - radius * radius);
+		w = viewCenter[2] * projection[11] + projection[15];
+	}
+	float radiusX = radius * projection[0] * scale;
+	float radiusY = radius * projection[5] * scale;
+	float centerX = (viewCenter[0] * projection[0] + viewCenter[2] * projection[8] + projection[12]) / w;
+	float centerY = (viewCenter[1] * projection[5] + viewCenter[2] * projection[9] + projection[13]) / w;
+	if (fabsf(centerX) - radiusX >= 1.0f || fabsf(centerY) - radiusY >= 1.0f)
+		return 0.0f;
+
+	// Ellipse area over the 2x2 of NDC
+	return std::min(3.14159265f * radiusX * radiusY / 4.0f, 1.0f);
+}
+
+ShadowAtlas::ShadowAtlas(ShadowAtlasSettings settings)
+{
+	droppedCount = 0;
+	SetSettings(settings);
+}
+
+void ShadowAtlas::Request(unsigned int key, float importance)
+{
+	requests.push_back({ key, importance, 0 });
+}
+
+void ShadowAtlas::Allocate()
+{
+	// Sizes come from last frame's tiles, so work them out before those are cleared
+	for (auto& request : requests) { request.Size = GetRequestedSize(request); }
+
+	// Most important first, so shrinking and dropping start from the back
+	std::sort(requests.begin(), requests.end(), [](const TileRequest& a, const TileRequest& b)
+		{ return a.Importance != b.Importance ? a.Importance > b.Importance : a.Key < b.Key; });
+	double budget = (double)settings.Budget * settings.Size * settings.Size;
+	double used = 0.0;
+	for (auto& request : requests) { used += (double)request.Size * request.Size; }
+	size_t kept = requests.size();
+	droppedCount = 0;
+	while (used > budget && kept > 0)
+	{
+		// Halve each tile once, least important first, until they fit
+		bool shrunk = false;
+		for (size_t i = kept; i-- > 0 && used > budget; )
+		{
+			if (requests[i].Size <= settings.MinTileSize)
+				continue;
+			used -= 0.75 * requests[i].Size * requests[i].Size;
+			requests[i].Size /= 2;
+			shrunk = true;
+		}
+		// Everything is as small as it goes
+		if (!shrunk)
+		{
+			kept--;
+			used -= (double)requests[kept].Size * requests[kept].Size;
+			droppedCount++;
+		}
+	}
+	requests.resize(kept);
+
+	// Largest first, each tile starts on a multiple of its own area along the Z-order walk,
+	// which is the corner of a free quad-tree node of its size. Ties go by key, so an unchanged
+	// set of tiles lands in the same place every frame.
+	std::sort(requests.begin(), requests.end(), [](const TileRequest& a, const TileRequest& b)
+		{ return a.Size != b.Size ? a.Size > b.Size : a.Key < b.Key; });
+	previousTiles.swap(tiles);
+	tiles.clear();
+	unsigned int cellArea = settings.MinTileSize * settings.MinTileSize;
+	unsigned int cell = 0;
+	for (auto& request : requests)
+	{
+		ShadowAtlasTile tile = {};
+		tile.X = CompactBits(cell) * settings.MinTileSize;
+		tile.Y = CompactBits(cell >> 1) * settings.MinTileSize;
+		tile.Size = request.Size;
+		tiles[request.Key] = tile;
+		cell += request.Size * request.Size / cellArea;
+	}
+	requests.clear();
+}
+
+const ShadowAtlasTile* ShadowAtlas::GetTile(unsigned int key) const
+{
+	auto tile = tiles.find(key);
+	return tile == tiles.end() ? nullptr : &tile->second;
+}
+
+bool ShadowAtlas::IsTileUnchanged(unsigned int key) const
+{
+	const ShadowAtlasTile* tile = GetTile(key);
+	auto previous = previousTiles.find(key);
+	return tile && previous != previousTiles.end() &&
+		tile->X == previous->second.X && tile->Y == previous->second.Y && tile->Size == previous->second.Size;
+}
+
+void ShadowAtlas::GetTileRect(const ShadowAtlasTile& tile, float rect[4]) const
+{
+	rect[0] = (float)tile.X / settings.Size;
+	rect[1] = (float)tile.Y / settings.Size;
+	rect[2] = (float)tile.Size / settings.Size;
+	rect[3] = rect[2];
+}
+
+void ShadowAtlas::SetSettings(ShadowAtlasSettings _settings)
+{
+	settings = _settings;
+	settings.MaxTileSize = std::min(settings.MaxTileSize, settings.Size);
+	settings.MinTileSize = std::min(std::max(settings.MinTileSize, 1u), settings.MaxTileSize);
+	settings.Budget = std::min(std::max(settings.Budget, 0.0f), 1.0f);
+	settings.Hysteresis = std::max(settings.Hysteresis, 0.0f);
+}
+
+float ShadowAtlas::GetUsage() const
+{
+	double used = 0.0;
+	for (auto& tile : tiles) { used += (double)tile.second.Size * tile.second.Size; }
+	return (float)(used / ((double)settings.Size * settings.Size));
+}
+
+// --------------------------------------------------------
+// The power of 2 nearest the square root of importance
+// (in octaves), or last frame's size if importance hasn't
+// moved more than half an octave plus the hysteresis away
+// --------------------------------------------------------
+unsigned int ShadowAtlas::GetRequestedSize(const TileRequest& request) const
+{
+	float importance = std::min(std::max(request.Importance, 0.0f), 1.0f);
+	float ideal = std::max(sqrtf(importance) * settings.MaxTileSize, (float)settings.MinTileSize);
+	float octave = log2f(ideal);
+
+	const ShadowAtlasTile* previous = GetTile(request.Key);
+	if (previous && previous->Size >= settings.MinTileSize && previous->Size <= settings.MaxTileSize &&
+		fabsf(octave - log2f((float)previous->Size)) <= 0.5f + settings.Hysteresis)
+	{
+		return previous->Size;
+	}
+
+	unsigned int size = 1u << (unsigned int)floorf(octave + 0.5f);
+	return std::min(std::max(size, settings.MinTileSize), settings.MaxTileSize);
+}
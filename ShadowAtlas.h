@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+
+// --------------------------------------------------------
+// Packs every shadow map into tiles of one large depth
+// texture, reallocated every frame
+//
+// Each shadow (a cascade or a spot light's view) asks for a
+// tile with an importance: roughly how much of the screen
+// it covers. Tiles are square powers of two, sized by the
+// square root of importance. A shadow keeps last frame's
+// size until its importance moves well past it, so sizes
+// don't flicker. When the tiles don't fit the budget, the
+// least important ones shrink first, then are dropped.
+//
+// Tiles are placed largest first along a quad-tree's
+// Z-order walk, so they pack without gaps. Nothing here
+// needs D3D, so allocation can be checked on the CPU.
+// --------------------------------------------------------
+
+struct ShadowAtlasSettings
+{
+	unsigned int Size;			// Atlas texels across (a power of 2)
+	unsigned int MinTileSize;	// Powers of 2, at most Size
+	unsigned int MaxTileSize;
+	float Budget;				// Fraction of the atlas tiles may use, up to 1
+	float Hysteresis;			// Extra octaves importance must move before a tile changes size
+};
+
+struct ShadowAtlasTile
+{
+	unsigned int X;				// Top left texel
+	unsigned int Y;
+	unsigned int Size;			// Texels across
+};
+
+/// <summary>
+/// Roughly how much of the screen a sphere covers, from 0 to 1
+/// </summary>
+/// <param name="view">Camera's view matrix, row major for row vectors</param>
+/// <param name="projection">Camera's projection (perspective or orthographic)</param>
+/// <param name="center">Sphere's world space center</param>
+/// <param name="radius">Sphere's radius</param>
+float GetSphereScreenCoverage(const float view[16], const float projection[16], const float center[3], float radius);
+
+class ShadowAtlas
+{
+public:
+	ShadowAtlas(ShadowAtlasSettings settings);
+
+	/// <summary>
+	/// Asks for a tile this frame
+	/// </summary>
+	/// <param name="key">Stays the same for a shadow from frame to frame</param>
+	/// <param name="importance">0 to 1, see GetSphereScreenCoverage()</param>
+	void Request(unsigned int key, float importance);
+	/// <summary>
+	/// Sizes and places every tile requested since the last call, then clears the requests
+	/// </summary>
+	void Allocate();
+	/// <summary>
+	/// A shadow's tile from the last Allocate()
+	/// </summary>
+	/// <returns>Null if the shadow wasn't requested or didn't fit</returns>
+	const ShadowAtlasTile* GetTile(unsigned int key) const;
+	/// <summary>
+	/// Whether a shadow's tile is in the same place and size as in the Allocate() before the last one,
+	/// so what was rendered into it then is still there
+	/// </summary>
+	bool IsTileUnchanged(unsigned int key) const;
+	/// <summary>
+	/// Where a tile is in atlas UVs
+	/// </summary>
+	/// <param name="rect">Receives the offset (x, y) and scale (z, w)</param>
+	void GetTileRect(const ShadowAtlasTile& tile, float rect[4]) const;
+
+	void SetSettings(ShadowAtlasSettings _settings);
+	ShadowAtlasSettings GetSettings() const { return settings; }
+	unsigned int GetTileCount() const { return (unsigned int)tiles.size(); }
+	unsigned int GetDroppedCount() const { return droppedCount; }
+	/// <summary>
+	/// Fraction of the atlas the last Allocate() used
+	/// </summary>
+	float GetUsage() const;
+
+private:
+	struct TileRequest
+	{
+		unsigned int Key;
+		float Importance;
+		unsigned int Size;
+	};
+
+	ShadowAtlasSettings settings;
+	std::vector<TileRequest> requests;
+	std::unordered_map<unsigned int, ShadowAtlasTile> tiles;
+	std::unordered_map<unsigned int, ShadowAtlasTile> previousTiles;
+	unsigned int droppedCount;
+
+	unsigned int GetRequestedSize(const TileRequest& request) const;
+};
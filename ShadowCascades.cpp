@@ -0,0 +1,158 @@
+#include "ShadowCascades.h"
+#include <algorithm>
+#include <cmath>
+
+// a * b, both row major
+static void MultiplyMatrices(const float a[16], const float b[16], float result[16])
+{
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++)
+		{
+			result[r * 4 + c] = a[r * 4] * b[c] + a[r * 4 + 1] * b[4 + c] + a[r * 4 + 2] * b[8 + c] + a[r * 4 + 3] * b[12 + c];
+		}
+}
+
+static void Normalize(float v[3])
+{
+	float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	if (length > 0.0f) { for (int a = 0; a < 3; a++) { v[a] /= length; } }
+}
+
+static void Cross(const float a[3], const float b[3], float result[3])
+{
+	result[0] = a[1] * b[2] - a[2] * b[1];
+	result[1] = a[2] * b[0] - a[0] * b[2];
+	result[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+void ComputeCascadeSplits(float nearDist, float farDist, unsigned int count, float lambda, float splits[MAX_SHADOW_CASCADES])
+{
+	count = std::min(std::max(count, 1u), (unsigned int)MAX_SHADOW_CASCADES);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float fraction = (float)(i + 1) / count;
+		float logarithmic = nearDist * powf(farDist / nearDist, fraction);
+		float even = nearDist + (farDist - nearDist) * fraction;
+		splits[i] = lambda * logarithmic + (1.0f - lambda) * even;
+	}
+	splits[count - 1] = farDist;
+}
+
+void GetFrustumSliceCorners(const float view[16], const float projection[16], float sliceNear, float sliceFar, float corners[8][3])
+{
+	// View x at a depth for an NDC x: ndc * w = x * P11 + z * P31 + P41, with w = z * P34 + P44 (see LightClusters)
+	for (int c = 0; c < 8; c++)
+	{
+		float z = c < 4 ? sliceNear : sliceFar;
+		float ndcX = (c & 1) ? 1.0f : -1.0f;
+		float ndcY = (c & 2) ? 1.0f : -1.0f;
+		float w = z * projection[11] + projection[15];
+		const float viewPosition[3] = {
+			(ndcX * w - z * projection[8] - projection[12]) / projection[0],
+			(ndcY * w - z * projection[9] - projection[13]) / projection[5],
+			z };
+
+		// Undo the view matrix: world = (view position - translation) * transpose(rotation)
+		for (int a = 0; a < 3; a++)
+		{
+			corners[c][a] = 0.0f;
+			for (int k = 0; k < 3; k++) { corners[c][a] += (viewPosition[k] - view[12 + k]) * view[a * 4 + k]; }
+		}
+	}
+}
+
+void FitShadowCascades(const float view[16], const float projection[16], float nearDist, float farDist,
+	const float lightDirection[3], const ShadowCascadeSettings& settings, ShadowCascade cascades[MAX_SHADOW_CASCADES])
+{
+	unsigned int count = std::min(std::max(settings.Count, 1u), (unsigned int)MAX_SHADOW_CASCADES);
+	float splits[MAX_SHADOW_CASCADES];
+	ComputeCascadeSplits(nearDist, std::min(settings.MaxDistance, farDist), count, settings.SplitLambda, splits);
+
+	// The light's basis only depends on its direction, so texel snapping holds from frame to frame
+	float forward[3] = { lightDirection[0], lightDirection[1], lightDirection[2] };
+	Normalize(forward);
+	float up[3] = { 0.0f, 1.0f, 0.0f };
+	if (fabsf(forward[1]) > 0.99f) { up[1] = 0.0f; up[2] = 1.0f; }
+	float right[3];
+	Cross(up, forward, right);
+	Normalize(right);
+	Cross(forward, right, up);
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		ShadowCascade& cascade = cascades[i];
+		cascade.SplitNear = i == 0 ? nearDist : splits[i - 1];
+		cascade.SplitFar = splits[i];
+
+		// Sphere around the slice's corners. The corners only turn with the camera, so the radius doesn't change;
+		// rounding it up keeps float error from changing it either.
+		float corners[8][3];
+		GetFrustumSliceCorners(view, projection, cascade.SplitNear, cascade.SplitFar, corners);
+		for (int a = 0; a < 3; a++)
+		{
+			cascade.Center[a] = 0.0f;
+			for (int c = 0; c < 8; c++) { cascade.Center[a] += corners[c][a] / 8.0f; }
+		}
+		float radiusSq = 0.0f;
+		for (int c = 0; c < 8; c++)
+		{
+			float offset[3] = { corners[c][0] - cascade.Center[0], corners[c][1] - cascade.Center[1], corners[c][2] - cascade.Center[2] };
+			radiusSq = std::max(radiusSq, offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+		}
+		cascade.Radius = ceilf(sqrtf(radiusSq) * 16.0f) / 16.0f;
+
+		// Look along the light from behind the sphere, far enough back to catch casters outside the slice (XMMatrixLookToLH)
+		float back = cascade.Radius + settings.CasterDistance;
+		float eye[3] = { cascade.Center[0] - forward[0] * back, cascade.Center[1] - forward[1] * back, cascade.Center[2] - forward[2] * back };
+		const float* axes[3] = { right, up, forward };
+		for (int a = 0; a < 3; a++)
+		{
+			cascade.View[a] = axes[a][0];
+			cascade.View[4 + a] = axes[a][1];
+			cascade.View[8 + a] = axes[a][2];
+			cascade.View[12 + a] = -(axes[a][0] * eye[0] + axes[a][1] * eye[1] + axes[a][2] * eye[2]);
+			cascade.View[a * 4 + 3] = 0.0f;
+		}
+		cascade.View[15] = 1.0f;
+
+		// Orthographic box around the sphere (XMMatrixOrthographicLH, near plane at the eye)
+		float depth = 2.0f * cascade.Radius + settings.CasterDistance;
+		for (int m = 0; m < 16; m++) { cascade.Projection[m] = 0.0f; }
+		cascade.Projection[0] = 1.0f / cascade.Radius;
+		cascade.Projection[5] = 1.0f / cascade.Radius;
+		cascade.Projection[10] = 1.0f / depth;
+		cascade.Projection[15] = 1.0f;
+
+		MultiplyMatrices(cascade.View, cascade.Projection, cascade.ViewProjection);
+	}
+}
+
+void SnapShadowCascade(ShadowCascade& cascade, unsigned int resolution)
+{
+	float halfResolution = resolution * 0.5f;
+	float originX = cascade.View[12] * cascade.Projection[0] * halfResolution;
+	float originY = cascade.View[13] * cascade.Projection[5] * halfResolution;
+	cascade.Projection[12] = (roundf(originX) - originX) / halfResolution;
+	cascade.Projection[13] = (roundf(originY) - originY) / halfResolution;
+
+	MultiplyMatrices(cascade.View, cascade.Projection, cascade.ViewProjection);
+}
+
+bool IsSphereInShadowMap(const float viewProjection[16], const float center[3], float radius)
+{
+	// Each plane is a sum of the matrix's columns (clip = position * viewProjection): -w <= x, y <= w and 0 <= z <= w
+	const int columns[6][2] = { { 0, 1 }, { 0, -1 }, { 1, 1 }, { 1, -1 }, { 2, 0 }, { 2, -1 } };
+	for (int p = 0; p < 6; p++)
+	{
+		float plane[4];
+		for (int r = 0; r < 4; r++)
+		{
+			float axis = viewProjection[r * 4 + columns[p][0]];
+			plane[r] = columns[p][1] == 0 ? axis : viewProjection[r * 4 + 3] + columns[p][1] * axis;
+		}
+		float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius * length)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// Most cascades a directional shadow map can have (slices of its Texture2DArray, float4 in PBR.hlsli)
+#define MAX_SHADOW_CASCADES 4
+
+// --------------------------------------------------------
+// Fits cascaded shadow maps for a directional light to a
+// camera
+//
+// The camera's view depth up to MaxDistance is split with
+// the practical split scheme (a blend of logarithmic and
+// even splits), and each slice of the frustum gets its own
+// orthographic shadow map. Each cascade is fit around the
+// bounding sphere of its slice, so its size doesn't change
+// as the camera turns. Once its resolution is known it is
+// snapped to whole shadow map texels, so edges don't shimmer
+// as the camera moves.
+//
+// Matrices are row major for row vectors, like DirectXMath's
+// (world * view * projection). Nothing here needs D3D, so
+// the fitting can be checked on the CPU.
+// --------------------------------------------------------
+
+struct ShadowCascadeSettings
+{
+	unsigned int Count;			// 1 to MAX_SHADOW_CASCADES
+	float SplitLambda;			// 0 = even splits, 1 = logarithmic
+	float MaxDistance;			// View depth the last cascade ends at (clamped to the camera's far plane)
+	float CasterDistance;		// How far behind a cascade, toward the light, casters are still caught
+};
+
+struct ShadowCascade
+{
+	float View[16];
+	float Projection[16];
+	float ViewProjection[16];
+	float SplitNear;			// View depth range covered
+	float SplitFar;
+	float Center[3];			// World space bounding sphere of the slice
+	float Radius;
+};
+
+/// <summary>
+/// Splits a view depth range with the practical split scheme
+/// </summary>
+/// <param name="nearDist">Start of the first cascade</param>
+/// <param name="farDist">End of the last cascade</param>
+/// <param name="count">Number of cascades</param>
+/// <param name="lambda">0 = even splits, 1 = logarithmic</param>
+/// <param name="splits">Receives where each cascade ends</param>
+void ComputeCascadeSplits(float nearDist, float farDist, unsigned int count, float lambda, float splits[MAX_SHADOW_CASCADES]);
+/// <summary>
+/// Finds the world space corners of a slice of a camera's frustum
+/// </summary>
+/// <param name="view">Camera's view matrix (rotation and translation only)</param>
+/// <param name="projection">Camera's projection (perspective or orthographic)</param>
+/// <param name="sliceNear">View depth the slice starts at</param>
+/// <param name="sliceFar">View depth the slice ends at</param>
+/// <param name="corners">Receives the near corners, then the far corners</param>
+void GetFrustumSliceCorners(const float view[16], const float projection[16], float sliceNear, float sliceFar, float corners[8][3]);
+/// <summary>
+/// Fits every cascade of a directional light to a camera
+/// </summary>
+/// <param name="view">Camera's view matrix (rotation and translation only)</param>
+/// <param name="projection">Camera's projection (perspective or orthographic)</param>
+/// <param name="nearDist">Camera's near plane distance</param>
+/// <param name="farDist">Camera's far plane distance</param>
+/// <param name="lightDirection">Direction the light shines</param>
+/// <param name="settings">Cascade count and splits</param>
+/// <param name="cascades">Receives settings.Count cascades, not yet snapped</param>
+void FitShadowCascades(const float view[16], const float projection[16], float nearDist, float farDist,
+	const float lightDirection[3], const ShadowCascadeSettings& settings, ShadowCascade cascades[MAX_SHADOW_CASCADES]);
+/// <summary>
+/// Shifts a fitted cascade so the world origin lands on a texel corner, so everything else moves in whole texels
+/// </summary>
+/// <param name="cascade">Cascade from FitShadowCascades()</param>
+/// <param name="resolution">Shadow map texels across the cascade</param>
+void SnapShadowCascade(ShadowCascade& cascade, unsigned int resolution);
+/// <summary>
+/// Whether a sphere can reach a shadow map, tested against the six planes of its view projection
+/// </summary>
+/// <param name="viewProjection">A cascade's ViewProjection, or any row major view projection</param>
+/// <param name="center">World space center</param>
+/// <param name="radius">Radius</param>
+bool IsSphereInShadowMap(const float viewProjection[16], const float center[3], float radius);
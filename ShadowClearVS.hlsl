@@ -0,0 +1,13 @@
+// --------------------------------------------------------
+// Covers the viewport with one triangle at the far plane,
+// so drawing it with depth test ALWAYS clears just the
+// viewport's tile of the shadow atlas (ClearDepthStencilView
+// can only clear the whole texture)
+// --------------------------------------------------------
+float4 main(uint id : SV_VertexID) : SV_POSITION
+{
+    float2 uv = float2(
+        (id << 1) & 2, // Essentially: id % 2 * 2
+        id & 2);
+    return float4(uv.x * 2 - 1, uv.y * -2 + 1, 1, 1);
+}
@@ -1,4 +1,6 @@
 #include "ShadowLight.h"
+#include <algorithm>
+#include <cstring>
 
 // Static Variables
 //Microsoft::WRL::ComPtr<ID3D11Device> ShadowLight::device;
@@ -20,6 +22,7 @@ ShadowLight::ShadowLight(DirectX::XMFLOAT3 _direction, float _intensity, DirectX
 	light.Direction = _direction;
 	light.Intensity = _intensity;
 	light.Color = _color;
+	sceneLightId = -1;
 
 	Init();
 }
@@ -37,26 +40,39 @@ ShadowLight::ShadowLight(DirectX::XMFLOAT3 _direction, float _range, DirectX::XM
 	light.Color = _color;
 	light.SpotFalloff = _spotFalloff;
 	light.Fov = _fov;
+	sceneLightId = -1;
 
 	Init();
 }
-ShadowLight::ShadowLight(Light _light, Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context) :
+ShadowLight::ShadowLight(Light _light, Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	int _sceneLightId) :
 	device(_device),
 	context(_context)
 {
 	// Create Light Struct
 	light = _light;
+	sceneLightId = _sceneLightId;
 
 	Init();
 }
 ShadowLight::~ShadowLight() {}
 void ShadowLight::Init()
 {
-	CreateShadowMapData();
+	CreateShadowStates();
 	// Create Vertex Shader
 	shadowVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"ShadowShader.cso").c_str()); 
+	shadowClearVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"ShadowClearVS.cso").c_str());
+	Mesh::CreatePositionInputLayouts(device, shadowVS->GetShaderBlob());
+	// Directional lights cover the camera's view with cascades, refit every Update()
+	cascadeSettings = { MAX_SHADOW_CASCADES, 0.75f, 60.0f, 50.0f };
+	for (unsigned int c = 0; c < MAX_LIGHT_SHADOW_MAPS; c++) { renderedSignatures[c] = 0; }
+	// Point lights far from the camera re-render two faces a frame
+	slicedFacesPerFrame = 2;
+	sliceDistance = 20.0f;
+	slicingFaces = false;
+	nextSlicedFace = 0;
+	renderStats = {};
 	// Create matricies
-	lightProjectionSize = 20.0f;
 	lightProjectionDirty = true;
 	lightViewDirty = true;
 	UpdateProjectionMatrix();
@@ -68,11 +84,6 @@ void ShadowLight::Init()
 //void ShadowLight::SetBackBufferRTV(Microsoft::WRL::ComPtr<ID3D11RenderTargetView> _backBufferRTV) { backBufferRTV = _backBufferRTV; }
 //void ShadowLight::SetDepthBufferDSV(Microsoft::WRL::ComPtr<ID3D11DepthStencilView> _depthBufferDSV) { depthBufferDSV = _depthBufferDSV; }
 //void ShadowLight::SetContext(Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context) { context = _context; }
-void ShadowLight::SetLightProjectionSize(float _lightProjectionSize)
-{
-	lightProjectionSize = _lightProjectionSize;
-	lightProjectionDirty = true;
-}
 void ShadowLight::SetWindowSize(unsigned int* _windowWidth, unsigned int* _windowHeight )
 { 
 	windowWidth = _windowWidth;
@@ -91,29 +102,42 @@ void ShadowLight::SetDirection(DirectX::XMFLOAT3 _direction)
 }
 void ShadowLight::SetPosition(DirectX::XMFLOAT3 _position)
 {
-	if (light.Type != LIGHT_TYPE_SPOT) { return; }
+	if (light.Type == LIGHT_TYPE_DIR) { return; }
 	light.Position = _position;
 	lightViewDirty = true;
 }
+void ShadowLight::SetCascadeSettings(ShadowCascadeSettings _cascadeSettings)
+{
+	cascadeSettings = _cascadeSettings;
+	cascadeSettings.Count = std::min(std::max(cascadeSettings.Count, 1u), (unsigned int)MAX_SHADOW_CASCADES);
+}
+void ShadowLight::SetFaceSlicing(unsigned int facesPerFrame, float distance)
+{
+	slicedFacesPerFrame = std::min(std::max(facesPerFrame, 1u), (unsigned int)POINT_SHADOW_FACES);
+	sliceDistance = distance;
+}
 
-Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ShadowLight::GetShadowSRV() { return shadowSRV; }
 DirectX::XMFLOAT4X4 ShadowLight::GetShadowViewMatrix() { return shadowViewMatrix; }
 DirectX::XMFLOAT4X4 ShadowLight::GetShadowProjectionMatrix() { return shadowProjectionMatrix; }
 Microsoft::WRL::ComPtr<ID3D11SamplerState> ShadowLight::GetShadowSampler() { return shadowSampler; }
 int ShadowLight::GetType() { return light.Type; }
 DirectX::XMFLOAT3 ShadowLight::GetDirection() { return light.Direction; }
 DirectX::XMFLOAT3 ShadowLight::GetPosition() { return light.Position; }
+ShadowCascadeSettings ShadowLight::GetCascadeSettings() { return cascadeSettings; }
+unsigned int ShadowLight::GetCascadeCount()
+{
+	if (light.Type == LIGHT_TYPE_DIR) { return cascadeSettings.Count; }
+	return light.Type == LIGHT_TYPE_POINT ? POINT_SHADOW_FACES : 1;
+}
+const ShadowCascade& ShadowLight::GetCascade(unsigned int index) { return cascades[index]; }
+ShadowRenderStats ShadowLight::GetRenderStats() { return renderStats; }
 
 // Public Functions
-void ShadowLight::Update(std::vector<Entity> entities, std::vector<Entity> transparentEntities,
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> _backBufferRTV,
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> _depthBufferDSV,
-	Microsoft::WRL::ComPtr<ID3D11RasterizerState> _rasterizerState)
+void ShadowLight::Update(std::shared_ptr<Camera> camera)
 {
 	if (lightProjectionDirty) { UpdateProjectionMatrix(); }
 	if (lightViewDirty) { UpdateViewMatrix(); }
-
-	Render(entities, transparentEntities, _backBufferRTV, _depthBufferDSV, _rasterizerState);
+	UpdateCascades(camera);
 }
 
 
@@ -121,48 +145,10 @@ void ShadowLight::Update(std::vector<Entity> entities, std::vector<Entity> trans
 // Private Helper Functions
 
 /// <summary>
-/// Create Depth Stencil view and Shader Resource View
+/// Create the comparison sampler and the depth biased rasterizer state
 /// </summary>
-void ShadowLight::CreateShadowMapData()	
+void ShadowLight::CreateShadowStates()
 {
-	shadowMapResolution = 1024;
-	// Create the actual texture that will be the shadow map
-	D3D11_TEXTURE2D_DESC shadowDesc = {};
-	shadowDesc.Width = shadowMapResolution; // Ideally a power of 2 (like 1024)
-	shadowDesc.Height = shadowMapResolution; // Ideally a power of 2 (like 1024)
-	shadowDesc.ArraySize = 1;
-	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
-	shadowDesc.CPUAccessFlags = 0;
-	shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-	shadowDesc.MipLevels = 1;
-	shadowDesc.MiscFlags = 0;
-	shadowDesc.SampleDesc.Count = 1;
-	shadowDesc.SampleDesc.Quality = 0;
-	shadowDesc.Usage = D3D11_USAGE_DEFAULT;
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
-	device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
-
-	// Create the depth/stencil view
-	D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
-	shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-	shadowDSDesc.Texture2D.MipSlice = 0;
-	device->CreateDepthStencilView(
-		shadowTexture.Get(),
-		&shadowDSDesc,
-		shadowDSV.GetAddressOf());
-
-	// Create the SRV for the shadow map
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	device->CreateShaderResourceView(
-		shadowTexture.Get(),
-		&srvDesc,
-		shadowSRV.GetAddressOf());
-
 	// Create the special "comparison" sampler state for shadows
 	D3D11_SAMPLER_DESC shadowSampDesc = {};
 	shadowSampDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR; // COMPARISON filter!
@@ -185,6 +171,13 @@ void ShadowLight::CreateShadowMapData()
 	shadowRastDesc.DepthBiasClamp = 0.0f;
 	shadowRastDesc.SlopeScaledDepthBias = 1.0f;
 	device->CreateRasterizerState(&shadowRastDesc, &shadowRasterizer);
+
+	// Depth state that overwrites a tile with the far plane whatever is there (see Render())
+	D3D11_DEPTH_STENCIL_DESC clearDepthDesc = {};
+	clearDepthDesc.DepthEnable = true;
+	clearDepthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+	clearDepthDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+	device->CreateDepthStencilState(&clearDepthDesc, &clearDepthState);
 }
 /// <summary>
 /// Update the light projection matrix
@@ -195,20 +188,14 @@ void ShadowLight::UpdateProjectionMatrix()
 	switch (light.Type)
 	{
 	case (LIGHT_TYPE_POINT):
-		printf("Cannot have Point Shadow Light");
-		return;
+		// Each face's projection comes with its view, in UpdateViewMatrix()
+		break;
 	case(LIGHT_TYPE_DIR):
-		// Only needs to be updated if lightProjectionSize changes
-		DirectX::XMMATRIX lightProjection = DirectX::XMMatrixOrthographicLH(
-			lightProjectionSize,
-			lightProjectionSize,
-			0.1f,
-			100.0f);
-		XMStoreFloat4x4(&shadowProjectionMatrix, lightProjection);
+		// Each cascade's projection is fit to the camera in UpdateCascades()
 		break;
 	case(LIGHT_TYPE_SPOT):
 		// Only needs to be updated if light.Fov changes
-		lightProjection = DirectX::XMMatrixPerspectiveFovLH(
+		DirectX::XMMATRIX lightProjection = DirectX::XMMatrixPerspectiveFovLH(
 			light.Fov,
 			1.0f,
 			0.01f,
@@ -228,22 +215,20 @@ void ShadowLight::UpdateViewMatrix()
 	switch (light.Type)
 	{
 	case (LIGHT_TYPE_POINT):
-		printf("Cannot have Point Shadow Light");
-		return;
+	{
+		// Only needs to update if position or range changes
+		float position[3] = { light.Position.x, light.Position.y, light.Position.z };
+		FitPointShadowFaces(position, light.Range, 0.05f, cascades);
+		break;
+	}
 	case(LIGHT_TYPE_DIR):
-		// Only needs to update if direction changes
-		lightDirection = DirectX::XMLoadFloat3(&light.Direction);
-		DirectX::XMMATRIX lightView = DirectX::XMMatrixLookToLH(
-			DirectX::XMVectorScale(lightDirection, -7.5f), // Position: "Backing up" 20 units from origin
-			lightDirection, // Direction: light's direction
-			DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)); // Up: World up vector (Y axis)
-		XMStoreFloat4x4(&shadowViewMatrix, lightView);
+		// Each cascade's view is fit to the camera in UpdateCascades()
 		break;
 	case(LIGHT_TYPE_SPOT):
 		// Only needs to update if direction or position changes
 		lightDirection = DirectX::XMLoadFloat3(&light.Direction);
 		lightPosition = DirectX::XMLoadFloat3(&light.Position);
-		lightView = DirectX::XMMatrixLookToLH(
+		DirectX::XMMATRIX lightView = DirectX::XMMatrixLookToLH(
 			lightPosition, // Position: "Backing up" 20 units from origin
 			lightDirection, // Direction: light's direction
 			DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)); // Up: World up vector (Y axis)
@@ -252,47 +237,186 @@ void ShadowLight::UpdateViewMatrix()
 	}
 }
 
-void ShadowLight::Render(std::vector<Entity> entities, std::vector<Entity> transparentEntities,
+// --------------------------------------------------------
+// Directional lights refit their cascades to the camera;
+// spot lights have a single cascade from their own matrices
+// and point lights only check how far away the camera is
+// --------------------------------------------------------
+void ShadowLight::UpdateCascades(std::shared_ptr<Camera> camera)
+{
+	if (light.Type == LIGHT_TYPE_POINT)
+	{
+		DirectX::XMFLOAT3 cameraPosition = camera->GetPosition();
+		DirectX::XMVECTOR offset = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&cameraPosition), DirectX::XMLoadFloat3(&light.Position));
+		slicingFaces = slicedFacesPerFrame < POINT_SHADOW_FACES && DirectX::XMVectorGetX(DirectX::XMVector3Length(offset)) > sliceDistance;
+		return;
+	}
+	if (light.Type == LIGHT_TYPE_DIR)
+	{
+		DirectX::XMFLOAT4X4 cameraView = camera->GetViewMatrix();
+		DirectX::XMFLOAT4X4 cameraProjection = camera->GetProjMatrix();
+		float direction[3] = { light.Direction.x, light.Direction.y, light.Direction.z };
+		FitShadowCascades(&cameraView._11, &cameraProjection._11, camera->GetNearDist(), camera->GetFarDist(),
+			direction, cascadeSettings, cascades);
+		return;
+	}
+
+	ShadowCascade& cascade = cascades[0];
+	memcpy(cascade.View, &shadowViewMatrix, sizeof(cascade.View));
+	memcpy(cascade.Projection, &shadowProjectionMatrix, sizeof(cascade.Projection));
+	DirectX::XMFLOAT4X4 viewProjection;
+	DirectX::XMStoreFloat4x4(&viewProjection,
+		DirectX::XMLoadFloat4x4(&shadowViewMatrix) * DirectX::XMLoadFloat4x4(&shadowProjectionMatrix));
+	memcpy(cascade.ViewProjection, &viewProjection, sizeof(cascade.ViewProjection));
+	cascade.SplitNear = 0.0f;
+	cascade.SplitFar = light.Range;
+	cascade.Center[0] = light.Position.x;
+	cascade.Center[1] = light.Position.y;
+	cascade.Center[2] = light.Position.z;
+	cascade.Radius = light.Range;
+}
+
+// FNV-1a, folded over everything a shadow map's contents depend on
+static void HashBytes(unsigned long long& hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) { hash = (hash ^ bytes[i]) * 1099511628211ull; }
+}
+
+void ShadowLight::Render(const ShadowAtlas& atlas, unsigned int firstKey, Microsoft::WRL::ComPtr<ID3D11DepthStencilView> atlasDSV,
+	std::vector<Entity>& casters, const std::vector<EntityBounds>& casterBounds, ShadowMomentFilter* momentFilter,
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> _backBufferRTV,
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> _depthBufferDSV,
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> _rasterizerState)
 {
+	renderStats = {};
 	// Setup
-	// Clear the Shadow Map
-	context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-	context->RSSetState(shadowRasterizer.Get());
 	ID3D11RenderTargetView* nullRTV{}; // Set up the output merger stage
-	context->OMSetRenderTargets(1, &nullRTV, shadowDSV.Get());
-	//context->OMSetRenderTargets(0, 0, shadowDSV.Get());
-	D3D11_VIEWPORT viewport = {}; // Change viewport
-	viewport.Width = (float)shadowMapResolution;
-	viewport.Height = (float)shadowMapResolution;
+	context->OMSetRenderTargets(1, &nullRTV, atlasDSV.Get());
+	D3D11_VIEWPORT viewport = {};
 	viewport.MaxDepth = 1.0f;
-	context->RSSetViewports(1, &viewport);
-	// Set Shaders
 	context->PSSetShader(0, 0, 0); // Deactivate the pixel shader
-	shadowVS->SetShader();
-	shadowVS->SetMatrix4x4("view", shadowViewMatrix);
-	shadowVS->SetMatrix4x4("projection", shadowProjectionMatrix);
-	// Entity Render Loop
-	for (auto& e : entities)
+	// A point light works out every caster's faces at once, instead of testing each face's frustum
+	if (light.Type == LIGHT_TYPE_POINT)
+	{
+		float position[3] = { light.Position.x, light.Position.y, light.Position.z };
+		casterFaceMasks.resize(casters.size());
+		for (size_t i = 0; i < casters.size(); i++)
+		{
+			casterFaceMasks[i] = GetPointShadowFaceMask(position, light.Range, casterBounds[i].Center, casterBounds[i].Radius);
+		}
+	}
+	// One pass per cascade (or face), each into its own tile of the atlas
+	for (unsigned int c = 0; c < GetCascadeCount(); c++)
 	{
-		shadowVS->SetMatrix4x4("world", e.GetTransform()->GetWorldMatrix());
-		shadowVS->CopyAllBufferData();
-		// Draw the mesh directly to avoid the entity's material
-		// Note: Your code may differ significantly here!
-		e.GetMesh()->Draw();
+		const ShadowAtlasTile* tile = atlas.GetTile(firstKey + c);
+		if (!tile)
+		{
+			renderedSignatures[c] = 0;
+			continue;
+		}
+		if (light.Type == LIGHT_TYPE_DIR) { SnapShadowCascade(cascades[c], tile->Size); }
+
+		// Only entities whose bounds reach the cascade cast into it
+		visibleCasters.clear();
+		for (size_t i = 0; i < casters.size(); i++)
+		{
+			bool visible = light.Type == LIGHT_TYPE_POINT ? ((casterFaceMasks[i] >> c) & 1) != 0 :
+				IsSphereInShadowMap(cascades[c].ViewProjection, casterBounds[i].Center, casterBounds[i].Radius);
+			if (visible)
+				visibleCasters.push_back((unsigned int)i);
+		}
+		renderStats.CulledCasters += (unsigned int)(casters.size() - visibleCasters.size());
+
+		// Nothing it depends on changed since it was rendered into this same tile, so it's still there
+		unsigned long long signature = 14695981039346656037ull;
+		HashBytes(signature, tile, sizeof(ShadowAtlasTile));
+		HashBytes(signature, cascades[c].ViewProjection, sizeof(cascades[c].ViewProjection));
+		// Turning filtering on or changing how it filters needs the moments redone from the depth
+		if (momentFilter)
+		{
+			ShadowMomentSettings momentSettings = momentFilter->GetSettings();
+			HashBytes(signature, &momentSettings, sizeof(momentSettings));
+		}
+		// Skinned casters move without their transform changing, so a map with one is never reused
+		bool dynamicCasters = false;
+		for (unsigned int i : visibleCasters)
+		{
+			DirectX::XMFLOAT4X4 world = casters[i].GetTransform()->GetWorldMatrix();
+			Mesh* mesh = casters[i].GetMesh().get();
+			bool ready = mesh->IsReady(); // Placeholders draw until it is
+			HashBytes(signature, &i, sizeof(i));
+			HashBytes(signature, &world, sizeof(world));
+			HashBytes(signature, &mesh, sizeof(mesh));
+			HashBytes(signature, &ready, sizeof(ready));
+			dynamicCasters = dynamicCasters || mesh->IsDynamic();
+		}
+		bool tileUnchanged = atlas.IsTileUnchanged(firstKey + c);
+		renderStats.Maps++;
+		if (tileUnchanged && !dynamicCasters && signature == renderedSignatures[c])
+		{
+			renderStats.CachedMaps++;
+			continue;
+		}
+		// Faces outside this frame's slice keep their old contents (and signature, so they're redone in turn)
+		if (slicingFaces && tileUnchanged && renderedSignatures[c] != 0 &&
+			(c + POINT_SHADOW_FACES - nextSlicedFace) % POINT_SHADOW_FACES >= slicedFacesPerFrame)
+		{
+			renderStats.SlicedMaps++;
+			continue;
+		}
+		renderedSignatures[c] = signature;
+
+		viewport.TopLeftX = (float)tile->X; // Change viewport to the tile
+		viewport.TopLeftY = (float)tile->Y;
+		viewport.Width = (float)tile->Size;
+		viewport.Height = (float)tile->Size;
+		context->RSSetViewports(1, &viewport);
+
+		// Clear just this tile: a triangle over it at the far plane
+		context->RSSetState(0);
+		context->OMSetDepthStencilState(clearDepthState.Get(), 0);
+		context->IASetInputLayout(0);
+		shadowClearVS->SetShader();
+		context->Draw(3, 0);
+		context->OMSetDepthStencilState(0, 0);
+
+		context->RSSetState(shadowRasterizer.Get());
+		shadowVS->SetShader();
+		DirectX::XMFLOAT4X4 view;
+		DirectX::XMFLOAT4X4 projection;
+		memcpy(&view, cascades[c].View, sizeof(view));
+		memcpy(&projection, cascades[c].Projection, sizeof(projection));
+		shadowVS->SetMatrix4x4("view", view);
+		shadowVS->SetMatrix4x4("projection", projection);
+		// Entity Render Loop
+		for (unsigned int i : visibleCasters)
+		{
+			Entity& e = casters[i];
+			DirectX::XMFLOAT4X4 world = e.GetTransform()->GetWorldMatrix();
+			DirectX::XMFLOAT4X4 positionTransform = e.GetMesh()->GetPositionTransform();
+			DirectX::XMStoreFloat4x4(&world, DirectX::XMLoadFloat4x4(&positionTransform) * DirectX::XMLoadFloat4x4(&world));
+			shadowVS->SetMatrix4x4("world", world);
+			shadowVS->CopyAllBufferData();
+			// Draw the mesh directly to avoid the entity's material
+			// Note: Your code may differ significantly here!
+			e.GetMesh()->DrawPositionOnly();
+			renderStats.Draws++;
+		}
+
+		// Blurred and mipmapped once here, instead of filtered by every pixel that reads it
+		if (momentFilter)
+		{
+			momentFilter->Filter(*tile, cascades[c].Projection);
+			context->OMSetRenderTargets(1, &nullRTV, atlasDSV.Get());
+			context->PSSetShader(0, 0, 0);
+		}
 	}
-	// Transparent Entities - Skip for now (light passes through)
-	//for (auto& e : transparentEntities)
-	//{
-	//	shadowVS->SetMatrix4x4("world", e.GetTransform()->GetWorldMatrix());
-	//	shadowVS->CopyAllBufferData();
-	//	// Draw the mesh directly to avoid the entity's material
-	//	// Note: Your code may differ significantly here!
-	//	e.GetMesh()->Draw();
-	//}
+	if (slicingFaces) { nextSlicedFace = (nextSlicedFace + slicedFacesPerFrame) % POINT_SHADOW_FACES; }
+	// Transparent entities don't cast shadows (light passes through)
 	// Reset the pipline
+	viewport.TopLeftX = 0.0f;
+	viewport.TopLeftY = 0.0f;
 	viewport.Width = (float)*windowWidth;
 	viewport.Height = (float)*windowHeight;
 	context->RSSetViewports(1, &viewport);
@@ -3,6 +3,24 @@
 #include "DXCore.h"
 #include <vector>
 #include "Entity.h"
+#include "ShadowCascades.h"
+#include "PointShadowFaces.h"
+#include "ShadowAtlas.h"
+#include "ShadowMomentFilter.h"
+#include "EntityBounds.h"
+
+// Most shadow maps one light renders: a point light's cube faces (a directional light has up to MAX_SHADOW_CASCADES)
+#define MAX_LIGHT_SHADOW_MAPS POINT_SHADOW_FACES
+
+// What the last ShadowLight::Render() did
+struct ShadowRenderStats
+{
+	unsigned int Maps;			// Shadow maps with a tile
+	unsigned int CachedMaps;	// Of those, skipped because their tile already held them
+	unsigned int SlicedMaps;	// Of those, point light faces left for a later frame
+	unsigned int Draws;			// Caster draw calls
+	unsigned int CulledCasters;	// Casters outside a shadow map's frustum, summed over maps
+};
 
 class ShadowLight
 {
@@ -32,7 +50,9 @@ public:
 	/// Shadow light for a given light
 	/// </summary>
 	/// <param name="_light">Light to cast shadows</param>
-	ShadowLight(Light _light, Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context);
+	/// <param name="_sceneLightId">LightSet id of the scene light it shadows, or -1 if it lights nothing else</param>
+	ShadowLight(Light _light, Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+		int _sceneLightId = -1);
 	~ShadowLight();
 
 	// Getters and Setters
@@ -40,22 +60,60 @@ public:
 	//static void SetBackBufferRTV(Microsoft::WRL::ComPtr<ID3D11RenderTargetView> _backBufferRTV);
 	//static void SetDepthBufferDSV(Microsoft::WRL::ComPtr<ID3D11DepthStencilView> _depthBufferDSV);
 	//static void SetContext(Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context);
-	void SetLightProjectionSize(float _lightProjectionSize);
 	static void SetWindowSize(unsigned int* _windowWidth, unsigned int* _windowHeight);
 	void SetFov(float _fov);
 	void SetDirection(DirectX::XMFLOAT3 _direction);
 	void SetPosition(DirectX::XMFLOAT3 _position);
+	/// <summary>
+	/// How a directional light's cascades are split and fit
+	/// </summary>
+	void SetCascadeSettings(ShadowCascadeSettings _cascadeSettings);
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetShadowSRV();
 	DirectX::XMFLOAT4X4 GetShadowViewMatrix();
 	DirectX::XMFLOAT4X4 GetShadowProjectionMatrix();
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> GetShadowSampler();
 	int GetType();
+	int GetSceneLightId() { return sceneLightId; }
 	DirectX::XMFLOAT3 GetDirection();
 	DirectX::XMFLOAT3 GetPosition();
+	ShadowCascadeSettings GetCascadeSettings();
+	/// <summary>
+	/// Faces of a point light re-rendered each frame while the camera is farther than distance from it;
+	/// the others keep what was last rendered into their tiles
+	/// </summary>
+	void SetFaceSlicing(unsigned int facesPerFrame, float distance);
+
+	/// <summary>
+	/// Shadow maps this light needs: the cascades of a directional light, a point light's cube faces, or 1
+	/// </summary>
+	unsigned int GetCascadeCount();
+	/// <summary>
+	/// Matrices, depth range and bounds of one shadow map, as of the last Update() (snapped by Render())
+	/// </summary>
+	const ShadowCascade& GetCascade(unsigned int index);
+	ShadowRenderStats GetRenderStats();
+	unsigned int GetSlicedFacesPerFrame() { return slicedFacesPerFrame; }
+	float GetSliceDistance() { return sliceDistance; }
 
 	// Public Functions
-	void Update(std::vector<Entity> entities, std::vector<Entity> transparentEntities,
+	/// <summary>
+	/// Fits the shadow maps to the camera (directional lights) or the light (point and spot lights), ready to
+	/// request atlas tiles for
+	/// </summary>
+	void Update(std::shared_ptr<Camera> camera);
+	/// <summary>
+	/// Renders each shadow map that got a tile into the shadow atlas, drawing only the casters
+	/// inside it. Maps whose tile, matrices and casters haven't changed since they were last
+	/// rendered are left as they are.
+	/// </summary>
+	/// <param name="atlas">Tiles from this frame's Allocate()</param>
+	/// <param name="firstKey">Atlas key of the first cascade; the rest follow it</param>
+	/// <param name="atlasDSV">Depth view of the whole atlas; each tile is cleared before it's rendered</param>
+	/// <param name="casters">Entities that cast shadows</param>
+	/// <param name="casterBounds">World bounding sphere of each caster</param>
+	/// <param name="momentFilter">Filters each map rendered into moments, or null for hardware compared depth only</param>
+	void Render(const ShadowAtlas& atlas, unsigned int firstKey, Microsoft::WRL::ComPtr<ID3D11DepthStencilView> atlasDSV,
+		std::vector<Entity>& casters, const std::vector<EntityBounds>& casterBounds, ShadowMomentFilter* momentFilter,
 		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> _backBufferRTV,
 		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> _depthBufferDSV,
 		Microsoft::WRL::ComPtr<ID3D11RasterizerState> _rasterizerState);
@@ -66,21 +124,30 @@ private:
 	/// </summary>
 	void Init();
 	Light light;
-	// Shadow Map Data
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
+	int sceneLightId;	// LightSet id of the scene light this shadows, or -1
+	// Shadow Map Data: the maps themselves are tiles of the shared shadow atlas
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
-	int shadowMapResolution;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> clearDepthState;
+	unsigned long long renderedSignatures[MAX_LIGHT_SHADOW_MAPS];	// Hash of each map's tile, matrices and casters when last drawn
+	std::vector<unsigned int> visibleCasters;
+	std::vector<unsigned int> casterFaceMasks;	// Point lights: the faces each caster reaches
+	unsigned int slicedFacesPerFrame;
+	float sliceDistance;
+	bool slicingFaces;							// This frame, from the camera's distance
+	unsigned int nextSlicedFace;
+	ShadowRenderStats renderStats;
 	// Light Matrices
 	DirectX::XMFLOAT4X4 shadowViewMatrix;
 	DirectX::XMFLOAT4X4 shadowProjectionMatrix;
 	bool lightViewDirty;
 	bool lightProjectionDirty;
-	float lightProjectionSize;
+	ShadowCascadeSettings cascadeSettings;
+	ShadowCascade cascades[MAX_LIGHT_SHADOW_MAPS];	// Or a point light's faces
 	
 	// Shaders
 	std::shared_ptr<SimpleVertexShader> shadowVS;
+	std::shared_ptr<SimpleVertexShader> shadowClearVS;
 
 	// Game Data
 	Microsoft::WRL::ComPtr<ID3D11Device> device;
@@ -91,13 +158,9 @@ private:
 	//static Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthBufferDSV;
 
 	// Helper Functions
-	void CreateShadowMapData();
+	void CreateShadowStates();
 	void UpdateProjectionMatrix();
 	void UpdateViewMatrix();
-
-	void Render(std::vector<Entity> entities, std::vector<Entity> transparentEntities,
-		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> _backBufferRTV,
-		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> _depthBufferDSV,
-		Microsoft::WRL::ComPtr<ID3D11RasterizerState> _rasterizerState);
+	void UpdateCascades(std::shared_ptr<Camera> camera);
 };
 
@@ -0,0 +1,185 @@
+#include "ShadowMomentFilter.h"
+#include "PathHelpers.h"
+#include <algorithm>
+#include <iostream>
+
+ShadowMomentFilter::ShadowMomentFilter(ShadowAtlasSettings atlasSettings, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> _depthAtlasSRV,
+	Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context) :
+	depthAtlasSRV(_depthAtlasSRV),
+	device(_device),
+	context(_context)
+{
+	// Sharp edges with little bleeding, and a blur a few depth texels wide
+	SetSettings({ 40.0f, 5.0f, 0.0002f, 0.2f, 2 });
+	size = atlasSettings.Size / 2;
+	mipCount = 1;
+	for (unsigned int smallest = atlasSettings.MinTileSize / 2; smallest > 8; smallest /= 2) { mipCount++; }
+	momentAtlasFailed = false;
+	scratchSize = 0;
+
+	fullscreenVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"PostProcessVS.cso").c_str());
+	momentsPS = std::make_shared<SimplePixelShader>(device, context, FixPath(L"ShadowMomentsPS.cso").c_str());
+	blurPS = std::make_shared<SimplePixelShader>(device, context, FixPath(L"ShadowMomentsBlurPS.cso").c_str());
+	downsamplePS = std::make_shared<SimplePixelShader>(device, context, FixPath(L"ShadowMomentsDownsamplePS.cso").c_str());
+
+	// Trilinear, and clamped (the shader keeps lookups inside their tile anyway)
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	device->CreateSamplerState(&samplerDesc, momentSampler.GetAddressOf());
+}
+ShadowMomentFilter::~ShadowMomentFilter() {}
+
+void ShadowMomentFilter::CreateMomentAtlas()
+{
+	// Full float moments: the squared positive moment reaches e^(2 * 42)
+	D3D11_TEXTURE2D_DESC momentDesc = {};
+	momentDesc.Width = size;
+	momentDesc.Height = size;
+	momentDesc.ArraySize = 1;
+	momentDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	momentDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	momentDesc.MipLevels = mipCount;
+	momentDesc.SampleDesc.Count = 1;
+	momentDesc.Usage = D3D11_USAGE_DEFAULT;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> momentTexture;
+	if (FAILED(device->CreateTexture2D(&momentDesc, 0, momentTexture.GetAddressOf())))
+	{
+		std::cerr << "Could not create the " << size << "x" << size << " shadow moment atlas" << std::endl;
+		momentAtlasFailed = true;
+		return;
+	}
+	device->CreateShaderResourceView(momentTexture.Get(), 0, momentSRV.GetAddressOf());
+	// Each mip is drawn into, then read for the next
+	mipRTVs.resize(mipCount);
+	mipSRVs.resize(mipCount);
+	for (unsigned int m = 0; m < mipCount; m++)
+	{
+		D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+		rtvDesc.Format = momentDesc.Format;
+		rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+		rtvDesc.Texture2D.MipSlice = m;
+		device->CreateRenderTargetView(momentTexture.Get(), &rtvDesc, mipRTVs[m].GetAddressOf());
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = momentDesc.Format;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = m;
+		srvDesc.Texture2D.MipLevels = 1;
+		device->CreateShaderResourceView(momentTexture.Get(), &srvDesc, mipSRVs[m].GetAddressOf());
+	}
+}
+
+void ShadowMomentFilter::Filter(const ShadowAtlasTile& tile, const float projection[16])
+{
+	if (!momentSRV && !momentAtlasFailed) { CreateMomentAtlas(); }
+	if (!momentSRV)
+		return;
+	unsigned int momentSize = tile.Size / 2;
+	if (momentSize > scratchSize) { CreateScratch(momentSize); }
+	float weights[MAX_SHADOW_BLUR_RADIUS + 1];
+	GetShadowBlurWeights(settings.BlurRadius, weights);
+	float depthParams[4];
+	GetShadowDepthParams(projection, depthParams);
+	const int depthOrigin[2] = { (int)tile.X, (int)tile.Y };
+	const int momentOrigin[2] = { (int)tile.X / 2, (int)tile.Y / 2 };
+	const float exponents[2] = { settings.PositiveExponent, settings.NegativeExponent };
+
+	// Every pass is a triangle over a viewport, read with Load()
+	context->RSSetState(0);
+	context->OMSetDepthStencilState(0, 0);
+	context->IASetInputLayout(0);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	fullscreenVS->SetShader();
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)momentSize;
+	viewport.Height = (float)momentSize;
+	viewport.MaxDepth = 1.0f;
+
+	// Warp and blur across, into the scratch target's corner
+	context->OMSetRenderTargets(1, scratchRTV.GetAddressOf(), 0);
+	context->RSSetViewports(1, &viewport);
+	momentsPS->SetShader();
+	momentsPS->SetShaderResourceView("DepthAtlas", depthAtlasSRV);
+	momentsPS->SetData("tileOrigin", depthOrigin, sizeof(depthOrigin));
+	momentsPS->SetInt("tileSize", (int)momentSize);
+	momentsPS->SetInt("blurRadius", (int)settings.BlurRadius);
+	momentsPS->SetData("blurWeights", weights, sizeof(weights));
+	momentsPS->SetFloat4("depthParams", depthParams);
+	momentsPS->SetFloat2("exponents", exponents);
+	momentsPS->CopyAllBufferData();
+	context->Draw(3, 0);
+
+	// Blur down, into the tile's place in the moment atlas
+	context->OMSetRenderTargets(1, mipRTVs[0].GetAddressOf(), 0);
+	viewport.TopLeftX = (float)momentOrigin[0];
+	viewport.TopLeftY = (float)momentOrigin[1];
+	context->RSSetViewports(1, &viewport);
+	blurPS->SetShader();
+	blurPS->SetShaderResourceView("Moments", scratchSRV);
+	blurPS->SetData("tileOrigin", momentOrigin, sizeof(momentOrigin));
+	blurPS->SetInt("tileSize", (int)momentSize);
+	blurPS->SetInt("blurRadius", (int)settings.BlurRadius);
+	blurPS->SetData("blurWeights", weights, sizeof(weights));
+	blurPS->CopyAllBufferData();
+	context->Draw(3, 0);
+
+	// Then the tile's mips, each from the one above
+	downsamplePS->SetShader();
+	for (unsigned int m = 1; m < mipCount && (momentSize >> m) > 0; m++)
+	{
+		ID3D11ShaderResourceView* nullSRV = 0;
+		context->PSSetShaderResources(0, 1, &nullSRV);
+		context->OMSetRenderTargets(1, mipRTVs[m].GetAddressOf(), 0);
+		viewport.TopLeftX = (float)(momentOrigin[0] >> m);
+		viewport.TopLeftY = (float)(momentOrigin[1] >> m);
+		viewport.Width = (float)(momentSize >> m);
+		viewport.Height = (float)(momentSize >> m);
+		context->RSSetViewports(1, &viewport);
+		downsamplePS->SetShaderResourceView("Moments", mipSRVs[m - 1]);
+		context->Draw(3, 0);
+	}
+
+	// Nothing stays bound, so the moment atlas can be read and the depth atlas drawn into
+	ID3D11ShaderResourceView* nullSRV = 0;
+	context->PSSetShaderResources(0, 1, &nullSRV);
+	ID3D11RenderTargetView* nullRTV = 0;
+	context->OMSetRenderTargets(1, &nullRTV, 0);
+}
+
+void ShadowMomentFilter::SetSettings(ShadowMomentSettings _settings)
+{
+	settings = _settings;
+	settings.PositiveExponent = std::min(std::max(settings.PositiveExponent, 0.0f), 42.0f);
+	settings.NegativeExponent = std::min(std::max(settings.NegativeExponent, 0.0f), 42.0f);
+	settings.MinDeviation = std::max(settings.MinDeviation, 0.0f);
+	settings.LightBleedReduction = std::min(std::max(settings.LightBleedReduction, 0.0f), 0.99f);
+	settings.BlurRadius = std::min(settings.BlurRadius, (unsigned int)MAX_SHADOW_BLUR_RADIUS);
+}
+
+DirectX::XMFLOAT4 ShadowMomentFilter::GetShaderParams()
+{
+	return DirectX::XMFLOAT4(settings.PositiveExponent, settings.NegativeExponent, settings.MinDeviation, settings.LightBleedReduction);
+}
+
+void ShadowMomentFilter::CreateScratch(unsigned int _scratchSize)
+{
+	scratchSize = _scratchSize;
+	scratchRTV.Reset();
+	scratchSRV.Reset();
+	D3D11_TEXTURE2D_DESC scratchDesc = {};
+	scratchDesc.Width = scratchSize;
+	scratchDesc.Height = scratchSize;
+	scratchDesc.ArraySize = 1;
+	scratchDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	scratchDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	scratchDesc.MipLevels = 1;
+	scratchDesc.SampleDesc.Count = 1;
+	scratchDesc.Usage = D3D11_USAGE_DEFAULT;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> scratchTexture;
+	device->CreateTexture2D(&scratchDesc, 0, scratchTexture.GetAddressOf());
+	device->CreateRenderTargetView(scratchTexture.Get(), 0, scratchRTV.GetAddressOf());
+	device->CreateShaderResourceView(scratchTexture.Get(), 0, scratchSRV.GetAddressOf());
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "DXCore.h"
+#include <memory>
+#include <vector>
+#include "SimpleShader.h"
+#include "ShadowAtlas.h"
+#include "ShadowMoments.h"
+
+// --------------------------------------------------------
+// Turns tiles of the shadow atlas into filtered moments
+// (see ShadowMoments.h), for the filtered shadow mode
+//
+// The moment atlas mirrors the depth atlas at half its
+// resolution: each tile lands at half its depth tile's
+// place and size, so the quad-tree packing still holds at
+// every mip. Filtering a tile warps its depths, blurs them
+// across into a scratch target and down into the moment
+// atlas, then averages the tile's own mips. It only runs
+// when a shadow map is rendered, so cached maps keep their
+// filtered moments too.
+//
+// The moment atlas is full float with a mip chain (about
+// 85MB for a 4096 depth atlas), so it isn't created until
+// the first Filter(), when filtered shadows are turned on.
+// --------------------------------------------------------
+class ShadowMomentFilter
+{
+public:
+	/// <summary>
+	/// Sets up filtering for a depth atlas (the moment atlas waits for the first Filter())
+	/// </summary>
+	/// <param name="atlasSettings">Depth atlas size, and its smallest tile (which bounds the mip count)</param>
+	/// <param name="_depthAtlasSRV">The depth atlas, read while filtering</param>
+	ShadowMomentFilter(ShadowAtlasSettings atlasSettings, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> _depthAtlasSRV,
+		Microsoft::WRL::ComPtr<ID3D11Device> _device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context);
+	~ShadowMomentFilter();
+
+	/// <summary>
+	/// Filters one freshly rendered tile into the moment atlas, creating the atlas the first
+	/// time. Leaves no render target or depth buffer bound.
+	/// </summary>
+	/// <param name="tile">Tile in the depth atlas</param>
+	/// <param name="projection">The shadow map's projection, to make its depth linear</param>
+	void Filter(const ShadowAtlasTile& tile, const float projection[16]);
+
+	void SetSettings(ShadowMomentSettings _settings);
+	ShadowMomentSettings GetSettings() { return settings; }
+	// Null until the first Filter()
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetMomentSRV() { return momentSRV; }
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> GetSampler() { return momentSampler; }
+	unsigned int GetSize() { return size; }
+	unsigned int GetMipCount() { return mipCount; }
+	/// <summary>
+	/// What PBR.hlsli's MomentShadow() needs: the exponents, smallest deviation and light bleed reduction
+	/// </summary>
+	DirectX::XMFLOAT4 GetShaderParams();
+
+private:
+	ShadowMomentSettings settings;
+	unsigned int size;			// Moment texels across, half the depth atlas
+	unsigned int mipCount;		// Until the smallest tile is 8 texels across
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> depthAtlasSRV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> momentSRV;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11RenderTargetView>> mipRTVs;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> mipSRVs;
+	bool momentAtlasFailed;		// Creating it failed, so filtering is skipped rather than retried
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> momentSampler;
+	// Blurred across, before the blur down; grows to the largest tile filtered
+	unsigned int scratchSize;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> scratchRTV;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchSRV;
+
+	std::shared_ptr<SimpleVertexShader> fullscreenVS;
+	std::shared_ptr<SimplePixelShader> momentsPS;
+	std::shared_ptr<SimplePixelShader> blurPS;
+	std::shared_ptr<SimplePixelShader> downsamplePS;
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	void CreateMomentAtlas();
+	void CreateScratch(unsigned int _scratchSize);
+};
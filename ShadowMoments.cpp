@@ -0,0 +1,130 @@
+#include "ShadowMoments.h"
+#include <algorithm>
+#include <cmath>
+
+// Chebyshev's upper bound on how much of a filtered region is at or past value, less the bleeding cut
+static float ChebyshevUpperBound(float mean, float meanSq, float value, float minVariance, float lightBleedReduction)
+{
+	if (value <= mean)
+		return 1.0f;
+	float variance = std::max(meanSq - mean * mean, minVariance);
+	float difference = value - mean;
+	float lit = variance / (variance + difference * difference);
+	return std::min(std::max((lit - lightBleedReduction) / (1.0f - lightBleedReduction), 0.0f), 1.0f);
+}
+
+// Exponents past 42 overflow a float once squared; settings from the UI can go anywhere
+static void GetExponents(const ShadowMomentSettings& settings, float exponents[2])
+{
+	exponents[0] = std::min(std::max(settings.PositiveExponent, 0.0f), 42.0f);
+	exponents[1] = std::min(std::max(settings.NegativeExponent, 0.0f), 42.0f);
+}
+
+void GetShadowDepthParams(const float projection[16], float params[4])
+{
+	// Perspective: depth = P33 + P43 / z, so z = P43 / (depth - P33), near = -P43 / P33, far = P43 / (1 - P33)
+	bool perspective = projection[11] != 0.0f;
+	if (!perspective)
+	{
+		params[0] = 1.0f;
+		params[1] = 0.0f;
+		params[2] = 1.0f;
+		params[3] = 0.0f;
+		return;
+	}
+	float nearDist = -projection[14] / projection[10];
+	float farDist = projection[14] / (1.0f - projection[10]);
+	params[0] = projection[10];
+	params[1] = projection[14];
+	params[2] = 1.0f / (farDist - nearDist);
+	params[3] = nearDist;
+}
+
+float LinearizeShadowDepth(float depth, const float params[4])
+{
+	float linear = params[1] == 0.0f ? depth : (params[1] / (depth - params[0]) - params[3]) * params[2];
+	return std::min(std::max(linear, 0.0f), 1.0f);
+}
+
+void GetShadowMoments(float depth, const ShadowMomentSettings& settings, float moments[4])
+{
+	float exponents[2];
+	GetExponents(settings, exponents);
+	float positive = expf(exponents[0] * depth);
+	float negative = -expf(-exponents[1] * depth);
+	moments[0] = positive;
+	moments[1] = positive * positive;
+	moments[2] = negative;
+	moments[3] = negative * negative;
+}
+
+float GetMomentShadow(const float moments[4], float depth, const ShadowMomentSettings& settings)
+{
+	float exponents[2];
+	GetExponents(settings, exponents);
+	float lightBleedReduction = std::min(std::max(settings.LightBleedReduction, 0.0f), 0.99f);
+	float positive = expf(exponents[0] * depth);
+	float negative = -expf(-exponents[1] * depth);
+
+	// The smallest variance is the smallest deviation carried through each warp's slope
+	float positiveDeviation = settings.MinDeviation * exponents[0] * positive;
+	float negativeDeviation = settings.MinDeviation * exponents[1] * negative;
+	float positiveLit = ChebyshevUpperBound(moments[0], moments[1], positive, positiveDeviation * positiveDeviation, lightBleedReduction);
+	float negativeLit = ChebyshevUpperBound(moments[2], moments[3], negative, negativeDeviation * negativeDeviation, lightBleedReduction);
+	return std::min(positiveLit, negativeLit);
+}
+
+void GetShadowBlurWeights(unsigned int radius, float weights[MAX_SHADOW_BLUR_RADIUS + 1])
+{
+	radius = std::min(radius, (unsigned int)MAX_SHADOW_BLUR_RADIUS);
+	// Two deviations fit inside the radius
+	float sigma = std::max(radius * 0.5f, 0.5f);
+	float total = 0.0f;
+	for (unsigned int i = 0; i <= MAX_SHADOW_BLUR_RADIUS; i++)
+	{
+		weights[i] = i <= radius ? expf(-(float)(i * i) / (2.0f * sigma * sigma)) : 0.0f;
+		total += i == 0 ? weights[i] : 2.0f * weights[i];
+	}
+	for (unsigned int i = 0; i <= radius; i++) { weights[i] /= total; }
+}
+
+void FilterShadowMoments(const float* depths, unsigned int size, const float params[4],
+	const ShadowMomentSettings& settings, std::vector<float>& moments)
+{
+	int half = (int)size / 2;
+	int radius = (int)std::min(settings.BlurRadius, (unsigned int)MAX_SHADOW_BLUR_RADIUS);
+	float weights[MAX_SHADOW_BLUR_RADIUS + 1];
+	GetShadowBlurWeights(radius, weights);
+
+	// Warp, then average 2x2 depths into each moment texel
+	std::vector<float> warped(half * half * 4, 0.0f);
+	for (int y = 0; y < half; y++)
+		for (int x = 0; x < half; x++)
+			for (int t = 0; t < 4; t++)
+			{
+				float texelMoments[4];
+				float depth = depths[(y * 2 + (t >> 1)) * size + x * 2 + (t & 1)];
+				GetShadowMoments(LinearizeShadowDepth(depth, params), settings, texelMoments);
+				for (int m = 0; m < 4; m++) { warped[(y * half + x) * 4 + m] += texelMoments[m] * 0.25f; }
+			}
+
+	// Blur across, then down, repeating the tile's edge texels past it
+	std::vector<float> across(half * half * 4, 0.0f);
+	moments.assign(half * half * 4, 0.0f);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		const std::vector<float>& source = pass == 0 ? warped : across;
+		std::vector<float>& destination = pass == 0 ? across : moments;
+		for (int y = 0; y < half; y++)
+			for (int x = 0; x < half; x++)
+				for (int k = -radius; k <= radius; k++)
+				{
+					int sampleX = pass == 0 ? std::min(std::max(x + k, 0), half - 1) : x;
+					int sampleY = pass == 1 ? std::min(std::max(y + k, 0), half - 1) : y;
+					for (int m = 0; m < 4; m++)
+					{
+						destination[(y * half + x) * 4 + m] += weights[std::abs(k)] * source[(sampleY * half + sampleX) * 4 + m];
+					}
+				}
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+
+// Widest separable blur of the moments, in moment texels either side (weights are two float4s in the shaders)
+#define MAX_SHADOW_BLUR_RADIUS 7
+
+// --------------------------------------------------------
+// Exponential variance shadow maps (EVSM): the math behind
+// the filtered shadow mode, on the CPU
+//
+// Instead of depth, a filtered shadow map stores the mean
+// and mean square of two warped depths, e^(c d) and
+// -e^(-c d). Those average linearly, so the map can be
+// blurred and mipmapped once when it's rendered, and one
+// bilinear fetch then gives a soft shadow through
+// Chebyshev's inequality. The exponents keep light from
+// bleeding through where casters overlap, and taking the
+// darker of the two bounds removes most of the rest.
+//
+// Depths are made linear from 0 to 1 first, so perspective
+// maps filter as evenly as orthographic ones.
+// ShadowMomentsPS.hlsl, ShadowMomentsBlurPS.hlsl and
+// ShadowMoments.hlsli do the same on the GPU; this is the
+// reference to check them against.
+// --------------------------------------------------------
+
+struct ShadowMomentSettings
+{
+	float PositiveExponent;		// Up to 42, so squared moments still fit a float
+	float NegativeExponent;
+	float MinDeviation;			// Smallest standard deviation in linear depth, hides float error on flat receivers
+	float LightBleedReduction;	// 0 to 1, how much of a bound is cut off as light bleeding
+	unsigned int BlurRadius;	// Moment texels either side, up to MAX_SHADOW_BLUR_RADIUS
+};
+
+/// <summary>
+/// Everything needed to make a shadow map's depth linear, from its projection
+/// </summary>
+/// <param name="projection">Row major (XMMatrixPerspectiveFovLH or XMMatrixOrthographicLH)</param>
+/// <param name="params">Receives the projection's z scale and offset, 1 / depth range and near plane; the offset is 0 for orthographic maps, whose depth is linear already</param>
+void GetShadowDepthParams(const float projection[16], float params[4]);
+/// <summary>
+/// A depth from the shadow map, linear from 0 at the near plane to 1 at the far plane
+/// </summary>
+float LinearizeShadowDepth(float depth, const float params[4]);
+/// <summary>
+/// The four moments one linear depth warps to: e^(c+ d), its square, -e^(-c- d) and its square
+/// </summary>
+void GetShadowMoments(float depth, const ShadowMomentSettings& settings, float moments[4]);
+/// <summary>
+/// How lit a linear depth is by filtered moments, from 0 to 1
+/// </summary>
+float GetMomentShadow(const float moments[4], float depth, const ShadowMomentSettings& settings);
+/// <summary>
+/// Normalized Gaussian weights of the separable blur, from the center tap out
+/// </summary>
+/// <param name="weights">Receives radius + 1 weights; the rest are zeroed</param>
+void GetShadowBlurWeights(unsigned int radius, float weights[MAX_SHADOW_BLUR_RADIUS + 1]);
+/// <summary>
+/// Filters one tile the way the GPU does: each moment texel averages the moments of 2x2 depths,
+/// then the tile is blurred across and down, clamped at its edges
+/// </summary>
+/// <param name="depths">size * size depths from the shadow map, row by row</param>
+/// <param name="size">Depth texels across (even)</param>
+/// <param name="params">From GetShadowDepthParams()</param>
+/// <param name="moments">Receives (size / 2)^2 texels of four moments each</param>
+void FilterShadowMoments(const float* depths, unsigned int size, const float params[4],
+	const ShadowMomentSettings& settings, std::vector<float>& moments);
@@ -0,0 +1,43 @@
+#ifndef __GGP_SHADOW_MOMENTS__
+#define __GGP_SHADOW_MOMENTS__
+
+// Exponential variance shadow maps, matching ShadowMoments.cpp
+
+// A depth from a shadow map, linear from 0 at its near plane to 1 at its far plane
+// params: projection z scale and offset (0 offset for orthographic maps), 1 / depth range, near plane
+float LinearizeShadowDepth(float depth, float4 params)
+{
+    return saturate(params.y == 0.0f ? depth : (params.y / (depth - params.x) - params.w) * params.z);
+}
+
+// e^(c+ d), its square, -e^(-c- d) and its square
+float4 GetShadowMoments(float depth, float2 exponents)
+{
+    float2 warped = float2(exp(exponents.x * depth), -exp(-exponents.y * depth));
+    return float4(warped.x, warped.x * warped.x, warped.y, warped.y * warped.y);
+}
+
+// Chebyshev's upper bound on how much of a filtered region is at or past value, less the bleeding cut
+float ChebyshevUpperBound(float2 moments, float value, float minVariance, float lightBleedReduction)
+{
+    if (value <= moments.x)
+        return 1.0f;
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float difference = value - moments.x;
+    float lit = variance / (variance + difference * difference);
+    return saturate((lit - lightBleedReduction) / (1.0f - lightBleedReduction));
+}
+
+// How lit a linear depth is by filtered moments
+// params: positive and negative exponents, smallest deviation in linear depth, light bleed reduction
+float MomentShadow(float4 moments, float depth, float4 params)
+{
+    float2 warped = float2(exp(params.x * depth), -exp(-params.y * depth));
+    // The smallest variance is the smallest deviation carried through each warp's slope
+    float2 minDeviation = params.z * params.xy * warped;
+    float positiveLit = ChebyshevUpperBound(moments.xy, warped.x, minDeviation.x * minDeviation.x, params.w);
+    float negativeLit = ChebyshevUpperBound(moments.zw, warped.y, minDeviation.y * minDeviation.y, params.w);
+    return min(positiveLit, negativeLit);
+}
+
+#endif
@@ -0,0 +1,25 @@
+cbuffer externalData : register(b0)
+{
+    int2 tileOrigin;        // Moment tile's top left texel in the moment atlas
+    int tileSize;           // Moment texels across
+    int blurRadius;
+    float4 blurWeights[2];  // Center tap out (see GetShadowBlurWeights())
+}
+Texture2D Moments : register(t0); // Blurred across by ShadowMomentsPS, at the scratch target's top left
+
+// --------------------------------------------------------
+// Second pass of filtering a shadow map: blurs the moments
+// down, into the tile's place in the moment atlas
+// --------------------------------------------------------
+float4 main(float4 position : SV_POSITION) : SV_TARGET
+{
+    int2 texel = int2(position.xy) - tileOrigin;
+    float4 total = 0;
+    for (int y = -blurRadius; y <= blurRadius; y++)
+    {
+        int2 sampleTexel = int2(texel.x, clamp(texel.y + y, 0, tileSize - 1));
+        uint tap = abs(y);
+        total += blurWeights[tap >> 2][tap & 3] * Moments.Load(int3(sampleTexel, 0));
+    }
+    return total;
+}
@@ -0,0 +1,16 @@
+Texture2D Moments : register(t0); // The mip above the one drawn into
+
+// --------------------------------------------------------
+// Averages 2x2 moment texels into the next mip, over one
+// tile's viewport. Moments average linearly, so the mips
+// filter as well as the blur did.
+// --------------------------------------------------------
+float4 main(float4 position : SV_POSITION) : SV_TARGET
+{
+    int2 texel = int2(position.xy) * 2;
+    return 0.25f * (
+        Moments.Load(int3(texel, 0)) +
+        Moments.Load(int3(texel + int2(1, 0), 0)) +
+        Moments.Load(int3(texel + int2(0, 1), 0)) +
+        Moments.Load(int3(texel + int2(1, 1), 0)));
+}
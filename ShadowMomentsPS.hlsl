@@ -0,0 +1,44 @@
+#include "ShadowMoments.hlsli"
+
+cbuffer externalData : register(b0)
+{
+    int2 tileOrigin;        // Depth tile's top left texel in the atlas
+    int tileSize;           // Moment texels across, half the depth tile's
+    int blurRadius;
+    float4 blurWeights[2];  // Center tap out (see GetShadowBlurWeights())
+    float4 depthParams;     // See LinearizeShadowDepth()
+    float2 exponents;
+}
+Texture2D DepthAtlas : register(t0);
+
+// Averaged moments of the 2x2 depths under one moment texel
+float4 DownsampledMoments(int2 texel)
+{
+    int2 depthTexel = tileOrigin + texel * 2;
+    float4 moments = 0;
+    for (int t = 0; t < 4; t++)
+    {
+        float depth = DepthAtlas.Load(int3(depthTexel + int2(t & 1, t >> 1), 0)).r;
+        moments += GetShadowMoments(LinearizeShadowDepth(depth, depthParams), exponents);
+    }
+    return moments * 0.25f;
+}
+
+// --------------------------------------------------------
+// First pass of filtering a shadow map: warps a depth tile
+// into moments at half resolution and blurs them across.
+// Drawn over a scratch target the size of the moment tile.
+// --------------------------------------------------------
+float4 main(float4 position : SV_POSITION) : SV_TARGET
+{
+    int2 texel = int2(position.xy);
+    float4 total = 0;
+    for (int x = -blurRadius; x <= blurRadius; x++)
+    {
+        // Past the tile's edges are other shadow maps, so its edge texels repeat instead
+        int2 sampleTexel = int2(clamp(texel.x + x, 0, tileSize - 1), texel.y);
+        uint tap = abs(x);
+        total += blurWeights[tap >> 2][tap & 3] * DownsampledMoments(sampleTexel);
+    }
+    return total;
+}
@@ -7,10 +7,17 @@ cbuffer externalData : register(b0)
     matrix view;
     matrix projection;
 };
+// Only positions are read, so meshes can bind their position-only
+// stream (Mesh::DrawPositionOnly()) instead of full vertices
+struct PositionOnlyInput
+{
+    float3 localPosition : POSITION;
+};
+
 // --------------------------------------------------------
 // A simplified vertex shader for rendering to a shadow map
 // --------------------------------------------------------
-float4 main(VertexShaderInput input) : SV_POSITION
+float4 main(PositionOnlyInput input) : SV_POSITION
 {
     matrix wvp = mul(projection, mul(view, world));
     return mul(wvp, float4(input.localPosition, 1.0f));
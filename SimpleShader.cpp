@@ -4,6 +4,9 @@
 bool ISimpleShader::ReportErrors = true;
 bool ISimpleShader::ReportWarnings = true;
 
+// Upload counters shared by all shaders
+SimpleShaderUploadStats ISimpleShader::UploadStats;
+
 // To enable error reporting, use either or both 
 // of the following lines somewhere in your program, 
 // preferably before loading/using any shaders.
@@ -203,6 +206,11 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
 		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
 
+		// The GPU buffer has no initial data, so the first copy must send everything
+		constantBuffers[b].Dirty = true;
+		constantBuffers[b].DirtyStart = 0;
+		constantBuffers[b].DirtyEnd = bufferDesc.Size;
+
 		// Loop through all variables in this buffer
 		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
 		{
@@ -345,13 +353,10 @@ void ISimpleShader::CopyAllBufferData()
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
-	// Loop through the constant buffers and copy all data
+	// Loop through the constant buffers and copy any that have changed
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		UploadConstantBuffer(&constantBuffers[i]);
 	}
 }
 
@@ -379,10 +384,8 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	SimpleConstantBuffer* cb = &this->constantBuffers[index];
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	UploadConstantBuffer(cb);
 }
 
 // --------------------------------------------------------
@@ -401,12 +404,51 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
 	if (!cb) return;
 
-	// Copy the data and get out
+	// Copy the data (if it changed) and get out
+	UploadConstantBuffer(cb);
+}
+
+
+// --------------------------------------------------------
+// Copies a constant buffer's local data to the GPU, but only
+// if SetData() has changed it since the last copy
+//
+// NOTE: D3D11.0 cannot partially update a constant buffer,
+//       so the whole buffer is sent; the dirty range is
+//       tracked for the upload statistics
+// --------------------------------------------------------
+void ISimpleShader::UploadConstantBuffer(SimpleConstantBuffer* cb)
+{
+	// Nothing changed since the last copy?
+	if (!cb->Dirty)
+	{
+		UploadStats.BuffersSkipped++;
+		return;
+	}
+
+	// Copy the entire local data buffer
 	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
+		cb->ConstantBuffer.Get(), 0, 0,
 		cb->LocalDataBuffer, 0, 0);
+
+	// Track the upload
+	UploadStats.BuffersUploaded++;
+	UploadStats.BytesUploaded += cb->Size;
+	UploadStats.DirtyBytes += cb->DirtyEnd - cb->DirtyStart;
+
+	// Buffer is clean again
+	cb->Dirty = false;
+	cb->DirtyStart = 0;
+	cb->DirtyEnd = 0;
 }
 
+// --------------------------------------------------------
+// Resets the upload counters (usually once per frame)
+// --------------------------------------------------------
+void ISimpleShader::ResetUploadStats()
+{
+	UploadStats = {};
+}
 
 // --------------------------------------------------------
 // Sets a variable by name with arbitrary data of the specified size
@@ -445,11 +487,30 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		return false;
 	}
 
+	// Skip the copy if the data is identical, so that
+	// re-setting the same value doesn't dirty the buffer
+	SimpleConstantBuffer* cb = &constantBuffers[var->ConstantBufferIndex];
+	unsigned char* dest = cb->LocalDataBuffer + var->ByteOffset;
+	if (memcmp(dest, data, size) == 0)
+		return true;
+
 	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	memcpy(dest, data, size);
+
+	// Grow the dirty range to include these bytes
+	unsigned int start = var->ByteOffset;
+	unsigned int end = var->ByteOffset + size;
+	if (!cb->Dirty)
+	{
+		cb->Dirty = true;
+		cb->DirtyStart = start;
+		cb->DirtyEnd = end;
+	}
+	else
+	{
+		if (start < cb->DirtyStart) cb->DirtyStart = start;
+		if (end > cb->DirtyEnd) cb->DirtyEnd = end;
+	}
 
 	// Success
 	return true;
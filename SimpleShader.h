@@ -37,6 +37,24 @@ struct SimpleConstantBuffer
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffer = 0;
 	unsigned char* LocalDataBuffer = 0;
 	std::vector<SimpleShaderVariable> Variables;
+
+	// Dirty tracking - set by SetData() when bytes actually
+	// change, cleared once the buffer is copied to the GPU
+	bool Dirty = true;
+	unsigned int DirtyStart = 0;	// First dirty byte (inclusive)
+	unsigned int DirtyEnd = 0;		// Last dirty byte (exclusive)
+};
+
+// --------------------------------------------------------
+// Counters for constant buffer uploads, accumulated
+// across all shaders until ResetUploadStats() is called
+// --------------------------------------------------------
+struct SimpleShaderUploadStats
+{
+	unsigned int BuffersUploaded = 0;	// Buffers actually copied to the GPU
+	unsigned int BuffersSkipped = 0;	// Copy requests skipped because nothing changed
+	unsigned int BytesUploaded = 0;		// Total bytes copied to the GPU
+	unsigned int DirtyBytes = 0;		// Bytes inside the dirty ranges of uploaded buffers
 };
 
 // --------------------------------------------------------
@@ -122,6 +140,10 @@ public:
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Upload statistics
+	static SimpleShaderUploadStats UploadStats;
+	static void ResetUploadStats();
+
 protected:
 	
 	bool shaderValid;
@@ -154,6 +176,9 @@ protected:
 	SimpleShaderVariable* FindVariable(std::string name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
 
+	// Helper for copying a single buffer to the GPU if it is dirty
+	void UploadConstantBuffer(SimpleConstantBuffer* cb);
+
 	// Error logging
 	void Log(std::string message, WORD color);
 	void LogW(std::wstring message, WORD color);
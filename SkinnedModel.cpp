@@ -0,0 +1,226 @@
+#include "SkinnedModel.h"
+#include <iostream>
+#include <unordered_map>
+#include <algorithm>
+
+#include <assimp/cimport.h>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+using namespace DirectX;
+
+// Same post processing as Mesh's imports (LimitBoneWeights is part of the preset, capping
+// influences at 4), so the geometry matches a static load of the same file
+static const unsigned int SKINNED_IMPORT_FLAGS = aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_ConvertToLeftHanded;
+
+// Assimp matrices are meant for column vectors, DirectXMath uses row vectors
+static XMMATRIX LoadAssimpMatrix(const aiMatrix4x4& m)
+{
+	XMFLOAT4X4 rows(
+		m.a1, m.b1, m.c1, m.d1,
+		m.a2, m.b2, m.c2, m.d2,
+		m.a3, m.b3, m.c3, m.d3,
+		m.a4, m.b4, m.c4, m.d4);
+	return XMLoadFloat4x4(&rows);
+}
+
+// Adds a node and its children to the skeleton, parents first
+static void AddJoints(const aiNode* node, int parent, Skeleton& skeleton,
+	std::unordered_map<std::string, unsigned int>& jointIndices, std::vector<int>& meshJoints)
+{
+	SkeletonJoint joint;
+	joint.Name = node->mName.C_Str();
+	joint.Parent = parent;
+	XMVECTOR scale, rotation, translation;
+	XMMatrixDecompose(&scale, &rotation, &translation, LoadAssimpMatrix(node->mTransformation));
+	XMStoreFloat3(&joint.BindPose.Scale, scale);
+	XMStoreFloat4(&joint.BindPose.Rotation, rotation);
+	XMStoreFloat3(&joint.BindPose.Translation, translation);
+
+	unsigned int index = (unsigned int)skeleton.Joints.size();
+	skeleton.Joints.push_back(joint);
+	jointIndices.emplace(joint.Name, index);
+	for (unsigned int m = 0; m < node->mNumMeshes; m++) { meshJoints[node->mMeshes[m]] = (int)index; }
+
+	for (unsigned int c = 0; c < node->mNumChildren; c++)
+	{
+		AddJoints(node->mChildren[c], (int)index, skeleton, jointIndices, meshJoints);
+	}
+}
+
+// Adds a vertex influence, keeping the strongest SKIN_MAX_INFLUENCES sorted by weight
+static void AddInfluence(SkinWeights& weights, unsigned int bone, float weight)
+{
+	for (unsigned int i = 0; i < SKIN_MAX_INFLUENCES; i++)
+	{
+		if (weight > weights.Weights[i])
+		{
+			for (unsigned int j = SKIN_MAX_INFLUENCES - 1; j > i; j--)
+			{
+				weights.Bones[j] = weights.Bones[j - 1];
+				weights.Weights[j] = weights.Weights[j - 1];
+			}
+			weights.Bones[i] = (unsigned char)bone;
+			weights.Weights[i] = weight;
+			return;
+		}
+	}
+}
+
+bool LoadSkinnedModel(const std::string& filePath, SkinnedModel& model)
+{
+	const aiScene* scene = aiImportFile(filePath.c_str(), SKINNED_IMPORT_FLAGS);
+	if (!scene || !scene->mRootNode)
+	{
+		std::cerr << "Could not load file " << filePath << ": " << aiGetErrorString() << std::endl;
+		return false;
+	}
+
+	model = SkinnedModel();
+	Skeleton& skeleton = model.Rig;
+
+	// Every node becomes a joint, so bones can hang off (and animate under) plain nodes
+	std::unordered_map<std::string, unsigned int> jointIndices;
+	std::vector<int> meshJoints(scene->mNumMeshes, 0);
+	AddJoints(scene->mRootNode, -1, skeleton, jointIndices, meshJoints);
+	XMStoreFloat4x4(&skeleton.RootInverse, XMMatrixInverse(nullptr, LoadAssimpMatrix(scene->mRootNode->mTransformation)));
+
+	// Bones are shared between parts by name; parts without bones get a bone for their own node
+	std::unordered_map<std::string, unsigned int> boneIndices;
+	auto getBone = [&](const std::string& key, unsigned int joint, const XMFLOAT4X4& offset)
+	{
+		auto existing = boneIndices.find(key);
+		if (existing != boneIndices.end()) { return existing->second; }
+		unsigned int index = (unsigned int)skeleton.Bones.size();
+		skeleton.Bones.push_back({ joint, offset });
+		boneIndices.emplace(key, index);
+		return index;
+	};
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+	for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+	{
+		const aiMesh* readMesh = scene->mMeshes[m];
+		if (!readMesh->HasPositions() || !readMesh->HasNormals() || !readMesh->HasFaces())
+			continue;
+
+		MeshSubmeshRange range = {};
+		range.StartIndex = (unsigned int)model.Indices.size();
+		range.BaseVertex = (unsigned int)model.Vertices.size();
+		range.MaterialIndex = readMesh->mMaterialIndex;
+
+		for (unsigned int i = 0; i < readMesh->mNumVertices; i++)
+		{
+			Vertex v = {};
+			v.Position = XMFLOAT3(readMesh->mVertices[i].x, readMesh->mVertices[i].y, readMesh->mVertices[i].z);
+			v.Normal = XMFLOAT3(readMesh->mNormals[i].x, readMesh->mNormals[i].y, readMesh->mNormals[i].z);
+			if (readMesh->HasTextureCoords(0))
+				v.UV = XMFLOAT2(readMesh->mTextureCoords[0][i].x, readMesh->mTextureCoords[0][i].y);
+			if (readMesh->HasTangentsAndBitangents())
+				v.Tangent = XMFLOAT3(readMesh->mTangents[i].x, readMesh->mTangents[i].y, readMesh->mTangents[i].z);
+			model.Vertices.push_back(v);
+		}
+		model.Weights.resize(model.Vertices.size(), SkinWeights());
+
+		for (unsigned int b = 0; b < readMesh->mNumBones; b++)
+		{
+			const aiBone* readBone = readMesh->mBones[b];
+			auto joint = jointIndices.find(readBone->mName.C_Str());
+			if (joint == jointIndices.end()) { continue; }
+			XMFLOAT4X4 offset;
+			XMStoreFloat4x4(&offset, LoadAssimpMatrix(readBone->mOffsetMatrix));
+			unsigned int bone = getBone(readBone->mName.C_Str(), joint->second, offset);
+			for (unsigned int w = 0; w < readBone->mNumWeights; w++)
+			{
+				const aiVertexWeight& weight = readBone->mWeights[w];
+				if (weight.mVertexId < readMesh->mNumVertices && weight.mWeight > 0.0f)
+					AddInfluence(model.Weights[range.BaseVertex + weight.mVertexId], bone, weight.mWeight);
+			}
+		}
+
+		// Normalize, and pin unweighted vertices to the part's node
+		for (unsigned int i = range.BaseVertex; i < model.Vertices.size(); i++)
+		{
+			SkinWeights& weights = model.Weights[i];
+			float total = 0.0f;
+			for (unsigned int w = 0; w < SKIN_MAX_INFLUENCES; w++) { total += weights.Weights[w]; }
+			if (total > 0.0f)
+			{
+				for (unsigned int w = 0; w < SKIN_MAX_INFLUENCES; w++) { weights.Weights[w] /= total; }
+				continue;
+			}
+			weights.Bones[0] = (unsigned char)getBone("node:" + skeleton.Joints[meshJoints[m]].Name, meshJoints[m], identity);
+			weights.Weights[0] = 1.0f;
+		}
+
+		for (unsigned int f = 0; f < readMesh->mNumFaces; f++)
+		{
+			if (readMesh->mFaces[f].mNumIndices != 3)
+				continue;
+			model.Indices.push_back(readMesh->mFaces[f].mIndices[0]);
+			model.Indices.push_back(readMesh->mFaces[f].mIndices[1]);
+			model.Indices.push_back(readMesh->mFaces[f].mIndices[2]);
+		}
+		range.IndexCount = (unsigned int)model.Indices.size() - range.StartIndex;
+		model.Submeshes.push_back(range);
+	}
+
+	// Clips, with times converted from ticks to seconds
+	for (unsigned int a = 0; a < scene->mNumAnimations; a++)
+	{
+		const aiAnimation* readAnimation = scene->mAnimations[a];
+		double ticksPerSecond = readAnimation->mTicksPerSecond != 0.0 ? readAnimation->mTicksPerSecond : 25.0;
+		AnimationClip clip;
+		clip.Name = readAnimation->mName.C_Str();
+		clip.Duration = (float)(readAnimation->mDuration / ticksPerSecond);
+		for (unsigned int c = 0; c < readAnimation->mNumChannels; c++)
+		{
+			const aiNodeAnim* readChannel = readAnimation->mChannels[c];
+			auto joint = jointIndices.find(readChannel->mNodeName.C_Str());
+			if (joint == jointIndices.end()) { continue; }
+
+			AnimationChannel channel;
+			channel.Joint = joint->second;
+			for (unsigned int k = 0; k < readChannel->mNumPositionKeys; k++)
+			{
+				const aiVectorKey& key = readChannel->mPositionKeys[k];
+				channel.Positions.push_back({ (float)(key.mTime / ticksPerSecond), XMFLOAT3(key.mValue.x, key.mValue.y, key.mValue.z) });
+			}
+			for (unsigned int k = 0; k < readChannel->mNumRotationKeys; k++)
+			{
+				const aiQuatKey& key = readChannel->mRotationKeys[k];
+				channel.Rotations.push_back({ (float)(key.mTime / ticksPerSecond), XMFLOAT4(key.mValue.x, key.mValue.y, key.mValue.z, key.mValue.w) });
+			}
+			for (unsigned int k = 0; k < readChannel->mNumScalingKeys; k++)
+			{
+				const aiVectorKey& key = readChannel->mScalingKeys[k];
+				channel.Scales.push_back({ (float)(key.mTime / ticksPerSecond), XMFLOAT3(key.mValue.x, key.mValue.y, key.mValue.z) });
+			}
+			clip.Channels.push_back(channel);
+		}
+		model.Clips.push_back(clip);
+	}
+	aiReleaseImport(scene);
+
+	if (skeleton.Bones.size() > SKIN_MAX_BONES)
+	{
+		std::cerr << "Could not load " << filePath << ": " << skeleton.Bones.size() << " bones (max " << SKIN_MAX_BONES << ")" << std::endl;
+		return false;
+	}
+	if (model.Vertices.empty() || model.Indices.empty())
+		return false;
+
+	CalculateBounds(model.Vertices.data(), (unsigned int)model.Vertices.size(), model.BoundsMin, model.BoundsMax);
+	model.Loaded = true;
+	return true;
+}
+
+int FindClip(const SkinnedModel& model, const std::string& name)
+{
+	for (size_t i = 0; i < model.Clips.size(); i++)
+	{
+		if (model.Clips[i].Name == name) { return (int)i; }
+	}
+	return -1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+#include "Animation.h"
+#include "MeshCache.h"
+
+// --------------------------------------------------------
+// A rigged model: bind pose geometry, per vertex bone
+// weights, the skeleton and its animation clips
+//
+// Imported with assimp (bones and aiAnimation channels).
+// Shared by every AnimatedMesh drawing it, and never
+// changed after loading. MeshLoader hands models out while
+// they're still importing, so check Loaded before use.
+// --------------------------------------------------------
+struct SkinnedModel
+{
+	std::vector<Vertex> Vertices;			// Bind pose, in each part's mesh space
+	std::vector<SkinWeights> Weights;		// One per vertex
+	std::vector<unsigned int> Indices;		// Relative to each submesh's BaseVertex
+	std::vector<MeshSubmeshRange> Submeshes;
+	Skeleton Rig;
+	std::vector<AnimationClip> Clips;
+	DirectX::XMFLOAT3 BoundsMin;			// Bind pose bounds
+	DirectX::XMFLOAT3 BoundsMax;
+	bool Loaded;							// Set once everything above is filled in
+};
+
+/// <summary>
+/// Imports a rigged model and its animations with assimp. Parts without bones
+/// follow their node, so models that are only partly rigged still animate.
+/// </summary>
+/// <param name="filePath">Path to the model file</param>
+/// <param name="model">Receives the model</param>
+/// <returns>True if the model was loaded</returns>
+bool LoadSkinnedModel(const std::string& filePath, SkinnedModel& model);
+
+/// <summary>
+/// Finds a clip by name
+/// </summary>
+/// <returns>Index into model.Clips, or -1 if there isn't one</returns>
+int FindClip(const SkinnedModel& model, const std::string& name);
@@ -1,23 +1,42 @@
 #include "Sky.h"
-#include <WICTextureLoader.h>
+#include "TextureCooker.h"
+#include <DDSTextureLoader.h>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+
+// Image based lighting settings (delete the cached ibl_* files after changing them)
+static const unsigned int ENVIRONMENT_SIZE = 128;			// Top mip of the specular cube map
+static const unsigned int SPECULAR_MIP_COUNT = 6;			// 128 down to 4, roughness 0 to 1
+static const unsigned int SPECULAR_SAMPLE_COUNT = 128;
+static const unsigned int BRDF_LOOKUP_SIZE = 64;
+static const unsigned int BRDF_LOOKUP_SAMPLE_COUNT = 256;
+static const unsigned int IRRADIANCE_FILE_MAGIC = 'S' | ('H' << 8) | ('9' << 16) | ('1' << 24);
 
 Sky::Sky(std::shared_ptr<Mesh> _mesh, Microsoft::WRL::ComPtr<ID3D11SamplerState> _sampleState, 
 	Microsoft::WRL::ComPtr<ID3D11Device> device,
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	TextureLoader& textureLoader,
 	std::wstring filePath) :
 	sampleState(_sampleState),
-	mesh(_mesh)
+	mesh(_mesh),
+	folderPath(filePath),
+	irradiance(),
+	specularMipCount(0),
+	environmentLightingTime(0.0f),
+	environmentLightingCached(false)
 {
 	colorTint = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	
-	skyTexture = CreateCubemap(device, context,
-		(filePath + std::wstring(L"right.png")).c_str(),
-		(filePath + std::wstring(L"left.png")).c_str(),
-		(filePath + std::wstring(L"up.png")).c_str(),
-		(filePath + std::wstring(L"down.png")).c_str(),
-		(filePath + std::wstring(L"front.png")).c_str(),
-		(filePath + std::wstring(L"back.png")).c_str()
-	);
+	// Order matters here! +X, -X, +Y, -Y, +Z, -Z
+	faceFilePaths[0] = filePath + L"right.png";
+	faceFilePaths[1] = filePath + L"left.png";
+	faceFilePaths[2] = filePath + L"up.png";
+	faceFilePaths[3] = filePath + L"down.png";
+	faceFilePaths[4] = filePath + L"front.png";
+	faceFilePaths[5] = filePath + L"back.png";
+	textureLoader.LoadCubemap(faceFilePaths, skyTexture);
 
 	D3D11_RASTERIZER_DESC rastDesc = {};
 	rastDesc.FillMode = D3D11_FILL_SOLID;
@@ -34,88 +53,6 @@ Sky::Sky(std::shared_ptr<Mesh> _mesh, Microsoft::WRL::ComPtr<ID3D11SamplerState>
 }
 Sky::~Sky() {}
 
-// --------------------------------------------------------
-// Loads six individual textures (the six faces of a cube map), then
-// creates a blank cube map and copies each of the six textures to
-// another face. Afterwards, creates a shader resource view for
-// the cube map and cleans up all of the temporary resources.
-// --------------------------------------------------------
-Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
-	Microsoft::WRL::ComPtr<ID3D11Device> device,
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
-	const wchar_t* right,
-	const wchar_t* left,
-	const wchar_t* up,
-	const wchar_t* down,
-	const wchar_t* front,
-	const wchar_t* back)
-{
-	// Load the 6 textures into an array.
-	// - We need references to the TEXTURES, not SHADER RESOURCE VIEWS!
-	// - Explicitly NOT generating mipmaps, as we don't need them for the sky!
-	// - Order matters here! +X, -X, +Y, -Y, +Z, -Z
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> textures[6] = {};
-	DirectX::CreateWICTextureFromFile(device.Get(), right, (ID3D11Resource**)textures[0].GetAddressOf(), 0);
-	DirectX::CreateWICTextureFromFile(device.Get(), left, (ID3D11Resource**)textures[1].GetAddressOf(), 0);
-	DirectX::CreateWICTextureFromFile(device.Get(), up, (ID3D11Resource**)textures[2].GetAddressOf(), 0);
-	DirectX::CreateWICTextureFromFile(device.Get(), down, (ID3D11Resource**)textures[3].GetAddressOf(), 0);
-	DirectX::CreateWICTextureFromFile(device.Get(), front, (ID3D11Resource**)textures[4].GetAddressOf(), 0);
-	DirectX::CreateWICTextureFromFile(device.Get(), back, (ID3D11Resource**)textures[5].GetAddressOf(), 0);
-	// We'll assume all of the textures are the same color format and resolution,
-	// so get the description of the first texture
-	D3D11_TEXTURE2D_DESC faceDesc = {};
-	textures[0]->GetDesc(&faceDesc);
-	// Describe the resource for the cube map, which is simply
-	// a "texture 2d array" with the TEXTURECUBE flag set.
-	// This is a special GPU resource format, NOT just a
-	// C++ array of textures!!!
-	D3D11_TEXTURE2D_DESC cubeDesc = {};
-	cubeDesc.ArraySize = 6; // Cube map!
-	cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE; // We'll be using as a texture in a shader
-	cubeDesc.CPUAccessFlags = 0; // No read back
-	cubeDesc.Format = faceDesc.Format; // Match the loaded texture's color format
-	cubeDesc.Width = faceDesc.Width; // Match the size
-	cubeDesc.Height = faceDesc.Height; // Match the size
-	cubeDesc.MipLevels = 1; // Only need 1
-	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE; // A CUBE, not 6 separate textures
-	cubeDesc.Usage = D3D11_USAGE_DEFAULT; // Standard usage
-	cubeDesc.SampleDesc.Count = 1;
-	cubeDesc.SampleDesc.Quality = 0;
-	// Create the final texture resource to hold the cube map
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMapTexture;
-	device->CreateTexture2D(&cubeDesc, 0, cubeMapTexture.GetAddressOf());
-	// Loop through the individual face textures and copy them,
-	// one at a time, to the cube map texure
-	for (int i = 0; i < 6; i++)
-	{
-		// Calculate the subresource position to copy into
-		unsigned int subresource = D3D11CalcSubresource(
-			0, // Which mip (zero, since there's only one)
-			i, // Which array element?
-			1); // How many mip levels are in the texture?
-		// Copy from one resource (texture) to another
-		context->CopySubresourceRegion(
-			cubeMapTexture.Get(), // Destination resource
-			subresource, // Dest subresource index (one of the array elements)
-			0, 0, 0, // XYZ location of copy
-			textures[i].Get(), // Source resource
-			0, // Source subresource index (we're assuming there's only one)
-			0); // Source subresource "box" of data to copy (zero means the whole thing)
-	}
-	// At this point, all of the faces have been copied into the
-	// cube map texture, so we can describe a shader resource view for it
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Format = cubeDesc.Format; // Same format as texture
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE; // Treat this as a cube!
-	srvDesc.TextureCube.MipLevels = 1; // Only need access to 1 mip
-	srvDesc.TextureCube.MostDetailedMip = 0; // Index of the first mip we want to see
-	// Make the SRV
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cubeSRV;
-	device->CreateShaderResourceView(cubeMapTexture.Get(), &srvDesc, cubeSRV.GetAddressOf());
-	// Send back the SRV, which is what we need for our shaders
-	return cubeSRV;
-}
-
 // Public Functions
 
 void Sky::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera,
@@ -141,6 +78,108 @@ void Sky::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_
 	context->OMSetDepthStencilState(0, 0);
 }
 
+static bool ReadWholeFile(const std::wstring& filePath, std::vector<unsigned char>& contents)
+{
+	std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+	contents.resize((size_t)file.tellg());
+	file.seekg(0);
+	file.read((char*)contents.data(), contents.size());
+	return file.good();
+}
+
+static void WriteWholeFile(const std::wstring& filePath, const std::vector<unsigned char>& contents)
+{
+	// A failed write only means prefiltering again next run
+	std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+	file.write((const char*)contents.data(), contents.size());
+}
+
+bool Sky::CreateEnvironmentLighting(Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	std::wstring specularPath = folderPath + L"ibl_specular.dds";
+	std::wstring brdfPath = folderPath + L"ibl_brdf.dds";
+	std::wstring irradiancePath = folderPath + L"ibl_irradiance.bin";
+
+	// The BRDF lookup doesn't depend on the sky, so any copy of it will do
+	std::vector<unsigned char> specularDDS, brdfDDS, irradianceFile;
+	unsigned int magic = 0;
+	environmentLightingCached = IsDerivedFileCurrent(specularPath, faceFilePaths, 6) && IsDerivedFileCurrent(irradiancePath, faceFilePaths, 6) &&
+		ReadWholeFile(specularPath, specularDDS) && ReadWholeFile(brdfPath, brdfDDS) && ReadWholeFile(irradiancePath, irradianceFile) &&
+		irradianceFile.size() == sizeof(magic) + sizeof(irradiance);
+	if (environmentLightingCached) { memcpy(&magic, irradianceFile.data(), sizeof(magic)); }
+	environmentLightingCached = environmentLightingCached && magic == IRRADIANCE_FILE_MAGIC;
+
+	if (environmentLightingCached)
+	{
+		memcpy(&irradiance, irradianceFile.data() + sizeof(magic), sizeof(irradiance));
+	}
+	else
+	{
+		ThreadPool pool;
+		TextureImage faces[6];
+		bool decoded[6] = {};
+		for (int f = 0; f < 6; f++)
+		{
+			pool.Enqueue([this, &faces, &decoded, f]() { decoded[f] = DecodeTextureImage(faceFilePaths[f], faces[f]); });
+		}
+		pool.WaitIdle();
+		for (int f = 0; f < 6; f++)
+		{
+			if (!decoded[f])
+			{
+				std::wcerr << L"Could not load sky face " << faceFilePaths[f] << std::endl;
+				return false;
+			}
+		}
+
+		EnvironmentCubemap cubemap;
+		if (!CreateEnvironmentCubemap(faces, ENVIRONMENT_SIZE, pool, cubemap))
+		{
+			std::wcerr << L"Could not prefilter " << folderPath << L": the faces must be square and the same size" << std::endl;
+			return false;
+		}
+		std::vector<EnvironmentCubemap> specularMips;
+		PrefilterSpecular(cubemap, SPECULAR_MIP_COUNT, SPECULAR_SAMPLE_COUNT, pool, specularMips);
+		SHCoefficients radiance;
+		ProjectSH(cubemap, radiance);
+		GetIrradianceSH(radiance, irradiance);
+		std::vector<float> lookup;
+		ComputeBRDFLookup(BRDF_LOOKUP_SIZE, BRDF_LOOKUP_SAMPLE_COUNT, pool, lookup);
+
+		WriteSpecularDDS(specularMips, specularDDS);
+		WriteBRDFLookupDDS(BRDF_LOOKUP_SIZE, lookup, brdfDDS);
+		magic = IRRADIANCE_FILE_MAGIC;
+		irradianceFile.resize(sizeof(magic) + sizeof(irradiance));
+		memcpy(irradianceFile.data(), &magic, sizeof(magic));
+		memcpy(irradianceFile.data() + sizeof(magic), &irradiance, sizeof(irradiance));
+		WriteWholeFile(specularPath, specularDDS);
+		WriteWholeFile(brdfPath, brdfDDS);
+		WriteWholeFile(irradiancePath, irradianceFile);
+	}
+
+	HRESULT hr = DirectX::CreateDDSTextureFromMemory(device.Get(), specularDDS.data(), specularDDS.size(),
+		nullptr, specularMap.ReleaseAndGetAddressOf());
+	if (SUCCEEDED(hr))
+	{
+		hr = DirectX::CreateDDSTextureFromMemory(device.Get(), brdfDDS.data(), brdfDDS.size(),
+			nullptr, brdfLookup.ReleaseAndGetAddressOf());
+	}
+	if (FAILED(hr))
+	{
+		std::wcerr << L"Could not create the image based lighting textures for " << folderPath << std::endl;
+		return false;
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC specularDesc;
+	specularMap->GetDesc(&specularDesc);
+	specularMipCount = specularDesc.TextureCube.MipLevels;
+	environmentLightingTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return true;
+}
+
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::GetSkyTexture()
 {
 	return skyTexture;
@@ -4,6 +4,8 @@
 #include "Mesh.h"
 #include "SimpleShader.h"
 #include "Camera.h"
+#include "TextureLoader.h"
+#include "ImageBasedLighting.h"
 
 class Sky
 {
@@ -15,11 +17,13 @@ public:
 	/// <param name="_sampleState">ComPtr of the Sampler State</param>
 	/// <param name="device">ComPtr of the Device</param>
 	/// <param name="context">ComPtr of the Device Context</param>
+	/// <param name="textureLoader">Loads the six textures; the sky is ready after its Finish()</param>
 	/// <param name="filePath">File Path to the folder holding the six textures</param>
 	Sky(std::shared_ptr<Mesh> _mesh,
 		Microsoft::WRL::ComPtr<ID3D11SamplerState> _sampleState,
 		Microsoft::WRL::ComPtr<ID3D11Device> device,
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		TextureLoader& textureLoader,
 		std::wstring filePath);
 	~Sky();
 
@@ -30,7 +34,21 @@ public:
 	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera,
 		Microsoft::WRL::ComPtr<ID3D11RasterizerState> _rasterizerState);
 
+	/// <summary>
+	/// Prefilters the sky for image based lighting (see ImageBasedLighting.h), or reads the
+	/// results cached next to its images if they're newer than every face
+	/// </summary>
+	/// <param name="device">ComPtr of the Device</param>
+	/// <returns>False if the faces couldn't be read or the textures created</returns>
+	bool CreateEnvironmentLighting(Microsoft::WRL::ComPtr<ID3D11Device> device);
+
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSkyTexture();
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSpecularMap() { return specularMap; }
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetBRDFLookup() { return brdfLookup; }
+	const SHCoefficients& GetIrradiance() { return irradiance; }
+	unsigned int GetSpecularMipCount() { return specularMipCount; }
+	float GetEnvironmentLightingTime() { return environmentLightingTime; }
+	bool IsEnvironmentLightingCached() { return environmentLightingCached; }
 
 private:
 	// Variables
@@ -43,15 +61,14 @@ private:
 	std::shared_ptr<SimplePixelShader> ps;
 	std::shared_ptr<SimpleVertexShader> vs;
 
-	// Helper for creating a cubemap from 6 individual textures
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
-		Microsoft::WRL::ComPtr<ID3D11Device> device,
-		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
-		const wchar_t* right,
-		const wchar_t* left,
-		const wchar_t* up,
-		const wchar_t* down,
-		const wchar_t* front,
-		const wchar_t* back);
+	// Image based lighting
+	std::wstring folderPath;
+	std::wstring faceFilePaths[6];
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> specularMap;	// GGX prefiltered, one roughness per mip
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> brdfLookup;
+	SHCoefficients irradiance;
+	unsigned int specularMipCount;
+	float environmentLightingTime;									// Milliseconds
+	bool environmentLightingCached;
 };
 
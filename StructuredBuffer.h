@@ -0,0 +1,174 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// A typed, growable GPU StructuredBuffer<T> for large arrays
+// (like lights) that would bloat a constant buffer.
+//
+// Elements are staged on the CPU, copied to the GPU at most
+// once per change with Upload(), and bound to shaders through
+// the regular SetShaderResourceView() path, since SimpleShader
+// already treats structured buffers as SRVs.
+//
+// T must match the HLSL struct's packed layout (structured
+// buffers do NOT use cbuffer 16-byte packing rules)
+// --------------------------------------------------------
+template <typename T>
+class StructuredBuffer
+{
+	static_assert(sizeof(T) % 4 == 0, "StructuredBuffer elements must be a multiple of 4 bytes");
+
+public:
+	StructuredBuffer(Microsoft::WRL::ComPtr<ID3D11Device> _device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+		unsigned int initialCapacity = 16);
+
+	// Setting data (CPU side only until Upload() is called)
+	void SetData(const T* data, unsigned int count);
+	void SetData(const std::vector<T>& data);
+	void SetElement(unsigned int index, const T& element);
+	void Clear();
+
+	// Getters
+	unsigned int GetCount() { return (unsigned int)elements.size(); }
+	unsigned int GetCapacity() { return capacity; }
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSRV() { return srv; }
+
+	/// <summary>
+	/// Copies the staged elements to the GPU if they changed since the last upload,
+	/// growing the GPU buffer when needed
+	/// </summary>
+	/// <returns>True if data was copied to the GPU</returns>
+	bool Upload();
+	/// <summary>
+	/// Uploads (if needed) and binds the buffer to the given shader
+	/// </summary>
+	/// <param name="shader">Shader to bind to</param>
+	/// <param name="name">Name of the StructuredBuffer in the shader</param>
+	/// <returns>True if the shader has an SRV of the given name</returns>
+	bool Bind(std::shared_ptr<ISimpleShader> shader, std::string name);
+
+private:
+	std::vector<T> elements;
+	bool dirty;
+	unsigned int capacity;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	// Helper Functions
+	void CreateBuffer(unsigned int _capacity);
+};
+
+// Constructor
+template <typename T>
+StructuredBuffer<T>::StructuredBuffer(Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context, unsigned int initialCapacity) :
+	dirty(true),
+	capacity(0),
+	device(_device),
+	context(_context)
+{
+	CreateBuffer(initialCapacity > 0 ? initialCapacity : 1);
+}
+
+// Setters
+template <typename T>
+void StructuredBuffer<T>::SetData(const T* data, unsigned int count)
+{
+	elements.assign(data, data + count);
+	dirty = true;
+}
+template <typename T>
+void StructuredBuffer<T>::SetData(const std::vector<T>& data)
+{
+	elements = data;
+	dirty = true;
+}
+template <typename T>
+void StructuredBuffer<T>::SetElement(unsigned int index, const T& element)
+{
+	if (index >= elements.size()) { elements.resize(index + 1); }
+	elements[index] = element;
+	dirty = true;
+}
+template <typename T>
+void StructuredBuffer<T>::Clear()
+{
+	elements.clear();
+	dirty = true;
+}
+
+// Public Functions
+template <typename T>
+bool StructuredBuffer<T>::Upload()
+{
+	if (!dirty) { return false; }
+
+	// Grow by doubling so a slowly growing array doesn't recreate the buffer every frame
+	unsigned int count = (unsigned int)elements.size();
+	if (count > capacity)
+	{
+		unsigned int newCapacity = capacity;
+		while (newCapacity < count) { newCapacity *= 2; }
+		CreateBuffer(newCapacity);
+	}
+
+	// Dynamic buffer, so discard the old contents and write the new ones
+	if (count > 0)
+	{
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		if (FAILED(context->Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) { return false; }
+		memcpy(mapped.pData, elements.data(), sizeof(T) * count);
+		context->Unmap(buffer.Get(), 0);
+	}
+
+	dirty = false;
+	return true;
+}
+template <typename T>
+bool StructuredBuffer<T>::Bind(std::shared_ptr<ISimpleShader> shader, std::string name)
+{
+	if (!shader->HasShaderResourceView(name)) { return false; }
+	Upload();
+	return shader->SetShaderResourceView(name, srv);
+}
+
+// Helper Functions
+
+/// <summary>
+/// (Re)create the GPU buffer and its SRV with room for the given number of elements
+/// </summary>
+template <typename T>
+void StructuredBuffer<T>::CreateBuffer(unsigned int _capacity)
+{
+	capacity = _capacity;
+	buffer.Reset();
+	srv.Reset();
+
+	D3D11_BUFFER_DESC bd = {};
+	bd.Usage = D3D11_USAGE_DYNAMIC;
+	bd.ByteWidth = sizeof(T) * capacity;
+	bd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	bd.StructureByteStride = sizeof(T);
+	device->CreateBuffer(&bd, 0, buffer.GetAddressOf());
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN; // Required for structured buffers
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = capacity;
+	device->CreateShaderResourceView(buffer.Get(), &srvDesc, srv.GetAddressOf());
+
+	// New buffer has no contents yet
+	dirty = true;
+}
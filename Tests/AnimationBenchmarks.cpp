@@ -0,0 +1,196 @@
+#include "TestFramework.h"
+#include "Animation.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace DirectX;
+
+// A character about the size of an imported one: a tube up a chain of joints, each ring blended between two
+static const unsigned int CROWD_SIZE = 500;
+static const unsigned int CROWD_JOINTS = 48;
+static const unsigned int CROWD_RINGS_PER_JOINT = 4;
+static const unsigned int CROWD_RING_VERTICES = 32;
+static const float CROWD_SEGMENT = 0.1f;
+static const int CROWD_FRAMES = 20;
+
+struct CrowdCharacter
+{
+	std::vector<JointPose> Pose;
+	std::vector<JointPose> LayerPose;
+	std::vector<XMFLOAT4X4> JointGlobals;
+	std::vector<XMFLOAT4X4> Palette;
+	std::vector<CompactVertex> Output;
+};
+
+struct CrowdModel
+{
+	Skeleton Rig;
+	std::vector<Vertex> Vertices;
+	std::vector<SkinWeights> Weights;
+	AnimationClip Wave;		// A rotation key every frame or so on every joint but the root
+	AnimationClip Sway;		// The root rocking and rising
+};
+
+static void CreateCrowdModel(CrowdModel& model)
+{
+	XMStoreFloat4x4(&model.Rig.RootInverse, XMMatrixIdentity());
+	for (unsigned int j = 0; j < CROWD_JOINTS; j++)
+	{
+		SkeletonJoint joint;
+		joint.Name = "Joint" + std::to_string(j);
+		joint.Parent = (int)j - 1;
+		joint.BindPose = { XMFLOAT3(0.0f, j > 0 ? CROWD_SEGMENT : 0.0f, 0.0f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f) };
+		model.Rig.Joints.push_back(joint);
+		SkinBone bone;
+		bone.Joint = j;
+		XMStoreFloat4x4(&bone.Offset, XMMatrixTranslation(0.0f, -(float)j * CROWD_SEGMENT, 0.0f));
+		model.Rig.Bones.push_back(bone);
+	}
+
+	for (unsigned int ring = 0; ring < CROWD_JOINTS * CROWD_RINGS_PER_JOINT; ring++)
+	{
+		unsigned int joint = ring / CROWD_RINGS_PER_JOINT;
+		float blend = (float)(ring % CROWD_RINGS_PER_JOINT) / CROWD_RINGS_PER_JOINT;
+		for (unsigned int k = 0; k < CROWD_RING_VERTICES; k++)
+		{
+			float angle = k * 6.2831853f / CROWD_RING_VERTICES;
+			Vertex vertex = {};
+			vertex.Position = XMFLOAT3(0.05f * cosf(angle), ring * CROWD_SEGMENT / CROWD_RINGS_PER_JOINT, 0.05f * sinf(angle));
+			vertex.Normal = XMFLOAT3(cosf(angle), 0.0f, sinf(angle));
+			vertex.Tangent = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			vertex.UV = XMFLOAT2((float)k / CROWD_RING_VERTICES, (float)ring / (CROWD_JOINTS * CROWD_RINGS_PER_JOINT));
+			SkinWeights weight = {};
+			weight.Bones[0] = (unsigned char)joint;
+			weight.Weights[0] = 1.0f;
+			if (blend > 0.0f && joint + 1 < CROWD_JOINTS)
+			{
+				weight.Bones[1] = (unsigned char)(joint + 1);
+				weight.Weights[0] = 1.0f - blend;
+				weight.Weights[1] = blend;
+			}
+			model.Vertices.push_back(vertex);
+			model.Weights.push_back(weight);
+		}
+	}
+
+	model.Wave.Name = "Wave";
+	model.Wave.Duration = 2.0f;
+	for (unsigned int j = 1; j < CROWD_JOINTS; j++)
+	{
+		AnimationChannel channel;
+		channel.Joint = j;
+		for (int key = 0; key <= 30; key++)
+		{
+			float time = key * model.Wave.Duration / 30;
+			XMFLOAT4 rotation;
+			XMStoreFloat4(&rotation, XMQuaternionRotationAxis(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), 0.15f * sinf(time * 3.14159f + j * 0.3f)));
+			channel.Rotations.push_back({ time, rotation });
+		}
+		model.Wave.Channels.push_back(channel);
+	}
+
+	model.Sway.Name = "Sway";
+	model.Sway.Duration = 1.0f;
+	AnimationChannel root;
+	root.Joint = 0;
+	for (int key = 0; key <= 10; key++)
+	{
+		float time = key * 0.1f;
+		XMFLOAT4 rotation;
+		XMStoreFloat4(&rotation, XMQuaternionRotationAxis(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), 0.3f * sinf(time * 6.2831853f)));
+		root.Rotations.push_back({ time, rotation });
+		root.Positions.push_back({ time, XMFLOAT3(0.0f, 0.1f * time, 0.0f) });
+	}
+	model.Sway.Channels.push_back(root);
+}
+
+// Every fourth character blends the sway in over the wave, as two layers on an AnimatedMesh would
+static void SampleCrowdPose(const CrowdModel& model, CrowdCharacter& character, unsigned int index, float time)
+{
+	SampleClip(model.Rig, model.Wave, time + index * 0.01f, true, character.Pose.data());
+	if (index % 4 == 0)
+	{
+		SampleClip(model.Rig, model.Sway, time, true, character.LayerPose.data());
+		BlendPoses(character.Pose.data(), character.LayerPose.data(), 0.5f, (unsigned int)model.Rig.Joints.size());
+	}
+}
+
+static double GetMilliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+BENCHMARK(AnimateCrowd)
+{
+	CrowdModel model;
+	CreateCrowdModel(model);
+	std::vector<CrowdCharacter> crowd(CROWD_SIZE);
+	for (CrowdCharacter& character : crowd)
+	{
+		character.Pose.resize(model.Rig.Joints.size());
+		character.LayerPose.resize(model.Rig.Joints.size());
+		character.JointGlobals.resize(model.Rig.Joints.size());
+		character.Palette.resize(model.Rig.Bones.size());
+		character.Output.resize(model.Vertices.size());
+	}
+	unsigned int vertexCount = (unsigned int)model.Vertices.size();
+
+	// Each stage on its own, on this thread
+	double sampleTime = 0.0;
+	double paletteTime = 0.0;
+	double skinTime = 0.0;
+	for (int frame = 0; frame < CROWD_FRAMES; frame++)
+	{
+		float time = frame / 60.0f;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int c = 0; c < CROWD_SIZE; c++) { SampleCrowdPose(model, crowd[c], c, time); }
+		sampleTime += GetMilliseconds(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (CrowdCharacter& character : crowd)
+		{
+			BuildSkinPalette(model.Rig, character.Pose.data(), character.JointGlobals.data(), character.Palette.data());
+		}
+		paletteTime += GetMilliseconds(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (CrowdCharacter& character : crowd)
+		{
+			SkinVertices(model.Vertices.data(), model.Weights.data(), vertexCount, character.Palette.data(), character.Output.data());
+		}
+		skinTime += GetMilliseconds(start);
+	}
+	printf("  %u characters, %u joints and %u vertices each (%u vertices)\n",
+		CROWD_SIZE, CROWD_JOINTS, vertexCount, CROWD_SIZE * vertexCount);
+	printf("  1 thread: sample and blend %.2fms, palettes %.2fms, skinning %.2fms, %.2fms per frame\n",
+		sampleTime / CROWD_FRAMES, paletteTime / CROWD_FRAMES, skinTime / CROWD_FRAMES,
+		(sampleTime + paletteTime + skinTime) / CROWD_FRAMES);
+
+	// The whole character per task, batched the way Animator::Update() splits it between its workers
+	ThreadPool pool;
+	double pooledTime = 0.0;
+	for (int frame = 0; frame < CROWD_FRAMES; frame++)
+	{
+		float time = frame / 60.0f;
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t batchSize = std::max<size_t>(1, crowd.size() / (pool.GetThreadCount() * 4));
+		for (size_t first = 0; first < crowd.size(); first += batchSize)
+		{
+			size_t last = std::min(first + batchSize, crowd.size());
+			pool.Enqueue([&, first, last, time]()
+			{
+				for (size_t c = first; c < last; c++)
+				{
+					CrowdCharacter& character = crowd[c];
+					SampleCrowdPose(model, character, (unsigned int)c, time);
+					BuildSkinPalette(model.Rig, character.Pose.data(), character.JointGlobals.data(), character.Palette.data());
+					SkinVertices(model.Vertices.data(), model.Weights.data(), vertexCount, character.Palette.data(), character.Output.data());
+				}
+			});
+		}
+		pool.WaitIdle();
+		pooledTime += GetMilliseconds(start);
+	}
+	printf("  %u workers: %.2fms per frame\n", pool.GetThreadCount(), pooledTime / CROWD_FRAMES);
+}
@@ -0,0 +1,227 @@
+#include "TestFramework.h"
+#include "Animation.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+// A chain of joints up the Y axis, SEGMENT apart, with a ring of vertices around each
+static const unsigned int JOINT_COUNT = 8;
+static const unsigned int RING_VERTICES = 16;
+static const float SEGMENT = 0.25f;
+
+// Every bone's offset is the inverse of its joint's model space bind transform, as assimp imports them
+static void SetBindOffsets(Skeleton& skeleton)
+{
+	std::vector<XMMATRIX> globals;
+	for (const SkeletonJoint& joint : skeleton.Joints)
+	{
+		XMMATRIX local = XMMatrixAffineTransformation(XMLoadFloat3(&joint.BindPose.Scale), XMVectorZero(),
+			XMLoadFloat4(&joint.BindPose.Rotation), XMLoadFloat3(&joint.BindPose.Translation));
+		globals.push_back(joint.Parent >= 0 ? local * globals[joint.Parent] : local);
+	}
+	skeleton.Bones.clear();
+	for (unsigned int j = 0; j < skeleton.Joints.size(); j++)
+	{
+		SkinBone bone;
+		bone.Joint = j;
+		XMStoreFloat4x4(&bone.Offset, XMMatrixInverse(nullptr, globals[j] * XMLoadFloat4x4(&skeleton.RootInverse)));
+		skeleton.Bones.push_back(bone);
+	}
+}
+
+static Skeleton CreateChain()
+{
+	Skeleton skeleton;
+	XMStoreFloat4x4(&skeleton.RootInverse, XMMatrixIdentity());
+	for (unsigned int j = 0; j < JOINT_COUNT; j++)
+	{
+		SkeletonJoint joint;
+		joint.Name = "Joint" + std::to_string(j);
+		joint.Parent = (int)j - 1;
+		joint.BindPose = { XMFLOAT3(0.0f, j > 0 ? SEGMENT : 0.0f, 0.0f), XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 1.0f, 1.0f) };
+		skeleton.Joints.push_back(joint);
+	}
+	SetBindOffsets(skeleton);
+	return skeleton;
+}
+
+// A ring around each joint, weighted fully to it, and a ring between each pair, weighted to both
+static void CreateTube(std::vector<Vertex>& vertices, std::vector<SkinWeights>& weights)
+{
+	for (unsigned int ring = 0; ring < JOINT_COUNT * 2 - 1; ring++)
+	{
+		unsigned int joint = ring / 2;
+		for (unsigned int k = 0; k < RING_VERTICES; k++)
+		{
+			float angle = k * 6.2831853f / RING_VERTICES;
+			Vertex vertex = {};
+			vertex.Position = XMFLOAT3(0.1f * cosf(angle), ring * SEGMENT * 0.5f, 0.1f * sinf(angle));
+			vertex.Normal = XMFLOAT3(cosf(angle), 0.0f, sinf(angle));
+			vertex.Tangent = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			vertex.UV = XMFLOAT2((float)k / RING_VERTICES, (float)ring / (JOINT_COUNT * 2));
+			SkinWeights weight = {};
+			weight.Bones[0] = (unsigned char)joint;
+			weight.Weights[0] = 1.0f;
+			if (ring % 2 == 1)
+			{
+				weight.Bones[1] = (unsigned char)(joint + 1);
+				weight.Weights[0] = 0.6f;
+				weight.Weights[1] = 0.4f;
+			}
+			vertices.push_back(vertex);
+			weights.push_back(weight);
+		}
+	}
+}
+
+// Skins the tube in a pose and decodes the results
+static std::vector<Vertex> SkinPose(const Skeleton& skeleton, const std::vector<JointPose>& pose,
+	const std::vector<Vertex>& vertices, const std::vector<SkinWeights>& weights, std::vector<XMFLOAT4X4>& palette)
+{
+	std::vector<XMFLOAT4X4> globals(skeleton.Joints.size());
+	palette.resize(skeleton.Bones.size());
+	BuildSkinPalette(skeleton, pose.data(), globals.data(), palette.data());
+	std::vector<CompactVertex> encoded(vertices.size());
+	SkinVertices(vertices.data(), weights.data(), (unsigned int)vertices.size(), palette.data(), encoded.data());
+	std::vector<Vertex> skinned;
+	for (const CompactVertex& vertex : encoded) { skinned.push_back(DecodeCompactVertex(vertex)); }
+	return skinned;
+}
+
+// Largest distance between two vectors of each vertex
+static float GetMaxError(const std::vector<Vertex>& a, const std::vector<XMFLOAT3>& b, XMFLOAT3 Vertex::* attribute)
+{
+	float maxError = 0.0f;
+	for (size_t v = 0; v < a.size(); v++)
+	{
+		const XMFLOAT3& value = a[v].*attribute;
+		maxError = std::max(maxError, std::max(fabsf(value.x - b[v].x), std::max(fabsf(value.y - b[v].y), fabsf(value.z - b[v].z))));
+	}
+	return maxError;
+}
+
+static std::vector<XMFLOAT3> GetAttribute(const std::vector<Vertex>& vertices, XMFLOAT3 Vertex::* attribute)
+{
+	std::vector<XMFLOAT3> values;
+	for (const Vertex& vertex : vertices) { values.push_back(vertex.*attribute); }
+	return values;
+}
+
+// Rotates (x, y) about the Z axis
+static std::vector<XMFLOAT3> RotateZ(const std::vector<XMFLOAT3>& values, float angle)
+{
+	std::vector<XMFLOAT3> rotated;
+	for (const XMFLOAT3& value : values)
+	{
+		rotated.push_back(XMFLOAT3(value.x * cosf(angle) - value.y * sinf(angle), value.x * sinf(angle) + value.y * cosf(angle), value.z));
+	}
+	return rotated;
+}
+
+TEST(BindPoseSkinsToItself)
+{
+	// A skeleton with a moved, turned and scaled root and twisted joints still gives identity matrices in its bind pose
+	Skeleton skeleton = CreateChain();
+	XMFLOAT4 rootRotation, twist;
+	XMStoreFloat4(&rootRotation, XMQuaternionRotationAxis(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), -1.5707963f));
+	XMStoreFloat4(&twist, XMQuaternionRotationAxis(XMVectorSet(0.3f, 1.0f, 0.2f, 0.0f), 0.4f));
+	skeleton.Joints[0].BindPose = { XMFLOAT3(1.0f, -2.0f, 0.5f), rootRotation, XMFLOAT3(0.01f, 0.01f, 0.01f) };
+	for (unsigned int j = 1; j < JOINT_COUNT; j++) { skeleton.Joints[j].BindPose.Rotation = twist; }
+	XMMATRIX root = XMMatrixAffineTransformation(XMLoadFloat3(&skeleton.Joints[0].BindPose.Scale), XMVectorZero(),
+		XMLoadFloat4(&rootRotation), XMLoadFloat3(&skeleton.Joints[0].BindPose.Translation));
+	XMStoreFloat4x4(&skeleton.RootInverse, XMMatrixInverse(nullptr, root));
+	SetBindOffsets(skeleton);
+
+	// A clip with no channels samples to the bind pose
+	AnimationClip clip = { "Empty", 1.0f, {} };
+	std::vector<JointPose> pose(JOINT_COUNT);
+	SampleClip(skeleton, clip, 0.5f, true, pose.data());
+	std::vector<Vertex> vertices;
+	std::vector<SkinWeights> weights;
+	CreateTube(vertices, weights);
+	std::vector<XMFLOAT4X4> palette;
+	std::vector<Vertex> skinned = SkinPose(skeleton, pose, vertices, weights, palette);
+
+	float maxPaletteError = 0.0f;
+	for (const XMFLOAT4X4& matrix : palette)
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++) { maxPaletteError = std::max(maxPaletteError, fabsf(matrix.m[r][c] - (r == c ? 1.0f : 0.0f))); }
+	CHECK(maxPaletteError <= 1e-5f);
+	CHECK(GetMaxError(skinned, GetAttribute(vertices, &Vertex::Position), &Vertex::Position) <= 1e-5f);
+	// Normals and tangents only lose what the compact encoding does
+	CHECK(GetMaxError(skinned, GetAttribute(vertices, &Vertex::Normal), &Vertex::Normal) <= 1e-3f);
+	CHECK(GetMaxError(skinned, GetAttribute(vertices, &Vertex::Tangent), &Vertex::Tangent) <= 1e-3f);
+}
+
+TEST(SampledRootRotationTurnsEveryVertex)
+{
+	// The root turns from none to 90 degrees about Z over two seconds, so every vertex turns with it
+	Skeleton skeleton = CreateChain();
+	AnimationClip clip = { "Turn", 2.0f, {} };
+	AnimationChannel channel;
+	channel.Joint = 0;
+	XMFLOAT4 start, end;
+	XMStoreFloat4(&start, XMQuaternionIdentity());
+	XMStoreFloat4(&end, XMQuaternionRotationAxis(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), 1.5707963f));
+	channel.Rotations = { { 0.0f, start }, { 2.0f, end } };
+	clip.Channels.push_back(channel);
+
+	std::vector<Vertex> vertices;
+	std::vector<SkinWeights> weights;
+	CreateTube(vertices, weights);
+	std::vector<XMFLOAT3> positions = GetAttribute(vertices, &Vertex::Position);
+	std::vector<XMFLOAT3> normals = GetAttribute(vertices, &Vertex::Normal);
+
+	// At the last key, halfway (slerped), looped back to halfway, and clamped past the end
+	const struct { float Time; bool Loop; float Angle; } samples[] = {
+		{ 2.0f, false, 1.5707963f }, { 1.0f, false, 0.7853982f }, { 3.0f, true, 0.7853982f }, { 5.0f, false, 1.5707963f }, { 0.0f, false, 0.0f } };
+	for (const auto& sample : samples)
+	{
+		std::vector<JointPose> pose(JOINT_COUNT);
+		SampleClip(skeleton, clip, sample.Time, sample.Loop, pose.data());
+		// Joints the clip doesn't animate keep their bind pose
+		CHECK_NEAR(pose[3].Translation.y, SEGMENT, 1e-6);
+		CHECK_NEAR(pose[3].Rotation.w, 1.0, 1e-6);
+
+		std::vector<XMFLOAT4X4> palette;
+		std::vector<Vertex> skinned = SkinPose(skeleton, pose, vertices, weights, palette);
+		CHECK(GetMaxError(skinned, RotateZ(positions, sample.Angle), &Vertex::Position) <= 1e-5f);
+		CHECK(GetMaxError(skinned, RotateZ(normals, sample.Angle), &Vertex::Normal) <= 1e-3f);
+	}
+}
+
+TEST(JointRotationTurnsOnlyItsChildren)
+{
+	// Turning one joint 90 degrees about Z swings the vertices on it and its children around it, and leaves the rest
+	const unsigned int turned = 3;
+	Skeleton skeleton = CreateChain();
+	std::vector<JointPose> pose(JOINT_COUNT);
+	for (unsigned int j = 0; j < JOINT_COUNT; j++) { pose[j] = skeleton.Joints[j].BindPose; }
+	XMStoreFloat4(&pose[turned].Rotation, XMQuaternionRotationAxis(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), 1.5707963f));
+
+	std::vector<Vertex> vertices;
+	std::vector<SkinWeights> weights;
+	CreateTube(vertices, weights);
+	std::vector<XMFLOAT4X4> palette;
+	std::vector<Vertex> skinned = SkinPose(skeleton, pose, vertices, weights, palette);
+
+	float pivot = turned * SEGMENT;
+	float maxError = 0.0f;
+	for (size_t v = 0; v < vertices.size(); v++)
+	{
+		const XMFLOAT3& position = vertices[v].Position;
+		XMFLOAT3 swung(-(position.y - pivot), pivot + position.x, position.z);
+		// Blended vertices land between where each of their bones puts them
+		XMFLOAT3 expected(0.0f, 0.0f, 0.0f);
+		for (unsigned int i = 0; i < SKIN_MAX_INFLUENCES && weights[v].Weights[i] > 0.0f; i++)
+		{
+			const XMFLOAT3& moved = weights[v].Bones[i] >= turned ? swung : position;
+			expected.x += moved.x * weights[v].Weights[i];
+			expected.y += moved.y * weights[v].Weights[i];
+			expected.z += moved.z * weights[v].Weights[i];
+		}
+		const XMFLOAT3& actual = skinned[v].Position;
+		maxError = std::max(maxError, std::max(fabsf(actual.x - expected.x), std::max(fabsf(actual.y - expected.y), fabsf(actual.z - expected.z))));
+	}
+	CHECK(maxError <= 1e-5f);
+}
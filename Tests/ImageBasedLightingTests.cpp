@@ -0,0 +1,95 @@
+#include "TestFramework.h"
+#include "ImageBasedLighting.h"
+#include <algorithm>
+
+// Three SH bands smooth a clamped cosine slightly, so they can't match brute force exactly
+static const double MAX_IRRADIANCE_ERROR = 0.01;
+
+// Fills every texel of a cube map from its direction
+template <typename Radiance>
+static void FillCubemap(unsigned int size, Radiance radiance, EnvironmentCubemap& cubemap)
+{
+	cubemap.Size = size;
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		cubemap.Faces[face].resize(size * size * 3);
+		for (unsigned int i = 0; i < size * size; i++)
+		{
+			float direction[3];
+			GetCubemapDirection(face, ((i % size) + 0.5f) / size, ((i / size) + 0.5f) / size, direction);
+			for (int c = 0; c < 3; c++) { cubemap.Faces[face][i * 3 + c] = radiance(direction); }
+		}
+	}
+}
+
+// Irradiance over pi at a normal, summing every texel weighted by its solid angle and cosine
+static void GetBruteForceIrradiance(const EnvironmentCubemap& cubemap, const float normal[3], float color[3])
+{
+	double sums[3] = {};
+	unsigned int size = cubemap.Size;
+	for (unsigned int face = 0; face < 6; face++)
+		for (unsigned int y = 0; y < size; y++)
+			for (unsigned int x = 0; x < size; x++)
+			{
+				float direction[3];
+				GetCubemapDirection(face, (x + 0.5f) / size, (y + 0.5f) / size, direction);
+				double cosine = normal[0] * direction[0] + normal[1] * direction[1] + normal[2] * direction[2];
+				if (cosine <= 0.0)
+					continue;
+				double faceX = (x + 0.5) / size * 2.0 - 1.0;
+				double faceY = (y + 0.5) / size * 2.0 - 1.0;
+				double solidAngle = (2.0 / size) * (2.0 / size) / pow(faceX * faceX + faceY * faceY + 1.0, 1.5);
+				for (int c = 0; c < 3; c++) { sums[c] += cubemap.Faces[face][(y * size + x) * 3 + c] * cosine * solidAngle; }
+			}
+	for (int c = 0; c < 3; c++) { color[c] = (float)(sums[c] / 3.14159265358979); }
+}
+
+// Unit normals spread evenly over the sphere
+static void GetFibonacciNormal(unsigned int index, unsigned int count, float normal[3])
+{
+	float z = 1.0f - 2.0f * (index + 0.5f) / count;
+	float radius = sqrtf(1.0f - z * z);
+	float angle = index * 2.39996323f;
+	normal[0] = radius * cosf(angle);
+	normal[1] = radius * sinf(angle);
+	normal[2] = z;
+}
+
+TEST(ConstantSkyGivesItsRadiance)
+{
+	// A white surface under a uniform sky reflects exactly the sky's radiance, whichever way it faces
+	EnvironmentCubemap cubemap;
+	FillCubemap(32, [](const float*) { return 0.5f; }, cubemap);
+	SHCoefficients radiance, irradiance;
+	ProjectSH(cubemap, radiance);
+	GetIrradianceSH(radiance, irradiance);
+	for (unsigned int i = 0; i < 64; i++)
+	{
+		float normal[3], color[3];
+		GetFibonacciNormal(i, 64, normal);
+		EvaluateIrradianceSH(irradiance, normal, color);
+		for (int c = 0; c < 3; c++) { CHECK_NEAR(color[c], 0.5, 1e-3); }
+	}
+}
+
+TEST(HemisphereSkyMatchesBruteForce)
+{
+	// Radiance max(0, z) lights +Z fully, the sides partly and -Z not at all
+	EnvironmentCubemap cubemap;
+	FillCubemap(32, [](const float* direction) { return std::max(0.0f, direction[2]); }, cubemap);
+	SHCoefficients radiance, irradiance;
+	ProjectSH(cubemap, radiance);
+	GetIrradianceSH(radiance, irradiance);
+	for (unsigned int i = 0; i < 64; i++)
+	{
+		float normal[3], color[3], expected[3];
+		GetFibonacciNormal(i, 64, normal);
+		EvaluateIrradianceSH(irradiance, normal, color);
+		GetBruteForceIrradiance(cubemap, normal, expected);
+		for (int c = 0; c < 3; c++) { CHECK_NEAR(color[c], expected[c], MAX_IRRADIANCE_ERROR); }
+	}
+	const float down[3] = { 0.0f, 0.0f, -1.0f };
+	float color[3];
+	EvaluateIrradianceSH(irradiance, down, color);
+	CHECK_NEAR(color[0], 0.0, MAX_IRRADIANCE_ERROR);
+}
@@ -0,0 +1,130 @@
+#include "TestFramework.h"
+#include "LightAssignment.h"
+#include "LightClusters.h"
+#include <algorithm>
+#include <cfloat>
+#include <random>
+
+// 10k entities and the lights among them, all in a 100 x 10 x 100 area in front of a camera at the origin
+static const unsigned int ENTITY_COUNT = 10000;
+static const float NEAR_DIST = 0.1f;
+static const float FAR_DIST = 200.0f;
+static const int ASSIGN_RUNS = 20;
+
+static std::vector<Light> CreateLights(unsigned int count, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Light> lights(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Light& light = lights[i];
+		light = {};
+		light.Type = i % 40 == 0 ? LIGHT_TYPE_DIR : i % 3 == 0 ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT;
+		light.Position = DirectX::XMFLOAT3(unit(random) * 50.0f, unit(random) * 5.0f, unit(random) * 50.0f + 50.0f);
+		light.Range = 1.0f + (unit(random) + 1.0f) * 2.0f;
+		light.Direction = DirectX::XMFLOAT3(unit(random), unit(random), unit(random));
+		light.Intensity = (unit(random) + 1.0f) * 0.5f;
+		light.Color = DirectX::XMFLOAT3(1.0f, (unit(random) + 1.0f) * 0.5f, 1.0f);
+	}
+	return lights;
+}
+
+// Whether a point or spot light's range (and the side of the spot it faces) covers a point
+static bool LightReaches(const Light& light, const float point[3])
+{
+	float offset[3] = { point[0] - light.Position.x, point[1] - light.Position.y, point[2] - light.Position.z };
+	if (offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2] >= light.Range * light.Range)
+		return false;
+	return light.Type != LIGHT_TYPE_SPOT ||
+		offset[0] * light.Direction.x + offset[1] * light.Direction.y + offset[2] * light.Direction.z > 0.0f;
+}
+
+BENCHMARK(AssignLightsTo10kEntities)
+{
+	// XMMatrixPerspectiveFovLH, looking down +Z from the origin
+	const float yScale = 1.0f / tanf(0.3927f);
+	const float xScale = yScale * 9.0f / 16.0f;
+	float projection[16] = {};
+	projection[0] = xScale;
+	projection[5] = yScale;
+	projection[10] = FAR_DIST / (FAR_DIST - NEAR_DIST);
+	projection[11] = 1.0f;
+	projection[14] = -NEAR_DIST * FAR_DIST / (FAR_DIST - NEAR_DIST);
+	float view[16] = {};
+	view[0] = view[5] = view[10] = view[15] = 1.0f;
+
+	for (unsigned int lightCount : { 64u, 1024u, 4096u })
+	{
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<Light> sceneLights = CreateLights(lightCount, random);
+		LightSet lights;
+		for (const Light& light : sceneLights) { lights.Add(light); }
+
+		std::vector<EntityBounds> entities(ENTITY_COUNT);
+		for (EntityBounds& entity : entities)
+		{
+			entity.Center[0] = unit(random) * 50.0f;
+			entity.Center[1] = unit(random) * 5.0f;
+			entity.Center[2] = unit(random) * 50.0f + 50.0f;
+			entity.Radius = 0.5f + (unit(random) + 1.0f) * 0.5f;
+		}
+
+		// Best of several runs, on one worker and on the default pool
+		std::vector<EntityLights> results;
+		for (unsigned int threadCount : { 1u, 0u })
+		{
+			LightAssignment assignment(threadCount);
+			float assignTime = FLT_MAX;
+			float gridTime = FLT_MAX;
+			for (int run = 0; run < ASSIGN_RUNS; run++)
+			{
+				assignment.SetLights(lights);
+				assignment.Assign(entities.data(), ENTITY_COUNT, results);
+				assignTime = std::min(assignTime, assignment.GetStats().AssignTime);
+				gridTime = std::min(gridTime, assignment.GetStats().GridTime);
+			}
+			LightAssignmentStats stats = assignment.GetStats();
+			printf("  %u lights, %u entities, %s: assign %.2fms, grid %.3fms, %.2f lights per entity, %u dropped\n",
+				lightCount, ENTITY_COUNT, threadCount == 1 ? "1 worker" : "default workers", assignTime, gridTime,
+				(float)stats.AssignedLights / ENTITY_COUNT, stats.DroppedLights);
+		}
+
+		// Lights each shaded pixel loops over: its cluster's list, its entity's list, and those actually reaching it
+		LightClusters clusters;
+		clusters.SetProjection(projection, NEAR_DIST, FAR_DIST);
+		clusters.Bin(lights, view);
+		double clustered = 0.0;
+		double perEntity = 0.0;
+		double reaching = 0.0;
+		unsigned int samples = 0;
+		for (unsigned int e = 0; e < ENTITY_COUNT; e += 7)
+		{
+			const EntityBounds& entity = entities[e];
+			for (int sample = 0; sample < 8; sample++)
+			{
+				float direction[3] = { unit(random), unit(random), unit(random) };
+				float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]) + 1e-6f;
+				float point[3];
+				for (int a = 0; a < 3; a++) { point[a] = entity.Center[a] + direction[a] / length * entity.Radius; }
+				if (point[2] < NEAR_DIST)
+					continue;
+				float screenX = (point[0] * xScale / point[2] + 1.0f) * 0.5f;
+				float screenY = (1.0f - point[1] * yScale / point[2]) * 0.5f;
+				if (screenX < 0.0f || screenX > 1.0f || screenY < 0.0f || screenY > 1.0f)
+					continue;
+
+				clustered += clusters.GetRanges()[clusters.FindCluster(screenX, screenY, point[2])].Count;
+				perEntity += results[e].Count;
+				for (const Light& light : sceneLights)
+				{
+					if (light.Type != LIGHT_TYPE_DIR && LightReaches(light, point))
+						reaching++;
+				}
+				samples++;
+			}
+		}
+		printf("  lights per pixel: clustered %.2f, per entity %.2f, reaching %.2f (%u samples)\n",
+			clustered / samples, perEntity / samples, reaching / samples, samples);
+	}
+}
@@ -0,0 +1,275 @@
+#include "TestFramework.h"
+#include "LightClusters.h"
+#include <algorithm>
+#include <cfloat>
+#include <random>
+
+static const float NEAR_DIST = 0.1f;
+static const float FAR_DIST = 100.0f;
+
+// 15 tiles across, so rows end partway through a group of four
+static const unsigned int TILES_X = 15;
+static const unsigned int TILES_Y = 9;
+static const unsigned int SLICES = 24;
+
+// Lights closer than this fraction of their range to a cluster's edge may go either way
+static const float EDGE_TOLERANCE = 1e-4f;
+
+// XMMatrixPerspectiveFovLH and XMMatrixOrthographicLH
+static void GetProjection(bool perspective, float projection[16])
+{
+	for (int m = 0; m < 16; m++) { projection[m] = 0.0f; }
+	if (perspective)
+	{
+		projection[5] = 1.0f / tanf(0.3927f);
+		projection[0] = projection[5] * 9.0f / 16.0f;
+		projection[10] = FAR_DIST / (FAR_DIST - NEAR_DIST);
+		projection[11] = 1.0f;
+		projection[14] = -NEAR_DIST * FAR_DIST / (FAR_DIST - NEAR_DIST);
+	}
+	else
+	{
+		projection[0] = 2.0f / 20.0f;
+		projection[5] = 2.0f / 11.25f;
+		projection[10] = 1.0f / (FAR_DIST - NEAR_DIST);
+		projection[14] = -NEAR_DIST / (FAR_DIST - NEAR_DIST);
+		projection[15] = 1.0f;
+	}
+}
+
+// A camera at (1, 2, -10) turned a little to the right, and the world axes of its view space
+static void GetView(float view[16], float axes[3][3], float position[3])
+{
+	const float yaw = 0.3f;
+	const float basis[3][3] = { { cosf(yaw), 0.0f, -sinf(yaw) }, { 0.0f, 1.0f, 0.0f }, { sinf(yaw), 0.0f, cosf(yaw) } };
+	const float camera[3] = { 1.0f, 2.0f, -10.0f };
+	for (int a = 0; a < 3; a++)
+	{
+		position[a] = camera[a];
+		for (int b = 0; b < 3; b++) { axes[a][b] = basis[a][b]; }
+		view[a] = basis[a][0];
+		view[4 + a] = basis[a][1];
+		view[8 + a] = basis[a][2];
+		view[12 + a] = -(camera[0] * basis[a][0] + camera[1] * basis[a][1] + camera[2] * basis[a][2]);
+		view[a * 4 + 3] = 0.0f;
+	}
+	view[15] = 1.0f;
+}
+
+// Some directional lights, then point and spot lights around the view, some reaching past its near and far planes
+static std::vector<Light> CreateLights(unsigned int count, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Light> lights(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Light& light = lights[i];
+		light = {};
+		light.Type = i % 11 == 0 ? LIGHT_TYPE_DIR : i % 3 == 0 ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT;
+		light.Position = DirectX::XMFLOAT3(unit(random) * 40.0f, unit(random) * 10.0f, unit(random) * 60.0f + 40.0f);
+		light.Range = 1.0f + (unit(random) + 1.0f) * 4.0f;
+		light.Direction = DirectX::XMFLOAT3(unit(random), unit(random), unit(random));
+	}
+	return lights;
+}
+
+// View space bounds of a cluster, from the corners of its tile at its slice's depths
+static void GetClusterBounds(const float projection[16], unsigned int x, unsigned int y, unsigned int slice, float boxMin[3], float boxMax[3])
+{
+	float depths[2] = { NEAR_DIST * powf(FAR_DIST / NEAR_DIST, (float)slice / SLICES), NEAR_DIST * powf(FAR_DIST / NEAR_DIST, (float)(slice + 1) / SLICES) };
+	float ndcX[2] = { -1.0f + 2.0f * x / TILES_X, -1.0f + 2.0f * (x + 1) / TILES_X };
+	float ndcY[2] = { 1.0f - 2.0f * y / TILES_Y, 1.0f - 2.0f * (y + 1) / TILES_Y };
+	for (int a = 0; a < 3; a++)
+	{
+		boxMin[a] = FLT_MAX;
+		boxMax[a] = -FLT_MAX;
+	}
+	for (int c = 0; c < 8; c++)
+	{
+		float z = depths[c >> 2];
+		float w = z * projection[11] + projection[15];
+		float corner[3] = { (ndcX[c & 1] * w - projection[12]) / projection[0], (ndcY[(c >> 1) & 1] * w - projection[13]) / projection[5], z };
+		for (int a = 0; a < 3; a++)
+		{
+			boxMin[a] = std::min(boxMin[a], corner[a]);
+			boxMax[a] = std::max(boxMax[a], corner[a]);
+		}
+	}
+}
+
+// Whether a light reaches a box: 1 if it surely does, 0 if it surely doesn't, -1 if it's too close to call
+static int LightReachesBox(const Light& light, const float view[16], const float boxMin[3], const float boxMax[3])
+{
+	float center[3], axis[3];
+	float axisLength = 0.0f;
+	for (int a = 0; a < 3; a++)
+	{
+		center[a] = light.Position.x * view[a] + light.Position.y * view[4 + a] + light.Position.z * view[8 + a] + view[12 + a];
+		axis[a] = light.Direction.x * view[a] + light.Direction.y * view[4 + a] + light.Direction.z * view[8 + a];
+		axisLength += axis[a] * axis[a];
+	}
+	float distanceSq = 0.0f;
+	for (int a = 0; a < 3; a++)
+	{
+		float d = std::max(0.0f, std::max(boxMin[a] - center[a], center[a] - boxMax[a]));
+		distanceSq += d * d;
+	}
+	float radiusSq = light.Range * light.Range;
+	if (distanceSq > radiusSq * (1.0f + EDGE_TOLERANCE))
+		return 0;
+	bool surelyReaches = distanceSq < radiusSq * (1.0f - EDGE_TOLERANCE);
+
+	// Spot lights only reach boxes with a corner in front of them
+	if (light.Type == LIGHT_TYPE_SPOT && axisLength > 0.0f)
+	{
+		float front = 0.0f;
+		for (int a = 0; a < 3; a++) { front += ((axis[a] > 0.0f ? boxMax[a] : boxMin[a]) - center[a]) * axis[a] / sqrtf(axisLength); }
+		if (front < -EDGE_TOLERANCE * light.Range)
+			return 0;
+		surelyReaches = surelyReaches && front > EDGE_TOLERANCE * light.Range;
+	}
+	return surelyReaches ? 1 : -1;
+}
+
+// Bins a set and checks every cluster's list against testing each light against the cluster's box one at a time
+static void CheckAgainstScalarBinning(LightClusters& clusters, LightSet& set, const std::vector<Light>& lights, const float projection[16], const float view[16])
+{
+	clusters.Bin(set, view);
+	unsigned int count = (unsigned int)lights.size();
+	unsigned int missing = 0;
+	unsigned int extra = 0;
+	unsigned int unsorted = 0;
+	unsigned int visible = 0;
+	for (unsigned int id = 0; id < count; id++)
+	{
+		float z = lights[id].Position.x * view[2] + lights[id].Position.y * view[6] + lights[id].Position.z * view[10] + view[14];
+		if (lights[id].Type != LIGHT_TYPE_DIR && z + lights[id].Range >= NEAR_DIST && z - lights[id].Range <= FAR_DIST)
+			visible++;
+	}
+	const std::vector<LightClusterRange>& ranges = clusters.GetRanges();
+	const std::vector<unsigned int>& indices = clusters.GetIndices();
+	for (unsigned int slice = 0; slice < SLICES; slice++)
+		for (unsigned int y = 0; y < TILES_Y; y++)
+			for (unsigned int x = 0; x < TILES_X; x++)
+			{
+				const LightClusterRange& range = ranges[(slice * TILES_Y + y) * TILES_X + x];
+				const unsigned int* listed = indices.data() + range.Offset;
+				for (unsigned int i = 0; i < range.Count; i++)
+				{
+					unsorted += i > 0 && listed[i] <= listed[i - 1] ? 1 : 0;
+					extra += listed[i] >= count ? 1 : 0;
+				}
+				float boxMin[3], boxMax[3];
+				GetClusterBounds(projection, x, y, slice, boxMin, boxMax);
+				for (unsigned int id = 0; id < count; id++)
+				{
+					unsigned int index = set.GetIndex(id);
+					bool isListed = std::binary_search(listed, listed + range.Count, index);
+					int reaches = lights[id].Type == LIGHT_TYPE_DIR ? 0 : LightReachesBox(lights[id], view, boxMin, boxMax);
+					if (reaches == 1 && !isListed)
+						missing++;
+					if (reaches == 0 && isListed)
+						extra++;
+				}
+			}
+	CHECK(missing == 0);
+	CHECK(extra == 0);
+	CHECK(unsorted == 0);
+	CHECK(clusters.GetStats().Lights == count);
+	CHECK(clusters.GetStats().DirectionalLights == set.GetTypeCount(LIGHT_TYPE_DIR));
+	CHECK(clusters.GetStats().VisibleLights == visible);
+	CHECK(clusters.GetStats().Indices == indices.size());
+}
+
+TEST(ClusterListsMatchScalarBinning)
+{
+	// Counts that leave one to three lights in the last group of four, after one or more directional lights
+	std::mt19937 random(23);
+	LightClusters clusters(TILES_X, TILES_Y, SLICES, 2);
+	float view[16], axes[3][3], position[3];
+	GetView(view, axes, position);
+	for (bool perspective : { true, false })
+	{
+		float projection[16];
+		GetProjection(perspective, projection);
+		clusters.SetProjection(projection, NEAR_DIST, FAR_DIST);
+		for (unsigned int count : { 1u, 2u, 3u, 5u, 6u, 7u, 13u, 14u, 101u, 1002u })
+		{
+			std::vector<Light> lights = CreateLights(count, random);
+			LightSet set;
+			for (const Light& light : lights) { set.Add(light); }
+			CheckAgainstScalarBinning(clusters, set, lights, projection, view);
+		}
+
+		// Cut down from a bigger set, so the padding past the last light is where other lights were
+		std::vector<Light> lights = CreateLights(200, random);
+		for (unsigned int count : { 103u, 50u, 9u, 2u })
+		{
+			LightSet set;
+			for (const Light& light : lights) { set.Add(light); }
+			set.Truncate(count);
+			std::vector<Light> kept(lights.begin(), lights.begin() + count);
+			CheckAgainstScalarBinning(clusters, set, kept, projection, view);
+		}
+	}
+}
+
+TEST(FoundClustersListEveryLightReachingAPoint)
+{
+	// What a pixel sees: the cluster FindCluster() picks for it holds every light that reaches it
+	std::mt19937 random(29);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	LightClusters clusters(TILES_X, TILES_Y, SLICES, 2);
+	float view[16], axes[3][3], position[3];
+	GetView(view, axes, position);
+	for (bool perspective : { true, false })
+	{
+		float projection[16];
+		GetProjection(perspective, projection);
+		clusters.SetProjection(projection, NEAR_DIST, FAR_DIST);
+		for (unsigned int count : { 7u, 502u })
+		{
+			std::vector<Light> lights = CreateLights(count, random);
+			LightSet set;
+			for (const Light& light : lights) { set.Add(light); }
+			clusters.Bin(set, view);
+			const std::vector<LightClusterRange>& ranges = clusters.GetRanges();
+			const std::vector<unsigned int>& indices = clusters.GetIndices();
+
+			unsigned int reaching = 0;
+			unsigned int missing = 0;
+			for (int sample = 0; sample < 20000; sample++)
+			{
+				float screenX = unit(random);
+				float screenY = unit(random);
+				float z = NEAR_DIST * powf(FAR_DIST / NEAR_DIST, unit(random));
+				float w = z * projection[11] + projection[15];
+				float viewPosition[3] = { ((screenX * 2.0f - 1.0f) * w - projection[12]) / projection[0],
+					((1.0f - screenY * 2.0f) * w - projection[13]) / projection[5], z };
+				float world[3];
+				for (int a = 0; a < 3; a++)
+				{
+					world[a] = position[a] + viewPosition[0] * axes[0][a] + viewPosition[1] * axes[1][a] + viewPosition[2] * axes[2][a];
+				}
+
+				const LightClusterRange& range = ranges[clusters.FindCluster(screenX, screenY, z)];
+				for (unsigned int id = 0; id < count; id++)
+				{
+					const Light& light = lights[id];
+					if (light.Type == LIGHT_TYPE_DIR)
+						continue;
+					float offset[3] = { world[0] - light.Position.x, world[1] - light.Position.y, world[2] - light.Position.z };
+					if (offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2] >= light.Range * light.Range * (1.0f - EDGE_TOLERANCE))
+						continue;
+					if (light.Type == LIGHT_TYPE_SPOT && offset[0] * light.Direction.x + offset[1] * light.Direction.y + offset[2] * light.Direction.z <= 0.0f)
+						continue;
+					reaching++;
+					if (!std::binary_search(indices.begin() + range.Offset, indices.begin() + range.Offset + range.Count, set.GetIndex(id)))
+						missing++;
+				}
+			}
+			CHECK(reaching > 0);
+			CHECK(missing == 0);
+		}
+	}
+}
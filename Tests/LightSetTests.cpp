@@ -0,0 +1,112 @@
+#include "TestFramework.h"
+#include "LightSet.h"
+#include <algorithm>
+#include <random>
+
+// Radiance scale a light gives a point, as PBR.hlsli's PointLight() and SpotLight() work it out, and the direction to the light
+static void GetLightTerms(const Light& light, const float position[3], float radiance[3], float toLight[3])
+{
+	float offset[3] = { light.Position.x - position[0], light.Position.y - position[1], light.Position.z - position[2] };
+	if (light.Type == LIGHT_TYPE_DIR)
+	{
+		offset[0] = -light.Direction.x;
+		offset[1] = -light.Direction.y;
+		offset[2] = -light.Direction.z;
+	}
+	float distance = sqrtf(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+	for (int a = 0; a < 3; a++) { toLight[a] = offset[a] / distance; }
+
+	float scale = light.Intensity;
+	if (light.Type != LIGHT_TYPE_DIR)
+	{
+		// Attenuate()
+		float attenuation = std::min(std::max(1.0f - distance * distance / (light.Range * light.Range), 0.0f), 1.0f);
+		scale *= attenuation * attenuation;
+	}
+	if (light.Type == LIGHT_TYPE_SPOT)
+	{
+		// ConeAttenuate()
+		float length = sqrtf(light.Direction.x * light.Direction.x + light.Direction.y * light.Direction.y + light.Direction.z * light.Direction.z);
+		float cosine = -(toLight[0] * light.Direction.x + toLight[1] * light.Direction.y + toLight[2] * light.Direction.z) / length;
+		scale *= powf(std::min(std::max(cosine, 0.0f), 1.0f), light.SpotFalloff);
+	}
+	radiance[0] = scale * light.Color.x;
+	radiance[1] = scale * light.Color.y;
+	radiance[2] = scale * light.Color.z;
+}
+
+// Lights of every type, with the ranges of values the scenes use
+static std::vector<Light> CreateRandomLights(unsigned int count)
+{
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<Light> lights(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Light& light = lights[i];
+		light = {};
+		light.Type = i % 7 == 0 ? LIGHT_TYPE_DIR : i % 3 == 0 ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT;
+		light.Position = DirectX::XMFLOAT3(unit(random) * 200.0f - 100.0f, unit(random) * 40.0f - 20.0f, unit(random) * 200.0f - 100.0f);
+		light.Range = 0.5f + unit(random) * 20.0f;
+		light.Direction = DirectX::XMFLOAT3(unit(random) * 2.0f - 1.0f, unit(random) * 2.0f - 1.0f, unit(random) * 2.0f - 1.0f);
+		light.Color = DirectX::XMFLOAT3(unit(random), unit(random), unit(random));
+		light.Intensity = unit(random) * 8.0f;
+		light.SpotFalloff = 1.0f + unit(random) * 32.0f;
+	}
+	return lights;
+}
+
+TEST(PackedLightsRoundTrip)
+{
+	std::vector<Light> lights = CreateRandomLights(1000);
+	for (const Light& light : lights)
+	{
+		Light unpacked = UnpackLight(PackLight(light), light.Type);
+		CHECK(unpacked.Type == light.Type);
+		// World space distances stay full precision
+		CHECK(unpacked.Position.x == light.Position.x);
+		CHECK(unpacked.Position.y == light.Position.y);
+		CHECK(unpacked.Position.z == light.Position.z);
+		CHECK(unpacked.Range == light.Range);
+		// Halves round to 11 significant bits
+		const float original[8] = { light.Color.x, light.Color.y, light.Color.z, light.Intensity,
+			light.Direction.x, light.Direction.y, light.Direction.z, light.SpotFalloff };
+		const float decoded[8] = { unpacked.Color.x, unpacked.Color.y, unpacked.Color.z, unpacked.Intensity,
+			unpacked.Direction.x, unpacked.Direction.y, unpacked.Direction.z, unpacked.SpotFalloff };
+		for (int f = 0; f < 8; f++) { CHECK_NEAR(decoded[f], original[f], fabsf(original[f]) / 2048.0f + 1e-7f); }
+	}
+}
+
+TEST(PackedLightsLightLikeTheOriginals)
+{
+	// Through the set, so lights are read back from the index and type they were sorted to
+	std::vector<Light> lights = CreateRandomLights(1000);
+	LightSet set;
+	for (const Light& light : lights) { set.Add(light); }
+
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+	double maxRadianceError = 0.0;
+	double maxDirectionError = 0.0;
+	for (unsigned int id = 0; id < lights.size(); id++)
+	{
+		const Light& light = lights[id];
+		unsigned int index = set.GetIndex(id);
+		CHECK(set.GetType(index) == light.Type);
+		Light unpacked = UnpackLight(set.GetPacked()[index], set.GetType(index));
+		for (int sample = 0; sample < 50; sample++)
+		{
+			float position[3] = { light.Position.x + offset(random) * light.Range, light.Position.y + offset(random) * light.Range,
+				light.Position.z + offset(random) * light.Range };
+			float expected[3], actual[3], expectedToLight[3], actualToLight[3];
+			GetLightTerms(light, position, expected, expectedToLight);
+			GetLightTerms(unpacked, position, actual, actualToLight);
+			for (int c = 0; c < 3; c++) { maxRadianceError = std::max(maxRadianceError, (double)fabsf(actual[c] - expected[c])); }
+			float cosine = expectedToLight[0] * actualToLight[0] + expectedToLight[1] * actualToLight[1] + expectedToLight[2] * actualToLight[2];
+			maxDirectionError = std::max(maxDirectionError, acos(std::min(cosine, 1.0f)) * 180.0 / 3.14159265358979);
+		}
+	}
+	// Halves keep about 0.05% of each value; spot falloff exponents up to 33 make that a little more
+	CHECK(maxRadianceError <= 0.01);
+	CHECK(maxDirectionError <= 0.1);
+}
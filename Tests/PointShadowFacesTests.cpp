@@ -0,0 +1,153 @@
+#include "TestFramework.h"
+#include "PointShadowFaces.h"
+#include <random>
+
+static const float LIGHT_POSITION[3] = { 4.0f, 2.5f, -2.0f };
+static const float LIGHT_RANGE = 5.0f;
+
+// The face PBR.hlsli's PointShadow() samples for an offset from the light: the major axis, ties going to x then y
+static unsigned int GetShaderFace(const float offset[3])
+{
+	float axis[3] = { fabsf(offset[0]), fabsf(offset[1]), fabsf(offset[2]) };
+	if (axis[0] >= axis[1] && axis[0] >= axis[2])
+		return offset[0] >= 0.0f ? 0 : 1;
+	if (axis[1] >= axis[2])
+		return offset[1] >= 0.0f ? 2 : 3;
+	return offset[2] >= 0.0f ? 4 : 5;
+}
+
+// Row vector times row major matrix, as the shaders' mul(position, matrix)
+static void Transform(const float position[4], const float matrix[16], float result[4])
+{
+	for (int c = 0; c < 4; c++)
+	{
+		result[c] = position[0] * matrix[c] + position[1] * matrix[4 + c] + position[2] * matrix[8 + c] + position[3] * matrix[12 + c];
+	}
+}
+
+// Every face the shader would sample for a point of the sphere within the light's range has to be in its mask
+static bool MaskCoversSphere(const float center[3], float radius, unsigned int mask, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (int sample = 0; sample < 200; sample++)
+	{
+		float direction[3] = { unit(random), unit(random), unit(random) };
+		float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+		if (length > 1.0f || length < 1e-3f)
+			continue;
+		// Half the samples on the surface, where the sphere reaches furthest into its neighbors
+		float scale = sample % 2 == 0 ? radius / length : radius * fabsf(unit(random)) / length;
+		float offset[3];
+		for (int a = 0; a < 3; a++) { offset[a] = center[a] + direction[a] * scale - LIGHT_POSITION[a]; }
+		if (sqrtf(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]) > LIGHT_RANGE)
+			continue;
+		if (((mask >> GetShaderFace(offset)) & 1) == 0)
+			return false;
+	}
+	return true;
+}
+
+static unsigned int CountFaces(unsigned int mask)
+{
+	unsigned int count = 0;
+	for (unsigned int f = 0; f < POINT_SHADOW_FACES; f++) { count += (mask >> f) & 1; }
+	return count;
+}
+
+TEST(PointFacesHoldWhatTheShaderSamplesFromThem)
+{
+	ShadowCascade faces[POINT_SHADOW_FACES];
+	FitPointShadowFaces(LIGHT_POSITION, LIGHT_RANGE, 0.05f, faces);
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	unsigned int outside = 0;
+	for (int sample = 0; sample < 100000; sample++)
+	{
+		float offset[3] = { unit(random) * LIGHT_RANGE, unit(random) * LIGHT_RANGE, unit(random) * LIGHT_RANGE };
+		float distance = sqrtf(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+		if (distance > LIGHT_RANGE || distance < 0.1f)
+			continue;
+		const ShadowCascade& face = faces[GetShaderFace(offset)];
+		float position[4] = { LIGHT_POSITION[0] + offset[0], LIGHT_POSITION[1] + offset[1], LIGHT_POSITION[2] + offset[2], 1.0f };
+		float clip[4];
+		Transform(position, face.ViewProjection, clip);
+		float slack = clip[3] * 1e-4f;
+		bool inFrustum = fabsf(clip[0]) <= clip[3] + slack && fabsf(clip[1]) <= clip[3] + slack && clip[2] >= 0.0f && clip[2] <= clip[3] + slack;
+		float fromCenter[3] = { position[0] - face.Center[0], position[1] - face.Center[1], position[2] - face.Center[2] };
+		bool inBounds = sqrtf(fromCenter[0] * fromCenter[0] + fromCenter[1] * fromCenter[1] + fromCenter[2] * fromCenter[2]) <= face.Radius;
+		if (!inFrustum || !inBounds)
+			outside++;
+	}
+	CHECK(outside == 0);
+}
+
+TEST(FaceMasksCoverRandomSpheres)
+{
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	unsigned int missed = 0;
+	unsigned int reached = 0;
+	unsigned int faceCount = 0;
+	for (int sample = 0; sample < 20000; sample++)
+	{
+		float center[3] = { LIGHT_POSITION[0] + unit(random) * 7.0f, LIGHT_POSITION[1] + unit(random) * 7.0f, LIGHT_POSITION[2] + unit(random) * 7.0f };
+		float radius = fabsf(unit(random));
+		unsigned int mask = GetPointShadowFaceMask(LIGHT_POSITION, LIGHT_RANGE, center, radius);
+		if (!MaskCoversSphere(center, radius, mask, random))
+			missed++;
+		if (mask != 0)
+		{
+			reached++;
+			faceCount += CountFaces(mask);
+		}
+	}
+	CHECK(missed == 0);
+	// Culling has to pay for itself: most spheres in reach land in one or two faces, not all six
+	CHECK(reached > 0 && faceCount < reached * 2);
+}
+
+TEST(FaceMasksCoverSpheresStraddlingFaces)
+{
+	std::mt19937 random(11);
+	// Centered on an edge between two faces, and on a corner between three
+	const float directions[][3] = {
+		{ 1, 1, 0 }, { 1, -1, 0 }, { -1, 0, 1 }, { 0, -1, -1 }, { 0, 1, 1 }, { -1, 0, -1 },
+		{ 1, 1, 1 }, { -1, 1, -1 }, { 1, -1, -1 }, { -1, -1, 1 } };
+	for (const float* direction : directions)
+	{
+		float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+		unsigned int expectedFaces = 0;
+		for (int a = 0; a < 3; a++) { expectedFaces += direction[a] != 0.0f ? 1 : 0; }
+		for (float distance = 0.5f; distance < LIGHT_RANGE; distance += 1.0f)
+		{
+			float center[3];
+			for (int a = 0; a < 3; a++) { center[a] = LIGHT_POSITION[a] + direction[a] / length * distance; }
+			unsigned int mask = GetPointShadowFaceMask(LIGHT_POSITION, LIGHT_RANGE, center, 0.1f);
+			CHECK(CountFaces(mask) >= expectedFaces);
+			CHECK(MaskCoversSphere(center, 0.1f, mask, random));
+		}
+	}
+
+	// Moving off the +X/+Y boundary (the plane x = y), a sphere reaches +Y until it's a radius away from it
+	const float radius = 0.2f;
+	for (float gap = 0.02f; gap < 0.4f; gap += 0.02f)
+	{
+		float center[3] = { LIGHT_POSITION[0] + 3.0f, LIGHT_POSITION[1] + 3.0f - gap, LIGHT_POSITION[2] };
+		unsigned int mask = GetPointShadowFaceMask(LIGHT_POSITION, LIGHT_RANGE, center, radius);
+		float planeDistance = gap / 1.41421356f;
+		CHECK((mask & 1) != 0);
+		if (planeDistance < radius - 1e-3f) { CHECK((mask & (1u << 2)) != 0); }
+		if (planeDistance > radius + 1e-3f) { CHECK((mask & (1u << 2)) == 0); }
+		CHECK(MaskCoversSphere(center, radius, mask, random));
+	}
+}
+
+TEST(FaceMasksOfSpheresAroundAndBeyondTheLight)
+{
+	// Holding the light reaches every face, out of range reaches none, deep inside one face reaches only it
+	CHECK(GetPointShadowFaceMask(LIGHT_POSITION, LIGHT_RANGE, LIGHT_POSITION, 0.5f) == (1u << POINT_SHADOW_FACES) - 1);
+	float beyond[3] = { LIGHT_POSITION[0] + LIGHT_RANGE + 1.0f, LIGHT_POSITION[1], LIGHT_POSITION[2] };
+	CHECK(GetPointShadowFaceMask(LIGHT_POSITION, LIGHT_RANGE, beyond, 0.5f) == 0);
+	float inside[3] = { LIGHT_POSITION[0], LIGHT_POSITION[1], LIGHT_POSITION[2] - 3.0f };
+	CHECK(GetPointShadowFaceMask(LIGHT_POSITION, LIGHT_RANGE, inside, 0.5f) == (1u << 5));
+}
@@ -0,0 +1,187 @@
+#include "TestFramework.h"
+#include "ShadowAtlas.h"
+#include <algorithm>
+#include <random>
+
+static const ShadowAtlasSettings SETTINGS = { 4096, 64, 2048, 1.0f, 0.25f };
+
+// Whether every tile sits inside the atlas and no two tiles share a texel
+static bool TilesArePacked(const ShadowAtlas& atlas, unsigned int keyCount)
+{
+	std::vector<ShadowAtlasTile> placed;
+	for (unsigned int key = 0; key < keyCount; key++)
+	{
+		const ShadowAtlasTile* tile = atlas.GetTile(key);
+		if (!tile)
+			continue;
+		if (tile->X + tile->Size > atlas.GetSettings().Size || tile->Y + tile->Size > atlas.GetSettings().Size)
+			return false;
+		for (const ShadowAtlasTile& other : placed)
+		{
+			if (tile->X < other.X + other.Size && other.X < tile->X + tile->Size &&
+				tile->Y < other.Y + other.Size && other.Y < tile->Y + tile->Size)
+				return false;
+		}
+		placed.push_back(*tile);
+	}
+	return true;
+}
+
+TEST(AtlasTilesNeverOverlap)
+{
+	// Random sets of shadows, changing every frame, at every budget
+	std::mt19937 random(13);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (float budget : { 0.25f, 0.5f, 1.0f })
+	{
+		ShadowAtlasSettings settings = SETTINGS;
+		settings.Budget = budget;
+		ShadowAtlas atlas(settings);
+		unsigned int overlapping = 0;
+		unsigned int overBudget = 0;
+		for (int frame = 0; frame < 200; frame++)
+		{
+			unsigned int keyCount = 1 + (unsigned int)(unit(random) * 60.0f);
+			for (unsigned int key = 0; key < keyCount; key++)
+			{
+				if (unit(random) < 0.9f)
+					atlas.Request(key, unit(random) * unit(random));
+			}
+			atlas.Allocate();
+			if (!TilesArePacked(atlas, keyCount))
+				overlapping++;
+			if (atlas.GetUsage() > budget)
+				overBudget++;
+		}
+		CHECK(overlapping == 0);
+		CHECK(overBudget == 0);
+	}
+}
+
+TEST(AtlasShrinksThenDropsTheLeastImportant)
+{
+	// Eight full size tiles in room for four: the least important halve first, until they fit
+	ShadowAtlasSettings settings = { 1024, 64, 512, 1.0f, 0.0f };
+	ShadowAtlas atlas(settings);
+	for (unsigned int key = 0; key < 8; key++) { atlas.Request(key, 1.0f - key * 0.001f); }
+	atlas.Allocate();
+	CHECK(atlas.GetDroppedCount() == 0);
+	CHECK(TilesArePacked(atlas, 8));
+	for (unsigned int key = 0; key < 8; key++)
+	{
+		const ShadowAtlasTile* tile = atlas.GetTile(key);
+		CHECK(tile != nullptr);
+		if (tile) { CHECK(tile->Size == (key < 2 ? 512u : 256u)); }
+	}
+
+	// Once everything is as small as it goes, the least important are dropped
+	settings.MinTileSize = 256;
+	atlas.SetSettings(settings);
+	for (unsigned int key = 0; key < 20; key++) { atlas.Request(key, 1.0f - key * 0.001f); }
+	atlas.Allocate();
+	CHECK(atlas.GetDroppedCount() == 4);
+	CHECK(atlas.GetTileCount() == 16);
+	for (unsigned int key = 0; key < 20; key++) { CHECK((atlas.GetTile(key) != nullptr) == (key < 16)); }
+	CHECK_NEAR(atlas.GetUsage(), 1.0, 1e-6);
+}
+
+TEST(AtlasHysteresisKeepsTilesStable)
+{
+	// Importance wobbling around the point where 512 rounds to 1024: sqrt(importance) * 2048 = 2^9.5
+	const float boundary = powf(2.0f, 9.5f) / 2048.0f;
+	for (float hysteresis : { 0.0f, 0.25f })
+	{
+		ShadowAtlasSettings settings = SETTINGS;
+		settings.Hysteresis = hysteresis;
+		ShadowAtlas atlas(settings);
+		unsigned int resized = 0;
+		unsigned int moved = 0;
+		unsigned int previousSize = 0;
+		for (int frame = 0; frame < 100; frame++)
+		{
+			float importance = boundary * boundary * (frame % 2 ? 1.05f : 0.95f);
+			atlas.Request(0, importance);
+			atlas.Request(1, 0.01f);
+			atlas.Allocate();
+			const ShadowAtlasTile* tile = atlas.GetTile(0);
+			if (frame > 0 && tile->Size != previousSize)
+				resized++;
+			if (frame > 0 && (!atlas.IsTileUnchanged(0) || !atlas.IsTileUnchanged(1)))
+				moved++;
+			previousSize = tile->Size;
+		}
+		if (hysteresis > 0.0f)
+		{
+			CHECK(resized == 0);
+			CHECK(moved == 0);
+		}
+		else
+			CHECK(resized == 99);
+	}
+
+	// Past the hysteresis a tile does resize
+	ShadowAtlas atlas(SETTINGS);
+	atlas.Request(0, 0.25f);
+	atlas.Allocate();
+	CHECK(atlas.GetTile(0)->Size == 1024);
+	atlas.Request(0, 0.6f);
+	atlas.Allocate();
+	CHECK(atlas.GetTile(0)->Size == 1024);
+	atlas.Request(0, 1.0f);
+	atlas.Allocate();
+	CHECK(atlas.GetTile(0)->Size == 2048);
+}
+
+TEST(AtlasReportsUnchangedTiles)
+{
+	ShadowAtlas atlas(SETTINGS);
+
+	// Nothing was rendered before the first frame
+	atlas.Request(1, 0.1f);
+	atlas.Allocate();
+	CHECK(!atlas.IsTileUnchanged(1));
+
+	// The same request lands in the same place
+	atlas.Request(1, 0.1f);
+	atlas.Allocate();
+	CHECK(atlas.IsTileUnchanged(1));
+
+	// A new tile of the same size and a lower key goes first, so the old one moves
+	atlas.Request(0, 0.1f);
+	atlas.Request(1, 0.1f);
+	atlas.Allocate();
+	CHECK(!atlas.IsTileUnchanged(0));
+	CHECK(!atlas.IsTileUnchanged(1));
+	atlas.Request(0, 0.1f);
+	atlas.Request(1, 0.1f);
+	atlas.Allocate();
+	CHECK(atlas.IsTileUnchanged(0));
+	CHECK(atlas.IsTileUnchanged(1));
+
+	// A resized tile has changed, and so has one that wasn't requested last frame
+	atlas.Request(0, 1.0f);
+	atlas.Allocate();
+	CHECK(!atlas.IsTileUnchanged(0));
+	CHECK(!atlas.IsTileUnchanged(1));
+	atlas.Request(0, 1.0f);
+	atlas.Request(1, 0.1f);
+	atlas.Allocate();
+	CHECK(atlas.IsTileUnchanged(0));
+	CHECK(!atlas.IsTileUnchanged(1));
+	CHECK(!atlas.IsTileUnchanged(7));
+
+	// Shadows are requested in whatever order the scene walks them; the same set still lands in the same places
+	ShadowAtlas shuffled(SETTINGS);
+	std::mt19937 random(17);
+	std::vector<unsigned int> keys;
+	for (unsigned int key = 0; key < 40; key++) { keys.push_back(key); }
+	unsigned int moved = 0;
+	for (int frame = 0; frame < 20; frame++)
+	{
+		std::shuffle(keys.begin(), keys.end(), random);
+		for (unsigned int key : keys) { shuffled.Request(key, key % 2 ? 0.01f : 0.05f); }
+		shuffled.Allocate();
+		for (unsigned int key : keys) { moved += frame > 0 && !shuffled.IsTileUnchanged(key) ? 1 : 0; }
+	}
+	CHECK(moved == 0);
+}
@@ -0,0 +1,223 @@
+#include "TestFramework.h"
+#include "ShadowCascades.h"
+#include <algorithm>
+#include <random>
+
+static const float NEAR_DIST = 0.01f;
+static const float FAR_DIST = 750.0f;
+static const float LIGHT_DIRECTION[3] = { 1.0f, -1.0f, 0.3f };
+static const ShadowCascadeSettings SETTINGS = { 4, 0.75f, 60.0f, 50.0f };
+static const unsigned int RESOLUTION = 1024;
+
+// A camera's view matrix as Camera.cpp builds it (XMMatrixLookToLH from a yaw and pitch)
+static void GetCameraView(const float position[3], float yaw, float pitch, float view[16])
+{
+	float forward[3] = { cosf(pitch) * sinf(yaw), -sinf(pitch), cosf(pitch) * cosf(yaw) };
+	float right[3] = { forward[2], 0.0f, -forward[0] };
+	float length = sqrtf(right[0] * right[0] + right[2] * right[2]);
+	right[0] /= length;
+	right[2] /= length;
+	float up[3] = { forward[1] * right[2] - forward[2] * right[1], forward[2] * right[0] - forward[0] * right[2], forward[0] * right[1] - forward[1] * right[0] };
+	const float* axes[3] = { right, up, forward };
+	for (int a = 0; a < 3; a++)
+	{
+		view[a] = axes[a][0];
+		view[4 + a] = axes[a][1];
+		view[8 + a] = axes[a][2];
+		view[12 + a] = -(axes[a][0] * position[0] + axes[a][1] * position[1] + axes[a][2] * position[2]);
+		view[a * 4 + 3] = 0.0f;
+	}
+	view[15] = 1.0f;
+}
+
+// XMMatrixPerspectiveFovLH and XMMatrixOrthographicLH, as Camera.cpp sets them up
+static void GetCameraProjection(bool perspective, float projection[16])
+{
+	for (int m = 0; m < 16; m++) { projection[m] = 0.0f; }
+	if (perspective)
+	{
+		projection[5] = 1.0f / tanf(0.7854f);
+		projection[0] = projection[5] * 9.0f / 16.0f;
+		projection[10] = FAR_DIST / (FAR_DIST - NEAR_DIST);
+		projection[11] = 1.0f;
+		projection[14] = -NEAR_DIST * FAR_DIST / (FAR_DIST - NEAR_DIST);
+	}
+	else
+	{
+		projection[0] = 2.0f / 36.0f;
+		projection[5] = 2.0f / 20.0f;
+		projection[10] = 1.0f / (FAR_DIST - NEAR_DIST);
+		projection[14] = -NEAR_DIST / (FAR_DIST - NEAR_DIST);
+		projection[15] = 1.0f;
+	}
+}
+
+// Row vector times row major matrix, as the shaders' mul(position, matrix)
+static void Transform(const float position[3], const float matrix[16], float result[4])
+{
+	for (int c = 0; c < 4; c++)
+	{
+		result[c] = position[0] * matrix[c] + position[1] * matrix[4 + c] + position[2] * matrix[8 + c] + matrix[12 + c];
+	}
+}
+
+TEST(CascadeSplitsBlendEvenAndLogarithmic)
+{
+	float even[MAX_SHADOW_CASCADES], logarithmic[MAX_SHADOW_CASCADES], practical[MAX_SHADOW_CASCADES];
+	ComputeCascadeSplits(1.0f, 100.0f, 4, 0.0f, even);
+	ComputeCascadeSplits(1.0f, 100.0f, 4, 1.0f, logarithmic);
+	ComputeCascadeSplits(1.0f, 100.0f, 4, 0.75f, practical);
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		CHECK_NEAR(even[i], 1.0f + 99.0f * (i + 1) / 4.0f, 1e-4);
+		CHECK_NEAR(logarithmic[i], powf(100.0f, (i + 1) / 4.0f), 1e-3);
+		CHECK_NEAR(practical[i], 0.75f * logarithmic[i] + 0.25f * even[i], 1e-3);
+		if (i > 0) { CHECK(practical[i] > practical[i - 1]); }
+	}
+	CHECK(practical[3] == 100.0f);
+
+	// Fitted cascades tile the view depth up to MaxDistance without gaps, whatever the count
+	float view[16], projection[16];
+	const float position[3] = { 0.0f, 2.0f, -10.0f };
+	GetCameraView(position, 0.3f, 0.2f, view);
+	GetCameraProjection(true, projection);
+	for (unsigned int count = 1; count <= MAX_SHADOW_CASCADES; count++)
+	{
+		ShadowCascadeSettings settings = SETTINGS;
+		settings.Count = count;
+		ShadowCascade cascades[MAX_SHADOW_CASCADES];
+		FitShadowCascades(view, projection, NEAR_DIST, FAR_DIST, LIGHT_DIRECTION, settings, cascades);
+		CHECK(cascades[0].SplitNear == NEAR_DIST);
+		for (unsigned int i = 1; i < count; i++) { CHECK(cascades[i].SplitNear == cascades[i - 1].SplitFar); }
+		CHECK(cascades[count - 1].SplitFar == SETTINGS.MaxDistance);
+	}
+}
+
+TEST(CascadesHoldTheirSlices)
+{
+	// Every point of each slice of the frustum lands inside its cascade's sphere and shadow map
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (bool perspective : { true, false })
+	{
+		float projection[16];
+		GetCameraProjection(perspective, projection);
+		unsigned int outside = 0;
+		for (int frame = 0; frame < 50; frame++)
+		{
+			float view[16];
+			const float position[3] = { frame * 0.37f, 2.0f, -10.0f + frame * 0.21f };
+			GetCameraView(position, frame * 0.13f, 0.3f * sinf(frame * 0.2f), view);
+			ShadowCascade cascades[MAX_SHADOW_CASCADES];
+			FitShadowCascades(view, projection, NEAR_DIST, FAR_DIST, LIGHT_DIRECTION, SETTINGS, cascades);
+			for (unsigned int i = 0; i < SETTINGS.Count; i++)
+			{
+				SnapShadowCascade(cascades[i], RESOLUTION);
+				float corners[8][3];
+				GetFrustumSliceCorners(view, projection, cascades[i].SplitNear, cascades[i].SplitFar, corners);
+				for (int sample = 0; sample < 100; sample++)
+				{
+					// A random blend of the slice's corners
+					float weights[3] = { (unit(random) + 1.0f) * 0.5f, (unit(random) + 1.0f) * 0.5f, (unit(random) + 1.0f) * 0.5f };
+					float point[3];
+					for (int a = 0; a < 3; a++)
+					{
+						float x0 = corners[0][a] + (corners[1][a] - corners[0][a]) * weights[0];
+						float x1 = corners[2][a] + (corners[3][a] - corners[2][a]) * weights[0];
+						float x2 = corners[4][a] + (corners[5][a] - corners[4][a]) * weights[0];
+						float x3 = corners[6][a] + (corners[7][a] - corners[6][a]) * weights[0];
+						float nearPoint = x0 + (x1 - x0) * weights[1];
+						float farPoint = x2 + (x3 - x2) * weights[1];
+						point[a] = nearPoint + (farPoint - nearPoint) * weights[2];
+					}
+					float clip[4];
+					Transform(point, cascades[i].ViewProjection, clip);
+					float fromCenter[3] = { point[0] - cascades[i].Center[0], point[1] - cascades[i].Center[1], point[2] - cascades[i].Center[2] };
+					bool inSphere = sqrtf(fromCenter[0] * fromCenter[0] + fromCenter[1] * fromCenter[1] + fromCenter[2] * fromCenter[2]) <= cascades[i].Radius;
+					bool inMap = fabsf(clip[0]) <= 1.0f && fabsf(clip[1]) <= 1.0f && clip[2] >= 0.0f && clip[2] <= 1.0f;
+					if (!inSphere || !inMap)
+						outside++;
+				}
+				CHECK(IsSphereInShadowMap(cascades[i].ViewProjection, cascades[i].Center, cascades[i].Radius));
+
+				// Casters up to CasterDistance toward the light from the sphere still land in the depth range
+				float length = sqrtf(LIGHT_DIRECTION[0] * LIGHT_DIRECTION[0] + LIGHT_DIRECTION[1] * LIGHT_DIRECTION[1] + LIGHT_DIRECTION[2] * LIGHT_DIRECTION[2]);
+				float back = cascades[i].Radius + SETTINGS.CasterDistance * 0.99f;
+				float caster[3], clip[4];
+				for (int a = 0; a < 3; a++) { caster[a] = cascades[i].Center[a] - LIGHT_DIRECTION[a] / length * back; }
+				Transform(caster, cascades[i].ViewProjection, clip);
+				CHECK(clip[2] >= 0.0f && clip[2] <= 1.0f);
+			}
+		}
+		CHECK(outside == 0);
+	}
+}
+
+TEST(CascadeRadiiHoldAsTheCameraTurns)
+{
+	// The slices only turn and move with the camera, so the spheres, and so the texel size, never change
+	for (bool perspective : { true, false })
+	{
+		float projection[16];
+		GetCameraProjection(perspective, projection);
+		float firstRadii[MAX_SHADOW_CASCADES];
+		unsigned int changed = 0;
+		for (int frame = 0; frame < 500; frame++)
+		{
+			float view[16];
+			const float position[3] = { frame * 0.0137f, 2.0f, -10.0f + frame * 0.021f };
+			GetCameraView(position, frame * 0.013f, 1.2f * sinf(frame * 0.02f), view);
+			ShadowCascade cascades[MAX_SHADOW_CASCADES];
+			FitShadowCascades(view, projection, NEAR_DIST, FAR_DIST, LIGHT_DIRECTION, SETTINGS, cascades);
+			for (unsigned int i = 0; i < SETTINGS.Count; i++)
+			{
+				if (frame == 0)
+					firstRadii[i] = cascades[i].Radius;
+				else if (cascades[i].Radius != firstRadii[i])
+					changed++;
+			}
+		}
+		CHECK(changed == 0);
+	}
+}
+
+TEST(SnappedCascadesMoveInWholeTexels)
+{
+	// A fixed world point keeps the same spot within its texel however the camera moves, and snapping moves a cascade less than a texel
+	float projection[16];
+	GetCameraProjection(true, projection);
+	const float point[3] = { 3.3f, 0.7f, 5.1f };
+	float firstFractions[MAX_SHADOW_CASCADES][2];
+	double maxDrift = 0.0;
+	double maxShift = 0.0;
+	for (int frame = 0; frame < 500; frame++)
+	{
+		float view[16];
+		const float position[3] = { frame * 0.0137f, 2.0f + frame * 0.003f, -10.0f + frame * 0.021f };
+		GetCameraView(position, frame * 0.013f, 0.3f * sinf(frame * 0.02f), view);
+		ShadowCascade cascades[MAX_SHADOW_CASCADES];
+		FitShadowCascades(view, projection, NEAR_DIST, FAR_DIST, LIGHT_DIRECTION, SETTINGS, cascades);
+		for (unsigned int i = 0; i < SETTINGS.Count; i++)
+		{
+			float unsnapped[4], clip[4];
+			Transform(point, cascades[i].ViewProjection, unsnapped);
+			SnapShadowCascade(cascades[i], RESOLUTION);
+			Transform(point, cascades[i].ViewProjection, clip);
+			for (int a = 0; a < 2; a++)
+			{
+				maxShift = std::max(maxShift, fabs(clip[a] - unsnapped[a]) * RESOLUTION * 0.5);
+				double texel = (clip[a] + 1.0) * 0.5 * RESOLUTION;
+				double fraction = texel - floor(texel);
+				if (frame == 0)
+					firstFractions[i][a] = (float)fraction;
+				else
+				{
+					double drift = fabs(fraction - firstFractions[i][a]);
+					maxDrift = std::max(maxDrift, std::min(drift, 1.0 - drift));
+				}
+			}
+		}
+	}
+	CHECK(maxDrift <= 0.01);
+	CHECK(maxShift <= 0.5 + 1e-3);
+}
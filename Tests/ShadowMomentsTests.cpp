@@ -0,0 +1,159 @@
+#include "TestFramework.h"
+#include "ShadowMoments.h"
+#include <algorithm>
+
+// ShadowMomentFilter's defaults
+static const ShadowMomentSettings DEFAULT_SETTINGS = { 40.0f, 5.0f, 0.0002f, 0.2f, 2 };
+
+// Depth texels across a test tile, and moment texels across once it's filtered
+static const unsigned int TILE_SIZE = 128;
+static const unsigned int MOMENT_SIZE = TILE_SIZE / 2;
+
+// An orthographic map's params, so test depths are already linear
+static void GetOrthographicParams(float params[4])
+{
+	float projection[16] = {};
+	projection[0] = projection[5] = projection[15] = 1.0f;
+	projection[10] = 0.01f;
+	GetShadowDepthParams(projection, params);
+}
+
+// How lit a receiver is at a moment texel
+static float GetLit(const std::vector<float>& moments, unsigned int x, unsigned int y, float depth, const ShadowMomentSettings& settings)
+{
+	return GetMomentShadow(&moments[(y * MOMENT_SIZE + x) * 4], depth, settings);
+}
+
+// Most light a receiver at depth gets anywhere away from the tile's clamped edges
+static float GetMaxInteriorLit(const std::vector<float>& moments, float depth, const ShadowMomentSettings& settings)
+{
+	float maxLit = 0.0f;
+	for (unsigned int y = 8; y < MOMENT_SIZE - 8; y++)
+		for (unsigned int x = 8; x < MOMENT_SIZE - 8; x++) { maxLit = std::max(maxLit, GetLit(moments, x, y, depth, settings)); }
+	return maxLit;
+}
+
+TEST(LinearizedDepthMatchesViewDepth)
+{
+	// XMMatrixPerspectiveFovLH's depth terms
+	const float nearDist = 0.05f;
+	const float farDist = 10.0f;
+	float projection[16] = {};
+	projection[10] = farDist / (farDist - nearDist);
+	projection[11] = 1.0f;
+	projection[14] = -nearDist * farDist / (farDist - nearDist);
+	float params[4];
+	GetShadowDepthParams(projection, params);
+	double maxError = 0.0;
+	for (float z = nearDist; z <= farDist; z += 0.01f)
+	{
+		float depth = projection[10] + projection[14] / z;
+		maxError = std::max(maxError, (double)fabsf(LinearizeShadowDepth(depth, params) - (z - nearDist) / (farDist - nearDist)));
+	}
+	CHECK(maxError <= 1e-4);
+
+	// Orthographic depth is linear already
+	GetOrthographicParams(params);
+	for (float depth = 0.0f; depth <= 1.0f; depth += 0.125f) { CHECK(LinearizeShadowDepth(depth, params) == depth); }
+}
+
+TEST(BlurWeightsSumToOne)
+{
+	// Past the largest radius the blur is clamped to it
+	for (unsigned int radius = 0; radius <= MAX_SHADOW_BLUR_RADIUS + 2; radius++)
+	{
+		float weights[MAX_SHADOW_BLUR_RADIUS + 1];
+		GetShadowBlurWeights(radius, weights);
+		double total = weights[0];
+		for (unsigned int i = 1; i <= MAX_SHADOW_BLUR_RADIUS; i++)
+		{
+			total += 2.0 * weights[i];
+			CHECK(weights[i] <= weights[i - 1]);
+			if (i > radius) { CHECK(weights[i] == 0.0f); }
+		}
+		CHECK_NEAR(total, 1.0, 1e-5);
+	}
+}
+
+TEST(OverlappingCastersDontLeakLight)
+{
+	// Stripes of casters at 0.2 over casters at 0.5, blurred together, with the receiver far behind both
+	float params[4];
+	GetOrthographicParams(params);
+	std::vector<float> depths(TILE_SIZE * TILE_SIZE);
+	for (unsigned int y = 0; y < TILE_SIZE; y++)
+		for (unsigned int x = 0; x < TILE_SIZE; x++) { depths[y * TILE_SIZE + x] = (x / 8) % 2 ? 0.2f : 0.5f; }
+
+	for (float lightBleedReduction : { 0.0f, 0.2f })
+	{
+		ShadowMomentSettings settings = DEFAULT_SETTINGS;
+		settings.LightBleedReduction = lightBleedReduction;
+		std::vector<float> moments;
+		FilterShadowMoments(depths.data(), TILE_SIZE, params, settings, moments);
+		CHECK(GetMaxInteriorLit(moments, 0.9f, settings) <= 0.01f);
+	}
+
+	// Which is down to the exponents: barely warped depths leak through as plain variance shadow maps do
+	ShadowMomentSettings unwarped = DEFAULT_SETTINGS;
+	unwarped.PositiveExponent = 0.0001f;
+	unwarped.NegativeExponent = 0.0001f;
+	std::vector<float> moments;
+	FilterShadowMoments(depths.data(), TILE_SIZE, params, unwarped, moments);
+	CHECK(GetMaxInteriorLit(moments, 0.9f, unwarped) > 0.5f);
+}
+
+TEST(ReceiversDontShadowThemselves)
+{
+	float params[4];
+	GetOrthographicParams(params);
+	std::vector<float> depths(TILE_SIZE * TILE_SIZE, 0.5f);
+	std::vector<float> moments;
+
+	// A flat receiver is lit at its own depth and shadowed just behind it
+	FilterShadowMoments(depths.data(), TILE_SIZE, params, DEFAULT_SETTINGS, moments);
+	CHECK(GetLit(moments, 0, 0, 0.5f, DEFAULT_SETTINGS) >= 0.99f);
+	CHECK(GetLit(moments, 0, 0, 0.51f, DEFAULT_SETTINGS) <= 0.01f);
+	CHECK(GetLit(moments, 0, 0, 0.9f, DEFAULT_SETTINGS) <= 0.01f);
+
+	// A slanted one stays lit across the blur, away from the tile's clamped edges
+	ShadowMomentSettings settings = DEFAULT_SETTINGS;
+	settings.BlurRadius = 3;
+	for (unsigned int y = 0; y < TILE_SIZE; y++)
+		for (unsigned int x = 0; x < TILE_SIZE; x++) { depths[y * TILE_SIZE + x] = 0.2f + 0.6f * x / TILE_SIZE; }
+	FilterShadowMoments(depths.data(), TILE_SIZE, params, settings, moments);
+	float minLit = 1.0f;
+	for (unsigned int y = 0; y < MOMENT_SIZE; y++)
+		for (unsigned int x = 4; x < MOMENT_SIZE - 4; x++)
+		{
+			float depth = 0.2f + 0.6f * (2 * x + 0.5f) / TILE_SIZE;
+			minLit = std::min(minLit, GetLit(moments, x, y, depth, settings));
+		}
+	CHECK(minLit >= 0.99f);
+}
+
+TEST(ShadowEdgesSoftenMonotonically)
+{
+	// Casters at 0.3 over the left half of a floor at 0.7: fully shadowed on the left, lit on the right, rising in between
+	float params[4];
+	GetOrthographicParams(params);
+	std::vector<float> depths(TILE_SIZE * TILE_SIZE);
+	for (unsigned int y = 0; y < TILE_SIZE; y++)
+		for (unsigned int x = 0; x < TILE_SIZE; x++) { depths[y * TILE_SIZE + x] = x < TILE_SIZE / 2 ? 0.3f : 0.7f; }
+	for (unsigned int radius : { 0u, 2u, 5u })
+	{
+		ShadowMomentSettings settings = DEFAULT_SETTINGS;
+		settings.BlurRadius = radius;
+		std::vector<float> moments;
+		FilterShadowMoments(depths.data(), TILE_SIZE, params, settings, moments);
+		unsigned int y = MOMENT_SIZE / 2;
+		float previous = 0.0f;
+		for (unsigned int x = 0; x < MOMENT_SIZE; x++)
+		{
+			float lit = GetLit(moments, x, y, 0.7f, settings);
+			CHECK(lit >= previous - 1e-4f);
+			previous = lit;
+		}
+		CHECK(GetLit(moments, MOMENT_SIZE / 2 - radius - 2, y, 0.7f, settings) <= 0.01f);
+		CHECK(GetLit(moments, MOMENT_SIZE / 2 + radius + 2, y, 0.7f, settings) >= 0.99f);
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// --------------------------------------------------------
+// A minimal runner for headless tests of the CPU side of
+// the renderer, mostly the math the shaders mirror, which
+// needs no device or window
+//
+// TEST(Name) { ... } defines and registers a test. CHECK()
+// and CHECK_NEAR() report a failure with its file and line
+// and carry on, so one run shows every broken bound.
+// TestMain.cpp runs every registered test, and the exit
+// code is the number that failed.
+//
+// BENCHMARK(Name) { ... } registers timing code that only
+// runs with --bench (Tests.exe --bench [part of a name]),
+// so numbers can be taken on the target machine; each one
+// prints its own timings.
+// --------------------------------------------------------
+
+struct TestCase
+{
+	const char* Name;
+	void (*Run)();
+};
+
+/// <summary>
+/// Every test registered by TEST(), in the order their files were initialized
+/// </summary>
+std::vector<TestCase>& GetTestCases();
+// Checks failed by the test that's running
+extern unsigned int testFailedChecks;
+
+/// <summary>
+/// Every benchmark registered by BENCHMARK(), in the order their files were initialized
+/// </summary>
+std::vector<TestCase>& GetBenchmarks();
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, void (*run)()) { GetTestCases().push_back({ name, run }); }
+};
+
+struct BenchmarkRegistration
+{
+	BenchmarkRegistration(const char* name, void (*run)()) { GetBenchmarks().push_back({ name, run }); }
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static BenchmarkRegistration name##Registration(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			printf("  %s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			testFailedChecks++; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+	do { \
+		double checkActual = (double)(actual); \
+		double checkExpected = (double)(expected); \
+		if (!(fabs(checkActual - checkExpected) <= (double)(tolerance))) \
+		{ \
+			printf("  %s(%d): %s is %g, expected %g within %g\n", __FILE__, __LINE__, #actual, \
+				checkActual, checkExpected, (double)(tolerance)); \
+			testFailedChecks++; \
+		} \
+	} while (0)
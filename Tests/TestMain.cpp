@@ -0,0 +1,45 @@
+#include "TestFramework.h"
+#include <cstring>
+
+unsigned int testFailedChecks = 0;
+
+std::vector<TestCase>& GetTestCases()
+{
+	// Built on first use, so registrations from any file's static initializers land in it
+	static std::vector<TestCase> testCases;
+	return testCases;
+}
+
+std::vector<TestCase>& GetBenchmarks()
+{
+	static std::vector<TestCase> benchmarks;
+	return benchmarks;
+}
+
+int main(int argc, char* argv[])
+{
+	// --bench runs the benchmarks instead, or just those whose name contains the next argument
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+	{
+		for (const TestCase& benchmark : GetBenchmarks())
+		{
+			if (argc > 2 && !strstr(benchmark.Name, argv[2]))
+				continue;
+			printf("%s\n", benchmark.Name);
+			benchmark.Run();
+		}
+		return 0;
+	}
+
+	unsigned int failedTests = 0;
+	for (const TestCase& test : GetTestCases())
+	{
+		testFailedChecks = 0;
+		test.Run();
+		printf("%s %s\n", testFailedChecks == 0 ? "PASS" : "FAIL", test.Name);
+		if (testFailedChecks > 0)
+			failedTests++;
+	}
+	printf("%u of %u tests failed\n", failedTests, (unsigned int)GetTestCases().size());
+	return (int)failedTests;
+}
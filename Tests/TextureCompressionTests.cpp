@@ -0,0 +1,61 @@
+#include "TestFramework.h"
+#include "TextureCompression.h"
+
+// A single channel map of one value, as DecodeTextureImage() gives it (red, plus the rest of RGBA)
+static TextureImage CreateMap(unsigned int width, unsigned int height, unsigned char value)
+{
+	TextureImage image;
+	image.Width = width;
+	image.Height = height;
+	image.Pixels.assign((size_t)width * height * 4, 255);
+	for (size_t i = 0; i < (size_t)width * height; i++) { image.Pixels[i * 4] = value; }
+	return image;
+}
+
+TEST(PackingPicksMapsTheSizeOfTheLargest)
+{
+	// Two or more at the largest size pack, missing maps don't count
+	const unsigned int webWidths[4] = { 1024, 1024, 0, 1024 };
+	CHECK(ChoosePackedChannels(webWidths, webWidths) == 0xB);
+	const unsigned int floorWidths[4] = { 0, 1024, 1024, 0 };
+	CHECK(ChoosePackedChannels(floorWidths, floorWidths) == 0x6);
+
+	// Smaller maps stay out, and one map left at the largest size isn't worth a pack
+	const unsigned int mixedWidths[4] = { 512, 1024, 128, 1024 };
+	CHECK(ChoosePackedChannels(mixedWidths, mixedWidths) == 0xA);
+	const unsigned int bronzeWidths[4] = { 0, 1024, 128, 0 };
+	CHECK(ChoosePackedChannels(bronzeWidths, bronzeWidths) == 0);
+	const unsigned int waterWidths[4] = { 1024, 16, 0, 0 };
+	CHECK(ChoosePackedChannels(waterWidths, waterWidths) == 0);
+	const unsigned int noWidths[4] = {};
+	CHECK(ChoosePackedChannels(noWidths, noWidths) == 0);
+
+	// Same area isn't the same size
+	const unsigned int wideWidths[4] = { 256, 128, 0, 0 };
+	const unsigned int wideHeights[4] = { 128, 256, 0, 0 };
+	CHECK(ChoosePackedChannels(wideWidths, wideHeights) == 0);
+}
+
+TEST(PackingKeepsEachMapAndFillsInDefaults)
+{
+	TextureImage roughness = CreateMap(8, 4, 100);
+	TextureImage opacity = CreateMap(8, 4, 30);
+	const TextureImage* channels[TEXTURE_PACKED_CHANNEL_COUNT] = { nullptr, &roughness, nullptr, &opacity };
+	TextureImage packed;
+	CHECK(PackTextureChannels(channels, packed));
+	CHECK(packed.Width == 8 && packed.Height == 4);
+	unsigned int wrong = 0;
+	for (size_t i = 0; i < (size_t)packed.Width * packed.Height; i++)
+	{
+		const unsigned char expected[4] = { 255, 100, 0, 30 };
+		for (int c = 0; c < 4; c++) { wrong += packed.Pixels[i * 4 + c] != expected[c] ? 1 : 0; }
+	}
+	CHECK(wrong == 0);
+
+	// A smaller map is refused rather than stretched
+	TextureImage metalness = CreateMap(2, 2, 255);
+	const TextureImage* mixed[TEXTURE_PACKED_CHANNEL_COUNT] = { nullptr, &roughness, &metalness, nullptr };
+	CHECK(!PackTextureChannels(mixed, packed));
+	const TextureImage* none[TEXTURE_PACKED_CHANNEL_COUNT] = {};
+	CHECK(!PackTextureChannels(none, packed));
+}
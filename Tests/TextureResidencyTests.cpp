@@ -0,0 +1,248 @@
+#include "TestFramework.h"
+#include "TextureResidency.h"
+#include <random>
+
+// Mips below 64x64 are the always resident tail
+static const unsigned int TAIL_SIZE = 64;
+static const size_t MB = 1024 * 1024;
+
+// An RGBA8 texture's mip sizes, most detailed first
+static std::vector<size_t> GetMipBytes(unsigned int size, unsigned int& tailMip)
+{
+	std::vector<size_t> mipBytes;
+	tailMip = 0;
+	for (unsigned int mipSize = size; mipSize >= 1; mipSize /= 2)
+	{
+		if (mipSize > TAIL_SIZE)
+			tailMip++;
+		mipBytes.push_back((size_t)mipSize * mipSize * 4);
+	}
+	return mipBytes;
+}
+
+static unsigned int AddTexture(TextureResidency& residency, unsigned int size)
+{
+	unsigned int tailMip;
+	std::vector<size_t> mipBytes = GetMipBytes(size, tailMip);
+	return residency.AddTexture(mipBytes, tailMip);
+}
+
+// What a texture takes with every mip resident, or with only its tail
+static size_t GetTextureBytes(unsigned int size, bool tailOnly)
+{
+	unsigned int tailMip;
+	std::vector<size_t> mipBytes = GetMipBytes(size, tailMip);
+	size_t bytes = 0;
+	for (size_t mip = tailOnly ? tailMip : 0; mip < mipBytes.size(); mip++) { bytes += mipBytes[mip]; }
+	return bytes;
+}
+
+// What a texture's resident mips take, from its resident mip down
+static size_t GetResidentBytes(TextureResidency& residency, unsigned int size, unsigned int texture)
+{
+	unsigned int tailMip;
+	std::vector<size_t> mipBytes = GetMipBytes(size, tailMip);
+	size_t bytes = 0;
+	for (size_t mip = residency.GetResidentMip(texture); mip < mipBytes.size(); mip++) { bytes += mipBytes[mip]; }
+	return bytes;
+}
+
+// Updates and finishes every load straight away, as TextureStreamer would a frame or so later
+static void RunFrame(TextureResidency& residency, std::vector<TextureResidencyChange>& changes)
+{
+	residency.Update(changes);
+	for (const TextureResidencyChange& change : changes)
+	{
+		if (change.Load)
+			residency.FinishLoad(change.Texture, true);
+	}
+}
+
+TEST(ResidencyStaysWithinBudget)
+{
+	// Random textures asked for at random mips, with loads finishing a few frames late
+	std::mt19937 random(31);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	TextureResidency residency(48 * MB, 4);
+	std::vector<unsigned int> sizes;
+	for (unsigned int i = 0; i < 24; i++)
+	{
+		sizes.push_back(256u << (i % 4));
+		AddTexture(residency, sizes.back());
+	}
+
+	std::vector<TextureResidencyChange> changes;
+	std::vector<TextureResidencyChange> inFlight;
+	unsigned int overBudget = 0;
+	unsigned int wrongMips = 0;
+	unsigned int wrongBytes = 0;
+	for (int frame = 0; frame < 500; frame++)
+	{
+		for (unsigned int i = 0; i < sizes.size(); i++)
+		{
+			if (unit(random) < 0.5f)
+				residency.Request(i, unit(random) * 6.0f - 1.0f);
+		}
+		std::vector<unsigned int> residentMips;
+		for (unsigned int i = 0; i < sizes.size(); i++) { residentMips.push_back(residency.GetResidentMip(i)); }
+		residency.Update(changes);
+		for (const TextureResidencyChange& change : changes)
+		{
+			// Loads are always the next mip up, evictions always the top one
+			if (change.Mip + (change.Load ? 1 : 0) != residentMips[change.Texture])
+				wrongMips++;
+			if (change.Load)
+				inFlight.push_back(change);
+			else
+				residentMips[change.Texture]++;
+		}
+		for (unsigned int i = 0; i < sizes.size(); i++) { wrongMips += residentMips[i] != residency.GetResidentMip(i) ? 1 : 0; }
+		if (residency.GetResidentBytes() + residency.GetPendingBytes() > residency.GetBudget())
+			overBudget++;
+
+		// Finish the oldest loads
+		while (inFlight.size() > 2)
+		{
+			residency.FinishLoad(inFlight.front().Texture, true);
+			inFlight.erase(inFlight.begin());
+		}
+		size_t residentBytes = 0;
+		for (unsigned int i = 0; i < sizes.size(); i++) { residentBytes += GetResidentBytes(residency, sizes[i], i); }
+		if (residentBytes != residency.GetResidentBytes())
+			wrongBytes++;
+	}
+	CHECK(overBudget == 0);
+	CHECK(wrongMips == 0);
+	CHECK(wrongBytes == 0);
+	CHECK(residency.GetEvictionCount() > 0);
+}
+
+TEST(ResidencyEvictsLeastRecentlyNeededFirst)
+{
+	// Room for the tails and two full 1024s
+	TextureResidency residency(2 * GetTextureBytes(1024, false) + GetTextureBytes(1024, true), 4);
+	unsigned int a = AddTexture(residency, 1024);
+	unsigned int b = AddTexture(residency, 1024);
+	unsigned int c = AddTexture(residency, 1024);
+
+	std::vector<TextureResidencyChange> changes;
+	for (int frame = 0; frame < 10; frame++)
+	{
+		residency.Request(a, 0.0f);
+		residency.Request(b, 0.0f);
+		RunFrame(residency, changes);
+	}
+	CHECK(residency.GetResidentMip(a) == 0);
+	CHECK(residency.GetResidentMip(b) == 0);
+	CHECK(residency.GetEvictionCount() == 0);
+
+	// A goes out of view and C comes in: A gives up its mips top first, B keeps all of its own
+	std::vector<TextureResidencyChange> evictions;
+	for (int frame = 0; frame < 10; frame++)
+	{
+		residency.Request(b, 0.0f);
+		residency.Request(c, 0.0f);
+		RunFrame(residency, changes);
+		for (const TextureResidencyChange& change : changes)
+		{
+			if (!change.Load)
+				evictions.push_back(change);
+		}
+		CHECK(residency.GetResidentMip(b) == 0);
+	}
+	CHECK(residency.GetResidentMip(c) == 0);
+	CHECK(residency.GetResidentMip(a) == 4);
+	CHECK(evictions.size() == 4);
+	for (unsigned int i = 0; i < evictions.size(); i++)
+	{
+		CHECK(evictions[i].Texture == a);
+		CHECK(evictions[i].Mip == i);
+	}
+
+	// Of two textures last needed in the same frame, the bigger mip goes first
+	TextureResidency tie(GetTextureBytes(512, false) + GetTextureBytes(1024, false) + GetTextureBytes(128, true), 4);
+	unsigned int small = AddTexture(tie, 512);
+	unsigned int large = AddTexture(tie, 1024);
+	unsigned int incoming = AddTexture(tie, 128);
+	for (int frame = 0; frame < 10; frame++)
+	{
+		tie.Request(small, 0.0f);
+		tie.Request(large, 0.0f);
+		RunFrame(tie, changes);
+	}
+	CHECK(tie.GetResidentMip(small) == 0);
+	CHECK(tie.GetResidentMip(large) == 0);
+	tie.Request(incoming, 0.0f);
+	tie.Update(changes);
+	CHECK(changes.size() >= 1 && !changes[0].Load && changes[0].Texture == large && changes[0].Mip == 0);
+}
+
+TEST(LoweringTheBudgetEvictsDownToIt)
+{
+	TextureResidency residency(256 * MB, 4);
+	const unsigned int count = 8;
+	for (unsigned int i = 0; i < count; i++) { AddTexture(residency, 1024); }
+	std::vector<TextureResidencyChange> changes;
+	for (int frame = 0; frame < 10; frame++)
+	{
+		for (unsigned int i = 0; i < count; i++) { residency.Request(i, 0.0f); }
+		RunFrame(residency, changes);
+	}
+	for (unsigned int i = 0; i < count; i++) { CHECK(residency.GetResidentMip(i) == 0); }
+
+	// Half the budget, with only the first half still in view: only the ones out of view give anything up
+	size_t budget = residency.GetResidentBytes() / 2 + MB;
+	residency.SetBudget(budget);
+	for (unsigned int i = 0; i < count / 2; i++) { residency.Request(i, 0.0f); }
+	RunFrame(residency, changes);
+	CHECK(residency.GetResidentBytes() + residency.GetPendingBytes() <= budget);
+	for (unsigned int i = 0; i < count / 2; i++) { CHECK(residency.GetResidentMip(i) == 0); }
+	for (const TextureResidencyChange& change : changes) { CHECK(!change.Load && change.Texture >= count / 2); }
+
+	// Below what's in view, needed mips go too rather than breaking the budget
+	budget = residency.GetResidentBytes() / 4;
+	residency.SetBudget(budget);
+	for (unsigned int i = 0; i < count / 2; i++) { residency.Request(i, 0.0f); }
+	RunFrame(residency, changes);
+	CHECK(residency.GetResidentBytes() + residency.GetPendingBytes() <= budget);
+
+	// Raising it again brings them back
+	residency.SetBudget(256 * MB);
+	for (int frame = 0; frame < 10; frame++)
+	{
+		for (unsigned int i = 0; i < count; i++) { residency.Request(i, 0.0f); }
+		RunFrame(residency, changes);
+	}
+	for (unsigned int i = 0; i < count; i++) { CHECK(residency.GetResidentMip(i) == 0); }
+}
+
+TEST(ResidencySettlesWithoutChurn)
+{
+	// More asked for than fits, the same every frame: once settled, nothing loads or evicts
+	for (size_t budget : { 24 * MB, 64 * MB, 512 * MB })
+	{
+		TextureResidency residency(budget, 4);
+		std::vector<unsigned int> sizes;
+		for (unsigned int i = 0; i < 16; i++)
+		{
+			sizes.push_back(512u << (i % 3));
+			AddTexture(residency, sizes.back());
+		}
+		std::vector<TextureResidencyChange> changes;
+		unsigned int loads = 0;
+		unsigned int evictions = 0;
+		for (int frame = 0; frame < 300; frame++)
+		{
+			for (unsigned int i = 0; i < sizes.size(); i++) { residency.Request(i, (float)(i % 2)); }
+			RunFrame(residency, changes);
+			if (frame == 100)
+			{
+				loads = residency.GetLoadCount();
+				evictions = residency.GetEvictionCount();
+			}
+		}
+		CHECK(residency.GetLoadCount() == loads);
+		CHECK(residency.GetEvictionCount() == evictions);
+		CHECK(residency.GetResidentBytes() <= budget);
+	}
+}
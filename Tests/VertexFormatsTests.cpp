@@ -0,0 +1,84 @@
+#include "TestFramework.h"
+#include "VertexFormats.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+// Snorm16 octahedral normals land within this many degrees of the original anywhere on the sphere
+static const double MAX_NORMAL_ERROR_DEGREES = 0.05;
+
+// Largest angle between a unit normal and its compact round trip, over a Fibonacci sphere of directions
+static double GetMaxNormalErrorDegrees(unsigned int count)
+{
+	double maxDegrees = 0.0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float y = 1.0f - 2.0f * (i + 0.5f) / count;
+		float radius = sqrtf(1.0f - y * y);
+		float angle = i * 2.39996323f; // Golden angle
+		Vertex vertex = {};
+		vertex.Normal = XMFLOAT3(radius * cosf(angle), y, radius * sinf(angle));
+		vertex.Tangent = vertex.Normal;
+		Vertex decoded = DecodeCompactVertex(EncodeCompactVertex(vertex));
+		double cosine = vertex.Normal.x * decoded.Normal.x + vertex.Normal.y * decoded.Normal.y + vertex.Normal.z * decoded.Normal.z;
+		maxDegrees = std::max(maxDegrees, acos(std::min(cosine, 1.0)) * 180.0 / 3.14159265358979);
+		cosine = vertex.Tangent.x * decoded.Tangent.x + vertex.Tangent.y * decoded.Tangent.y + vertex.Tangent.z * decoded.Tangent.z;
+		maxDegrees = std::max(maxDegrees, acos(std::min(cosine, 1.0)) * 180.0 / 3.14159265358979);
+	}
+	return maxDegrees;
+}
+
+TEST(OctahedralNormalsStayWithinErrorBound)
+{
+	CHECK(GetMaxNormalErrorDegrees(200000) <= MAX_NORMAL_ERROR_DEGREES);
+}
+
+TEST(OctahedralAxesRoundTripExactly)
+{
+	// The axes and the folded lower hemisphere's corners are where a sign slip would show
+	const XMFLOAT3 axes[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	for (const XMFLOAT3& axis : axes)
+	{
+		XMFLOAT3 decoded = OctahedralDecode(OctahedralEncode(axis));
+		CHECK_NEAR(decoded.x, axis.x, 1e-6);
+		CHECK_NEAR(decoded.y, axis.y, 1e-6);
+		CHECK_NEAR(decoded.z, axis.z, 1e-6);
+	}
+}
+
+TEST(HalfUVsStayWithinErrorBound)
+{
+	// Halves keep 11 significant bits, so [0, 1] UVs are off by at most half of 2^-11
+	double maxError = 0.0;
+	for (unsigned int i = 0; i <= 4096; i++)
+	{
+		float u = i / 4096.0f;
+		Vertex vertex = {};
+		vertex.UV = XMFLOAT2(u, 1.0f - u);
+		Vertex decoded = DecodeCompactVertex(EncodeCompactVertex(vertex));
+		maxError = std::max(maxError, (double)fabsf(decoded.UV.x - vertex.UV.x));
+		maxError = std::max(maxError, (double)fabsf(decoded.UV.y - vertex.UV.y));
+	}
+	CHECK(maxError <= 1.0 / 4096.0);
+
+	// Tiled UVs lose precision with their magnitude, but stay within the same relative bound
+	for (unsigned int i = 0; i <= 4096; i++)
+	{
+		float u = -16.0f + 32.0f * i / 4096.0f;
+		Vertex vertex = {};
+		vertex.UV = XMFLOAT2(u, u);
+		Vertex decoded = DecodeCompactVertex(EncodeCompactVertex(vertex));
+		CHECK(fabsf(decoded.UV.x - u) <= std::max(fabsf(u), 1.0f) / 2048.0f);
+	}
+}
+
+TEST(CompactPositionsAreExact)
+{
+	Vertex vertex = {};
+	vertex.Position = XMFLOAT3(1.2345f, -678.9f, 0.001f);
+	vertex.Normal = XMFLOAT3(0, 1, 0);
+	Vertex decoded = DecodeCompactVertex(EncodeCompactVertex(vertex));
+	CHECK(decoded.Position.x == vertex.Position.x);
+	CHECK(decoded.Position.y == vertex.Position.y);
+	CHECK(decoded.Position.z == vertex.Position.z);
+}
@@ -0,0 +1,1000 @@
+#include "TextureCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+#include <climits>
+#include <cctype>
+
+// DXGI_FORMAT values for the DDS header (spelled out so this file doesn't need D3D)
+static const unsigned int DDS_FORMAT_BC4_UNORM = 80;
+static const unsigned int DDS_FORMAT_BC5_UNORM = 83;
+static const unsigned int DDS_FORMAT_BC7_UNORM = 98;
+
+// Gamma the shaders decode color with
+static const float TEXTURE_GAMMA = 2.2f;
+
+// BC7 4-bit and 2-bit index interpolation weights, out of 64
+static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+static const int BC7_WEIGHTS_2BIT[4] = { 0, 21, 43, 64 };
+
+// --------------------------------------------------------
+// Cook settings
+// --------------------------------------------------------
+
+static bool EndsWith(const std::string& str, const char* suffix)
+{
+	size_t length = strlen(suffix);
+	return str.size() >= length && str.compare(str.size() - length, length, suffix) == 0;
+}
+
+void GetTextureCookSettings(const std::string& fileName, TextureContent& content, TextureCompression& compression)
+{
+	// Lower case file name without its directory or extension
+	size_t slash = fileName.find_last_of("/\\");
+	std::string name = fileName.substr(slash == std::string::npos ? 0 : slash + 1);
+	size_t dot = name.find_last_of('.');
+	if (dot != std::string::npos) { name.resize(dot); }
+	std::transform(name.begin(), name.end(), name.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+
+	content = TEXTURE_CONTENT_COLOR;
+	compression = TEXTURE_COMPRESSION_BC7;
+	if (EndsWith(name, "_normals") || EndsWith(name, "_normal"))
+	{
+		content = TEXTURE_CONTENT_NORMAL;
+		compression = TEXTURE_COMPRESSION_BC5;
+	}
+	else if (EndsWith(name, "_roughness") || EndsWith(name, "_metal") || EndsWith(name, "_metalness") ||
+		EndsWith(name, "_opacity") || EndsWith(name, "_ao") || EndsWith(name, "_height"))
+	{
+		content = TEXTURE_CONTENT_LINEAR;
+		compression = TEXTURE_COMPRESSION_BC4;
+	}
+	else if (EndsWith(name, "_orm"))
+	{
+		// Packed maps (see PackTextureChannels()) need all four channels
+		content = TEXTURE_CONTENT_LINEAR;
+		compression = TEXTURE_COMPRESSION_BC7;
+	}
+}
+
+unsigned int ChoosePackedChannels(const unsigned int widths[TEXTURE_PACKED_CHANNEL_COUNT], const unsigned int heights[TEXTURE_PACKED_CHANNEL_COUNT])
+{
+	// The largest map (by area) sets the size
+	int largest = -1;
+	for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+	{
+		if (widths[c] == 0 || heights[c] == 0)
+			continue;
+		if (largest < 0 || (size_t)widths[c] * heights[c] > (size_t)widths[largest] * heights[largest])
+			largest = c;
+	}
+	if (largest < 0)
+		return 0;
+
+	unsigned int channels = 0;
+	unsigned int count = 0;
+	for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+	{
+		if (widths[c] == widths[largest] && heights[c] == heights[largest])
+		{
+			channels |= 1u << c;
+			count++;
+		}
+	}
+	return count >= 2 ? channels : 0;
+}
+
+bool PackTextureChannels(const TextureImage* const channels[TEXTURE_PACKED_CHANNEL_COUNT], TextureImage& packed)
+{
+	// What the shaders use when a map is missing
+	const unsigned char defaults[TEXTURE_PACKED_CHANNEL_COUNT] = { 255, 51, 0, 255 };
+
+	// Every map has to match the first
+	packed.Width = 0;
+	packed.Height = 0;
+	for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+	{
+		if (!channels[c] || channels[c]->Width == 0 || channels[c]->Height == 0)
+			continue;
+		if (packed.Width == 0)
+		{
+			packed.Width = channels[c]->Width;
+			packed.Height = channels[c]->Height;
+		}
+		else if (channels[c]->Width != packed.Width || channels[c]->Height != packed.Height)
+		{
+			return false;
+		}
+	}
+	if (packed.Width == 0)
+		return false;
+
+	size_t pixelCount = (size_t)packed.Width * packed.Height;
+	packed.Pixels.resize(pixelCount * 4);
+	for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+	{
+		const TextureImage* channel = channels[c];
+		if (!channel || channel->Width == 0 || channel->Height == 0)
+		{
+			for (size_t i = 0; i < pixelCount; i++) { packed.Pixels[i * 4 + c] = defaults[c]; }
+		}
+		else
+		{
+			for (size_t i = 0; i < pixelCount; i++) { packed.Pixels[i * 4 + c] = channel->Pixels[i * 4]; }
+		}
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Mip chain
+// --------------------------------------------------------
+
+void GenerateMipChain(const TextureImage& source, TextureContent content, std::vector<TextureImage>& mips)
+{
+	mips.clear();
+	mips.push_back(source);
+
+	float toLinear[256];
+	for (int i = 0; i < 256; i++)
+	{
+		float value = i / 255.0f;
+		toLinear[i] = content == TEXTURE_CONTENT_COLOR ? powf(value, TEXTURE_GAMMA) :
+			content == TEXTURE_CONTENT_NORMAL ? value * 2.0f - 1.0f : value;
+	}
+
+	// Filter from the previous level's floats, so rounding doesn't build up down the chain
+	unsigned int width = source.Width;
+	unsigned int height = source.Height;
+	std::vector<float> level((size_t)width * height * 4);
+	for (size_t i = 0; i < level.size(); i++)
+	{
+		unsigned char value = source.Pixels[i];
+		level[i] = (i & 3) == 3 ? value / 255.0f : toLinear[value];
+	}
+
+	std::vector<float> next;
+	while (width > 1 || height > 1)
+	{
+		unsigned int nextWidth = std::max(1u, width / 2);
+		unsigned int nextHeight = std::max(1u, height / 2);
+		next.assign((size_t)nextWidth * nextHeight * 4, 0.0f);
+
+		TextureImage mip;
+		mip.Width = nextWidth;
+		mip.Height = nextHeight;
+		mip.Pixels.resize(next.size());
+
+		for (unsigned int y = 0; y < nextHeight; y++)
+		{
+			// 2x2 box, clamped for 1 pixel wide/tall levels
+			unsigned int y0 = std::min(y * 2, height - 1);
+			unsigned int y1 = std::min(y * 2 + 1, height - 1);
+			for (unsigned int x = 0; x < nextWidth; x++)
+			{
+				unsigned int x0 = std::min(x * 2, width - 1);
+				unsigned int x1 = std::min(x * 2 + 1, width - 1);
+				const float* a = &level[((size_t)y0 * width + x0) * 4];
+				const float* b = &level[((size_t)y0 * width + x1) * 4];
+				const float* c = &level[((size_t)y1 * width + x0) * 4];
+				const float* d = &level[((size_t)y1 * width + x1) * 4];
+				float* out = &next[((size_t)y * nextWidth + x) * 4];
+				for (int ch = 0; ch < 4; ch++) { out[ch] = (a[ch] + b[ch] + c[ch] + d[ch]) * 0.25f; }
+
+				if (content == TEXTURE_CONTENT_NORMAL)
+				{
+					float length = sqrtf(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+					if (length > 1e-6f) { out[0] /= length; out[1] /= length; out[2] /= length; }
+					else { out[0] = 0.0f; out[1] = 0.0f; out[2] = 1.0f; }
+				}
+
+				unsigned char* texel = &mip.Pixels[((size_t)y * nextWidth + x) * 4];
+				for (int ch = 0; ch < 3; ch++)
+				{
+					float value = content == TEXTURE_CONTENT_COLOR ? powf(std::max(out[ch], 0.0f), 1.0f / TEXTURE_GAMMA) :
+						content == TEXTURE_CONTENT_NORMAL ? out[ch] * 0.5f + 0.5f : out[ch];
+					texel[ch] = (unsigned char)std::min(255.0f, std::max(0.0f, value * 255.0f + 0.5f));
+				}
+				texel[3] = (unsigned char)std::min(255.0f, std::max(0.0f, out[3] * 255.0f + 0.5f));
+			}
+		}
+
+		mips.push_back(std::move(mip));
+		level.swap(next);
+		width = nextWidth;
+		height = nextHeight;
+	}
+}
+
+// --------------------------------------------------------
+// BC4 / BC5
+// --------------------------------------------------------
+
+// The 8 value palette (r0 > r1): both endpoints, then 6 steps from r0 towards r1
+static void GetBC4Palette(int r0, int r1, int palette[8])
+{
+	palette[0] = r0;
+	palette[1] = r1;
+	if (r0 > r1)
+	{
+		for (int i = 1; i < 7; i++) { palette[i + 1] = ((7 - i) * r0 + i * r1 + 3) / 7; }
+	}
+	else
+	{
+		for (int i = 1; i < 5; i++) { palette[i + 1] = ((5 - i) * r0 + i * r1 + 2) / 5; }
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+// Picks the closest palette entry for every value, returning the squared error
+static int FitBC4Indices(const unsigned char values[16], const int palette[8], unsigned char indices[16])
+{
+	int total = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int bestError = INT_MAX;
+		for (int p = 0; p < 8; p++)
+		{
+			int error = (values[i] - palette[p]) * (values[i] - palette[p]);
+			if (error < bestError) { bestError = error; indices[i] = (unsigned char)p; }
+		}
+		total += bestError;
+	}
+	return total;
+}
+
+static void EncodeBC4Block(const unsigned char values[16], unsigned char* out)
+{
+	int minValue = 255;
+	int maxValue = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		minValue = std::min(minValue, (int)values[i]);
+		maxValue = std::max(maxValue, (int)values[i]);
+	}
+
+	unsigned char indices[16] = {};
+	int bestR0 = maxValue;
+	int bestR1 = minValue;
+	if (maxValue > minValue)
+	{
+		// The bounding range, and slightly inset ones (the extremes are often lone outliers)
+		int bestError = INT_MAX;
+		int inset = std::min(2, (maxValue - minValue) / 8);
+		for (int high = 0; high <= inset; high++)
+		{
+			for (int low = 0; low <= inset; low++)
+			{
+				int r0 = maxValue - high;
+				int r1 = minValue + low;
+				if (r0 <= r1) { continue; }
+				int palette[8];
+				unsigned char candidate[16];
+				GetBC4Palette(r0, r1, palette);
+				int error = FitBC4Indices(values, palette, candidate);
+				if (error < bestError)
+				{
+					bestError = error;
+					bestR0 = r0;
+					bestR1 = r1;
+					memcpy(indices, candidate, sizeof(indices));
+				}
+			}
+		}
+	}
+
+	out[0] = (unsigned char)bestR0;
+	out[1] = (unsigned char)bestR1;
+	unsigned long long bits = 0;
+	for (int i = 0; i < 16; i++) { bits |= (unsigned long long)indices[i] << (3 * i); }
+	for (int b = 0; b < 6; b++) { out[2 + b] = (unsigned char)(bits >> (8 * b)); }
+}
+
+static void DecodeBC4Block(const unsigned char* block, unsigned char values[16])
+{
+	int palette[8];
+	GetBC4Palette(block[0], block[1], palette);
+	unsigned long long bits = 0;
+	for (int b = 0; b < 6; b++) { bits |= (unsigned long long)block[2 + b] << (8 * b); }
+	for (int i = 0; i < 16; i++) { values[i] = (unsigned char)palette[(bits >> (3 * i)) & 7]; }
+}
+
+// --------------------------------------------------------
+// BC7 mode 6: one subset, 7 bit RGBA endpoints + a p-bit
+// each, 4 bit indices
+// --------------------------------------------------------
+
+// Quantizes an endpoint to 7 bits per channel plus a shared low bit, whichever p-bit fits best
+static void QuantizeBC7Endpoint(const float color[4], int quantized[4], int& pBit)
+{
+	float bestError = FLT_MAX;
+	for (int p = 0; p < 2; p++)
+	{
+		int candidate[4];
+		float error = 0.0f;
+		for (int ch = 0; ch < 4; ch++)
+		{
+			float value = std::min(255.0f, std::max(0.0f, color[ch]));
+			candidate[ch] = std::min(127, std::max(0, (int)floorf((value - p) * 0.5f + 0.5f)));
+			float difference = (float)(candidate[ch] * 2 + p) - value;
+			error += difference * difference;
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			pBit = p;
+			memcpy(quantized, candidate, sizeof(candidate));
+		}
+	}
+}
+
+static void GetBC7Palette(const int endpoints[2][4], const int pBits[2], int palette[16][4])
+{
+	for (int ch = 0; ch < 4; ch++)
+	{
+		int e0 = endpoints[0][ch] * 2 + pBits[0];
+		int e1 = endpoints[1][ch] * 2 + pBits[1];
+		for (int i = 0; i < 16; i++) { palette[i][ch] = ((64 - BC7_WEIGHTS[i]) * e0 + BC7_WEIGHTS[i] * e1 + 32) >> 6; }
+	}
+}
+
+static int FitBC7Indices(const unsigned char pixels[64], const int palette[16][4], unsigned char indices[16])
+{
+	int total = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		const unsigned char* pixel = &pixels[i * 4];
+		int bestError = INT_MAX;
+		for (int p = 0; p < 16; p++)
+		{
+			int error = 0;
+			for (int ch = 0; ch < 4; ch++)
+			{
+				int difference = pixel[ch] - palette[p][ch];
+				error += difference * difference;
+			}
+			if (error < bestError) { bestError = error; indices[i] = (unsigned char)p; }
+		}
+		total += bestError;
+	}
+	return total;
+}
+
+// Quantizes a pair of float endpoints and fits indices to them
+static int FitBC7Endpoints(const unsigned char pixels[64], const float ends[2][4],
+	int endpoints[2][4], int pBits[2], unsigned char indices[16])
+{
+	QuantizeBC7Endpoint(ends[0], endpoints[0], pBits[0]);
+	QuantizeBC7Endpoint(ends[1], endpoints[1], pBits[1]);
+	int palette[16][4];
+	GetBC7Palette(endpoints, pBits, palette);
+	return FitBC7Indices(pixels, palette, indices);
+}
+
+// Encodes a block with mode 6, returning the squared error
+static int EncodeBC7Mode6(const unsigned char pixels[64], unsigned char* out)
+{
+	// Principal axis of the block's colors (power iteration on the covariance)
+	float mean[4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		for (int ch = 0; ch < 4; ch++) { mean[ch] += pixels[i * 4 + ch] / 16.0f; }
+	}
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float d[4];
+		for (int ch = 0; ch < 4; ch++) { d[ch] = pixels[i * 4 + ch] - mean[ch]; }
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++) { covariance[r][c] += d[r] * d[c]; }
+		}
+	}
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++) { next[r] += covariance[r][c] * axis[c]; }
+		}
+		float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+		if (length < 1e-6f) { break; }
+		for (int ch = 0; ch < 4; ch++) { axis[ch] = next[ch] / length; }
+	}
+
+	// Endpoints at the extremes of the colors along the axis
+	float minT = FLT_MAX;
+	float maxT = -FLT_MAX;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (int ch = 0; ch < 4; ch++) { t += (pixels[i * 4 + ch] - mean[ch]) * axis[ch]; }
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	float ends[2][4];
+	for (int ch = 0; ch < 4; ch++)
+	{
+		ends[0][ch] = mean[ch] + axis[ch] * minT;
+		ends[1][ch] = mean[ch] + axis[ch] * maxT;
+	}
+
+	int endpoints[2][4];
+	int pBits[2];
+	unsigned char indices[16];
+	int error = FitBC7Endpoints(pixels, ends, endpoints, pBits, indices);
+
+	// Least squares refinement: best endpoints for the chosen indices, then refit the indices
+	for (int iteration = 0; iteration < 2 && error > 0; iteration++)
+	{
+		float a = 0.0f, b = 0.0f, c = 0.0f;
+		float d0[4] = {}, d1[4] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			float w = BC7_WEIGHTS[indices[i]] / 64.0f;
+			a += (1.0f - w) * (1.0f - w);
+			b += (1.0f - w) * w;
+			c += w * w;
+			for (int ch = 0; ch < 4; ch++)
+			{
+				d0[ch] += (1.0f - w) * pixels[i * 4 + ch];
+				d1[ch] += w * pixels[i * 4 + ch];
+			}
+		}
+		float determinant = a * c - b * b;
+		if (fabsf(determinant) < 1e-6f) { break; }
+		float refined[2][4];
+		for (int ch = 0; ch < 4; ch++)
+		{
+			refined[0][ch] = (c * d0[ch] - b * d1[ch]) / determinant;
+			refined[1][ch] = (a * d1[ch] - b * d0[ch]) / determinant;
+		}
+
+		int refinedEndpoints[2][4];
+		int refinedPBits[2];
+		unsigned char refinedIndices[16];
+		int refinedError = FitBC7Endpoints(pixels, refined, refinedEndpoints, refinedPBits, refinedIndices);
+		if (refinedError >= error) { break; }
+		error = refinedError;
+		memcpy(endpoints, refinedEndpoints, sizeof(endpoints));
+		memcpy(pBits, refinedPBits, sizeof(pBits));
+		memcpy(indices, refinedIndices, sizeof(indices));
+	}
+
+	// The first index is stored without its top bit, so flip the block if it's set
+	if (indices[0] & 8)
+	{
+		for (int ch = 0; ch < 4; ch++) { std::swap(endpoints[0][ch], endpoints[1][ch]); }
+		std::swap(pBits[0], pBits[1]);
+		for (int i = 0; i < 16; i++) { indices[i] = (unsigned char)(15 - indices[i]); }
+	}
+
+	// Pack, least significant bit first
+	memset(out, 0, 16);
+	unsigned int position = 0;
+	auto write = [&](unsigned int value, unsigned int bitCount)
+	{
+		for (unsigned int bit = 0; bit < bitCount; bit++, position++)
+		{
+			if ((value >> bit) & 1) { out[position >> 3] |= (unsigned char)(1 << (position & 7)); }
+		}
+	};
+	write(1 << 6, 7);
+	for (int ch = 0; ch < 4; ch++)
+	{
+		write(endpoints[0][ch], 7);
+		write(endpoints[1][ch], 7);
+	}
+	write(pBits[0], 1);
+	write(pBits[1], 1);
+	write(indices[0], 3);
+	for (int i = 1; i < 16; i++) { write(indices[i], 4); }
+	return error;
+}
+
+// --------------------------------------------------------
+// BC7 mode 5: one subset, 7 bit RGB and 8 bit alpha
+// endpoints with their own 2 bit indices, plus a rotation
+// that swaps alpha with one of the color channels. Loses to
+// mode 6 on smooth color, but wins when one channel doesn't
+// follow the others, like in packed material maps.
+// --------------------------------------------------------
+
+static int Unquantize7(int value) { return (value << 1) | (value >> 6); }
+
+// Picks the closest of 4 colors between 7 bit endpoints for every pixel's rgb
+static int FitBC7Mode5Color(const unsigned char pixels[64], const int endpoints[2][3], unsigned char indices[16])
+{
+	int palette[4][3];
+	for (int ch = 0; ch < 3; ch++)
+	{
+		int e0 = Unquantize7(endpoints[0][ch]);
+		int e1 = Unquantize7(endpoints[1][ch]);
+		for (int i = 0; i < 4; i++) { palette[i][ch] = ((64 - BC7_WEIGHTS_2BIT[i]) * e0 + BC7_WEIGHTS_2BIT[i] * e1 + 32) >> 6; }
+	}
+	int total = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int bestError = INT_MAX;
+		for (int p = 0; p < 4; p++)
+		{
+			int error = 0;
+			for (int ch = 0; ch < 3; ch++)
+			{
+				int difference = pixels[i * 4 + ch] - palette[p][ch];
+				error += difference * difference;
+			}
+			if (error < bestError) { bestError = error; indices[i] = (unsigned char)p; }
+		}
+		total += bestError;
+	}
+	return total;
+}
+
+// Picks the closest of 4 values between 8 bit endpoints for every pixel's alpha
+static int FitBC7Mode5Alpha(const unsigned char pixels[64], const int endpoints[2], unsigned char indices[16])
+{
+	int total = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int bestError = INT_MAX;
+		for (int p = 0; p < 4; p++)
+		{
+			int value = ((64 - BC7_WEIGHTS_2BIT[p]) * endpoints[0] + BC7_WEIGHTS_2BIT[p] * endpoints[1] + 32) >> 6;
+			int error = (pixels[i * 4 + 3] - value) * (pixels[i * 4 + 3] - value);
+			if (error < bestError) { bestError = error; indices[i] = (unsigned char)p; }
+		}
+		total += bestError;
+	}
+	return total;
+}
+
+// Best endpoints for fixed 2 bit indices (least squares), false if the indices are all the same
+static bool SolveBC7Mode5Endpoints(const unsigned char pixels[64], const unsigned char indices[16],
+	int firstChannel, int channelCount, float ends[2][4])
+{
+	float a = 0.0f, b = 0.0f, c = 0.0f;
+	float d0[4] = {}, d1[4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float w = BC7_WEIGHTS_2BIT[indices[i]] / 64.0f;
+		a += (1.0f - w) * (1.0f - w);
+		b += (1.0f - w) * w;
+		c += w * w;
+		for (int ch = firstChannel; ch < firstChannel + channelCount; ch++)
+		{
+			d0[ch] += (1.0f - w) * pixels[i * 4 + ch];
+			d1[ch] += w * pixels[i * 4 + ch];
+		}
+	}
+	float determinant = a * c - b * b;
+	if (fabsf(determinant) < 1e-6f)
+		return false;
+	for (int ch = firstChannel; ch < firstChannel + channelCount; ch++)
+	{
+		ends[0][ch] = std::min(255.0f, std::max(0.0f, (c * d0[ch] - b * d1[ch]) / determinant));
+		ends[1][ch] = std::min(255.0f, std::max(0.0f, (a * d1[ch] - b * d0[ch]) / determinant));
+	}
+	return true;
+}
+
+// Encodes a block with mode 5 and the given rotation, returning the squared error
+static int EncodeBC7Mode5(const unsigned char source[64], int rotation, unsigned char* out)
+{
+	// Rotation n stores channel n - 1 in alpha (and alpha in its place)
+	unsigned char pixels[64];
+	memcpy(pixels, source, sizeof(pixels));
+	if (rotation > 0)
+	{
+		for (int i = 0; i < 16; i++) { std::swap(pixels[i * 4 + rotation - 1], pixels[i * 4 + 3]); }
+	}
+
+	// Color: principal axis of the rgb values, as in mode 6
+	float mean[3] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		for (int ch = 0; ch < 3; ch++) { mean[ch] += pixels[i * 4 + ch] / 16.0f; }
+	}
+	float covariance[3][3] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float d[3];
+		for (int ch = 0; ch < 3; ch++) { d[ch] = pixels[i * 4 + ch] - mean[ch]; }
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 3; c++) { covariance[r][c] += d[r] * d[c]; }
+		}
+	}
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[3] = {};
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 3; c++) { next[r] += covariance[r][c] * axis[c]; }
+		}
+		float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+		if (length < 1e-6f) { break; }
+		for (int ch = 0; ch < 3; ch++) { axis[ch] = next[ch] / length; }
+	}
+	float minT = FLT_MAX;
+	float maxT = -FLT_MAX;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (int ch = 0; ch < 3; ch++) { t += (pixels[i * 4 + ch] - mean[ch]) * axis[ch]; }
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+
+	int color[2][3];
+	unsigned char colorIndices[16];
+	for (int ch = 0; ch < 3; ch++)
+	{
+		color[0][ch] = std::min(127, std::max(0, (int)((mean[ch] + axis[ch] * minT) * 127.0f / 255.0f + 0.5f)));
+		color[1][ch] = std::min(127, std::max(0, (int)((mean[ch] + axis[ch] * maxT) * 127.0f / 255.0f + 0.5f)));
+	}
+	int colorError = FitBC7Mode5Color(pixels, color, colorIndices);
+
+	// Alpha: its range, then the same refinement
+	int alpha[2] = { 255, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		alpha[0] = std::min(alpha[0], (int)pixels[i * 4 + 3]);
+		alpha[1] = std::max(alpha[1], (int)pixels[i * 4 + 3]);
+	}
+	unsigned char alphaIndices[16];
+	int alphaError = FitBC7Mode5Alpha(pixels, alpha, alphaIndices);
+
+	for (int iteration = 0; iteration < 2; iteration++)
+	{
+		float ends[2][4];
+		if (colorError > 0 && SolveBC7Mode5Endpoints(pixels, colorIndices, 0, 3, ends))
+		{
+			int refined[2][3];
+			unsigned char refinedIndices[16];
+			for (int ch = 0; ch < 3; ch++)
+			{
+				refined[0][ch] = (int)(ends[0][ch] * 127.0f / 255.0f + 0.5f);
+				refined[1][ch] = (int)(ends[1][ch] * 127.0f / 255.0f + 0.5f);
+			}
+			int refinedError = FitBC7Mode5Color(pixels, refined, refinedIndices);
+			if (refinedError < colorError)
+			{
+				colorError = refinedError;
+				memcpy(color, refined, sizeof(color));
+				memcpy(colorIndices, refinedIndices, sizeof(colorIndices));
+			}
+		}
+		if (alphaError > 0 && SolveBC7Mode5Endpoints(pixels, alphaIndices, 3, 1, ends))
+		{
+			int refined[2] = { (int)(ends[0][3] + 0.5f), (int)(ends[1][3] + 0.5f) };
+			unsigned char refinedIndices[16];
+			int refinedError = FitBC7Mode5Alpha(pixels, refined, refinedIndices);
+			if (refinedError < alphaError)
+			{
+				alphaError = refinedError;
+				memcpy(alpha, refined, sizeof(alpha));
+				memcpy(alphaIndices, refinedIndices, sizeof(alphaIndices));
+			}
+		}
+	}
+
+	// Both index sets store their first index without its top bit
+	if (colorIndices[0] & 2)
+	{
+		for (int ch = 0; ch < 3; ch++) { std::swap(color[0][ch], color[1][ch]); }
+		for (int i = 0; i < 16; i++) { colorIndices[i] = (unsigned char)(3 - colorIndices[i]); }
+	}
+	if (alphaIndices[0] & 2)
+	{
+		std::swap(alpha[0], alpha[1]);
+		for (int i = 0; i < 16; i++) { alphaIndices[i] = (unsigned char)(3 - alphaIndices[i]); }
+	}
+
+	memset(out, 0, 16);
+	unsigned int position = 0;
+	auto write = [&](unsigned int value, unsigned int bitCount)
+	{
+		for (unsigned int bit = 0; bit < bitCount; bit++, position++)
+		{
+			if ((value >> bit) & 1) { out[position >> 3] |= (unsigned char)(1 << (position & 7)); }
+		}
+	};
+	write(1 << 5, 6);
+	write(rotation, 2);
+	for (int ch = 0; ch < 3; ch++)
+	{
+		write(color[0][ch], 7);
+		write(color[1][ch], 7);
+	}
+	write(alpha[0], 8);
+	write(alpha[1], 8);
+	write(colorIndices[0], 1);
+	for (int i = 1; i < 16; i++) { write(colorIndices[i], 2); }
+	write(alphaIndices[0], 1);
+	for (int i = 1; i < 16; i++) { write(alphaIndices[i], 2); }
+	return colorError + alphaError;
+}
+
+// Keeps whichever of mode 6 and the four mode 5 rotations fits the block best
+static void EncodeBC7Block(const unsigned char pixels[64], unsigned char* out)
+{
+	int bestError = EncodeBC7Mode6(pixels, out);
+	for (int rotation = 0; rotation < 4 && bestError > 0; rotation++)
+	{
+		unsigned char candidate[16];
+		int error = EncodeBC7Mode5(pixels, rotation, candidate);
+		if (error < bestError)
+		{
+			bestError = error;
+			memcpy(out, candidate, sizeof(candidate));
+		}
+	}
+}
+
+static void DecodeBC7Block(const unsigned char* block, unsigned char pixels[64])
+{
+	unsigned int position = 0;
+	auto read = [&](unsigned int bitCount)
+	{
+		unsigned int value = 0;
+		for (unsigned int bit = 0; bit < bitCount; bit++, position++) { value |= ((block[position >> 3] >> (position & 7)) & 1) << bit; }
+		return value;
+	};
+
+	// Only modes 5 and 6 are decoded, since that's all the encoder writes
+	if (read(6) == (1 << 5))
+	{
+		int rotation = (int)read(2);
+		int color[2][3];
+		for (int ch = 0; ch < 3; ch++)
+		{
+			color[0][ch] = Unquantize7((int)read(7));
+			color[1][ch] = Unquantize7((int)read(7));
+		}
+		int alpha[2];
+		alpha[0] = (int)read(8);
+		alpha[1] = (int)read(8);
+		unsigned int colorIndices[16];
+		for (int i = 0; i < 16; i++) { colorIndices[i] = read(i == 0 ? 1 : 2); }
+		for (int i = 0; i < 16; i++)
+		{
+			unsigned int alphaIndex = read(i == 0 ? 1 : 2);
+			unsigned char* pixel = &pixels[i * 4];
+			for (int ch = 0; ch < 3; ch++)
+			{
+				int w = BC7_WEIGHTS_2BIT[colorIndices[i]];
+				pixel[ch] = (unsigned char)(((64 - w) * color[0][ch] + w * color[1][ch] + 32) >> 6);
+			}
+			int w = BC7_WEIGHTS_2BIT[alphaIndex];
+			pixel[3] = (unsigned char)(((64 - w) * alpha[0] + w * alpha[1] + 32) >> 6);
+			if (rotation > 0) { std::swap(pixel[rotation - 1], pixel[3]); }
+		}
+		return;
+	}
+	position = 0;
+	if (read(7) != (1 << 6))
+	{
+		memset(pixels, 0, 64);
+		return;
+	}
+	int endpoints[2][4];
+	int pBits[2];
+	for (int ch = 0; ch < 4; ch++)
+	{
+		endpoints[0][ch] = (int)read(7);
+		endpoints[1][ch] = (int)read(7);
+	}
+	pBits[0] = (int)read(1);
+	pBits[1] = (int)read(1);
+	int palette[16][4];
+	GetBC7Palette(endpoints, pBits, palette);
+	for (int i = 0; i < 16; i++)
+	{
+		unsigned int index = read(i == 0 ? 3 : 4);
+		for (int ch = 0; ch < 4; ch++) { pixels[i * 4 + ch] = (unsigned char)palette[index][ch]; }
+	}
+}
+
+// --------------------------------------------------------
+// Images and DDS files
+// --------------------------------------------------------
+
+static unsigned int GetBlockSize(TextureCompression compression)
+{
+	return compression == TEXTURE_COMPRESSION_BC4 ? 8 : 16;
+}
+
+void CompressImage(const TextureImage& image, TextureCompression compression, std::vector<unsigned char>& blocks)
+{
+	unsigned int blocksWide = (image.Width + 3) / 4;
+	unsigned int blocksHigh = (image.Height + 3) / 4;
+	unsigned int blockSize = GetBlockSize(compression);
+	size_t start = blocks.size();
+	blocks.resize(start + (size_t)blocksWide * blocksHigh * blockSize);
+
+	unsigned char pixels[64];
+	unsigned char channel[16];
+	for (unsigned int by = 0; by < blocksHigh; by++)
+	{
+		for (unsigned int bx = 0; bx < blocksWide; bx++)
+		{
+			for (unsigned int i = 0; i < 16; i++)
+			{
+				unsigned int x = std::min(bx * 4 + (i & 3), image.Width - 1);
+				unsigned int y = std::min(by * 4 + (i >> 2), image.Height - 1);
+				memcpy(&pixels[i * 4], &image.Pixels[((size_t)y * image.Width + x) * 4], 4);
+			}
+
+			unsigned char* out = &blocks[start + ((size_t)by * blocksWide + bx) * blockSize];
+			switch (compression)
+			{
+			case TEXTURE_COMPRESSION_BC7:
+				EncodeBC7Block(pixels, out);
+				break;
+			case TEXTURE_COMPRESSION_BC5:
+				for (int i = 0; i < 16; i++) { channel[i] = pixels[i * 4 + 1]; }
+				EncodeBC4Block(channel, out + 8);
+			// Fall through for red
+			case TEXTURE_COMPRESSION_BC4:
+				for (int i = 0; i < 16; i++) { channel[i] = pixels[i * 4]; }
+				EncodeBC4Block(channel, out);
+				break;
+			}
+		}
+	}
+}
+
+void DecompressBlock(const unsigned char* block, TextureCompression compression, unsigned char* pixels)
+{
+	if (compression == TEXTURE_COMPRESSION_BC7)
+	{
+		DecodeBC7Block(block, pixels);
+		return;
+	}
+
+	unsigned char red[16];
+	unsigned char green[16] = {};
+	DecodeBC4Block(block, red);
+	if (compression == TEXTURE_COMPRESSION_BC5) { DecodeBC4Block(block + 8, green); }
+	for (int i = 0; i < 16; i++)
+	{
+		pixels[i * 4 + 0] = red[i];
+		pixels[i * 4 + 1] = green[i];
+		pixels[i * 4 + 2] = 0;
+		pixels[i * 4 + 3] = 255;
+	}
+}
+
+// The on-disk layout of a .dds file's headers
+struct DDSPixelFormat
+{
+	unsigned int Size;
+	unsigned int Flags;
+	unsigned int FourCC;
+	unsigned int RGBBitCount;
+	unsigned int RBitMask;
+	unsigned int GBitMask;
+	unsigned int BBitMask;
+	unsigned int ABitMask;
+};
+
+struct DDSHeader
+{
+	unsigned int Size;
+	unsigned int Flags;
+	unsigned int Height;
+	unsigned int Width;
+	unsigned int PitchOrLinearSize;
+	unsigned int Depth;
+	unsigned int MipMapCount;
+	unsigned int Reserved1[11];
+	DDSPixelFormat PixelFormat;
+	unsigned int Caps;
+	unsigned int Caps2;
+	unsigned int Caps3;
+	unsigned int Caps4;
+	unsigned int Reserved2;
+};
+
+struct DDSHeaderDX10
+{
+	unsigned int DXGIFormat;
+	unsigned int ResourceDimension;
+	unsigned int MiscFlag;
+	unsigned int ArraySize;
+	unsigned int MiscFlags2;
+};
+
+void WriteDDSHeader(unsigned int width, unsigned int height, unsigned int mipCount, unsigned int format, bool cubemap,
+	size_t topLevelBytes, std::vector<unsigned char>& dds)
+{
+	DDSHeader header = {};
+	header.Size = sizeof(DDSHeader);
+	header.Flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;	// Caps, height, width, pixel format, mip count, linear size
+	header.Height = height;
+	header.Width = width;
+	header.PitchOrLinearSize = (unsigned int)topLevelBytes;
+	header.MipMapCount = mipCount;
+	header.PixelFormat.Size = sizeof(DDSPixelFormat);
+	header.PixelFormat.Flags = 0x4;									// FourCC
+	header.PixelFormat.FourCC = 'D' | ('X' << 8) | ('1' << 16) | ('0' << 24);
+	header.Caps = 0x1000 | 0x8 | 0x400000;							// Texture, complex, mipmap
+	header.Caps2 = cubemap ? 0xFE00 : 0;							// Cube map with all six faces
+
+	DDSHeaderDX10 header10 = {};
+	header10.DXGIFormat = format;
+	header10.ResourceDimension = 3;									// Texture2D
+	header10.MiscFlag = cubemap ? 0x4 : 0;							// Texture cube
+	header10.ArraySize = 1;
+
+	const unsigned int magic = 'D' | ('D' << 8) | ('S' << 16) | (' ' << 24);
+	dds.resize(sizeof(magic) + sizeof(header) + sizeof(header10));
+	memcpy(dds.data(), &magic, sizeof(magic));
+	memcpy(dds.data() + sizeof(magic), &header, sizeof(header));
+	memcpy(dds.data() + sizeof(magic) + sizeof(header), &header10, sizeof(header10));
+}
+
+bool CookTextureImage(const TextureImage& source, TextureContent content, TextureCompression compression, std::vector<unsigned char>& dds)
+{
+	// Only the top level has to be made of whole blocks
+	if (source.Width == 0 || source.Height == 0 || source.Width % 4 != 0 || source.Height % 4 != 0)
+		return false;
+
+	std::vector<TextureImage> mips;
+	GenerateMipChain(source, content, mips);
+
+	unsigned int format = compression == TEXTURE_COMPRESSION_BC7 ? DDS_FORMAT_BC7_UNORM :
+		compression == TEXTURE_COMPRESSION_BC5 ? DDS_FORMAT_BC5_UNORM : DDS_FORMAT_BC4_UNORM;
+	WriteDDSHeader(source.Width, source.Height, (unsigned int)mips.size(), format, false,
+		(size_t)(source.Width / 4) * (source.Height / 4) * GetBlockSize(compression), dds);
+
+	for (const TextureImage& mip : mips) { CompressImage(mip, compression, dds); }
+	return true;
+}
+
+bool ReadCookedTextureLayout(const unsigned char* dds, size_t size, size_t fileSize, CookedTextureLayout& layout)
+{
+	const unsigned int magic = 'D' | ('D' << 8) | ('S' << 16) | (' ' << 24);
+	const unsigned int dx10 = 'D' | ('X' << 8) | ('1' << 16) | ('0' << 24);
+	size_t dataOffset = sizeof(magic) + sizeof(DDSHeader) + sizeof(DDSHeaderDX10);
+	if (size < dataOffset)
+		return false;
+
+	unsigned int fileMagic;
+	DDSHeader header;
+	DDSHeaderDX10 header10;
+	memcpy(&fileMagic, dds, sizeof(fileMagic));
+	memcpy(&header, dds + sizeof(magic), sizeof(header));
+	memcpy(&header10, dds + sizeof(magic) + sizeof(header), sizeof(header10));
+	if (fileMagic != magic || header.Size != sizeof(DDSHeader) || header.PixelFormat.FourCC != dx10 ||
+		header10.ResourceDimension != 3 || header10.ArraySize != 1 || (header10.MiscFlag & 0x4) != 0 ||
+		header.Width == 0 || header.Height == 0)
+		return false;
+
+	if (header10.DXGIFormat == DDS_FORMAT_BC4_UNORM) { layout.BlockSize = 8; }
+	else if (header10.DXGIFormat == DDS_FORMAT_BC5_UNORM || header10.DXGIFormat == DDS_FORMAT_BC7_UNORM) { layout.BlockSize = 16; }
+	else return false;
+
+	layout.Width = header.Width;
+	layout.Height = header.Height;
+	layout.Format = header10.DXGIFormat;
+	layout.MipOffsets.clear();
+	layout.MipSizes.clear();
+	unsigned int mipCount = std::max(1u, header.MipMapCount);
+	size_t offset = dataOffset;
+	for (unsigned int mip = 0; mip < mipCount; mip++)
+	{
+		unsigned int width = std::max(1u, header.Width >> mip);
+		unsigned int height = std::max(1u, header.Height >> mip);
+		size_t mipSize = (size_t)((width + 3) / 4) * ((height + 3) / 4) * layout.BlockSize;
+		layout.MipOffsets.push_back(offset);
+		layout.MipSizes.push_back(mipSize);
+		offset += mipSize;
+	}
+	return offset <= fileSize;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// CPU side of the texture cooker: mip chain generation,
+// block compression and DDS output
+//
+// - BC7 (modes 5 and 6) for color and packed maps, 8 bits
+//   per pixel
+// - BC5 for tangent space normals (x and y, z is rebuilt
+//   in the shader), 8 bits per pixel
+// - BC4 for single channel maps, 4 bits per pixel
+//
+// Everything here works on plain RGBA8 arrays, so it can
+// run on any thread. Decoding the sources and loading the
+// results lives in TextureCooker.
+// --------------------------------------------------------
+
+// Block compressed formats the cooker writes
+enum TextureCompression
+{
+	TEXTURE_COMPRESSION_BC7,		// RGBA
+	TEXTURE_COMPRESSION_BC5,		// RG
+	TEXTURE_COMPRESSION_BC4			// R
+};
+
+// What the texels mean, which decides how mips are filtered
+enum TextureContent
+{
+	TEXTURE_CONTENT_COLOR,			// Gamma encoded RGB (the shaders apply pow 2.2), linear alpha
+	TEXTURE_CONTENT_NORMAL,			// Tangent space normals packed as rgb * 0.5 + 0.5
+	TEXTURE_CONTENT_LINEAR			// Data (roughness, metalness, opacity, etc)
+};
+
+// Channels of a packed material texture (cooked to BC7, sampled once for all four)
+enum TexturePackedChannel
+{
+	TEXTURE_PACKED_OCCLUSION,		// R
+	TEXTURE_PACKED_ROUGHNESS,		// G
+	TEXTURE_PACKED_METALNESS,		// B
+	TEXTURE_PACKED_OPACITY,			// A
+	TEXTURE_PACKED_CHANNEL_COUNT
+};
+
+// An uncompressed image, 4 bytes per pixel, rows tightly packed
+struct TextureImage
+{
+	unsigned int Width;
+	unsigned int Height;
+	std::vector<unsigned char> Pixels;
+};
+
+// Where each mip of a cooked .dds sits in the file
+struct CookedTextureLayout
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int Format;			// DXGI_FORMAT value
+	unsigned int BlockSize;			// Bytes per 4x4 block
+	std::vector<size_t> MipOffsets;	// From the start of the file, most detailed first
+	std::vector<size_t> MipSizes;
+};
+
+/// <summary>
+/// Picks how to cook a texture from its file name suffix (_albedo, _normals,
+/// _roughness, _metal, _opacity, _ao, _height, _orm); anything else is treated as color
+/// </summary>
+/// <param name="fileName">Source file name, with or without a directory</param>
+/// <param name="content">Receives how the texels should be filtered</param>
+/// <param name="compression">Receives the format to compress to</param>
+void GetTextureCookSettings(const std::string& fileName, TextureContent& content, TextureCompression& compression);
+
+/// <summary>
+/// Picks which of a material's maps are worth packing: those at the largest size, if there are
+/// at least two. Smaller maps would have to be stretched, and one map alone takes twice the
+/// memory as a BC7 pack as it does as its own BC4 texture.
+/// </summary>
+/// <param name="widths">Width of each TexturePackedChannel's map (0 if the material doesn't have one)</param>
+/// <param name="heights">Height of each map</param>
+/// <returns>A bit (1 &lt;&lt; channel) for each map to pack, or 0 to leave them all on their own</returns>
+unsigned int ChoosePackedChannels(const unsigned int widths[TEXTURE_PACKED_CHANNEL_COUNT], const unsigned int heights[TEXTURE_PACKED_CHANNEL_COUNT]);
+
+/// <summary>
+/// Builds one occlusion/roughness/metalness/opacity image from the red channels of
+/// single channel maps, which must all be the same size (see ChoosePackedChannels()).
+/// Missing maps are filled with what the shaders assume without them: occlusion 1,
+/// roughness 0.2, metalness 0, opacity 1.
+/// </summary>
+/// <param name="channels">Image for each TexturePackedChannel, or null</param>
+/// <param name="packed">Receives the packed image</param>
+/// <returns>False if no maps were given or they differ in size</returns>
+bool PackTextureChannels(const TextureImage* const channels[TEXTURE_PACKED_CHANNEL_COUNT], TextureImage& packed);
+
+/// <summary>
+/// Builds a full mip chain down to 1x1, box filtering in linear space: color is
+/// decoded with the shaders' 2.2 gamma first, normals are renormalized each level
+/// </summary>
+/// <param name="source">Top level image</param>
+/// <param name="content">How the texels should be filtered</param>
+/// <param name="mips">Receives every level, starting with a copy of the source</param>
+void GenerateMipChain(const TextureImage& source, TextureContent content, std::vector<TextureImage>& mips);
+
+/// <summary>
+/// Compresses one image into 4x4 blocks (edge blocks repeat the last row/column)
+/// </summary>
+/// <param name="image">Image to compress</param>
+/// <param name="compression">Block format</param>
+/// <param name="blocks">Compressed blocks are appended here, row by row</param>
+void CompressImage(const TextureImage& image, TextureCompression compression, std::vector<unsigned char>& blocks);
+
+/// <summary>
+/// Starts a .dds file with a DX10 header; the caller appends every mip of every face after it
+/// </summary>
+/// <param name="format">DXGI_FORMAT value</param>
+/// <param name="cubemap">True for six faces (each with all its mips, +X first)</param>
+/// <param name="topLevelBytes">Size of the most detailed level of one face</param>
+/// <param name="dds">Receives the headers (replacing its contents)</param>
+void WriteDDSHeader(unsigned int width, unsigned int height, unsigned int mipCount, unsigned int format, bool cubemap,
+	size_t topLevelBytes, std::vector<unsigned char>& dds);
+
+/// <summary>
+/// Builds a complete .dds file (DX10 header) from an image: mips, compression and all
+/// </summary>
+/// <param name="source">Top level image (width and height must be multiples of 4)</param>
+/// <param name="content">How the texels should be filtered</param>
+/// <param name="compression">Block format</param>
+/// <param name="dds">Receives the file contents</param>
+/// <returns>False if the image can't be block compressed</returns>
+bool CookTextureImage(const TextureImage& source, TextureContent content, TextureCompression compression, std::vector<unsigned char>& dds);
+
+/// <summary>
+/// Reads the headers of a .dds written by CookTextureImage(), so single mips can be
+/// loaded straight from the file
+/// </summary>
+/// <param name="dds">Start of the file (at least the headers)</param>
+/// <param name="size">Bytes available at dds</param>
+/// <param name="fileSize">Size of the whole file, to check the mips are all there</param>
+/// <param name="layout">Receives the size, format and mip locations</param>
+/// <returns>False if the file isn't a 2D BC4/BC5/BC7 texture in the cooker's layout</returns>
+bool ReadCookedTextureLayout(const unsigned char* dds, size_t size, size_t fileSize, CookedTextureLayout& layout);
+
+/// <summary>
+/// Decodes one block written by CompressImage back to RGBA8 (BC7 modes 5 and 6 only), for checking the encoders
+/// </summary>
+/// <param name="block">8 (BC4) or 16 (BC5, BC7) bytes</param>
+/// <param name="compression">Block format</param>
+/// <param name="pixels">Receives 16 pixels, 4 bytes each (unused channels are 0, alpha 255)</param>
+void DecompressBlock(const unsigned char* block, TextureCompression compression, unsigned char* pixels);
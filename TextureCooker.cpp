@@ -0,0 +1,401 @@
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+#include "PathHelpers.h"
+#include <Windows.h>
+#include <wincodec.h>
+#include <wrl/client.h>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <cwctype>
+#include <array>
+#include <map>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+std::wstring GetCookedTexturePath(const std::wstring& sourceFilePath)
+{
+	return sourceFilePath + L".dds";
+}
+
+static bool GetFileInfo(const std::wstring& filePath, unsigned long long& writeTime, size_t& size)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExW(filePath.c_str(), GetFileExInfoStandard, &data))
+		return false;
+	writeTime = ((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+	size = ((size_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	return true;
+}
+
+bool IsCookedTextureCurrent(const std::wstring& sourceFilePath)
+{
+	unsigned long long sourceTime, cookedTime;
+	size_t sourceSize, cookedSize;
+	if (!GetFileInfo(GetCookedTexturePath(sourceFilePath), cookedTime, cookedSize))
+		return false;
+	return !GetFileInfo(sourceFilePath, sourceTime, sourceSize) || cookedTime >= sourceTime;
+}
+
+bool IsDerivedFileCurrent(const std::wstring& filePath, const std::wstring sourceFilePaths[], unsigned int sourceCount)
+{
+	unsigned long long fileTime, sourceTime;
+	size_t fileSize, sourceSize;
+	if (!GetFileInfo(filePath, fileTime, fileSize))
+		return false;
+	for (unsigned int i = 0; i < sourceCount; i++)
+	{
+		if (GetFileInfo(sourceFilePaths[i], sourceTime, sourceSize) && sourceTime > fileTime)
+			return false;
+	}
+	return true;
+}
+
+// Lower case file name without its directory or extension
+static std::wstring GetBaseName(const std::wstring& filePath)
+{
+	size_t slash = filePath.find_last_of(L"/\\");
+	std::wstring name = filePath.substr(slash == std::wstring::npos ? 0 : slash + 1);
+	size_t dot = name.find_last_of(L'.');
+	if (dot != std::wstring::npos) { name.resize(dot); }
+	std::transform(name.begin(), name.end(), name.begin(), [](wchar_t c) { return (wchar_t)towlower(c); });
+	return name;
+}
+
+static bool EndsWith(const std::wstring& str, const wchar_t* suffix)
+{
+	size_t length = wcslen(suffix);
+	return str.size() >= length && str.compare(str.size() - length, length, suffix) == 0;
+}
+
+// Which packed channel a map fills, from its file name suffix
+static bool GetPackedChannel(const std::wstring& filePath, TexturePackedChannel& channel)
+{
+	std::wstring name = GetBaseName(filePath);
+	if (EndsWith(name, L"_ao")) { channel = TEXTURE_PACKED_OCCLUSION; }
+	else if (EndsWith(name, L"_roughness")) { channel = TEXTURE_PACKED_ROUGHNESS; }
+	else if (EndsWith(name, L"_metal") || EndsWith(name, L"_metalness")) { channel = TEXTURE_PACKED_METALNESS; }
+	else if (EndsWith(name, L"_opacity")) { channel = TEXTURE_PACKED_OPACITY; }
+	else return false;
+	return true;
+}
+
+// Swaps a map's suffix (and extension) for _orm.dds
+static std::wstring GetPackedTexturePath(const std::wstring& mapFilePath)
+{
+	size_t slash = mapFilePath.find_last_of(L"/\\");
+	size_t start = slash == std::wstring::npos ? 0 : slash + 1;
+	size_t dot = mapFilePath.find_last_of(L'.');
+	std::wstring path = mapFilePath.substr(0, dot == std::wstring::npos || dot < start ? mapFilePath.size() : dot);
+	size_t underscore = path.find_last_of(L'_');
+	if (underscore != std::wstring::npos && underscore >= start) { path.resize(underscore); }
+	return path + L"_orm.dds";
+}
+
+std::wstring GetPackedTexturePath(const std::wstring channelFilePaths[TEXTURE_PACKED_CHANNEL_COUNT])
+{
+	for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+	{
+		if (!channelFilePaths[c].empty())
+			return GetPackedTexturePath(channelFilePaths[c]);
+	}
+	return std::wstring();
+}
+
+bool IsPackedTextureCurrent(const std::wstring channelFilePaths[TEXTURE_PACKED_CHANNEL_COUNT])
+{
+	unsigned long long packedTime, mapTime;
+	size_t packedSize, mapSize;
+	if (!GetFileInfo(GetPackedTexturePath(channelFilePaths), packedTime, packedSize))
+		return false;
+	for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+	{
+		if (!channelFilePaths[c].empty() && GetFileInfo(channelFilePaths[c], mapTime, mapSize) && mapTime > packedTime)
+			return false;
+	}
+	return true;
+}
+
+size_t GetCookedSize(unsigned int width, unsigned int height, unsigned int blockSize)
+{
+	size_t bytes = 0;
+	for (;;)
+	{
+		bytes += (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+		if (width == 1 && height == 1) { break; }
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+	}
+	return bytes;
+}
+
+// Decodes any image WIC understands to RGBA8 (COM must be initialized)
+static bool DecodeImage(const std::wstring& filePath, TextureImage& image)
+{
+	Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+	Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+	Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+	Microsoft::WRL::ComPtr<IWICFormatConverter> converter;
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()))) ||
+		FAILED(factory->CreateDecoderFromFilename(filePath.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) ||
+		FAILED(decoder->GetFrame(0, frame.GetAddressOf())) ||
+		FAILED(factory->CreateFormatConverter(converter.GetAddressOf())) ||
+		FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom)))
+		return false;
+
+	UINT width, height;
+	frame->GetSize(&width, &height);
+	image.Width = width;
+	image.Height = height;
+	image.Pixels.resize((size_t)width * height * 4);
+	return SUCCEEDED(converter->CopyPixels(nullptr, width * 4, (UINT)image.Pixels.size(), image.Pixels.data()));
+}
+
+// Reads an image's size from its header, without decoding the pixels (COM must be initialized)
+static bool ReadImageSize(const std::wstring& filePath, unsigned int& width, unsigned int& height)
+{
+	Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+	Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+	Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+	UINT frameWidth, frameHeight;
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()))) ||
+		FAILED(factory->CreateDecoderFromFilename(filePath.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) ||
+		FAILED(decoder->GetFrame(0, frame.GetAddressOf())) ||
+		FAILED(frame->GetSize(&frameWidth, &frameHeight)))
+		return false;
+	width = frameWidth;
+	height = frameHeight;
+	return true;
+}
+
+unsigned int ChoosePackedTextureMaps(const std::wstring channelFilePaths[TEXTURE_PACKED_CHANNEL_COUNT],
+	unsigned int widths[TEXTURE_PACKED_CHANNEL_COUNT], unsigned int heights[TEXTURE_PACKED_CHANNEL_COUNT])
+{
+	HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+	{
+		widths[c] = 0;
+		heights[c] = 0;
+		if (!channelFilePaths[c].empty()) { ReadImageSize(channelFilePaths[c], widths[c], heights[c]); }
+	}
+	if (SUCCEEDED(comResult)) { CoUninitialize(); }
+	return ChoosePackedChannels(widths, heights);
+}
+
+bool DecodeTextureImage(const std::wstring& filePath, TextureImage& image)
+{
+	// Every thread that uses WIC needs COM
+	HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	bool succeeded = DecodeImage(filePath, image);
+	if (SUCCEEDED(comResult)) { CoUninitialize(); }
+	return succeeded;
+}
+
+bool CookTexture(const std::wstring& sourceFilePath)
+{
+	bool succeeded = false;
+	TextureImage image;
+	if (DecodeTextureImage(sourceFilePath, image))
+	{
+		TextureContent content;
+		TextureCompression compression;
+		GetTextureCookSettings(WideToNarrow(sourceFilePath), content, compression);
+
+		std::vector<unsigned char> dds;
+		if (!CookTextureImage(image, content, compression, dds))
+		{
+			std::wcerr << L"Could not cook " << sourceFilePath << L": " << image.Width << L"x" << image.Height
+				<< L" isn't a multiple of 4" << std::endl;
+		}
+		else
+		{
+			std::ofstream output(GetCookedTexturePath(sourceFilePath), std::ios::binary | std::ios::trunc);
+			output.write((const char*)dds.data(), dds.size());
+			succeeded = output.good();
+		}
+	}
+	else
+	{
+		std::wcerr << L"Could not decode " << sourceFilePath << std::endl;
+	}
+	return succeeded;
+}
+
+bool CookPackedTexture(const std::wstring channelFilePaths[TEXTURE_PACKED_CHANNEL_COUNT])
+{
+	std::wstring packedPath = GetPackedTexturePath(channelFilePaths);
+	TextureImage images[TEXTURE_PACKED_CHANNEL_COUNT];
+	unsigned int widths[TEXTURE_PACKED_CHANNEL_COUNT] = {};
+	unsigned int heights[TEXTURE_PACKED_CHANNEL_COUNT] = {};
+	for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+	{
+		if (channelFilePaths[c].empty())
+			continue;
+		if (!DecodeTextureImage(channelFilePaths[c], images[c]))
+		{
+			std::wcerr << L"Could not decode " << channelFilePaths[c] << std::endl;
+			return false;
+		}
+		widths[c] = images[c].Width;
+		heights[c] = images[c].Height;
+	}
+
+	// Only maps the same size as the largest go in; the rest keep their own .dds
+	unsigned int packedChannels = ChoosePackedChannels(widths, heights);
+	if (packedChannels == 0)
+	{
+		std::wcerr << L"Could not pack " << packedPath << L": no two maps are the same size" << std::endl;
+		return false;
+	}
+	const TextureImage* channels[TEXTURE_PACKED_CHANNEL_COUNT] = {};
+	unsigned int mapCount = 0;
+	size_t separateBytes = 0;
+	for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+	{
+		if ((packedChannels & (1u << c)) == 0)
+			continue;
+		channels[c] = &images[c];
+		mapCount++;
+		separateBytes += GetCookedSize(images[c].Width, images[c].Height, 8);
+	}
+
+	TextureImage packed;
+	std::vector<unsigned char> dds;
+	if (!PackTextureChannels(channels, packed))
+		return false;
+	if (!CookTextureImage(packed, TEXTURE_CONTENT_LINEAR, TEXTURE_COMPRESSION_BC7, dds))
+	{
+		std::wcerr << L"Could not cook " << packedPath << L": " << packed.Width << L"x" << packed.Height
+			<< L" isn't a multiple of 4" << std::endl;
+		return false;
+	}
+	std::ofstream output(packedPath, std::ios::binary | std::ios::trunc);
+	output.write((const char*)dds.data(), dds.size());
+	if (!output.good())
+		return false;
+
+	// What packing saves this material: samples per pixel, and memory against separate BC4 maps
+	printf("Packed %s: %u map(s) -> 1 sample per pixel, %.0fKB as separate BC4 -> %.0fKB BC7\n",
+		WideToNarrow(packedPath).c_str(), mapCount, separateBytes / 1024.0f, dds.size() / 1024.0f);
+	return true;
+}
+
+TextureCookStats CookTextures(const std::wstring& directory, bool force)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	TextureCookStats stats = {};
+
+	std::vector<std::wstring> sources;
+	WIN32_FIND_DATAW found;
+	HANDLE search = FindFirstFileW((directory + L"\\*").c_str(), &found);
+	if (search != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			std::wstring name = found.cFileName;
+			size_t dot = name.find_last_of(L'.');
+			if (dot == std::wstring::npos || (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) { continue; }
+			std::wstring extension = name.substr(dot);
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](wchar_t c) { return (wchar_t)towlower(c); });
+			if (extension == L".png" || extension == L".jpg" || extension == L".jpeg" || extension == L".bmp")
+				sources.push_back(directory + L"\\" + name);
+		} while (FindNextFileW(search, &found));
+		FindClose(search);
+	}
+
+	// Group each material's occlusion/roughness/metalness/opacity maps for packing
+	std::map<std::wstring, std::array<std::wstring, TEXTURE_PACKED_CHANNEL_COUNT>> packedSets;
+	for (const std::wstring& source : sources)
+	{
+		TexturePackedChannel channel;
+		if (GetPackedChannel(source, channel))
+			packedSets[GetPackedTexturePath(source)][channel] = source;
+	}
+
+	// One file per task; a 1024x1024 BC7 texture is a few hundred milliseconds of work
+	std::mutex statsMutex;
+	{
+		ThreadPool pool(std::thread::hardware_concurrency());
+		for (const std::wstring& source : sources)
+		{
+			if (!force && IsCookedTextureCurrent(source))
+			{
+				stats.UpToDate++;
+				continue;
+			}
+			pool.Enqueue([source, &stats, &statsMutex]()
+			{
+				bool cooked = CookTexture(source);
+				unsigned long long writeTime;
+				size_t sourceSize = 0, cookedSize = 0;
+				GetFileInfo(source, writeTime, sourceSize);
+				if (cooked) { GetFileInfo(GetCookedTexturePath(source), writeTime, cookedSize); }
+
+				std::lock_guard<std::mutex> lock(statsMutex);
+				if (cooked)
+				{
+					stats.Cooked++;
+					stats.SourceBytes += sourceSize;
+					stats.CookedBytes += cookedSize;
+				}
+				else
+				{
+					stats.Failed++;
+				}
+			});
+		}
+		for (auto& set : packedSets)
+		{
+			// Maps that don't share the largest size are left to their own .dds (see ChoosePackedChannels())
+			std::array<std::wstring, TEXTURE_PACKED_CHANNEL_COUNT> channels = set.second;
+			unsigned int widths[TEXTURE_PACKED_CHANNEL_COUNT], heights[TEXTURE_PACKED_CHANNEL_COUNT];
+			unsigned int packedChannels = ChoosePackedTextureMaps(channels.data(), widths, heights);
+			if (packedChannels == 0)
+			{
+				printf("Not packing %s: no two maps are the same size\n", WideToNarrow(set.first).c_str());
+				continue;
+			}
+			for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+			{
+				if ((packedChannels & (1u << c)) == 0) { channels[c].clear(); }
+			}
+			if (!force && IsPackedTextureCurrent(channels.data()))
+			{
+				stats.UpToDate++;
+				continue;
+			}
+			pool.Enqueue([channels, &stats, &statsMutex]()
+			{
+				bool cooked = CookPackedTexture(channels.data());
+				unsigned long long writeTime;
+				size_t sourceSize = 0, cookedSize = 0;
+				for (const std::wstring& channel : channels)
+				{
+					size_t mapSize = 0;
+					if (!channel.empty() && GetFileInfo(channel, writeTime, mapSize)) { sourceSize += mapSize; }
+				}
+				if (cooked) { GetFileInfo(GetPackedTexturePath(channels.data()), writeTime, cookedSize); }
+
+				std::lock_guard<std::mutex> lock(statsMutex);
+				if (cooked)
+				{
+					stats.Cooked++;
+					stats.Packed++;
+					stats.SourceBytes += sourceSize;
+					stats.CookedBytes += cookedSize;
+				}
+				else
+				{
+					stats.Failed++;
+				}
+			});
+		}
+		pool.WaitIdle();
+	}
+
+	stats.CookTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return stats;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <string>
+#include "TextureCompression.h"
+
+// --------------------------------------------------------
+// Offline texture cooking
+//
+// CookTextures() (run with "-cook" on the command line)
+// decodes every image in a directory with WIC and writes a
+// block compressed, fully mipped .dds next to it, one file
+// per task across all cores. Each material's occlusion,
+// roughness, metalness and opacity maps are also packed
+// into one <material>_orm.dds, so shaders sample them once;
+// maps smaller than the rest are left out, not stretched.
+//
+// TextureLoader loads the cooked .dds instead of its source
+// whenever it's up to date.
+// --------------------------------------------------------
+
+// Results of a CookTextures() run
+struct TextureCookStats
+{
+	unsigned int Cooked;
+	unsigned int UpToDate;			// Skipped, the .dds was newer than its source
+	unsigned int Failed;
+	unsigned int Packed;			// Packed maps cooked (also counted in Cooked)
+	size_t SourceBytes;				// Of the textures cooked this run
+	size_t CookedBytes;
+	float CookTime;					// Milliseconds, wall clock
+};
+
+/// <summary>
+/// Gets the path of the cooked .dds for a source image (next to it)
+/// </summary>
+std::wstring GetCookedTexturePath(const std::wstring& sourceFilePath);
+
+/// <summary>
+/// Checks for a cooked .dds written after its source was last changed
+/// </summary>
+bool IsCookedTextureCurrent(const std::wstring& sourceFilePath);
+
+/// <summary>
+/// Gets the path of the cooked packed map for a material: the first map's path with
+/// its suffix swapped for _orm.dds (cobblestone_roughness.png -> cobblestone_orm.dds)
+/// </summary>
+/// <param name="channelFilePaths">Map for each TexturePackedChannel (empty if the material doesn't have one)</param>
+std::wstring GetPackedTexturePath(const std::wstring channelFilePaths[TEXTURE_PACKED_CHANNEL_COUNT]);
+
+/// <summary>
+/// Checks for a cooked packed map written after all of its maps were last changed
+/// </summary>
+bool IsPackedTextureCurrent(const std::wstring channelFilePaths[TEXTURE_PACKED_CHANNEL_COUNT]);
+
+/// <summary>
+/// Gets the size of a fully mipped block compressed texture
+/// </summary>
+/// <param name="blockSize">Bytes per 4x4 block: 8 for BC4, 16 for BC5 and BC7</param>
+size_t GetCookedSize(unsigned int width, unsigned int height, unsigned int blockSize);
+
+/// <summary>
+/// Checks for a file built from others (a cache) written after all of them were last changed
+/// </summary>
+/// <param name="filePath">The built file</param>
+/// <param name="sourceFilePaths">Files it was built from; missing ones are ignored</param>
+/// <param name="sourceCount">Number of sources</param>
+bool IsDerivedFileCurrent(const std::wstring& filePath, const std::wstring sourceFilePaths[], unsigned int sourceCount);
+
+/// <summary>
+/// Reads the size of each of a material's maps (just the headers) and picks the ones worth
+/// packing (see ChoosePackedChannels()). Safe to call from any thread.
+/// </summary>
+/// <param name="channelFilePaths">Map for each TexturePackedChannel (empty if the material doesn't have one)</param>
+/// <param name="widths">Receives each map's width (0 if it's missing or can't be read)</param>
+/// <param name="heights">Receives each map's height</param>
+/// <returns>A bit (1 &lt;&lt; channel) for each map to pack, or 0 to leave them all on their own</returns>
+unsigned int ChoosePackedTextureMaps(const std::wstring channelFilePaths[TEXTURE_PACKED_CHANNEL_COUNT],
+	unsigned int widths[TEXTURE_PACKED_CHANNEL_COUNT], unsigned int heights[TEXTURE_PACKED_CHANNEL_COUNT]);
+
+/// <summary>
+/// Decodes any image WIC understands to RGBA8. Safe to call from any thread.
+/// </summary>
+/// <param name="filePath">Path to the image</param>
+/// <param name="image">Receives the pixels</param>
+/// <returns>True if the image was decoded</returns>
+bool DecodeTextureImage(const std::wstring& filePath, TextureImage& image);
+
+/// <summary>
+/// Decodes one image and writes its cooked .dds
+/// </summary>
+/// <param name="sourceFilePath">Path to a PNG/JPG/etc; its name picks the format (see GetTextureCookSettings())</param>
+/// <returns>True if the .dds was written</returns>
+bool CookTexture(const std::wstring& sourceFilePath);
+
+/// <summary>
+/// Decodes a material's maps, packs the ones the same size as the largest (see ChoosePackedChannels()
+/// and PackTextureChannels()) and writes the BC7 .dds
+/// </summary>
+/// <param name="channelFilePaths">Map for each TexturePackedChannel (empty if the material doesn't have one)</param>
+/// <returns>True if the .dds was written</returns>
+bool CookPackedTexture(const std::wstring channelFilePaths[TEXTURE_PACKED_CHANNEL_COUNT]);
+
+/// <summary>
+/// Cooks every PNG, JPG and BMP in a directory on a thread per core, plus a packed map for
+/// every material with two or more _ao, _roughness, _metal(ness) or _opacity maps of one size
+/// </summary>
+/// <param name="directory">Directory to cook (not recursive)</param>
+/// <param name="force">Cook even the images whose .dds is already up to date</param>
+TextureCookStats CookTextures(const std::wstring& directory, bool force = false);
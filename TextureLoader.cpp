@@ -0,0 +1,369 @@
+#include "TextureLoader.h"
+#include "TextureCooker.h"
+#include "TextureStreamer.h"
+#include "PathHelpers.h"
+#include <DDSTextureLoader.h>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+TextureLoader::TextureLoader(Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	unsigned int threadCount) :
+	context(_context),
+	device(_device),
+	streamer(nullptr),
+	pendingCount(0),
+	stats(),
+	pool(threadCount)
+{
+}
+
+void TextureLoader::Load(const std::wstring& filePath, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	std::shared_ptr<PendingTexture> texture = std::make_shared<PendingTexture>();
+	texture->Target = std::addressof(srv);	// ComPtr overloads &
+	texture->FilePaths.push_back(filePath);
+	texture->Packed = false;
+	Queue(texture);
+}
+
+void TextureLoader::LoadCubemap(const std::wstring faceFilePaths[6], Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	std::shared_ptr<PendingTexture> texture = std::make_shared<PendingTexture>();
+	texture->Target = std::addressof(srv);	// ComPtr overloads &
+	texture->FilePaths.assign(faceFilePaths, faceFilePaths + 6);
+	texture->Packed = false;
+	Queue(texture);
+}
+
+void TextureLoader::LoadPacked(const std::wstring channelFilePaths[TEXTURE_PACKED_CHANNEL_COUNT], Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> channelSRVs[TEXTURE_PACKED_CHANNEL_COUNT])
+{
+	// Picked from the maps' headers; the ones left out load as textures of their own
+	unsigned int widths[TEXTURE_PACKED_CHANNEL_COUNT], heights[TEXTURE_PACKED_CHANNEL_COUNT];
+	unsigned int packedChannels = ChoosePackedTextureMaps(channelFilePaths, widths, heights);
+
+	TexturePackStats pack = {};
+	std::wstring packedPath = GetPackedTexturePath(channelFilePaths);
+	pack.Name = WideToNarrow(packedPath.substr(packedPath.find_last_of(L"/\\") + 1));
+	std::wstring packedFilePaths[TEXTURE_PACKED_CHANNEL_COUNT];
+	for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+	{
+		if (channelFilePaths[c].empty())
+			continue;
+		size_t mapBytes = GetCookedSize(widths[c], heights[c], 8);
+		pack.Maps++;
+		pack.SeparateBytes += mapBytes;
+		if (packedChannels & (1u << c))
+		{
+			if (pack.PackedMaps++ == 0) { pack.Bytes += GetCookedSize(widths[c], heights[c], 16); }
+			packedFilePaths[c] = channelFilePaths[c];
+		}
+		else
+		{
+			pack.Bytes += mapBytes;
+			Load(channelFilePaths[c], channelSRVs[c]);
+		}
+	}
+	pack.Samples = pack.Maps - pack.PackedMaps + (pack.PackedMaps > 0 ? 1 : 0);
+	pack.SeparateTexelBytes = pack.Maps * 0.5f;
+	pack.TexelBytes = (pack.Maps - pack.PackedMaps) * 0.5f + (pack.PackedMaps > 0 ? 1.0f : 0.0f);
+	packStats.push_back(pack);
+
+	if (packedChannels == 0)
+		return;
+	std::shared_ptr<PendingTexture> texture = std::make_shared<PendingTexture>();
+	texture->Target = std::addressof(srv);	// ComPtr overloads &
+	texture->FilePaths.assign(packedFilePaths, packedFilePaths + TEXTURE_PACKED_CHANNEL_COUNT);
+	texture->Packed = true;
+	Queue(texture);
+}
+
+void TextureLoader::Queue(std::shared_ptr<PendingTexture> texture)
+{
+	if (pendingCount == 0) { batchStart = std::chrono::high_resolution_clock::now(); }
+	pendingCount++;
+
+	// Single channel maps and normal maps (z is rebuilt in the shader) don't need all four channels
+	unsigned int channels = 4;
+	if (texture->Packed)
+	{
+		texture->CookedPath = GetPackedTexturePath(texture->FilePaths.data());
+	}
+	else if (texture->FilePaths.size() == 1)
+	{
+		TextureContent content;
+		TextureCompression compression;
+		GetTextureCookSettings(WideToNarrow(texture->FilePaths[0]), content, compression);
+		channels = compression == TEXTURE_COMPRESSION_BC4 ? 1 : compression == TEXTURE_COMPRESSION_BC5 ? 2 : 4;
+		texture->CookedPath = GetCookedTexturePath(texture->FilePaths[0]);
+	}
+	texture->BytesPerPixel = channels;
+	texture->Format = channels == 1 ? DXGI_FORMAT_R8_UNORM : channels == 2 ? DXGI_FORMAT_R8G8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM;
+	texture->Cooked = false;
+	texture->Failed = false;
+	unsigned int faceCount = texture->Packed ? 1 : (unsigned int)texture->FilePaths.size();	// Packed maps are one task
+	texture->FacesLeft = faceCount;
+
+	// Whichever face finishes last hands the texture back
+	for (unsigned int face = 0; face < faceCount; face++)
+	{
+		pool.Enqueue([this, texture, face]()
+		{
+			Decode(*texture, face);
+			if (--texture->FacesLeft > 0) { return; }
+			{
+				std::lock_guard<std::mutex> lock(completedMutex);
+				completed.push_back(texture);
+			}
+			completedCondition.notify_one();
+		});
+	}
+}
+
+void TextureLoader::Decode(PendingTexture& texture, unsigned int face)
+{
+	// An up to date .dds only needs reading; it's already compressed and mipped
+	bool current = texture.Packed ? IsPackedTextureCurrent(texture.FilePaths.data()) :
+		texture.FilePaths.size() == 1 && IsCookedTextureCurrent(texture.FilePaths[0]);
+	if (current)
+	{
+		std::ifstream file(texture.CookedPath, std::ios::binary | std::ios::ate);
+		if (file)
+		{
+			texture.CookedFile.resize((size_t)file.tellg());
+			file.seekg(0);
+			file.read(texture.CookedFile.data(), texture.CookedFile.size());
+			texture.Cooked = file.good();
+			if (texture.Cooked) { return; }
+		}
+	}
+
+	if (texture.Packed)
+	{
+		DecodePacked(texture);
+		return;
+	}
+
+	TextureImage image;
+	if (!DecodeTextureImage(texture.FilePaths[face], image))
+	{
+		std::wcerr << L"Could not load texture " << texture.FilePaths[face] << std::endl;
+		texture.Failed = true;
+		return;
+	}
+	texture.Widths[face] = image.Width;
+	texture.Heights[face] = image.Height;
+
+	unsigned int channels = texture.BytesPerPixel;
+	if (channels == 4)
+	{
+		texture.Pixels[face].swap(image.Pixels);
+		return;
+	}
+	size_t pixelCount = (size_t)image.Width * image.Height;
+	texture.Pixels[face].resize(pixelCount * channels);
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		for (unsigned int c = 0; c < channels; c++) { texture.Pixels[face][i * channels + c] = image.Pixels[i * 4 + c]; }
+	}
+}
+
+void TextureLoader::DecodePacked(PendingTexture& texture)
+{
+	TextureImage images[TEXTURE_PACKED_CHANNEL_COUNT];
+	const TextureImage* channels[TEXTURE_PACKED_CHANNEL_COUNT] = {};
+	for (int c = 0; c < TEXTURE_PACKED_CHANNEL_COUNT; c++)
+	{
+		if (texture.FilePaths[c].empty())
+			continue;
+		if (!DecodeTextureImage(texture.FilePaths[c], images[c]))
+		{
+			std::wcerr << L"Could not load texture " << texture.FilePaths[c] << std::endl;
+			texture.Failed = true;
+			return;
+		}
+		channels[c] = &images[c];
+	}
+
+	TextureImage packed;
+	if (!PackTextureChannels(channels, packed))
+	{
+		std::wcerr << L"Could not pack " << texture.CookedPath << L": its maps have changed size" << std::endl;
+		texture.Failed = true;
+		return;
+	}
+	texture.Widths[0] = packed.Width;
+	texture.Heights[0] = packed.Height;
+	texture.Pixels[0].swap(packed.Pixels);
+}
+
+// Bytes taken by one mip level
+static size_t GetSurfaceBytes(DXGI_FORMAT format, unsigned int width, unsigned int height)
+{
+	size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM: case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_UNORM: case DXGI_FORMAT_BC4_SNORM:
+		return blocks * 8;
+	case DXGI_FORMAT_BC2_UNORM: case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM: case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_UNORM: case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_UF16: case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_UNORM: case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return blocks * 16;
+	case DXGI_FORMAT_R8_UNORM: case DXGI_FORMAT_A8_UNORM:
+		return (size_t)width * height;
+	case DXGI_FORMAT_R8G8_UNORM: case DXGI_FORMAT_R16_UNORM: case DXGI_FORMAT_R16_FLOAT: case DXGI_FORMAT_B5G6R5_UNORM:
+		return (size_t)width * height * 2;
+	case DXGI_FORMAT_R16G16B16A16_UNORM: case DXGI_FORMAT_R16G16B16A16_FLOAT: case DXGI_FORMAT_R32G32_FLOAT:
+		return (size_t)width * height * 8;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return (size_t)width * height * 16;
+	default:
+		return (size_t)width * height * 4;
+	}
+}
+
+// Bytes taken by every mip and array slice of the texture behind a view
+static size_t GetGPUMemory(ID3D11ShaderResourceView* srv)
+{
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	srv->GetResource(resource.GetAddressOf());
+	if (FAILED(resource.As(&texture)))
+		return 0;
+
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+	size_t bytes = 0;
+	for (unsigned int mip = 0; mip < desc.MipLevels; mip++)
+	{
+		bytes += GetSurfaceBytes(desc.Format, std::max(1u, desc.Width >> mip), std::max(1u, desc.Height >> mip)) * desc.ArraySize;
+	}
+	return bytes;
+}
+
+bool TextureLoader::Create(PendingTexture& texture)
+{
+	if (texture.Failed)
+		return false;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv = *texture.Target;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> resource;
+	HRESULT hr;
+	bool streamed = false;
+	if (texture.Cooked && streamer)
+	{
+		streamed = streamer->CreateTexture(texture.CookedPath, texture.CookedFile, srv);
+	}
+
+	if (streamed)
+	{
+		hr = S_OK;
+	}
+	else if (texture.Cooked)
+	{
+		hr = DirectX::CreateDDSTextureFromMemory(device.Get(), (const uint8_t*)texture.CookedFile.data(), texture.CookedFile.size(),
+			nullptr, srv.ReleaseAndGetAddressOf());
+	}
+	else if (texture.FilePaths.size() == 6)
+	{
+		for (int f = 1; f < 6; f++)
+		{
+			if (texture.Widths[f] != texture.Widths[0] || texture.Heights[f] != texture.Heights[0])
+			{
+				std::wcerr << L"Could not create cube map: " << texture.FilePaths[f] << L" is a different size to the first face" << std::endl;
+				return false;
+			}
+		}
+
+		// No mips, the sky is never minified much
+		D3D11_TEXTURE2D_DESC cubeDesc = {};
+		cubeDesc.Width = texture.Widths[0];
+		cubeDesc.Height = texture.Heights[0];
+		cubeDesc.MipLevels = 1;
+		cubeDesc.ArraySize = 6;
+		cubeDesc.Format = texture.Format;
+		cubeDesc.SampleDesc.Count = 1;
+		cubeDesc.Usage = D3D11_USAGE_DEFAULT;
+		cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+		D3D11_SUBRESOURCE_DATA faces[6] = {};
+		for (int f = 0; f < 6; f++)
+		{
+			faces[f].pSysMem = texture.Pixels[f].data();
+			faces[f].SysMemPitch = texture.Widths[0] * texture.BytesPerPixel;
+		}
+		hr = device->CreateTexture2D(&cubeDesc, faces, resource.GetAddressOf());
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = cubeDesc.Format;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+		srvDesc.TextureCube.MipLevels = 1;
+		srvDesc.TextureCube.MostDetailedMip = 0;
+		if (SUCCEEDED(hr)) { hr = device->CreateShaderResourceView(resource.Get(), &srvDesc, srv.ReleaseAndGetAddressOf()); }
+	}
+	else
+	{
+		// Full mip chain, filled in on the GPU from the top level
+		D3D11_TEXTURE2D_DESC desc = {};
+		desc.Width = texture.Widths[0];
+		desc.Height = texture.Heights[0];
+		desc.MipLevels = 0;
+		desc.ArraySize = 1;
+		desc.Format = texture.Format;
+		desc.SampleDesc.Count = 1;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+		hr = device->CreateTexture2D(&desc, nullptr, resource.GetAddressOf());
+		if (SUCCEEDED(hr)) { hr = device->CreateShaderResourceView(resource.Get(), nullptr, srv.ReleaseAndGetAddressOf()); }
+		if (SUCCEEDED(hr))
+		{
+			context->UpdateSubresource(resource.Get(), 0, nullptr, texture.Pixels[0].data(), texture.Widths[0] * texture.BytesPerPixel, 0);
+			context->GenerateMips(srv.Get());
+		}
+	}
+
+	if (FAILED(hr))
+	{
+		std::wcerr << L"Could not create texture " << (texture.Packed ? texture.CookedPath : texture.FilePaths[0]) << std::endl;
+		return false;
+	}
+
+	stats.Textures++;
+	if (texture.Cooked) { stats.Cooked++; }
+	if (streamed) { stats.Streamed++; }
+	stats.GPUBytes += GetGPUMemory(srv.Get());
+	return true;
+}
+
+unsigned int TextureLoader::Finish()
+{
+	if (pendingCount == 0)
+		return 0;
+
+	unsigned int created = 0;
+	std::deque<std::shared_ptr<PendingTexture>> batch;
+	while (pendingCount > 0)
+	{
+		// Take whatever has finished decoding, so resource creation overlaps the remaining decodes
+		{
+			std::unique_lock<std::mutex> lock(completedMutex);
+			completedCondition.wait(lock, [this]() { return !completed.empty(); });
+			batch.swap(completed);
+		}
+		for (std::shared_ptr<PendingTexture>& texture : batch)
+		{
+			if (Create(*texture)) { created++; }
+			pendingCount--;
+		}
+		batch.clear();
+	}
+
+	stats.LoadTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - batchStart).count();
+	return created;
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include "ThreadPool.h"
+#include "TextureCompression.h"
+
+class TextureStreamer;
+
+// --------------------------------------------------------
+// Loads textures on worker threads
+//
+// Load() and LoadCubemap() only queue the work: a worker
+// reads the cooked .dds (see TextureCooker) or decodes the
+// source with WIC, and each cube map face gets its own.
+// LoadPacked() combines a material's single channel maps
+// of one size into one texture, loading any smaller ones on
+// their own. Finish() then runs on the render thread,
+// creating the GPU resources in batches as decodes complete
+// and filling in the ComPtrs handed to Load().
+//
+// With a TextureStreamer attached, cooked textures only get
+// their low mips here and the streamer handles the rest.
+// --------------------------------------------------------
+
+// Totals for every texture a TextureLoader has created
+struct TextureLoadStats
+{
+	unsigned int Textures;
+	unsigned int Cooked;			// Loaded from a .dds instead of the source
+	unsigned int Streamed;			// Cooked textures handed to a TextureStreamer
+	size_t GPUBytes;				// Every mip of every texture, as created (streamed textures only have their tails)
+	float LoadTime;					// Milliseconds from the first Load() until Finish() returned
+};
+
+// What packing does for one material's maps (see TextureLoader::LoadPacked()), with every map as
+// cooked: BC4 on its own, BC7 in the pack
+struct TexturePackStats
+{
+	std::string Name;				// The packed .dds's file name
+	unsigned int Maps;
+	unsigned int PackedMaps;		// 0 if no two maps are the same size
+	unsigned int Samples;			// Per pixel: one for the pack, plus one per map left out
+	size_t SeparateBytes;			// Every map on its own, all mips
+	size_t Bytes;					// The pack plus the maps left out of it
+	float SeparateTexelBytes;		// Read per pixel from the top mips, every map on its own (0.5 per BC4 map)
+	float TexelBytes;				// Read per pixel with the pack (1 for the BC7 pack)
+};
+
+class TextureLoader
+{
+public:
+	/// <summary>
+	/// Starts the worker threads
+	/// </summary>
+	/// <param name="threadCount">Number of worker threads (0 = one less than the hardware thread count)</param>
+	TextureLoader(Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+		Microsoft::WRL::ComPtr<ID3D11Device> _device,
+		unsigned int threadCount = 0);
+
+	/// <summary>
+	/// Queues a texture. Sources without an up to date .dds get mips generated on the GPU,
+	/// and single channel maps and normal maps are uploaded as R8 and R8G8 (see GetTextureCookSettings()).
+	/// </summary>
+	/// <param name="filePath">Path to the source image</param>
+	/// <param name="srv">Filled in by Finish(); must stay alive until then</param>
+	void Load(const std::wstring& filePath, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
+	/// <summary>
+	/// Queues six images to become the faces of a cube map (no mips)
+	/// </summary>
+	/// <param name="faceFilePaths">+X, -X, +Y, -Y, +Z, -Z</param>
+	/// <param name="srv">Filled in by Finish(); must stay alive until then</param>
+	void LoadCubemap(const std::wstring faceFilePaths[6], Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
+	/// <summary>
+	/// Queues a material's occlusion, roughness, metalness and opacity maps. Those the size of the largest
+	/// become one RGBA texture (see ChoosePackedChannels() and PackTextureChannels()), read from the cooked
+	/// _orm.dds when it's up to date; the rest are loaded on their own, as by Load(). Reads the maps'
+	/// headers on this thread to pick.
+	/// </summary>
+	/// <param name="channelFilePaths">Map for each TexturePackedChannel (empty for the default)</param>
+	/// <param name="srv">Filled in by Finish(), or left null if nothing is packed; must stay alive until then</param>
+	/// <param name="channelSRVs">Filled in by Finish() for each map left out of the pack; must stay alive until then</param>
+	void LoadPacked(const std::wstring channelFilePaths[TEXTURE_PACKED_CHANNEL_COUNT], Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv,
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> channelSRVs[TEXTURE_PACKED_CHANNEL_COUNT]);
+	/// <summary>
+	/// Blocks until every queued texture is decoded, creating the GPU resources as they come in
+	/// </summary>
+	/// <returns>Number of textures created</returns>
+	unsigned int Finish();
+	/// <summary>
+	/// Hands cooked textures created from now on to a streamer, which only uploads their low mips
+	/// </summary>
+	/// <param name="_streamer">Streamer to use (null loads every mip up front)</param>
+	void SetStreamer(TextureStreamer* _streamer) { streamer = _streamer; }
+
+	// Getters
+	TextureLoadStats GetStats() { return stats; }
+	const std::vector<TexturePackStats>& GetPackStats() { return packStats; }
+	unsigned int GetThreadCount() { return pool.GetThreadCount(); }
+
+private:
+	struct PendingTexture
+	{
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* Target;
+		std::vector<std::wstring> FilePaths;		// One, six for a cube map (a task each) or one per packed channel
+		bool Packed;
+		std::wstring CookedPath;					// The .dds that replaces FilePaths
+		std::atomic<unsigned int> FacesLeft;		// Decodes still running
+		std::atomic<bool> Failed;
+		bool Cooked;
+		std::vector<char> CookedFile;				// Contents of the .dds
+		DXGI_FORMAT Format;							// Of the decoded pixels
+		unsigned int BytesPerPixel;
+		unsigned int Widths[6];
+		unsigned int Heights[6];
+		std::vector<unsigned char> Pixels[6];		// Decoded pixels, per face
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+
+	// Decodes finished by the workers, waiting for Finish()
+	std::mutex completedMutex;
+	std::condition_variable completedCondition;
+	std::deque<std::shared_ptr<PendingTexture>> completed;
+
+	// Render thread only
+	TextureStreamer* streamer;
+	unsigned int pendingCount;
+	std::chrono::high_resolution_clock::time_point batchStart;
+	TextureLoadStats stats;
+	std::vector<TexturePackStats> packStats;
+
+	// Declared last so the workers are joined before anything they use is destroyed
+	ThreadPool pool;
+
+	void Queue(std::shared_ptr<PendingTexture> texture);
+	void Decode(PendingTexture& texture, unsigned int face);
+	void DecodePacked(PendingTexture& texture);
+	bool Create(PendingTexture& texture);
+};
@@ -0,0 +1,158 @@
+#include "TextureResidency.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+TextureResidency::TextureResidency(size_t budgetBytes, unsigned int _maxPendingLoads) :
+	budget(budgetBytes),
+	residentBytes(0),
+	pendingBytes(0),
+	maxPendingLoads(std::max(1u, _maxPendingLoads)),
+	pendingLoads(0),
+	frame(1),	// Mips start out last needed in frame 0, so nothing looks needed before its first request
+	loadCount(0),
+	evictionCount(0)
+{
+}
+
+unsigned int TextureResidency::AddTexture(const std::vector<size_t>& mipBytes, unsigned int tailMip)
+{
+	TrackedTexture texture;
+	texture.MipBytes = mipBytes;
+	texture.MipLastNeeded.assign(mipBytes.size(), 0);
+	texture.TailMip = mipBytes.empty() ? 0 : std::min(tailMip, (unsigned int)mipBytes.size() - 1);
+	texture.ResidentMip = texture.TailMip;
+	texture.RequestedMip = texture.TailMip;
+	texture.Loading = false;
+	texture.Failed = false;
+	for (size_t mip = texture.TailMip; mip < mipBytes.size(); mip++) { residentBytes += mipBytes[mip]; }
+
+	textures.push_back(texture);
+	return (unsigned int)textures.size() - 1;
+}
+
+void TextureResidency::Request(unsigned int texture, float mip)
+{
+	TrackedTexture& tracked = textures[texture];
+	unsigned int requested = tracked.TailMip;
+	if (mip <= 0.0f)
+		requested = 0;
+	else if (mip < (float)tracked.TailMip)
+		requested = (unsigned int)mip;
+	tracked.RequestedMip = std::min(tracked.RequestedMip, requested);
+}
+
+bool TextureResidency::Evict(bool onlyUnneeded, std::vector<TextureResidencyChange>& changes)
+{
+	// The least recently needed top mip, the biggest one on a tie
+	TrackedTexture* victim = nullptr;
+	unsigned int victimIndex = 0;
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		TrackedTexture& texture = textures[i];
+		if (texture.Loading || texture.ResidentMip >= texture.TailMip)
+			continue;
+		unsigned int lastNeeded = texture.MipLastNeeded[texture.ResidentMip];
+		if (onlyUnneeded && lastNeeded == frame)
+			continue;
+		if (!victim || lastNeeded < victim->MipLastNeeded[victim->ResidentMip] ||
+			(lastNeeded == victim->MipLastNeeded[victim->ResidentMip] &&
+				texture.MipBytes[texture.ResidentMip] > victim->MipBytes[victim->ResidentMip]))
+		{
+			victim = &texture;
+			victimIndex = i;
+		}
+	}
+	if (!victim)
+		return false;
+
+	residentBytes -= victim->MipBytes[victim->ResidentMip];
+	changes.push_back({ victimIndex, victim->ResidentMip, false });
+	victim->ResidentMip++;
+	evictionCount++;
+	return true;
+}
+
+void TextureResidency::Update(std::vector<TextureResidencyChange>& changes)
+{
+	changes.clear();
+
+	// Remember what this frame needed, for choosing what to evict later
+	for (TrackedTexture& texture : textures)
+	{
+		for (unsigned int mip = texture.RequestedMip; mip < texture.TailMip; mip++) { texture.MipLastNeeded[mip] = frame; }
+	}
+
+	// Get back under the budget if it was lowered, giving up needed mips only as a last resort
+	while (residentBytes + pendingBytes > budget && Evict(false, changes)) {}
+
+	// Load the next mip of the textures furthest from their requests first, cheapest first on a tie
+	std::vector<unsigned int> candidates;
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		TrackedTexture& texture = textures[i];
+		if (!texture.Loading && !texture.Failed && texture.RequestedMip < texture.ResidentMip)
+			candidates.push_back(i);
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](unsigned int a, unsigned int b)
+	{
+		TrackedTexture& textureA = textures[a];
+		TrackedTexture& textureB = textures[b];
+		unsigned int missingA = textureA.ResidentMip - textureA.RequestedMip;
+		unsigned int missingB = textureB.ResidentMip - textureB.RequestedMip;
+		if (missingA != missingB)
+			return missingA > missingB;
+		return textureA.MipBytes[textureA.ResidentMip - 1] < textureB.MipBytes[textureB.ResidentMip - 1];
+	});
+	for (unsigned int i : candidates)
+	{
+		if (pendingLoads >= maxPendingLoads)
+			break;
+
+		// Only mips nobody asked for this frame make room, so needed mips never trade places
+		TrackedTexture& texture = textures[i];
+		size_t bytes = texture.MipBytes[texture.ResidentMip - 1];
+		while (residentBytes + pendingBytes + bytes > budget && Evict(true, changes)) {}
+		if (residentBytes + pendingBytes + bytes > budget)
+			continue;
+
+		texture.Loading = true;
+		pendingBytes += bytes;
+		pendingLoads++;
+		loadCount++;
+		changes.push_back({ i, texture.ResidentMip - 1, true });
+	}
+
+	// Start collecting the next frame's requests
+	for (TrackedTexture& texture : textures) { texture.RequestedMip = texture.TailMip; }
+	frame++;
+}
+
+void TextureResidency::FinishLoad(unsigned int texture, bool succeeded)
+{
+	TrackedTexture& tracked = textures[texture];
+	if (!tracked.Loading)
+		return;
+
+	size_t bytes = tracked.MipBytes[tracked.ResidentMip - 1];
+	tracked.Loading = false;
+	pendingLoads--;
+	pendingBytes -= bytes;
+	if (succeeded)
+	{
+		tracked.ResidentMip--;
+		residentBytes += bytes;
+	}
+	else
+	{
+		tracked.Failed = true;
+	}
+}
+
+float ComputeTextureMip(unsigned int textureSize, float uvDensity, float objectRadius, float projectedRadius)
+{
+	float texels = textureSize * uvDensity * objectRadius;
+	if (projectedRadius <= 0.0f || texels <= 0.0f)
+		return FLT_MAX;
+	return std::log2(texels / projectedRadius);
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// --------------------------------------------------------
+// Decides which mips of each streamed texture should be in
+// GPU memory, without touching the GPU
+//
+// Every frame, whatever draws a texture calls Request() with
+// the mip it needs (see ComputeTextureMip()). Update() then
+// asks for at most one more detailed mip per texture at a
+// time, making room under the budget by evicting the mips
+// that were needed least recently. The low mip tail given to
+// AddTexture() is always resident. TextureStreamer carries
+// the decisions out.
+// --------------------------------------------------------
+
+// One decision made by TextureResidency::Update()
+struct TextureResidencyChange
+{
+	unsigned int Texture;
+	unsigned int Mip;
+	bool Load;						// True: read Mip then call FinishLoad(). False: Mip was evicted.
+};
+
+class TextureResidency
+{
+public:
+	/// <summary>
+	/// Creates an empty residency tracker
+	/// </summary>
+	/// <param name="budgetBytes">Most memory all resident and loading mips may take (the tails are counted, but never evicted)</param>
+	/// <param name="maxPendingLoads">Most mip loads in flight at once</param>
+	TextureResidency(size_t budgetBytes, unsigned int maxPendingLoads = 4);
+
+	/// <summary>
+	/// Starts tracking a texture
+	/// </summary>
+	/// <param name="mipBytes">Size of every mip, most detailed first</param>
+	/// <param name="tailMip">Most detailed mip of the always resident tail</param>
+	/// <returns>The texture's index</returns>
+	unsigned int AddTexture(const std::vector<size_t>& mipBytes, unsigned int tailMip);
+	/// <summary>
+	/// Asks for a texture to be resident down to a mip this frame. Requests
+	/// are combined until Update(), keeping the most detailed.
+	/// </summary>
+	/// <param name="texture">Index from AddTexture()</param>
+	/// <param name="mip">Fractional mip level, rounded down (negative asks for mip 0)</param>
+	void Request(unsigned int texture, float mip);
+	/// <summary>
+	/// Evicts and queues loads for this frame's requests, then starts the next frame
+	/// </summary>
+	/// <param name="changes">Receives the decisions (cleared first). Evictions are already applied.</param>
+	void Update(std::vector<TextureResidencyChange>& changes);
+	/// <summary>
+	/// Reports that a load from Update() has been done
+	/// </summary>
+	/// <param name="texture">Index from AddTexture()</param>
+	/// <param name="succeeded">False stops the texture streaming any further</param>
+	void FinishLoad(unsigned int texture, bool succeeded);
+
+	// Getters
+	unsigned int GetTextureCount() { return (unsigned int)textures.size(); }
+	unsigned int GetResidentMip(unsigned int texture) { return textures[texture].ResidentMip; }
+	unsigned int GetRequestedMip(unsigned int texture) { return textures[texture].RequestedMip; }
+	bool IsLoading(unsigned int texture) { return textures[texture].Loading; }
+	size_t GetResidentBytes() { return residentBytes; }
+	size_t GetPendingBytes() { return pendingBytes; }
+	size_t GetBudget() { return budget; }
+	unsigned int GetFrame() { return frame; }
+	unsigned int GetLoadCount() { return loadCount; }
+	unsigned int GetEvictionCount() { return evictionCount; }
+
+	// Setters
+	/// <summary>
+	/// Changes the budget; the next Update() evicts down to it if needed
+	/// </summary>
+	void SetBudget(size_t budgetBytes) { budget = budgetBytes; }
+
+private:
+	struct TrackedTexture
+	{
+		std::vector<size_t> MipBytes;
+		std::vector<unsigned int> MipLastNeeded;	// Frame each mip was last requested in
+		unsigned int TailMip;
+		unsigned int ResidentMip;					// Most detailed resident mip
+		unsigned int RequestedMip;					// This frame's request (TailMip if none)
+		bool Loading;								// ResidentMip - 1 is being read
+		bool Failed;
+	};
+
+	std::vector<TrackedTexture> textures;
+	size_t budget;
+	size_t residentBytes;
+	size_t pendingBytes;
+	unsigned int maxPendingLoads;
+	unsigned int pendingLoads;
+	unsigned int frame;
+	unsigned int loadCount;
+	unsigned int evictionCount;
+
+	bool Evict(bool onlyUnneeded, std::vector<TextureResidencyChange>& changes);
+};
+
+/// <summary>
+/// Picks the mip that gives roughly one texel per pixel across an object
+/// </summary>
+/// <param name="textureSize">Width or height of the texture's top mip, in texels</param>
+/// <param name="uvDensity">UV units per object space unit on the surface (see Mesh::GetUVDensity()), times any UV scale</param>
+/// <param name="objectRadius">Bounding radius in object space</param>
+/// <param name="projectedRadius">The world space (scaled) radius on screen, in pixels</param>
+/// <returns>Fractional mip level (0 or less means the top mip is needed, FLT_MAX if nothing is visible)</returns>
+float ComputeTextureMip(unsigned int textureSize, float uvDensity, float objectRadius, float projectedRadius);
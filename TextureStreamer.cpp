@@ -0,0 +1,187 @@
+#include "TextureStreamer.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <unordered_set>
+
+TextureStreamer::TextureStreamer(Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+	Microsoft::WRL::ComPtr<ID3D11Device> _device,
+	size_t budgetBytes,
+	unsigned int _tailSize) :
+	context(_context),
+	device(_device),
+	tailSize(_tailSize),
+	residency(budgetBytes),
+	pool(1)		// Reads are small and sequential, one worker keeps them off the render thread
+{
+}
+
+bool TextureStreamer::CreateTexture(const std::wstring& cookedFilePath, const std::vector<char>& dds,
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv)
+{
+	StreamedTexture texture;
+	texture.FilePath = cookedFilePath;
+	if (!ReadCookedTextureLayout((const unsigned char*)dds.data(), dds.size(), dds.size(), texture.Layout))
+		return false;
+
+	// The tail starts at the first mip within tailSize, as long as it's still made of whole
+	// blocks (D3D needs the top level of a block compressed texture to be a multiple of 4)
+	const CookedTextureLayout& layout = texture.Layout;
+	unsigned int mipCount = (unsigned int)layout.MipSizes.size();
+	unsigned int tailMip = 0;
+	while (tailMip + 1 < mipCount && std::max(layout.Width, layout.Height) >> tailMip > tailSize) { tailMip++; }
+	while (tailMip > 0 && (((layout.Width >> tailMip) % 4) != 0 || ((layout.Height >> tailMip) % 4) != 0)) { tailMip--; }
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = std::max(1u, layout.Width >> tailMip);
+	desc.Height = std::max(1u, layout.Height >> tailMip);
+	desc.MipLevels = mipCount - tailMip;
+	desc.ArraySize = 1;
+	desc.Format = (DXGI_FORMAT)layout.Format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	std::vector<D3D11_SUBRESOURCE_DATA> data(desc.MipLevels);
+	for (unsigned int mip = tailMip; mip < mipCount; mip++)
+	{
+		data[mip - tailMip].pSysMem = dds.data() + layout.MipOffsets[mip];
+		data[mip - tailMip].SysMemPitch = ((std::max(1u, layout.Width >> mip) + 3) / 4) * layout.BlockSize;
+	}
+	if (FAILED(device->CreateTexture2D(&desc, data.data(), texture.Texture.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(texture.Texture.Get(), nullptr, texture.View.GetAddressOf())))
+		return false;
+	texture.TopMip = tailMip;
+
+	srv = texture.View;
+	residency.AddTexture(layout.MipSizes, tailMip);
+	textures.push_back(texture);
+	return true;
+}
+
+void TextureStreamer::TrackMaterials(const std::vector<std::shared_ptr<Material>>& materials)
+{
+	std::unordered_map<ID3D11ShaderResourceView*, unsigned int> views;
+	for (unsigned int i = 0; i < textures.size(); i++) { views[textures[i].View.Get()] = i; }
+
+	for (const std::shared_ptr<Material>& material : materials)
+	{
+		for (auto& t : material->GetTextureSRVs())
+		{
+			auto found = views.find(t.second.Get());
+			if (found == views.end())
+				continue;
+			textures[found->second].Bindings.push_back({ material.get(), t.first });
+			materialTextures[material.get()].push_back(found->second);
+		}
+	}
+}
+
+void TextureStreamer::RequestMaterial(Material* material, float uvDensity, float objectRadius, float projectedRadius)
+{
+	auto found = materialTextures.find(material);
+	if (found == materialTextures.end())
+		return;
+
+	// Tiling the UVs packs more texels into the same space
+	DirectX::XMFLOAT2 uvScale = material->GetUVScale();
+	float density = uvDensity * std::max(fabsf(uvScale.x), fabsf(uvScale.y));
+	for (unsigned int texture : found->second)
+	{
+		const CookedTextureLayout& layout = textures[texture].Layout;
+		residency.Request(texture, ComputeTextureMip(std::max(layout.Width, layout.Height), density, objectRadius, projectedRadius));
+	}
+}
+
+bool TextureStreamer::Resize(StreamedTexture& texture, unsigned int topMip, const std::vector<char>* topMipData)
+{
+	// Every level below the new top one is already on the GPU
+	const CookedTextureLayout& layout = texture.Layout;
+	unsigned int mipCount = (unsigned int)layout.MipSizes.size();
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = std::max(1u, layout.Width >> topMip);
+	desc.Height = std::max(1u, layout.Height >> topMip);
+	desc.MipLevels = mipCount - topMip;
+	desc.ArraySize = 1;
+	desc.Format = (DXGI_FORMAT)layout.Format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> resized;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view;
+	if (FAILED(device->CreateTexture2D(&desc, nullptr, resized.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(resized.Get(), nullptr, view.GetAddressOf())))
+	{
+		std::wcerr << L"Could not resize streamed texture " << texture.FilePath << std::endl;
+		return false;
+	}
+
+	for (unsigned int mip = topMip; mip < mipCount; mip++)
+	{
+		if (mip >= texture.TopMip)
+		{
+			context->CopySubresourceRegion(resized.Get(), mip - topMip, 0, 0, 0, texture.Texture.Get(), mip - texture.TopMip, nullptr);
+		}
+		else if (topMipData)
+		{
+			UINT rowPitch = ((std::max(1u, layout.Width >> mip) + 3) / 4) * layout.BlockSize;
+			context->UpdateSubresource(resized.Get(), mip - topMip, nullptr, topMipData->data(), rowPitch, 0);
+		}
+	}
+
+	texture.Texture = resized;
+	texture.View = view;
+	texture.TopMip = topMip;
+	for (auto& binding : texture.Bindings) { binding.first->SetTextureSRV(binding.second, view); }
+	return true;
+}
+
+void TextureStreamer::Update()
+{
+	// Add the mips the worker has read
+	std::deque<LoadedMip> batch;
+	{
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		batch.swap(loaded);
+	}
+	for (LoadedMip& mip : batch)
+	{
+		bool succeeded = mip.Succeeded && Resize(textures[mip.Texture], mip.Mip, &mip.Data);
+		if (!mip.Succeeded)
+			std::wcerr << L"Could not read mip " << mip.Mip << L" of " << textures[mip.Texture].FilePath << std::endl;
+		residency.FinishLoad(mip.Texture, succeeded);
+	}
+
+	// Decide what to load and evict for the last frame's requests
+	residency.Update(changes);
+	std::unordered_set<unsigned int> evicted;
+	for (const TextureResidencyChange& change : changes)
+	{
+		if (!change.Load)
+		{
+			evicted.insert(change.Texture);
+			continue;
+		}
+
+		const StreamedTexture& texture = textures[change.Texture];
+		std::wstring filePath = texture.FilePath;
+		size_t offset = texture.Layout.MipOffsets[change.Mip];
+		size_t size = texture.Layout.MipSizes[change.Mip];
+		LoadedMip request = { change.Texture, change.Mip, {}, false };
+		pool.Enqueue([this, filePath, offset, size, request]() mutable
+		{
+			std::ifstream file(filePath, std::ios::binary);
+			request.Data.resize(size);
+			file.seekg(offset);
+			file.read(request.Data.data(), size);
+			request.Succeeded = file.good();
+
+			std::lock_guard<std::mutex> lock(loadedMutex);
+			loaded.push_back(std::move(request));
+		});
+	}
+
+	// Evicted textures drop their top levels in one go
+	for (unsigned int texture : evicted) { Resize(textures[texture], residency.GetResidentMip(texture), nullptr); }
+}
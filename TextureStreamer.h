@@ -0,0 +1,117 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "TextureCompression.h"
+#include "TextureResidency.h"
+#include "Material.h"
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Streams the mips of cooked textures in and out of GPU
+// memory under a budget
+//
+// Textures start with only their low mip tail. Each frame,
+// RequestMaterial() turns an object's size on screen into
+// the mips its material needs, and Update() carries out
+// TextureResidency's decisions: a worker reads one more mip
+// from the .dds at a time, and the texture is recreated
+// with one more (or fewer) level, copying the levels it
+// already had on the GPU. Materials bound to a texture get
+// the new view swapped in.
+// --------------------------------------------------------
+
+class TextureStreamer
+{
+public:
+	/// <summary>
+	/// Starts the worker thread
+	/// </summary>
+	/// <param name="budgetBytes">GPU memory every streamed texture may take together</param>
+	/// <param name="tailSize">Textures keep every mip this size or smaller resident</param>
+	TextureStreamer(Microsoft::WRL::ComPtr<ID3D11DeviceContext> _context,
+		Microsoft::WRL::ComPtr<ID3D11Device> _device,
+		size_t budgetBytes,
+		unsigned int tailSize = 64);
+
+	/// <summary>
+	/// Creates the low mip tail of a cooked texture and starts streaming the rest
+	/// </summary>
+	/// <param name="cookedFilePath">The .dds, read again later for the detailed mips</param>
+	/// <param name="dds">Contents of the .dds (only the tail is uploaded)</param>
+	/// <param name="srv">Receives the view; materials holding it must be passed to TrackMaterials()</param>
+	/// <returns>False if the file isn't in the cooker's layout (load it whole instead)</returns>
+	bool CreateTexture(const std::wstring& cookedFilePath, const std::vector<char>& dds,
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>& srv);
+	/// <summary>
+	/// Finds the streamed textures bound to each material, so new views can be swapped in
+	/// and RequestMaterial() knows what to request
+	/// </summary>
+	void TrackMaterials(const std::vector<std::shared_ptr<Material>>& materials);
+	/// <summary>
+	/// Requests the mips a material's textures need on an object this frame
+	/// </summary>
+	/// <param name="uvDensity">The mesh's UV units per object space unit (Mesh::GetUVDensity())</param>
+	/// <param name="objectRadius">Bounding radius in object space</param>
+	/// <param name="projectedRadius">The world space (scaled) radius on screen, in pixels</param>
+	void RequestMaterial(Material* material, float uvDensity, float objectRadius, float projectedRadius);
+	/// <summary>
+	/// Uploads mips that finished reading, then evicts and starts reads for this frame's requests
+	/// </summary>
+	void Update();
+
+	// Getters
+	unsigned int GetTextureCount() { return residency.GetTextureCount(); }
+	size_t GetResidentBytes() { return residency.GetResidentBytes(); }
+	size_t GetPendingBytes() { return residency.GetPendingBytes(); }
+	size_t GetBudget() { return residency.GetBudget(); }
+	unsigned int GetLoadCount() { return residency.GetLoadCount(); }
+	unsigned int GetEvictionCount() { return residency.GetEvictionCount(); }
+
+	// Setters
+	void SetBudget(size_t budgetBytes) { residency.SetBudget(budgetBytes); }
+
+private:
+	struct StreamedTexture
+	{
+		std::wstring FilePath;
+		CookedTextureLayout Layout;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> View;
+		unsigned int TopMip;								// Layout mip that Texture's level 0 holds
+		std::vector<std::pair<Material*, std::string>> Bindings;	// Materials and shader variables using View
+	};
+
+	// A mip read by the worker
+	struct LoadedMip
+	{
+		unsigned int Texture;
+		unsigned int Mip;
+		std::vector<char> Data;
+		bool Succeeded;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	unsigned int tailSize;
+
+	// Render thread only
+	TextureResidency residency;
+	std::vector<StreamedTexture> textures;					// Same indices as residency
+	std::unordered_map<Material*, std::vector<unsigned int>> materialTextures;
+	std::vector<TextureResidencyChange> changes;
+
+	// Reads finished by the worker, waiting for Update()
+	std::mutex loadedMutex;
+	std::deque<LoadedMip> loaded;
+
+	// Declared last so the worker is joined before anything it uses is destroyed
+	ThreadPool pool;
+
+	bool Resize(StreamedTexture& texture, unsigned int topMip, const std::vector<char>* topMipData);
+};
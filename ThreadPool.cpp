@@ -0,0 +1,67 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount) :
+	runningCount(0),
+	stopping(false)
+{
+	if (threadCount == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+	for (unsigned int i = 0; i < threadCount; i++) { workers.emplace_back(&ThreadPool::WorkerLoop, this); }
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		tasks.clear();
+	}
+	taskAvailable.notify_all();
+	for (std::thread& worker : workers) { worker.join(); }
+}
+
+void ThreadPool::Enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	taskAvailable.notify_one();
+}
+
+void ThreadPool::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return tasks.empty() && runningCount == 0; });
+}
+
+unsigned int ThreadPool::GetQueuedCount()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return (unsigned int)tasks.size();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+		if (stopping) { return; }
+
+		std::function<void()> task = std::move(tasks.front());
+		tasks.pop_front();
+		runningCount++;
+
+		// Run without holding the lock so other workers can take tasks
+		lock.unlock();
+		task();
+		lock.lock();
+
+		runningCount--;
+		if (tasks.empty() && runningCount == 0) { idle.notify_all(); }
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+
+// --------------------------------------------------------
+// A fixed set of worker threads pulling tasks from a FIFO
+// queue. Used for CPU work that shouldn't block the render
+// thread (file parsing, mesh processing, etc).
+//
+// Tasks must not touch the D3D context; anything that needs
+// it should hand its results back to the render thread.
+// --------------------------------------------------------
+class ThreadPool
+{
+public:
+	/// <summary>
+	/// Starts the worker threads
+	/// </summary>
+	/// <param name="threadCount">Number of workers (0 = one less than the hardware thread count, at least 1)</param>
+	explicit ThreadPool(unsigned int threadCount = 0);
+	/// <summary>
+	/// Drops any tasks that haven't started, then waits for running ones to finish
+	/// </summary>
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/// <summary>
+	/// Queues a task to run on the next free worker
+	/// </summary>
+	void Enqueue(std::function<void()> task);
+	/// <summary>
+	/// Blocks until the queue is empty and no task is running
+	/// </summary>
+	void WaitIdle();
+
+	// Getters
+	unsigned int GetThreadCount() { return (unsigned int)workers.size(); }
+	unsigned int GetQueuedCount();
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable idle;
+	unsigned int runningCount;
+	bool stopping;
+
+	void WorkerLoop();
+};
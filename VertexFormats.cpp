@@ -0,0 +1,76 @@
+#include "VertexFormats.h"
+#include <cmath>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+XMFLOAT2 OctahedralEncode(XMFLOAT3 n)
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1
+	float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (l1 <= 0.0f) { return XMFLOAT2(0, 0); }
+	float x = n.x / l1;
+	float y = n.y / l1;
+
+	// Fold the lower half over the diagonals
+	if (n.z < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+	return XMFLOAT2(x, y);
+}
+
+XMFLOAT3 OctahedralDecode(XMFLOAT2 e)
+{
+	XMFLOAT3 n(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+	float t = n.z < 0.0f ? -n.z : 0.0f;
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	XMStoreFloat3(&n, XMVector3Normalize(XMLoadFloat3(&n)));
+	return n;
+}
+
+CompactVertex EncodeCompactVertex(const Vertex& v)
+{
+	CompactVertex c;
+	c.Position = v.Position;
+	XMFLOAT2 normal = OctahedralEncode(v.Normal);
+	XMFLOAT2 tangent = OctahedralEncode(v.Tangent);
+	XMStoreShortN2(&c.Normal, XMLoadFloat2(&normal));
+	XMStoreHalf2(&c.UV, XMLoadFloat2(&v.UV));
+	XMStoreShortN2(&c.Tangent, XMLoadFloat2(&tangent));
+	return c;
+}
+
+QuantizedVertex EncodeQuantizedVertex(const Vertex& v, XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+{
+	CompactVertex c = EncodeCompactVertex(v);
+	QuantizedVertex q;
+	q.Normal = c.Normal;
+	q.UV = c.UV;
+	q.Tangent = c.Tangent;
+
+	// Position as a 0-1 fraction of the bounds (flat axes are all 0)
+	XMVECTOR minV = XMLoadFloat3(&boundsMin);
+	XMVECTOR extent = XMLoadFloat3(&boundsMax) - minV;
+	XMVECTOR safeExtent = XMVectorSelect(extent, XMVectorReplicate(1.0f), XMVectorEqual(extent, XMVectorZero()));
+	XMVECTOR fraction = XMVectorSaturate((XMLoadFloat3(&v.Position) - minV) / safeExtent);
+	XMStoreUShortN4(&q.Position, XMVectorSetW(fraction, 0.0f));
+	return q;
+}
+
+Vertex DecodeCompactVertex(const CompactVertex& c)
+{
+	Vertex v;
+	v.Position = c.Position;
+	XMFLOAT2 normal, tangent;
+	XMStoreFloat2(&normal, XMLoadShortN2(&c.Normal));
+	XMStoreFloat2(&tangent, XMLoadShortN2(&c.Tangent));
+	v.Normal = OctahedralDecode(normal);
+	v.Tangent = OctahedralDecode(tangent);
+	XMStoreFloat2(&v.UV, XMLoadHalf2(&c.UV));
+	return v;
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <d3d11.h>
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// GPU vertex layouts
+//
+// Vertex (Vertex.h) stays the full precision format used by
+// importers and the .mesh cache. Before upload, Mesh encodes
+// it into one of the smaller layouts below.
+//
+// Each layout is described once at compile time as a list of
+// attributes; VertexLayout<> turns that list into the stride
+// and the matching D3D11_INPUT_ELEMENT_DESC array, and a
+// static_assert ties it to the C++ struct it describes.
+//
+// All layouts feed the same VertexShaderInput (ShaderIncludes.hlsli):
+// normals/tangents are octahedral encoded float2s, and the IA
+// converts every position format to float
+// --------------------------------------------------------
+
+// How an attribute is stored
+struct AttribFloat3 { static const DXGI_FORMAT Format = DXGI_FORMAT_R32G32B32_FLOAT; static const unsigned int Size = 12; };
+struct AttribFloat2 { static const DXGI_FORMAT Format = DXGI_FORMAT_R32G32_FLOAT; static const unsigned int Size = 8; };
+struct AttribHalf2 { static const DXGI_FORMAT Format = DXGI_FORMAT_R16G16_FLOAT; static const unsigned int Size = 4; };
+struct AttribSnorm16x2 { static const DXGI_FORMAT Format = DXGI_FORMAT_R16G16_SNORM; static const unsigned int Size = 4; };
+struct AttribUnorm16x4 { static const DXGI_FORMAT Format = DXGI_FORMAT_R16G16B16A16_UNORM; static const unsigned int Size = 8; };
+
+// What an attribute is (semantic names must match VertexShaderInput)
+template <typename Storage> struct PositionAttrib : Storage { static const char* Semantic() { return "POSITION"; } };
+template <typename Storage> struct NormalAttrib : Storage { static const char* Semantic() { return "NORMAL"; } };
+template <typename Storage> struct UVAttrib : Storage { static const char* Semantic() { return "TEXCOORD"; } };
+template <typename Storage> struct TangentAttrib : Storage { static const char* Semantic() { return "TANGENT"; } };
+
+// Sum of attribute sizes
+template <typename... Attributes> struct AttribSize;
+template <> struct AttribSize<> { static const unsigned int Value = 0; };
+template <typename First, typename... Rest> struct AttribSize<First, Rest...>
+{
+	static const unsigned int Value = First::Size + AttribSize<Rest...>::Value;
+};
+
+template <typename... Attributes>
+struct VertexLayout
+{
+	static const unsigned int Stride = AttribSize<Attributes...>::Value;
+	static const unsigned int ElementCount = sizeof...(Attributes);
+
+	/// <summary>
+	/// Fills in the input element descriptions for this layout (in slot 0, tightly packed)
+	/// </summary>
+	/// <param name="elements">Array of at least ElementCount descriptions</param>
+	static void GetInputElements(D3D11_INPUT_ELEMENT_DESC* elements)
+	{
+		const D3D11_INPUT_ELEMENT_DESC descs[] = {
+			{ Attributes::Semantic(), 0, Attributes::Format, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }...
+		};
+		for (unsigned int i = 0; i < ElementCount; i++) { elements[i] = descs[i]; }
+	}
+};
+
+// 24 bytes: float position, octahedral normal/tangent, half float UVs
+struct CompactVertex
+{
+	DirectX::XMFLOAT3 Position;
+	DirectX::PackedVector::XMSHORTN2 Normal;
+	DirectX::PackedVector::XMHALF2 UV;
+	DirectX::PackedVector::XMSHORTN2 Tangent;
+};
+typedef VertexLayout<PositionAttrib<AttribFloat3>, NormalAttrib<AttribSnorm16x2>,
+	UVAttrib<AttribHalf2>, TangentAttrib<AttribSnorm16x2>> CompactVertexLayout;
+static_assert(CompactVertexLayout::Stride == sizeof(CompactVertex), "CompactVertex doesn't match its layout");
+
+// 20 bytes: like CompactVertex, but positions are 16-bit fractions of the mesh's
+// bounds, dequantized by Mesh::GetPositionTransform() (folded into the world matrix)
+struct QuantizedVertex
+{
+	DirectX::PackedVector::XMUSHORTN4 Position;
+	DirectX::PackedVector::XMSHORTN2 Normal;
+	DirectX::PackedVector::XMHALF2 UV;
+	DirectX::PackedVector::XMSHORTN2 Tangent;
+};
+typedef VertexLayout<PositionAttrib<AttribUnorm16x4>, NormalAttrib<AttribSnorm16x2>,
+	UVAttrib<AttribHalf2>, TangentAttrib<AttribSnorm16x2>> QuantizedVertexLayout;
+static_assert(QuantizedVertexLayout::Stride == sizeof(QuantizedVertex), "QuantizedVertex doesn't match its layout");
+
+// Position-only streams for depth passes (Mesh::DrawPositionOnly()), holding just the
+// position of the matching layout above: 12 bytes for compact meshes, 8 for quantized
+typedef VertexLayout<PositionAttrib<AttribFloat3>> CompactPositionLayout;
+static_assert(CompactPositionLayout::Stride == sizeof(DirectX::XMFLOAT3), "Compact positions don't match their layout");
+typedef VertexLayout<PositionAttrib<AttribUnorm16x4>> QuantizedPositionLayout;
+static_assert(QuantizedPositionLayout::Stride == sizeof(DirectX::PackedVector::XMUSHORTN4), "Quantized positions don't match their layout");
+
+// Which layout a mesh's vertex buffer uses
+enum MeshVertexFormat
+{
+	MESH_VERTEX_COMPACT,
+	MESH_VERTEX_QUANTIZED,
+	MESH_VERTEX_FORMAT_COUNT
+};
+
+/// <summary>
+/// Maps a unit vector onto the [-1, 1] octahedral square
+/// </summary>
+DirectX::XMFLOAT2 OctahedralEncode(DirectX::XMFLOAT3 n);
+/// <summary>
+/// Inverse of OctahedralEncode() (matches DecodeOctahedral() in ShaderIncludes.hlsli)
+/// </summary>
+DirectX::XMFLOAT3 OctahedralDecode(DirectX::XMFLOAT2 e);
+
+/// <summary>
+/// Encodes a full precision vertex into the compact layout
+/// </summary>
+CompactVertex EncodeCompactVertex(const Vertex& v);
+/// <summary>
+/// Encodes a full precision vertex into the quantized layout
+/// </summary>
+/// <param name="v">Vertex to encode</param>
+/// <param name="boundsMin">Minimum corner of the mesh's bounds</param>
+/// <param name="boundsMax">Maximum corner of the mesh's bounds</param>
+QuantizedVertex EncodeQuantizedVertex(const Vertex& v, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax);
+/// <summary>
+/// Decodes a compact vertex back to full precision (for error checking)
+/// </summary>
+Vertex DecodeCompactVertex(const CompactVertex& v);